@@ -0,0 +1,69 @@
+/**
+ * @file acq_control.c
+ * @brief Implementação do controle adaptativo da aquisição
+ */
+
+#include "acq_control.h"
+#include <stddef.h>
+
+/**
+ * @brief Inicializa o controle na taxa plena
+ *
+ * @param ac Estado
+ * @param config Parâmetros; NULL usa ACQ_CONTROL_DEFAULT_CONFIG
+ */
+void acq_control_init(acq_control_t *ac, const acq_control_config_t *config) {
+    static const acq_control_config_t defaults = ACQ_CONTROL_DEFAULT_CONFIG;
+    ac->config = (config != NULL) ? *config : defaults;
+    ac->mode = ACQ_MODE_FULL;
+    ac->idle = 0;
+    ac->in_mode = 0;
+    ac->switches = 0;
+    ac->samples[ACQ_MODE_FULL] = ac->samples[ACQ_MODE_QUIET] = 0;
+}
+
+static void set_mode(acq_control_t *ac, acq_mode_t mode) {
+    ac->mode = mode;
+    ac->in_mode = 0;
+    ac->switches++;
+}
+
+/**
+ * @brief Atualiza o modo com o estado do detector em uma amostra NILM
+ *
+ * @param ac Estado
+ * @param activity true se o detector vê mudança em curso
+ * @return true se o modo mudou (o novo modo está em ac->mode)
+ */
+bool acq_control_update(acq_control_t *ac, bool activity) {
+    ac->samples[ac->mode]++;
+    if (ac->in_mode < UINT32_MAX) {
+        ac->in_mode++;
+    }
+
+    if (activity) {
+        ac->idle = 0;
+        if (ac->mode == ACQ_MODE_QUIET) {
+            set_mode(ac, ACQ_MODE_FULL);
+            return true;
+        }
+        return false;
+    }
+
+    if (ac->idle < UINT32_MAX) {
+        ac->idle++;
+    }
+    if (ac->mode == ACQ_MODE_FULL && ac->idle >= ac->config.quiet_after && ac->in_mode >= ac->config.min_full) {
+        set_mode(ac, ACQ_MODE_QUIET);
+        return true;
+    }
+    return false;
+}
+
+/**
+ * @brief Fração das amostras feitas no modo econômico
+ */
+float acq_control_quiet_fraction(const acq_control_t *ac) {
+    uint32_t total = ac->samples[ACQ_MODE_FULL] + ac->samples[ACQ_MODE_QUIET];
+    return total ? (float)ac->samples[ACQ_MODE_QUIET] / (float)total : 0.0f;
+}
@@ -0,0 +1,59 @@
+/**
+ * @file acq_control.h
+ * @brief Controle adaptativo da aquisição: taxa plena com atividade, rajadas em repouso
+ *
+ * Decide, a cada amostra NILM, entre dois modos:
+ *  - ACQ_MODE_FULL: ADC contínuo na taxa plena (transitórios e harmônicas);
+ *  - ACQ_MODE_QUIET: ADC ligado só em uma rajada curta por amostra NILM e
+ *    desligado no resto do período, o que libera o light sleep automático.
+ *
+ * Qualquer atividade do detector volta imediatamente para a taxa plena; o
+ * modo econômico só é retomado depois de quiet_after amostras seguidas sem
+ * atividade e de pelo menos min_full amostras na taxa plena. A máquina de
+ * estados não depende do ESP-IDF; quem liga/desliga o ADC é a task de
+ * aquisição.
+ */
+
+#ifndef ACQ_CONTROL_H
+#define ACQ_CONTROL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * @brief Modo de aquisição
+ */
+typedef enum {
+    ACQ_MODE_FULL = 0,          // ADC contínuo
+    ACQ_MODE_QUIET,             // Rajadas de poucos ciclos da rede por amostra NILM
+} acq_mode_t;
+
+/**
+ * @brief Parâmetros (em amostras NILM)
+ */
+typedef struct {
+    uint32_t quiet_after;       // Amostras sem atividade para entrar no modo econômico
+    uint32_t min_full;          // Permanência mínima na taxa plena depois de uma troca
+} acq_control_config_t;
+
+// A 10 Hz: 30 s sem atividade para economizar, no mínimo 10 s na taxa plena
+#define ACQ_CONTROL_DEFAULT_CONFIG { .quiet_after = 300, .min_full = 100 }
+
+/**
+ * @brief Estado do controle
+ */
+typedef struct {
+    acq_control_config_t config;
+    acq_mode_t mode;
+    uint32_t idle;              // Amostras seguidas sem atividade
+    uint32_t in_mode;           // Amostras no modo atual
+    uint32_t switches;          // Trocas de modo desde o início
+    uint32_t samples[2];        // Amostras em cada modo (ciclo de trabalho)
+} acq_control_t;
+
+// Protótipos de funções
+void acq_control_init(acq_control_t *ac, const acq_control_config_t *config);
+bool acq_control_update(acq_control_t *ac, bool activity);
+float acq_control_quiet_fraction(const acq_control_t *ac);
+
+#endif // ACQ_CONTROL_H
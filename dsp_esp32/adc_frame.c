@@ -0,0 +1,258 @@
+/**
+ * @file adc_frame.c
+ * @brief Implementação do decodificador de quadros do ADC contínuo
+ */
+
+#include "adc_frame.h"
+#include <math.h>
+#include <string.h>
+
+#if ADC_FRAME_USE_CALI
+#include "esp_adc/adc_cali.h"
+#include "esp_adc/adc_cali_scheme.h"
+#include "soc/soc_caps.h"
+_Static_assert(SOC_ADC_DIGI_RESULT_BYTES == ADC_FRAME_WORD_BYTES, "adc_frame decodifica apenas o formato TYPE2 de 32 bits");
+#endif
+
+// Campos da palavra TYPE2 do ESP32-S3 (adc_digi_output_data_t)
+#define ADC_FRAME_CODE_MASK     0x0FFFu
+#define ADC_FRAME_CHANNEL_SHIFT 13
+#define ADC_FRAME_CHANNEL_MASK  0x0Fu
+
+/**
+ * @brief Inicializa o decodificador para um padrão de conversão
+ *
+ * A saída i recebe as amostras de channels[i], com a conversão nominal
+ * 3.3/4095 até que uma calibração seja definida.
+ *
+ * @param dec Decodificador
+ * @param channels Canais do ADC no padrão (adc_channel_t)
+ * @param n_channels Número de canais (<= ADC_FRAME_MAX_CHANNELS)
+ */
+void adc_frame_decoder_init(adc_frame_decoder_t *dec, const uint8_t *channels, uint32_t n_channels) {
+    memset(dec, 0, sizeof(*dec));
+    memset(dec->slot, -1, sizeof(dec->slot));
+
+    if (n_channels > ADC_FRAME_MAX_CHANNELS) {
+        n_channels = ADC_FRAME_MAX_CHANNELS;
+    }
+    dec->n_channels = n_channels;
+    for (uint32_t i = 0; i < n_channels; i++) {
+        dec->channel[i] = channels[i];
+        dec->slot[channels[i] & ADC_FRAME_CHANNEL_MASK] = (int8_t)i;
+        dec->gain[i] = ADC_FRAME_NOMINAL_GAIN;
+    }
+}
+
+/**
+ * @brief Define a conversão linear de uma saída: V = offset + gain * código
+ */
+void adc_frame_set_linear(adc_frame_decoder_t *dec, uint32_t index, float gain, float offset) {
+    dec->gain[index] = gain;
+    dec->offset[index] = offset;
+}
+
+/**
+ * @brief Define a tabela código -> V de uma saída (NULL volta ao ajuste linear)
+ *
+ * @param lut ADC_FRAME_CODE_COUNT tensões; deve permanecer válida
+ */
+void adc_frame_set_lut(adc_frame_decoder_t *dec, uint32_t index, const float *lut) {
+    dec->lut[index] = lut;
+}
+
+/**
+ * @brief Lê uma palavra do quadro e devolve a saída de destino (-1 se descartada)
+ */
+static inline int decode_word(const adc_frame_decoder_t *dec, const uint8_t *raw, uint32_t *code) {
+    uint32_t word;
+    memcpy(&word, raw, sizeof(word));   // Buffer do driver sem alinhamento garantido
+    *code = word & ADC_FRAME_CODE_MASK;
+    return dec->slot[(word >> ADC_FRAME_CHANNEL_SHIFT) & ADC_FRAME_CHANNEL_MASK];
+}
+
+/**
+ * @brief Separa um quadro por canal em códigos de 12 bits
+ *
+ * out[i] recebe as amostras da saída i a partir de counts[i]. A decodificação
+ * para antes da primeira amostra que não cabe (counts[i] == capacity); o
+ * chamador troca o buffer cheio e continua do byte devolvido.
+ *
+ * @param dec Decodificador
+ * @param raw Quadro lido do driver
+ * @param n_bytes Bytes do quadro (múltiplo de ADC_FRAME_WORD_BYTES)
+ * @param out Buffer de destino de cada saída
+ * @param capacity Capacidade de cada buffer (amostras)
+ * @param counts Amostras já presentes em cada buffer (atualizado)
+ * @return Bytes consumidos do quadro
+ */
+size_t adc_frame_decode_codes(adc_frame_decoder_t *dec, const uint8_t *raw, size_t n_bytes,
+                              uint16_t *const out[], size_t capacity, size_t counts[]) {
+    size_t i;
+    for (i = 0; i + ADC_FRAME_WORD_BYTES <= n_bytes; i += ADC_FRAME_WORD_BYTES) {
+        uint32_t code;
+        int s = decode_word(dec, &raw[i], &code);
+        if (s < 0) {
+            dec->discarded++;
+            continue;
+        }
+        if (counts[s] == capacity) {
+            break;
+        }
+        out[s][counts[s]++] = (uint16_t)code;
+    }
+    return i;
+}
+
+/**
+ * @brief Separa um quadro por canal já convertido para tensão calibrada (V)
+ *
+ * Mesma semântica de adc_frame_decode_codes().
+ */
+size_t adc_frame_decode_volts(adc_frame_decoder_t *dec, const uint8_t *raw, size_t n_bytes,
+                              float *const out[], size_t capacity, size_t counts[]) {
+    size_t i;
+    for (i = 0; i + ADC_FRAME_WORD_BYTES <= n_bytes; i += ADC_FRAME_WORD_BYTES) {
+        uint32_t code;
+        int s = decode_word(dec, &raw[i], &code);
+        if (s < 0) {
+            dec->discarded++;
+            continue;
+        }
+        if (counts[s] == capacity) {
+            break;
+        }
+        const float *lut = dec->lut[s];
+        out[s][counts[s]++] = lut ? lut[code] : dec->offset[s] + dec->gain[s] * (float)code;
+    }
+    return i;
+}
+
+#if ADC_FRAME_USE_CALI
+#define ADC_FRAME_FIT_ORDER     5       // Grau do polinômio ajustado à curva do eFuse
+
+/**
+ * @brief Resolve o sistema normal a·c = b (ADC_FRAME_FIT_ORDER + 1 incógnitas) por Gauss com pivô parcial
+ */
+static void solve_normal(double a[ADC_FRAME_FIT_ORDER + 1][ADC_FRAME_FIT_ORDER + 1],
+                         double b[ADC_FRAME_FIT_ORDER + 1], double c[ADC_FRAME_FIT_ORDER + 1]) {
+    const int m = ADC_FRAME_FIT_ORDER + 1;
+    for (int col = 0; col < m; col++) {
+        int pivot = col;
+        for (int r = col + 1; r < m; r++) {
+            if (fabs(a[r][col]) > fabs(a[pivot][col])) {
+                pivot = r;
+            }
+        }
+        for (int k = 0; k < m; k++) {
+            double t = a[col][k];
+            a[col][k] = a[pivot][k];
+            a[pivot][k] = t;
+        }
+        double t = b[col];
+        b[col] = b[pivot];
+        b[pivot] = t;
+
+        for (int r = col + 1; r < m; r++) {
+            double f = a[r][col] / a[col][col];
+            for (int k = col; k < m; k++) {
+                a[r][k] -= f * a[col][k];
+            }
+            b[r] -= f * b[col];
+        }
+    }
+    for (int r = m - 1; r >= 0; r--) {
+        double acc = b[r];
+        for (int k = r + 1; k < m; k++) {
+            acc -= a[r][k] * c[k];
+        }
+        c[r] = acc / a[r][r];
+    }
+}
+
+/**
+ * @brief Calibra uma saída pela curva do eFuse (esquema curve fitting)
+ *
+ * adc_cali_raw_to_voltage() devolve mV inteiros, mais grossos que o LSB
+ * (≈ 0.8 mV a 12 dB): tabelar esse resultado direto faria uma escada na
+ * tensão. A curva do driver é linear mais uma correção polinomial de
+ * baixo grau, então a tabela é preenchida com um polinômio de grau
+ * ADC_FRAME_FIT_ORDER ajustado em double, por mínimos quadrados, aos 4096
+ * pontos: o arredondamento para mV (±0.5 mV) sai pela média e a tabela
+ * segue a curva contínua. O ajuste linear (ganho/offset) é usado sem
+ * tabela e em adc_frame_code_to_volts(). Se o chip não tiver a calibração
+ * gravada, a saída continua com a conversão atual.
+ *
+ * @param dec Decodificador
+ * @param index Saída (ordem do padrão)
+ * @param lut Se não NULL, recebe ADC_FRAME_CODE_COUNT tensões e passa a ser
+ *            usada na decodificação
+ * @return ESP_OK, ou o erro do driver de calibração
+ */
+esp_err_t adc_frame_calibrate(adc_frame_decoder_t *dec, uint32_t index, adc_unit_t unit,
+                              adc_atten_t atten, adc_bitwidth_t bitwidth, float *lut) {
+    adc_cali_curve_fitting_config_t config = {
+        .unit_id = unit,
+        .chan = (adc_channel_t)dec->channel[index],
+        .atten = atten,
+        .bitwidth = bitwidth,
+    };
+    adc_cali_handle_t handle;
+    esp_err_t ret = adc_cali_create_scheme_curve_fitting(&config, &handle);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    // Somas do sistema normal em x = código normalizado para [-1, 1]
+    const double half = (ADC_FRAME_CODE_COUNT - 1) / 2.0;
+    double sxk[2 * ADC_FRAME_FIT_ORDER + 1] = {0};
+    double syxk[ADC_FRAME_FIT_ORDER + 1] = {0};
+    double sx = 0.0, sy = 0.0, sxx = 0.0, sxy = 0.0;
+    for (int code = 0; code < ADC_FRAME_CODE_COUNT; code++) {
+        int mv = 0;
+        ret = adc_cali_raw_to_voltage(handle, code, &mv);
+        if (ret != ESP_OK) {
+            break;
+        }
+        double v = mv * 1e-3;
+        double x = code / half - 1.0, xk = 1.0;
+        for (int k = 0; k <= 2 * ADC_FRAME_FIT_ORDER; k++, xk *= x) {
+            sxk[k] += xk;
+            if (k <= ADC_FRAME_FIT_ORDER) {
+                syxk[k] += v * xk;
+            }
+        }
+        sx += code;
+        sy += v;
+        sxx += (double)code * code;
+        sxy += code * v;
+    }
+    adc_cali_delete_scheme_curve_fitting(handle);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    const double n = ADC_FRAME_CODE_COUNT;
+    double gain = (n * sxy - sx * sy) / (n * sxx - sx * sx);
+    adc_frame_set_linear(dec, index, (float)gain, (float)((sy - gain * sx) / n));
+    if (lut != NULL) {
+        double a[ADC_FRAME_FIT_ORDER + 1][ADC_FRAME_FIT_ORDER + 1];
+        double c[ADC_FRAME_FIT_ORDER + 1];
+        for (int r = 0; r <= ADC_FRAME_FIT_ORDER; r++) {
+            for (int k = 0; k <= ADC_FRAME_FIT_ORDER; k++) {
+                a[r][k] = sxk[r + k];
+            }
+        }
+        solve_normal(a, syxk, c);
+        for (int code = 0; code < ADC_FRAME_CODE_COUNT; code++) {
+            double x = code / half - 1.0, v = 0.0;
+            for (int k = ADC_FRAME_FIT_ORDER; k >= 0; k--) {
+                v = v * x + c[k];
+            }
+            lut[code] = (float)v;
+        }
+        adc_frame_set_lut(dec, index, lut);
+    }
+    return ESP_OK;
+}
+#endif
@@ -0,0 +1,82 @@
+/**
+ * @file adc_frame.h
+ * @brief Decodificação dos quadros do ADC contínuo (demux por canal e calibração)
+ *
+ * Um quadro de conversão é uma sequência de palavras de 32 bits no formato
+ * TYPE2 do ESP32-S3 (código de 12 bits nos bits 0-11, canal nos bits
+ * 13-16). O decodificador percorre o quadro uma vez, separa os canais por
+ * tabela (sem comparação com a lista de canais a cada palavra) e escreve
+ * direto no buffer do consumidor: códigos uint16 para o medidor de potência ou
+ * tensões float já calibradas para a análise.
+ *
+ * A conversão código -> V usa, por canal, a curva de calibração do eFuse
+ * tabelada em float (um acesso por amostra) ou, sem tabela, o ajuste linear dessa
+ * curva (ganho e offset). Sem calibração vale a constante nominal 3.3/4095.
+ *
+ * O núcleo não depende do ESP-IDF (compila também no host); só
+ * adc_frame_calibrate() usa o driver de calibração.
+ */
+
+#ifndef ADC_FRAME_H
+#define ADC_FRAME_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * Calibração pelo eFuse (esp_adc/adc_cali.h). Ativa por padrão no ESP-IDF;
+ * no host o decodificador usa só ganho/offset ou tabelas fornecidas.
+ */
+#ifndef ADC_FRAME_USE_CALI
+#ifdef ESP_PLATFORM
+#define ADC_FRAME_USE_CALI 1
+#else
+#define ADC_FRAME_USE_CALI 0
+#endif
+#endif
+
+#if ADC_FRAME_USE_CALI
+#include "esp_err.h"
+#include "hal/adc_types.h"
+#endif
+
+#define ADC_FRAME_WORD_BYTES        4       // SOC_ADC_DIGI_RESULT_BYTES no ESP32-S3
+#define ADC_FRAME_MAX_CHANNELS      6       // Canais no padrão de conversão (3 fases V/I)
+#define ADC_FRAME_CODE_COUNT        4096    // Códigos de 12 bits (entradas da tabela de calibração)
+#define ADC_FRAME_NOMINAL_GAIN      (3.3f / 4095.0f)   // V por código sem calibração
+
+/**
+ * @brief Estado do decodificador de um padrão de conversão
+ */
+typedef struct {
+    int8_t slot[16];                        // Canal do ADC -> índice de saída (-1 = descartado)
+    uint8_t channel[ADC_FRAME_MAX_CHANNELS];
+    uint32_t n_channels;
+    float gain[ADC_FRAME_MAX_CHANNELS];     // V por código (ajuste linear)
+    float offset[ADC_FRAME_MAX_CHANNELS];   // V no código 0
+    const float *lut[ADC_FRAME_MAX_CHANNELS];   // Código -> V (ADC_FRAME_CODE_COUNT) ou NULL
+    uint32_t discarded;                     // Palavras de canais fora do padrão
+} adc_frame_decoder_t;
+
+// Protótipos de funções
+void adc_frame_decoder_init(adc_frame_decoder_t *dec, const uint8_t *channels, uint32_t n_channels);
+void adc_frame_set_linear(adc_frame_decoder_t *dec, uint32_t index, float gain, float offset);
+void adc_frame_set_lut(adc_frame_decoder_t *dec, uint32_t index, const float *lut);
+size_t adc_frame_decode_codes(adc_frame_decoder_t *dec, const uint8_t *raw, size_t n_bytes,
+                              uint16_t *const out[], size_t capacity, size_t counts[]);
+size_t adc_frame_decode_volts(adc_frame_decoder_t *dec, const uint8_t *raw, size_t n_bytes,
+                              float *const out[], size_t capacity, size_t counts[]);
+
+#if ADC_FRAME_USE_CALI
+esp_err_t adc_frame_calibrate(adc_frame_decoder_t *dec, uint32_t index, adc_unit_t unit,
+                              adc_atten_t atten, adc_bitwidth_t bitwidth, float *lut);
+#endif
+
+/**
+ * @brief Converte um valor em códigos (ex.: média de códigos) para V pelo ajuste linear
+ */
+static inline float adc_frame_code_to_volts(const adc_frame_decoder_t *dec, uint32_t index, float code) {
+    return dec->offset[index] + dec->gain[index] * code;
+}
+
+#endif // ADC_FRAME_H
@@ -0,0 +1,334 @@
+"""
+Armazenamento de capturas do Signal Analyzer (HDF5 colunar)
+===========================================================
+Substitui o CSV de uma linha por amostra. Layout do arquivo:
+
+    /packets                índice: um registro por pacote (PACKET_DTYPE)
+    /blocks/<bloco>/x       eixo X concatenado de todos os pacotes
+    /blocks/<bloco>/y       valores concatenados de todos os pacotes
+
+<bloco> é um dos nomes de BLOCK_NAMES (signal_original, fft_original, ...).
+O eixo X segue o CSV: tempo (s) nos sinais, frequência (Hz, sem DC) nos
+espectros. Os valores ficam em float32, em chunks comprimidos (gzip +
+shuffle) de CHUNK_VALUES valores, ~um pacote por chunk. O índice guarda
+offset/comprimento de cada bloco, então um pacote ou um bloco de vários
+pacotes é lido com uma fatia contígua, sem carregar o resto do arquivo.
+
+O escritor só acrescenta (redimensiona e grava o final) e trabalha em modo
+SWMR: outro processo pode abrir a captura enquanto ela ainda é gravada.
+"""
+
+import os
+import threading
+from datetime import datetime
+
+import h5py
+import numpy as np
+import pandas as pd
+
+from telemetry_protocol import BLOCK_NAMES
+
+FORMAT_VERSION = 1
+CHUNK_VALUES = 2048
+INDEX_CHUNK = 1024
+FLUSH_PACKETS = 16          # Pacotes entre flushes do escritor
+BLOCKS = list(BLOCK_NAMES.values())
+CSV_COLUMNS = ['timestamp', 'packet_id', 'data_type', 'index', 'time_or_freq', 'amplitude_or_magnitude']
+
+# packet_id: número do pacote na captura; esp_packet_id: contador do firmware;
+# timestamp: segundos Unix da recepção
+PACKET_DTYPE = np.dtype([('packet_id', '<i8'), ('esp_packet_id', '<u4'), ('timestamp', '<f8')] +
+                        [(f'{b}_{field}', '<i8') for b in BLOCKS for field in ('offset', 'length')])
+
+
+def is_capture_file(path):
+    """True se o arquivo é uma captura HDF5 (pela assinatura, não pela extensão)"""
+    return os.path.exists(path) and h5py.is_hdf5(path)
+
+
+class CaptureWriter:
+    """
+    Acrescenta pacotes a uma captura (cria o arquivo se não existir). Pode ser
+    usado por várias threads (ex.: leitura serial e botão da GUI).
+    """
+
+    def __init__(self, path):
+        self.path = path
+        exists = os.path.exists(path)
+        self.file = h5py.File(path, 'a', libver='latest')
+        if not exists or 'packets' not in self.file:
+            self._create_layout()
+        self.packets = self.file['packets']
+        self.values = {b: (self.file[f'blocks/{b}/x'], self.file[f'blocks/{b}/y']) for b in BLOCKS}
+        self.file.swmr_mode = True
+        self.pending = 0
+        self.lock = threading.Lock()
+
+    def _create_layout(self):
+        f = self.file
+        f.attrs['format_version'] = FORMAT_VERSION
+        f.create_dataset('packets', shape=(0,), maxshape=(None,), dtype=PACKET_DTYPE,
+                         chunks=(INDEX_CHUNK,))
+        for b in BLOCKS:
+            group = f.create_group(f'blocks/{b}')
+            for axis in ('x', 'y'):
+                group.create_dataset(axis, shape=(0,), maxshape=(None,), dtype='<f4',
+                                     chunks=(CHUNK_VALUES,), compression='gzip',
+                                     compression_opts=4, shuffle=True)
+
+    @property
+    def n_packets(self):
+        return self.packets.shape[0]
+
+    def append(self, blocks, esp_packet_id=0, timestamp=None, packet_id=None):
+        """
+        Acrescenta um pacote.
+
+        Parameters:
+        -----------
+        blocks : dict
+            Nome do bloco -> (x, y); blocos ausentes ou vazios ficam com comprimento 0
+        esp_packet_id : int
+            Contador de pacotes do firmware
+        timestamp : float, optional
+            Segundos Unix da recepção (padrão: agora)
+        packet_id : int, optional
+            Número do pacote (padrão: sequencial a partir de 1)
+
+        Returns:
+        --------
+        int
+            Número do pacote gravado
+        """
+        with self.lock:
+            return self._append(blocks, esp_packet_id, timestamp, packet_id)
+
+    def _append(self, blocks, esp_packet_id, timestamp, packet_id):
+        n = self.n_packets
+        record = np.zeros(1, dtype=PACKET_DTYPE)
+        record['packet_id'] = n + 1 if packet_id is None else packet_id
+        record['esp_packet_id'] = esp_packet_id
+        record['timestamp'] = datetime.now().timestamp() if timestamp is None else timestamp
+        for b in BLOCKS:
+            dx, dy = self.values[b]
+            start = dy.shape[0]
+            x, y = blocks.get(b, ((), ()))
+            length = len(y)
+            if length:
+                dx.resize((start + length,))
+                dy.resize((start + length,))
+                dx[start:] = np.asarray(x, dtype='<f4')
+                dy[start:] = np.asarray(y, dtype='<f4')
+            record[f'{b}_offset'] = start
+            record[f'{b}_length'] = length
+        self.packets.resize((n + 1,))
+        self.packets[n] = record[0]
+
+        self.pending += 1
+        if self.pending >= FLUSH_PACKETS:
+            self.file.flush()
+            self.pending = 0
+        return int(record['packet_id'][0])
+
+    def flush(self):
+        with self.lock:
+            self.file.flush()
+            self.pending = 0
+
+    def reader(self):
+        """Leitor sobre o arquivo aberto (para exportar sem reabrir a captura)"""
+        with self.lock:
+            self.file.flush()
+            return CaptureReader(self.file)
+
+    def close(self):
+        with self.lock:
+            if self.file:
+                self.file.flush()
+                self.file.close()
+                self.file = None
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc):
+        self.close()
+
+
+class CaptureReader:
+    """
+    Leitura preguiçosa de uma captura: só o índice de pacotes fica na memória
+    (~90 bytes por pacote); blocos são lidos por fatias sob demanda.
+    """
+
+    def __init__(self, source):
+        if isinstance(source, h5py.File):
+            self.file, self.owns_file = source, False
+        else:
+            self.file, self.owns_file = h5py.File(source, 'r', libver='latest', swmr=True), True
+        self.refresh()
+
+    def refresh(self):
+        """Relê o índice (pacotes acrescentados por um escritor em andamento)"""
+        packets = self.file['packets']
+        if self.owns_file:
+            packets.refresh()
+        self.index = packets[:]
+        self.row_of = pd.Series(np.arange(len(self.index)), index=self.index['packet_id'])
+
+    def __len__(self):
+        return len(self.index)
+
+    @property
+    def packet_ids(self):
+        return self.index['packet_id']
+
+    def packet_times(self):
+        """Série packet_id -> datetime da recepção"""
+        return pd.Series(pd.to_datetime(self.index['timestamp'], unit='s'), index=self.index['packet_id'])
+
+    def _dataset(self, block, axis):
+        dataset = self.file[f'blocks/{block}/{axis}']
+        if self.owns_file:
+            dataset.refresh()
+        return dataset
+
+    def block_range(self, block, first, last):
+        """
+        (x, y, lengths) de um bloco nas linhas [first, last) do índice: uma
+        única leitura contígua, com lengths para separar os pacotes
+        (np.add.reduceat etc.)
+        """
+        rows = self.index[first:last]
+        if not len(rows):
+            return np.empty(0, np.float32), np.empty(0, np.float32), np.empty(0, np.int64)
+        lengths = rows[f'{block}_length']
+        start = int(rows[f'{block}_offset'][0])
+        stop = int(rows[f'{block}_offset'][-1] + lengths[-1])
+        return self._dataset(block, 'x')[start:stop], self._dataset(block, 'y')[start:stop], lengths
+
+    def packet(self, packet_id):
+        """Nome do bloco -> (x, y) de um pacote"""
+        row = int(self.row_of[packet_id])
+        return {b: self.block_range(b, row, row + 1)[:2] for b in BLOCKS}
+
+    def iter_batches(self, block, batch_packets=1024, first=0, last=None):
+        """Percorre um bloco em lotes de pacotes: (linhas do índice, x, y, lengths)"""
+        last = len(self.index) if last is None else min(last, len(self.index))
+        for row in range(first, last, batch_packets):
+            stop = min(row + batch_packets, last)
+            x, y, lengths = self.block_range(block, row, stop)
+            yield self.index[row:stop], x, y, lengths
+
+    def to_dataframe(self, packet_ids=None, blocks=None):
+        """
+        Pacotes selecionados no formato longo do CSV (colunas CSV_COLUMNS),
+        para as funções de gráfico do data_analyzer.py
+        """
+        if packet_ids is None:
+            rows = np.arange(len(self.index))
+        else:
+            # Pacotes inexistentes são ignorados
+            rows = self.row_of.reindex(list(packet_ids)).dropna().astype(np.int64).values
+        parts = []
+        for row in rows:
+            record = self.index[row]
+            timestamp = datetime.fromtimestamp(record['timestamp']).isoformat()
+            for b in blocks or BLOCKS:
+                x, y, _ = self.block_range(b, row, row + 1)
+                if not len(y):
+                    continue
+                parts.append(pd.DataFrame({
+                    'timestamp': timestamp, 'packet_id': record['packet_id'], 'data_type': b,
+                    'index': np.arange(len(y)), 'time_or_freq': x.astype(np.float64),
+                    'amplitude_or_magnitude': y.astype(np.float64),
+                }, columns=CSV_COLUMNS))
+        if not parts:
+            return pd.DataFrame(columns=CSV_COLUMNS)
+        return pd.concat(parts, ignore_index=True)
+
+    def export_csv(self, csv_path, batch_packets=256):
+        """Exporta a captura para o CSV antigo, em lotes (memória limitada)"""
+        total = 0
+        ids = self.packet_ids
+        for start in range(0, len(ids), batch_packets):
+            df = self.to_dataframe(ids[start:start + batch_packets])
+            df.to_csv(csv_path, mode='w' if start == 0 else 'a', header=start == 0, index=False)
+            total += len(df)
+        if not len(ids):
+            pd.DataFrame(columns=CSV_COLUMNS).to_csv(csv_path, index=False)
+        return total
+
+    def statistics(self, batch_packets=1024):
+        """
+        Estatísticas por tipo de bloco (como data_analyzer.generate_statistics),
+        acumuladas lote a lote
+        """
+        stats = {}
+        for b in BLOCKS:
+            count, total, total_sq = 0, 0.0, 0.0
+            vmin, vmax, packets = np.inf, -np.inf, 0
+            for _, _, y, lengths in self.iter_batches(b, batch_packets):
+                if not len(y):
+                    continue
+                y = y.astype(np.float64)
+                count += len(y)
+                total += y.sum()
+                total_sq += np.dot(y, y)
+                vmin, vmax = min(vmin, y.min()), max(vmax, y.max())
+                packets += int(np.count_nonzero(lengths))
+            if count:
+                mean = total / count
+                var = (total_sq - count * mean * mean) / (count - 1) if count > 1 else np.nan
+                stats[b] = {'count': count, 'mean': mean, 'std': np.sqrt(max(var, 0.0)),
+                            'min': vmin, 'max': vmax, 'packets': packets}
+        return stats
+
+    def close(self):
+        if self.owns_file and self.file:
+            self.file.close()
+        self.file = None
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc):
+        self.close()
+
+
+def convert_csv(csv_path, capture_path, chunksize=200000):
+    """
+    Converte um CSV antigo (uma linha por amostra) para captura, lendo-o em
+    pedaços. Um pacote é uma sequência de linhas com o mesmo (timestamp,
+    packet_id): o contador do signal_analyzer recomeçava a cada execução.
+    Os pacotes são renumerados em sequência.
+    """
+    def write(writer, group):
+        blocks = {name: (g['time_or_freq'].values, g['amplitude_or_magnitude'].values)
+                  for name, g in group.groupby('data_type', sort=False)}
+        writer.append(blocks, timestamp=pd.to_datetime(group['timestamp'].iloc[0]).timestamp())
+
+    with CaptureWriter(capture_path) as writer:
+        tail = None
+        for chunk in pd.read_csv(csv_path, chunksize=chunksize):
+            if tail is not None:
+                chunk = pd.concat([tail, chunk], ignore_index=True)
+            key = chunk['timestamp'].astype(str) + '#' + chunk['packet_id'].astype(str)
+            run = (key != key.shift()).cumsum()
+            # O último pacote do pedaço pode continuar no próximo
+            last = run.iloc[-1]
+            tail = chunk[run == last]
+            for _, group in chunk[run != last].groupby(run[run != last], sort=False):
+                write(writer, group)
+        if tail is not None and len(tail):
+            write(writer, tail)
+        return writer.n_packets
+
+
+if __name__ == '__main__':
+    import argparse
+    parser = argparse.ArgumentParser(description='Converte um CSV do signal_analyzer.py para captura HDF5')
+    parser.add_argument('csv', help='CSV antigo (uma linha por amostra)')
+    parser.add_argument('capture', help='Captura HDF5 de saída (pacotes são acrescentados)')
+    args = parser.parse_args()
+    print(f"[INFO] {convert_csv(args.csv, args.capture)} pacotes na captura {args.capture}")
@@ -0,0 +1,173 @@
+/**
+ * @file changepoint.c
+ * @brief Implementação do detector de mudança de regime (CUSUM bilateral)
+ */
+
+#include "changepoint.h"
+#include <math.h>
+#include <stddef.h>
+
+/**
+ * @brief Inicializa o detector
+ *
+ * @param cp Estado
+ * @param config Parâmetros; NULL usa CHANGEPOINT_DEFAULT_CONFIG
+ */
+void changepoint_init(changepoint_t *cp, const changepoint_config_t *config) {
+    static const changepoint_config_t defaults = CHANGEPOINT_DEFAULT_CONFIG;
+    cp->config = (config != NULL) ? *config : defaults;
+
+    if (cp->config.settle_samples < 2) {
+        cp->config.settle_samples = 2;
+    } else if (cp->config.settle_samples > CHANGEPOINT_MAX_SETTLE) {
+        cp->config.settle_samples = CHANGEPOINT_MAX_SETTLE;
+    }
+    if (cp->config.max_transient < cp->config.settle_samples) {
+        cp->config.max_transient = cp->config.settle_samples;
+    }
+    if (cp->config.level_window < 1) {
+        cp->config.level_window = 1;
+    }
+
+    running_stats_init(&cp->settle, cp->settle_values, NULL, NULL, cp->config.settle_samples);
+    changepoint_reset(cp);
+}
+
+/**
+ * @brief Volta ao estado inicial (o nível é o da próxima amostra)
+ */
+void changepoint_reset(changepoint_t *cp) {
+    cp->state = CHANGEPOINT_STEADY;
+    cp->n = 0;
+    cp->level = 0.0f;
+    cp->variance = cp->config.noise_floor * cp->config.noise_floor;
+    cp->level_count = 0;
+    cp->g_pos = cp->g_neg = 0.0f;
+    cp->pos_start = cp->neg_start = 0;
+    cp->transient_start = 0;
+    cp->level_before = 0.0f;
+    running_stats_reset(&cp->settle);
+}
+
+/**
+ * @brief Desvio padrão do ruído em regime (W), nunca abaixo de noise_floor
+ */
+float changepoint_sigma(const changepoint_t *cp) {
+    float sigma = sqrtf(cp->variance);
+    return (sigma > cp->config.noise_floor) ? sigma : cp->config.noise_floor;
+}
+
+/**
+ * @brief Inicia um novo regime no nível dado, com o CUSUM zerado
+ */
+static void start_regime(changepoint_t *cp, float level, uint32_t count) {
+    cp->state = CHANGEPOINT_STEADY;
+    cp->level = level;
+    cp->level_count = (count < cp->config.level_window) ? count : cp->config.level_window;
+    cp->g_pos = cp->g_neg = 0.0f;
+    cp->pos_start = cp->neg_start = cp->n + 1;
+}
+
+/**
+ * @brief Processa uma amostra em regime permanente
+ *
+ * Se o CUSUM disparar, a amostra já é a primeira da janela de acomodação.
+ */
+static void steady_update(changepoint_t *cp, float x) {
+    const changepoint_config_t *c = &cp->config;
+    float sigma = changepoint_sigma(cp);
+    float drift = c->drift_sigma * sigma;
+    if (drift < 0.5f * c->min_delta) {
+        drift = 0.5f * c->min_delta;
+    }
+
+    float d = x - cp->level;
+    cp->g_pos += d - drift;
+    cp->g_neg += -d - drift;
+    if (cp->g_pos <= 0.0f) {
+        cp->g_pos = 0.0f;
+        cp->pos_start = cp->n + 1;
+    }
+    if (cp->g_neg <= 0.0f) {
+        cp->g_neg = 0.0f;
+        cp->neg_start = cp->n + 1;
+    }
+
+    float h = c->threshold_sigma * sigma;
+    if (cp->g_pos > h || cp->g_neg > h) {
+        cp->state = CHANGEPOINT_TRANSIENT;
+        cp->transient_start = (cp->g_pos > h) ? cp->pos_start : cp->neg_start;
+        cp->level_before = cp->level;
+        running_stats_reset(&cp->settle);
+        running_stats_push(&cp->settle, x);
+        return;
+    }
+
+    // Só amostras sob controle atualizam nível e ruído: o nível anterior
+    // fica congelado enquanto uma mudança se acumula no CUSUM
+    if (cp->g_pos == 0.0f && cp->g_neg == 0.0f) {
+        if (cp->level_count < c->level_window) {
+            cp->level_count++;
+        }
+        float alpha = 1.0f / (float)cp->level_count;
+        cp->level += alpha * d;
+        cp->variance += alpha * (d * d - cp->variance);
+    }
+}
+
+/**
+ * @brief Processa uma amostra
+ *
+ * @param cp Estado
+ * @param x Amostra de potência (W)
+ * @param event Preenchido quando uma mudança de regime é confirmada
+ * @return true se event foi preenchido
+ */
+bool changepoint_update(changepoint_t *cp, float x, changepoint_event_t *event) {
+    const changepoint_config_t *c = &cp->config;
+    bool emitted = false;
+
+    if (cp->n == 0) {
+        start_regime(cp, x, 1);
+    } else if (cp->state == CHANGEPOINT_STEADY) {
+        steady_update(cp, x);
+    } else {
+        running_stats_push(&cp->settle, x);
+
+        if (running_stats_full(&cp->settle)) {
+            float sigma = changepoint_sigma(cp);
+            float bound = c->settle_sigma * sigma;
+            if (bound < c->settle_floor) {
+                bound = c->settle_floor;
+            }
+            float spread = running_stats_stddev(&cp->settle);
+            bool timed_out = (cp->n - cp->transient_start + 1) >= c->max_transient;
+
+            if (spread <= bound || timed_out) {
+                float level_after = running_stats_mean(&cp->settle);
+                float delta = level_after - cp->level_before;
+                uint32_t window_start = cp->n + 1 - c->settle_samples;
+
+                if (fabsf(delta) >= c->min_delta) {
+                    event->start = cp->transient_start;
+                    event->duration = (window_start > cp->transient_start) ? window_start - cp->transient_start : 0;
+                    event->level_before = cp->level_before;
+                    event->level_after = level_after;
+                    event->delta_power = delta;
+                    event->timed_out = timed_out && spread > bound;
+                    emitted = true;
+                }
+
+                // O novo regime começa com a variância da janela (uma carga
+                // ruidosa não deve disparar o CUSUM a cada poucas amostras)
+                float window_var = spread * spread;
+                float floor_var = c->noise_floor * c->noise_floor;
+                cp->variance = (window_var > floor_var) ? window_var : floor_var;
+                start_regime(cp, level_after, c->settle_samples);
+            }
+        }
+    }
+
+    cp->n++;
+    return emitted;
+}
@@ -0,0 +1,131 @@
+/**
+ * @file changepoint.h
+ * @brief Detector de mudança de regime (CUSUM bilateral) com segmentação em regime permanente
+ *
+ * Substitui o par "|passa-alta| > limiar + debounce" por um detector que
+ * mede o degrau entre dois regimes permanentes:
+ *
+ *  - REGIME: o nível de referência (média) e a variância do ruído são
+ *    acompanhados só com amostras sob controle (as duas estatísticas CUSUM
+ *    em zero), e cada amostra atualiza
+ *        g+ = max(0, g+ + (x - nível) - ν),  g- = max(0, g- - (x - nível) - ν)
+ *    com folga ν = max(min_delta / 2, drift_sigma * σ). Quando g+ ou g-
+ *    passa de h = threshold_sigma * σ, a mudança começou na primeira
+ *    amostra depois do último zero daquele lado (estimativa de máxima
+ *    verossimilhança do instante de mudança do CUSUM).
+ *  - TRANSITÓRIO: as amostras entram em uma janela deslizante de
+ *    settle_samples (running_stats.h); o novo regime é confirmado quando
+ *    a janela está cheia e seu desvio padrão cabe em
+ *    max(settle_sigma * σ, settle_floor), ou à força depois de
+ *    max_transient amostras. O evento leva ΔP = média da janela - nível
+ *    anterior, o instante de início e a duração do transitório; degraus
+ *    abaixo de min_delta (picos que voltam ao nível, deriva lenta) só
+ *    reposicionam o nível, sem evento.
+ *
+ * Custo O(1) por amostra e nenhum bloqueio: uma nova mudança pode ser
+ * detectada na amostra seguinte à confirmação do regime anterior.
+ * Nenhuma dependência do ESP-IDF.
+ */
+
+#ifndef CHANGEPOINT_H
+#define CHANGEPOINT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "running_stats.h"
+
+#define CHANGEPOINT_MAX_SETTLE      64      // Maior janela de acomodação (amostras)
+
+/**
+ * @brief Parâmetros do detector (em W e amostras)
+ */
+typedef struct {
+    float min_delta;            // Menor degrau entre regimes que gera evento (W)
+    float noise_floor;          // Piso do desvio padrão do ruído (W)
+    float drift_sigma;          // Folga ν do CUSUM em sigmas (nunca abaixo de min_delta / 2)
+    float threshold_sigma;      // Limiar h do CUSUM em sigmas
+    float settle_sigma;         // Desvio padrão máximo da janela de acomodação, em sigmas
+    float settle_floor;         // Piso do desvio padrão aceito na acomodação (W)
+    uint32_t settle_samples;    // Janela de acomodação (<= CHANGEPOINT_MAX_SETTLE)
+    uint32_t max_transient;     // Duração máxima do transitório (amostras)
+    uint32_t level_window;      // Constante de tempo do nível e do ruído em regime (amostras)
+} changepoint_config_t;
+
+// Configuração para potência a 10 Hz: acomodação em 1 s, transitório de até 60 s
+#define CHANGEPOINT_DEFAULT_CONFIG {    \
+    .min_delta = 50.0f,                 \
+    .noise_floor = 1.0f,                \
+    .drift_sigma = 1.0f,                \
+    .threshold_sigma = 5.0f,            \
+    .settle_sigma = 3.0f,               \
+    .settle_floor = 10.0f,              \
+    .settle_samples = 10,               \
+    .max_transient = 600,               \
+    .level_window = 100,                \
+}
+
+/**
+ * @brief Estado da segmentação
+ */
+typedef enum {
+    CHANGEPOINT_STEADY = 0,     // Regime permanente: CUSUM contra o nível de referência
+    CHANGEPOINT_TRANSIENT,      // Mudança detectada: aguarda a janela de acomodação estabilizar
+} changepoint_state_t;
+
+/**
+ * @brief Mudança de regime confirmada
+ *
+ * Índices contam amostras desde changepoint_init()/changepoint_reset().
+ */
+typedef struct {
+    uint32_t start;             // Primeira amostra do transitório
+    uint32_t duration;          // Amostras do início até a janela estável
+    float level_before;         // Nível do regime anterior (W)
+    float level_after;          // Nível do novo regime (média da janela de acomodação, W)
+    float delta_power;          // level_after - level_before (W)
+    bool timed_out;             // Confirmado por max_transient, não por estabilidade
+} changepoint_event_t;
+
+/**
+ * @brief Estado do detector
+ */
+typedef struct {
+    changepoint_config_t config;
+    changepoint_state_t state;
+    uint32_t n;                 // Índice da próxima amostra
+    float level;                // Nível de referência do regime (W)
+    float variance;             // Variância do ruído em regime (W²)
+    uint32_t level_count;       // Amostras na média do nível (satura em level_window)
+    float g_pos, g_neg;         // Estatísticas CUSUM de subida e de descida
+    uint32_t pos_start;         // Primeira amostra depois do último zero de g+
+    uint32_t neg_start;         // Primeira amostra depois do último zero de g-
+    uint32_t transient_start;   // Início do transitório em curso
+    float level_before;         // Nível congelado no início do transitório (W)
+    running_stats_t settle;     // Janela de acomodação
+    float settle_values[CHANGEPOINT_MAX_SETTLE];
+} changepoint_t;
+
+// Protótipos de funções
+void changepoint_init(changepoint_t *cp, const changepoint_config_t *config);
+void changepoint_reset(changepoint_t *cp);
+bool changepoint_update(changepoint_t *cp, float x, changepoint_event_t *event);
+float changepoint_sigma(const changepoint_t *cp);
+
+/**
+ * @brief Verdadeiro durante um transitório ainda não confirmado
+ */
+static inline bool changepoint_in_transient(const changepoint_t *cp) {
+    return cp->state == CHANGEPOINT_TRANSIENT;
+}
+
+/**
+ * @brief Verdadeiro se há mudança em curso: transitório ou CUSUM acumulando
+ *
+ * O CUSUM só sai de zero com desvios maiores que a folga ν (>= min_delta / 2),
+ * então ruído de regime não conta como atividade.
+ */
+static inline bool changepoint_active(const changepoint_t *cp) {
+    return cp->state == CHANGEPOINT_TRANSIENT || cp->g_pos > 0.0f || cp->g_neg > 0.0f;
+}
+
+#endif // CHANGEPOINT_H
@@ -0,0 +1,162 @@
+/**
+ * @file current_harmonics.c
+ * @brief Implementação das harmônicas da corrente por fase
+ */
+
+#include "current_harmonics.h"
+#include <math.h>
+#include <string.h>
+
+/**
+ * @brief Inicializa o medidor
+ *
+ * @param ch Estado
+ * @param n_phases Fases (até CURRENT_HARMONICS_MAX_PHASES)
+ * @param sample_rate_hz Taxa de cada canal (Hz)
+ * @param mains_hz Frequência nominal da rede (Hz)
+ */
+void current_harmonics_init(current_harmonics_t *ch, uint32_t n_phases, float sample_rate_hz, float mains_hz) {
+    memset(ch, 0, sizeof(*ch));
+    if (n_phases > CURRENT_HARMONICS_MAX_PHASES) {
+        n_phases = CURRENT_HARMONICS_MAX_PHASES;
+    }
+
+    // Janela retangular de ciclos inteiros na frequência nominal
+    uint32_t frame_size = (uint32_t)lroundf(sample_rate_hz * CURRENT_HARMONICS_CYCLES / mains_hz);
+    goertzel_bank_init(&ch->v_bank, mains_hz, 1, sample_rate_hz, frame_size, (float)frame_size);
+    goertzel_bank_init(&ch->i_bank, mains_hz, CURRENT_HARMONICS_COUNT, sample_rate_hz, frame_size, (float)frame_size);
+    ch->n_phases = n_phases;
+    ch->latest.n_phases = (uint8_t)n_phases;
+    ch->latest.n_harmonics = (uint8_t)ch->i_bank.n_harmonics;
+}
+
+/**
+ * @brief Descarta as janelas em curso e o último retrato (lacuna na aquisição)
+ *
+ * As médias dos canais são mantidas, então o próximo retrato sai ao fim
+ * da próxima janela completa.
+ */
+void current_harmonics_reset(current_harmonics_t *ch) {
+    for (uint32_t p = 0; p < ch->n_phases; p++) {
+        goertzel_stream_reset(&ch->v_stream[p]);
+        goertzel_stream_reset(&ch->i_stream[p]);
+        ch->v_sum[p] = 0.0;
+        ch->i_sum[p] = 0.0;
+        ch->measured[p] = false;
+    }
+    ch->latest.valid = false;
+    goertzel_bank_reset_tracking(&ch->v_bank);
+}
+
+/**
+ * @brief Fecha a janela de uma fase e atualiza o retrato
+ */
+static void finish_window(current_harmonics_t *ch, uint32_t p) {
+    goertzel_harmonic_t v1;
+    goertzel_harmonic_t current[GOERTZEL_MAX_HARMONICS];
+    goertzel_stream_result(&ch->v_bank, &ch->v_stream[p], &v1);
+    goertzel_stream_result(&ch->i_bank, &ch->i_stream[p], current);
+
+    // A primeira janela ainda tem a média do ADC (offset de meia escala) vazando para as harmônicas
+    bool usable = ch->has_offset[p];
+    ch->v_offset[p] = (float)(ch->v_sum[p] / ch->v_bank.frame_size);
+    ch->i_offset[p] = (float)(ch->i_sum[p] / ch->i_bank.frame_size);
+    ch->v_sum[p] = 0.0;
+    ch->i_sum[p] = 0.0;
+    ch->has_offset[p] = true;
+
+    // f0 pela fase 1 (janelas consecutivas); a corrente segue a sintonia da tensão
+    if (p == 0 && usable) {
+        goertzel_bank_track(&ch->v_bank, &v1, ch->v_bank.frame_size);
+        if (ch->v_bank.tuned_f0 != ch->i_bank.tuned_f0) {
+            goertzel_bank_tune(&ch->i_bank, ch->v_bank.tuned_f0);
+        }
+    }
+
+    // Sem tensão não há referência de fase
+    ch->measured[p] = usable && v1.amplitude >= GOERTZEL_MIN_TRACK_AMPL;
+    if (ch->measured[p]) {
+        for (uint32_t h = 0; h < ch->i_bank.n_harmonics; h++) {
+            float angle = current[h].phase - (float)(h + 1) * v1.phase;
+            ch->latest.re[p][h] = current[h].amplitude * cosf(angle);
+            ch->latest.im[p][h] = current[h].amplitude * sinf(angle);
+        }
+    }
+
+    bool valid = true;
+    for (uint32_t q = 0; q < ch->n_phases; q++) {
+        valid = valid && ch->measured[q];
+    }
+    ch->latest.valid = valid;
+}
+
+/**
+ * @brief Processa um bloco de códigos separados por canal
+ *
+ * V e I de cada fase avançam juntos (min dos dois n_codes); o retrato em
+ * ch->latest muda quando alguma fase fecha uma janela.
+ *
+ * @param ch Estado
+ * @param codes Códigos por canal (layout de power_meter.h)
+ * @param n_codes Códigos de cada canal
+ * @return true se alguma janela foi fechada
+ */
+bool current_harmonics_process(current_harmonics_t *ch, const uint16_t *const *codes, const size_t *n_codes) {
+    bool finished = false;
+
+    for (uint32_t p = 0; p < ch->n_phases; p++) {
+        const uint16_t *v = codes[2 * p];
+        const uint16_t *i = codes[2 * p + 1];
+        size_t n = (n_codes[2 * p] < n_codes[2 * p + 1]) ? n_codes[2 * p] : n_codes[2 * p + 1];
+
+        for (size_t k = 0; k < n; k++) {
+            ch->v_sum[p] += v[k];
+            ch->i_sum[p] += i[k];
+            goertzel_stream_push(&ch->v_bank, &ch->v_stream[p], (float)v[k] - ch->v_offset[p]);
+            if (goertzel_stream_push(&ch->i_bank, &ch->i_stream[p], (float)i[k] - ch->i_offset[p])) {
+                finish_window(ch, p);
+                finished = true;
+            }
+        }
+    }
+    return finished;
+}
+
+/**
+ * @brief Características harmônicas da corrente de um evento
+ *
+ * Subtrai os fasores de antes dos de depois e usa a fase com a maior
+ * variação da fundamental (onde a carga foi ligada ou desligada).
+ *
+ * @param before Retrato antes do transitório
+ * @param after Retrato depois do novo regime
+ * @param features Saída thd e h3_ratio (NAN sem os dois retratos); demais campos inalterados
+ */
+void current_harmonics_features(const current_harmonics_snapshot_t *before, const current_harmonics_snapshot_t *after,
+                                nilm_device_features_t *features) {
+    features->thd = NAN;
+    features->h3_ratio = NAN;
+    if (!before->valid || !after->valid || before->n_phases != after->n_phases || after->n_phases == 0) {
+        return;
+    }
+
+    uint32_t best = 0;
+    float best_d2 = -1.0f;
+    for (uint32_t p = 0; p < after->n_phases; p++) {
+        float dr = after->re[p][0] - before->re[p][0];
+        float di = after->im[p][0] - before->im[p][0];
+        if (dr * dr + di * di > best_d2) {
+            best_d2 = dr * dr + di * di;
+            best = p;
+        }
+    }
+
+    goertzel_harmonic_t delta[CURRENT_HARMONICS_COUNT];
+    for (uint32_t h = 0; h < after->n_harmonics; h++) {
+        float dr = after->re[best][h] - before->re[best][h];
+        float di = after->im[best][h] - before->im[best][h];
+        delta[h].amplitude = sqrtf(dr * dr + di * di);
+        delta[h].phase = atan2f(di, dr);
+    }
+    goertzel_fill_features(delta, after->n_harmonics, features);
+}
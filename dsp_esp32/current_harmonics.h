@@ -0,0 +1,74 @@
+/**
+ * @file current_harmonics.h
+ * @brief Harmônicas da corrente por fase para as características dos eventos NILM
+ *
+ * A cada janela de CURRENT_HARMONICS_CYCLES ciclos nominais da rede, um
+ * banco de Goertzel (goertzel.h, processado amostra a amostra, sem guardar
+ * a janela) mede as harmônicas 1..CURRENT_HARMONICS_COUNT da corrente de
+ * cada fase e a fundamental da tensão. Os fasores da corrente ficam com a
+ * fase relativa à fundamental da tensão (h · fase de V1 para a harmônica
+ * h), então não dependem do instante da janela e podem ser subtraídos: a
+ * diferença entre o retrato depois de um evento e o de antes é a corrente
+ * que a carga acrescentou ou retirou, da qual saem thd e h3_ratio de
+ * nilm_device_features_t.
+ *
+ * Os canais seguem o layout de power_meter.h (2p = tensão, 2p + 1 =
+ * corrente da fase p). A média de cada canal é removida com a média da
+ * janela anterior, então o primeiro retrato só sai na segunda janela. O
+ * atraso fixo entre os canais V e I desloca os dois retratos igualmente e
+ * se cancela na diferença.
+ *
+ * Nenhuma dependência do ESP-IDF (compila também no host).
+ */
+
+#ifndef CURRENT_HARMONICS_H
+#define CURRENT_HARMONICS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "goertzel.h"
+
+#define CURRENT_HARMONICS_COUNT         7       // Harmônicas 1..7 da corrente
+#define CURRENT_HARMONICS_CYCLES        6       // Ciclos nominais por janela (100 ms a 60 Hz)
+#define CURRENT_HARMONICS_MAX_PHASES    3
+
+/**
+ * @brief Fasores da corrente na última janela de cada fase
+ *
+ * Unidade dos códigos do ADC (só as razões entre harmônicas são usadas).
+ */
+typedef struct {
+    float re[CURRENT_HARMONICS_MAX_PHASES][CURRENT_HARMONICS_COUNT];
+    float im[CURRENT_HARMONICS_MAX_PHASES][CURRENT_HARMONICS_COUNT];
+    uint8_t n_phases;
+    uint8_t n_harmonics;
+    bool valid;                 // Todas as fases têm uma janela medida
+} current_harmonics_snapshot_t;
+
+/**
+ * @brief Estado do medidor
+ */
+typedef struct {
+    goertzel_bank_t v_bank;     // Fundamental da tensão (referência de fase)
+    goertzel_bank_t i_bank;     // Harmônicas da corrente
+    goertzel_stream_t v_stream[CURRENT_HARMONICS_MAX_PHASES];
+    goertzel_stream_t i_stream[CURRENT_HARMONICS_MAX_PHASES];
+    float v_offset[CURRENT_HARMONICS_MAX_PHASES];   // Média da janela anterior (códigos)
+    float i_offset[CURRENT_HARMONICS_MAX_PHASES];
+    double v_sum[CURRENT_HARMONICS_MAX_PHASES];     // Soma da janela atual
+    double i_sum[CURRENT_HARMONICS_MAX_PHASES];
+    bool has_offset[CURRENT_HARMONICS_MAX_PHASES];
+    bool measured[CURRENT_HARMONICS_MAX_PHASES];
+    uint32_t n_phases;
+    current_harmonics_snapshot_t latest;
+} current_harmonics_t;
+
+// Protótipos de funções
+void current_harmonics_init(current_harmonics_t *ch, uint32_t n_phases, float sample_rate_hz, float mains_hz);
+void current_harmonics_reset(current_harmonics_t *ch);
+bool current_harmonics_process(current_harmonics_t *ch, const uint16_t *const *codes, const size_t *n_codes);
+void current_harmonics_features(const current_harmonics_snapshot_t *before, const current_harmonics_snapshot_t *after,
+                                nilm_device_features_t *features);
+
+#endif // CURRENT_HARMONICS_H
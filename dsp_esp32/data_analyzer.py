@@ -1,7 +1,8 @@
 #!/usr/bin/env python3
 """
 Analisador de dados salvos do Signal Analyzer
-Carrega dados do CSV e gera gráficos de análise
+Carrega dados de uma captura HDF5 (capture_store.py), do CSV antigo ou de uma
+captura binária da serial e gera gráficos de análise
 """
 
 import pandas as pd
@@ -11,6 +12,11 @@ from datetime import datetime
 import argparse
 import os
 
+from telemetry_protocol import FrameDecoder, BLOCK_NAMES, block_axis
+from capture_store import CaptureReader, is_capture_file
+
+DEFAULT_CAPTURE = 'signal_analysis_data.h5'
+
 def load_data(csv_file):
     """Carrega dados do arquivo CSV"""
     try:
@@ -30,6 +36,56 @@ def load_data(csv_file):
         print(f"[ERRO] Não foi possível carregar {csv_file}: {e}")
         return None
 
+def load_capture(capture_file):
+    """
+    Abre uma captura HDF5 sem carregá-la: só o índice de pacotes vai para a
+    memória e cada análise lê apenas os pacotes/blocos de que precisa.
+    """
+    try:
+        reader = CaptureReader(capture_file)
+    except Exception as e:
+        print(f"[ERRO] Não foi possível abrir {capture_file}: {e}")
+        return None
+    print(f"[INFO] Captura aberta: {capture_file}")
+    print(f"[INFO] Pacotes: {len(reader)}")
+    if len(reader):
+        times = reader.packet_times()
+        print(f"Período: {times.iloc[0].isoformat()} até {times.iloc[-1].isoformat()}")
+    return reader
+
+def load_raw_capture(capture_file):
+    """
+    Decodifica uma captura binária da serial (ex.: `cat /dev/ttyACM0 > captura.bin`)
+    para o mesmo formato do CSV. Aceita todos os formatos de payload
+    (float32, int16, delta varint e espectros reduzidos).
+    """
+    decoder = FrameDecoder()
+    with open(capture_file, 'rb') as f:
+        frames = decoder.feed(f.read())
+
+    timestamp = datetime.fromtimestamp(os.path.getmtime(capture_file)).isoformat()
+    rows = []
+    for frame in frames:
+        block = BLOCK_NAMES.get(frame.type)
+        if block is None:
+            continue
+        x_vals = block_axis(frame)
+        if block.startswith('fft'):
+            # Como no CSV do signal_analyzer.py: sem a componente DC (eixo log)
+            valid = x_vals > 0
+            x_vals, values = x_vals[valid], frame.values[valid]
+        else:
+            values = frame.values
+        rows.extend([timestamp, frame.packet_id, block, i, x, v]
+                    for i, (x, v) in enumerate(zip(x_vals, values)))
+
+    print(f"[INFO] Captura decodificada: {capture_file} ({decoder.frames_ok} quadros, "
+          f"{decoder.crc_errors} erros de CRC)")
+    df = pd.DataFrame(rows, columns=['timestamp', 'packet_id', 'data_type', 'index',
+                                     'time_or_freq', 'amplitude_or_magnitude'])
+    print(f"[INFO] Total de registros: {len(df)}")
+    return df
+
 def plot_packet_comparison(df, packet_id):
     """Plota comparação de um pacote específico"""
     packet_data = df[df['packet_id'] == packet_id]
@@ -138,9 +194,15 @@ def generate_statistics(df):
     
     return stats
 
-def plot_statistics_summary(df):
-    """Plota resumo estatístico"""
-    stats = generate_statistics(df)
+def plot_statistics_summary(df, stats=None, packet_times=None):
+    """
+    Plota resumo estatístico (de df, ou de stats/packet_times já calculados
+    a partir de uma captura)
+    """
+    if stats is None:
+        stats = generate_statistics(df)
+    if packet_times is None:
+        packet_times = df.groupby('packet_id')['timestamp'].first()
     
     fig, ((ax1, ax2), (ax3, ax4)) = plt.subplots(2, 2, figsize=(15, 10))
     fig.suptitle('Resumo Estatístico dos Dados', fontsize=16)
@@ -168,7 +230,7 @@ def plot_statistics_summary(df):
     ax3.tick_params(axis='x', rotation=45)
     
     # Gráfico 4: Evolução de pacotes no tempo
-    packet_times = df.groupby('packet_id')['timestamp'].first().sort_values()
+    packet_times = packet_times.sort_values()
     packet_ids = packet_times.index
     times = pd.to_datetime(packet_times.values)
     
@@ -183,8 +245,12 @@ def plot_statistics_summary(df):
 
 def main():
     parser = argparse.ArgumentParser(description='Analisador de dados do Signal Analyzer')
-    parser.add_argument('--csv', default='signal_analysis_data.csv', 
-                       help='Arquivo CSV com os dados (padrão: signal_analysis_data.csv)')
+    parser.add_argument('--capture',
+                       help='Captura HDF5 do signal_analyzer.py (padrão: signal_analysis_data.h5, se existir)')
+    parser.add_argument('--csv',
+                       help='Arquivo CSV com os dados (padrão, sem captura: signal_analysis_data.csv)')
+    parser.add_argument('--raw',
+                       help='Captura binária da serial (quadros de telemetria) em vez do CSV')
     parser.add_argument('--packet', type=int, 
                        help='ID do pacote específico para análise')
     parser.add_argument('--evolution', choices=['signal_original', 'signal_filtered', 'fft_original', 'fft_filtered'],
@@ -198,36 +264,63 @@ def main():
     
     args = parser.parse_args()
     
+    if not (args.capture or args.raw or args.csv):
+        if is_capture_file(DEFAULT_CAPTURE):
+            args.capture = DEFAULT_CAPTURE
+        else:
+            args.csv = 'signal_analysis_data.csv'
+    
     # Verificar se arquivo existe
-    if not os.path.exists(args.csv):
-        print(f"[ERRO] Arquivo não encontrado: {args.csv}")
+    source = args.raw or args.capture or args.csv
+    if not os.path.exists(source):
+        print(f"[ERRO] Arquivo não encontrado: {source}")
         return
     
-    # Carregar dados
-    df = load_data(args.csv)
-    if df is None:
-        return
+    # Carregar dados: a captura é lida sob demanda, CSV e binário por inteiro
+    if args.capture:
+        reader = load_capture(args.capture)
+        if reader is None or not len(reader):
+            return
+        packet_ids = reader.packet_ids
+        select = reader.to_dataframe
+    else:
+        df = load_raw_capture(args.raw) if args.raw else load_data(args.csv)
+        if df is None or df.empty:
+            return
+        packet_ids = np.sort(df['packet_id'].unique())
+        def select(ids, blocks=None):
+            rows = df['packet_id'].isin(ids)
+            if blocks is not None:
+                rows &= df['data_type'].isin(blocks)
+            return df[rows]
     
     figures = []
     
     # Análise de pacote específico
     if args.packet is not None:
-        fig = plot_packet_comparison(df, args.packet)
+        fig = plot_packet_comparison(select([args.packet]), args.packet)
         if fig:
             figures.append(('packet_analysis', fig))
     
     # Análise de evolução temporal
     if args.evolution:
-        fig = plot_signal_evolution(df, args.evolution, args.max_packets)
+        if len(packet_ids) > args.max_packets:
+            print(f"[INFO] Plotando os últimos {args.max_packets} pacotes de {len(packet_ids)} total")
+        fig = plot_signal_evolution(select(packet_ids[-args.max_packets:], [args.evolution]),
+                                    args.evolution, args.max_packets)
         figures.append((f'evolution_{args.evolution}', fig))
     
     # Resumo estatístico
     if args.stats:
-        fig = plot_statistics_summary(df)
+        if args.capture:
+            stats = reader.statistics()
+            fig = plot_statistics_summary(None, stats, reader.packet_times())
+        else:
+            stats = generate_statistics(df)
+            fig = plot_statistics_summary(df, stats)
         figures.append(('statistics_summary', fig))
         
         # Imprimir estatísticas textuais
-        stats = generate_statistics(df)
         print("\n=== ESTATÍSTICAS DETALHADAS ===")
         for data_type, stat in stats.items():
             print(f"\n{data_type.replace('_', ' ').title()}:")
@@ -239,9 +332,9 @@ def main():
     
     # Se nenhuma opção específica foi escolhida, mostrar o último pacote
     if not any([args.packet is not None, args.evolution, args.stats]):
-        last_packet = df['packet_id'].max()
+        last_packet = packet_ids.max()
         print(f"[INFO] Mostrando análise do último pacote: #{last_packet}")
-        fig = plot_packet_comparison(df, last_packet)
+        fig = plot_packet_comparison(select([last_packet]), last_packet)
         if fig:
             figures.append(('last_packet_analysis', fig))
     
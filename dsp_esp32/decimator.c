@@ -0,0 +1,318 @@
+/**
+ * @file decimator.c
+ * @brief Implementação do decimador multiestágio CIC + FIR
+ */
+
+#include "decimator.h"
+#include <string.h>
+
+/**
+ * FIR compensador (21 taps, simétrico, fs = taxa de saída do CIC).
+ * Mínimos quadrados: ganho 1/|H_cic| em [0, fs/8], zero em [3fs/8, fs/2],
+ * para CIC de ordem 4. Resposta combinada CIC+FIR plana em ±0.003 dB até
+ * fs/8 e rejeição > 95 dB na banda que dobra sobre a banda útil.
+ * Apenas a metade é armazenada: [0] é o tap central, [k] os taps ±k.
+ */
+static const float comp_coeffs[(DECIMATOR_COMP_TAPS + 1) / 2] = {
+    0.534066069f, 0.329369675f, -0.009824811f, -0.108064151f, -0.013780586f, 0.037110093f,
+    0.009528060f, -0.009915070f, -0.003684784f, 0.001499231f, 0.000729308f
+};
+
+/**
+ * Filtro de meia-banda (23 taps, mínimos quadrados, banda passante até
+ * 0.2 fs, rejeição >= 34.8 dB a partir de 0.3 fs). O tap central vale 0.5
+ * e os taps de índice par (exceto o central) são nulos; apenas os taps
+ * ímpares ±1, ±3, ..., ±11 são armazenados.
+ */
+static const float hb_coeffs[(DECIMATOR_HB_TAPS + 1) / 4] = {
+    0.314710703f, -0.094741362f, 0.045962134f, -0.023248560f, 0.010636933f, -0.003319848f
+};
+
+/**
+ * @brief Insere uma amostra em um estágio FIR ÷2
+ *
+ * @param stage Estágio FIR
+ * @param x Amostra de entrada
+ * @return Ponteiro para a janela (mais antiga -> mais recente) quando uma
+ *         saída deve ser calculada, ou NULL na amostra descartada
+ */
+static const float *fir_stage_push(decimator_fir_stage_t *stage, float x) {
+    stage->delay[stage->pos] = x;
+    stage->delay[stage->pos + stage->n_taps] = x;
+    if (++stage->pos == stage->n_taps) {
+        stage->pos = 0;
+    }
+
+    if (++stage->phase < 2) {
+        return NULL;
+    }
+    stage->phase = 0;
+    return &stage->delay[stage->pos];
+}
+
+/**
+ * @brief Convolução do FIR compensador explorando a simetria
+ */
+static float comp_filter(const float *w) {
+    const int c = (DECIMATOR_COMP_TAPS - 1) / 2;
+    float acc = comp_coeffs[0] * w[c];
+    for (int k = 1; k <= c; k++) {
+        acc += comp_coeffs[k] * (w[c - k] + w[c + k]);
+    }
+    return acc;
+}
+
+/**
+ * @brief Convolução do filtro de meia-banda (apenas taps não nulos)
+ */
+static float halfband_filter(const float *w) {
+    const int c = (DECIMATOR_HB_TAPS - 1) / 2;
+    float acc = 0.5f * w[c];
+    for (int j = 0; j < (DECIMATOR_HB_TAPS + 1) / 4; j++) {
+        int k = 2 * j + 1;
+        acc += hb_coeffs[j] * (w[c - k] + w[c + k]);
+    }
+    return acc;
+}
+
+/**
+ * @brief Inicializa um canal do decimador
+ *
+ * Valores fora dos limites são saturados (ordem 1..DECIMATOR_MAX_CIC_ORDER,
+ * meia-bandas 0..DECIMATOR_MAX_HALFBANDS, R >= 1).
+ *
+ * @param dec Estado do canal
+ * @param cfg Configuração da cadeia
+ */
+void decimator_init(decimator_t *dec, const decimator_config_t *cfg) {
+    memset(dec, 0, sizeof(*dec));
+    dec->cfg = *cfg;
+
+    if (dec->cfg.cic_decimation < 1) dec->cfg.cic_decimation = 1;
+    if (dec->cfg.cic_order < 1) dec->cfg.cic_order = 1;
+    if (dec->cfg.cic_order > DECIMATOR_MAX_CIC_ORDER) dec->cfg.cic_order = DECIMATOR_MAX_CIC_ORDER;
+    if (dec->cfg.n_halfbands > DECIMATOR_MAX_HALFBANDS) dec->cfg.n_halfbands = DECIMATOR_MAX_HALFBANDS;
+
+    // Ganho DC do CIC = R^N
+    double cic_dc_gain = 1.0;
+    for (int k = 0; k < dec->cfg.cic_order; k++) {
+        cic_dc_gain *= (double)dec->cfg.cic_decimation;
+    }
+    dec->cic_gain = (float)(dec->cfg.output_scale / cic_dc_gain);
+
+    decimator_reset(dec);
+}
+
+/**
+ * @brief Zera integradores, pentes e linhas de atraso
+ */
+void decimator_reset(decimator_t *dec) {
+    memset(dec->integrator, 0, sizeof(dec->integrator));
+    memset(dec->comb, 0, sizeof(dec->comb));
+    dec->cic_phase = 0;
+
+    memset(&dec->comp, 0, sizeof(dec->comp));
+    dec->comp.n_taps = DECIMATOR_COMP_TAPS;
+    for (int s = 0; s < DECIMATOR_MAX_HALFBANDS; s++) {
+        memset(&dec->halfband[s], 0, sizeof(dec->halfband[s]));
+        dec->halfband[s].n_taps = DECIMATOR_HB_TAPS;
+    }
+}
+
+/**
+ * @brief Fator de decimação total da cadeia (R * 2 * 2^n_halfbands)
+ */
+uint32_t decimator_total_factor(const decimator_config_t *cfg) {
+    return cfg->cic_decimation * 2u * (1u << cfg->n_halfbands);
+}
+
+/**
+ * @brief Monta a cadeia para um fator total
+ *
+ * Usa o maior número de meia-bandas com R inteiro, R >= DECIMATOR_MIN_CIC_DECIMATION
+ * e R^N <= DECIMATOR_MAX_CIC_GAIN (1000 -> R = 125 com 2 meia-bandas).
+ *
+ * @param factor Fator total desejado
+ * @param cic_order Ordem do CIC
+ * @param output_scale Escala da saída
+ * @param cfg Recebe a configuração
+ * @return false se o fator não tem a forma R * 2 * 2^n com esses limites
+ */
+bool decimator_config_for_factor(uint32_t factor, uint8_t cic_order, float output_scale, decimator_config_t *cfg) {
+    for (int n = DECIMATOR_MAX_HALFBANDS; n >= 0; n--) {
+        uint32_t stages = 2u << n;
+        if (factor % stages != 0) {
+            continue;
+        }
+        uint32_t r = factor / stages;
+        double gain = 1.0;
+        for (int k = 0; k < cic_order; k++) {
+            gain *= (double)r;
+        }
+        if (r < DECIMATOR_MIN_CIC_DECIMATION || gain > DECIMATOR_MAX_CIC_GAIN) {
+            continue;
+        }
+        cfg->cic_decimation = r;
+        cfg->cic_order = cic_order;
+        cfg->n_halfbands = (uint8_t)n;
+        cfg->output_scale = output_scale;
+        return true;
+    }
+    return false;
+}
+
+/**
+ * @brief Atraso de grupo da cadeia, em amostras de entrada
+ *
+ * Todos os estágios têm fase linear: CIC N(R-1)/2, compensador 10 e cada
+ * meia-banda 11 amostras nas respectivas taxas.
+ */
+float decimator_group_delay(const decimator_config_t *cfg) {
+    float rate = (float)cfg->cic_decimation;
+    float delay = cfg->cic_order * (cfg->cic_decimation - 1) * 0.5f;
+
+    delay += (DECIMATOR_COMP_TAPS - 1) * 0.5f * rate;
+    for (int s = 0; s < cfg->n_halfbands; s++) {
+        rate *= 2.0f;
+        delay += (DECIMATOR_HB_TAPS - 1) * 0.5f * rate;
+    }
+    return delay;
+}
+
+/**
+ * @brief Pentes do CIC e estágios FIR em um instante de decimação do CIC
+ *
+ * @param dec Estado do canal
+ * @param y Recebe a saída da cadeia, se houver
+ * @return true se a última meia-banda produziu uma amostra
+ */
+static bool chain_step(decimator_t *dec, float *y) {
+    const int order = dec->cfg.cic_order;
+
+    // Pentes (M = 1) na taxa decimada
+    uint64_t v = dec->integrator[order - 1];
+    for (int s = 0; s < order; s++) {
+        uint64_t d = v - dec->comb[s];
+        dec->comb[s] = v;
+        v = d;
+    }
+    float x = (float)(int64_t)v * dec->cic_gain;
+
+    const float *w = fir_stage_push(&dec->comp, x);
+    if (w == NULL) {
+        return false;
+    }
+    x = comp_filter(w);
+
+    for (int s = 0; s < dec->cfg.n_halfbands; s++) {
+        w = fir_stage_push(&dec->halfband[s], x);
+        if (w == NULL) {
+            return false;
+        }
+        x = halfband_filter(w);
+    }
+    *y = x;
+    return true;
+}
+
+/**
+ * @brief Processa um bloco de amostras de um canal
+ *
+ * O bloco é percorrido em trechos até o próximo instante de decimação do
+ * CIC: dentro de cada trecho o laço só acumula os integradores, sem
+ * desvios por amostra. Os estágios FIR só rodam quando o CIC produz uma
+ * saída. O estado é preservado entre chamadas, então o bloco pode ter
+ * qualquer tamanho (tipicamente um quadro de DMA já separado por canal).
+ *
+ * @param dec Estado do canal
+ * @param input Códigos do ADC
+ * @param n Número de amostras
+ * @param output Amostras decimadas (já multiplicadas por output_scale)
+ * @param max_output Capacidade de output; saídas excedentes são descartadas
+ * @return Número de amostras escritas em output
+ */
+size_t decimator_process(decimator_t *dec, const uint16_t *input, size_t n, float *output, size_t max_output) {
+    const uint32_t R = dec->cfg.cic_decimation;
+    const int order = dec->cfg.cic_order;
+    size_t n_out = 0;
+    size_t i = 0;
+
+    while (i < n) {
+        size_t run = R - dec->cic_phase;
+        if (run > n - i) {
+            run = n - i;
+        }
+
+        // Integradores em cascata (cópia local para ficar em registradores)
+        uint64_t acc[DECIMATOR_MAX_CIC_ORDER];
+        memcpy(acc, dec->integrator, sizeof(acc));
+        for (size_t k = 0; k < run; k++) {
+            uint64_t v = input[i + k];
+            for (int s = 0; s < order; s++) {
+                acc[s] += v;
+                v = acc[s];
+            }
+        }
+        memcpy(dec->integrator, acc, sizeof(acc));
+
+        i += run;
+        dec->cic_phase += (uint32_t)run;
+        if (dec->cic_phase < R) {
+            break;
+        }
+        dec->cic_phase = 0;
+
+        float y;
+        if (chain_step(dec, &y) && n_out < max_output) {
+            output[n_out++] = y;
+        }
+    }
+
+    return n_out;
+}
+
+/**
+ * @brief Processa n amostras de mesmo valor (grandeza de um ciclo repetida em cada amostra dele)
+ *
+ * Mesma semântica de decimator_process(); value é somado em complemento
+ * de 2, então valores negativos valem.
+ */
+size_t decimator_process_hold(decimator_t *dec, int32_t value, size_t n, float *output, size_t max_output) {
+    const uint32_t R = dec->cfg.cic_decimation;
+    const int order = dec->cfg.cic_order;
+    const uint64_t x = (uint64_t)(int64_t)value;
+    size_t n_out = 0;
+    size_t i = 0;
+
+    while (i < n) {
+        size_t run = R - dec->cic_phase;
+        if (run > n - i) {
+            run = n - i;
+        }
+
+        uint64_t acc[DECIMATOR_MAX_CIC_ORDER];
+        memcpy(acc, dec->integrator, sizeof(acc));
+        for (size_t k = 0; k < run; k++) {
+            uint64_t v = x;
+            for (int s = 0; s < order; s++) {
+                acc[s] += v;
+                v = acc[s];
+            }
+        }
+        memcpy(dec->integrator, acc, sizeof(acc));
+
+        i += run;
+        dec->cic_phase += (uint32_t)run;
+        if (dec->cic_phase < R) {
+            break;
+        }
+        dec->cic_phase = 0;
+
+        float y;
+        if (chain_step(dec, &y) && n_out < max_output) {
+            output[n_out++] = y;
+        }
+    }
+
+    return n_out;
+}
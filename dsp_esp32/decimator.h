@@ -0,0 +1,97 @@
+/**
+ * @file decimator.h
+ * @brief Decimador multiestágio (CIC + FIR compensador + meia-banda) por canal
+ *
+ * Cadeia de decimação usada para levar as grandezas por ciclo do medidor
+ * de potência (power_meter.c) à taxa do NILM:
+ *
+ *   entrada inteira -> CIC ordem N, fator R -> FIR compensador ÷2 -> meia-banda ÷2 (x n)
+ *
+ * Fator total = R * 2 * 2^n_halfbands. Para o detector NILM com 1 fase
+ * (10 kHz por canal -> 10 Hz) usa-se R = 125 e 2 estágios de meia-banda
+ * (125*2*2*2 = 1000); decimator_config_for_factor() escolhe R e n para
+ * outros fatores.
+ *
+ * O CIC usa apenas somas inteiras de 64 bits por amostra; os estágios FIR
+ * rodam já na taxa reduzida (80/40/20 Hz no caso acima), em float. O FIR
+ * compensador corrige a queda sinc^N do CIC na banda útil e rejeita o
+ * quarto superior da banda antes da primeira decimação por 2.
+ *
+ * A entrada é um código do ADC (decimator_process) ou um valor inteiro
+ * repetido em n amostras (decimator_process_hold, a grandeza de um ciclo
+ * em cada amostra dele). O estouro modular dos integradores se cancela
+ * nos pentes enquanto |entrada|·R^N couber em 63 bits: R^N <= 2^32 para
+ * entradas int32 (DECIMATOR_MAX_CIC_GAIN).
+ *
+ * Cada canal tem sua própria instância; nenhum estado é compartilhado.
+ * Nenhuma dependência do ESP-IDF (compila também no host).
+ */
+
+#ifndef DECIMATOR_H
+#define DECIMATOR_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// Limites da cadeia
+#define DECIMATOR_MAX_CIC_ORDER     5       // Ordem máxima do CIC (integrador de 64 bits)
+#define DECIMATOR_MAX_HALFBANDS     3       // Estágios de meia-banda após o compensador
+#define DECIMATOR_COMP_TAPS         21      // Taps do FIR compensador (simétrico)
+#define DECIMATOR_HB_TAPS           23      // Taps do filtro de meia-banda
+#define DECIMATOR_MIN_CIC_DECIMATION 16     // Menor R para o qual o compensador de ordem 4 vale
+#define DECIMATOR_MAX_CIC_GAIN      4294967296.0    // R^N máximo com entrada int32 (2^32)
+
+/**
+ * @brief Configuração da cadeia de decimação
+ *
+ * Os coeficientes do compensador foram projetados para CIC de ordem 4;
+ * como a queda do CIC depende praticamente só de f/fs_saída para R
+ * grande, eles servem para qualquer R >= 16 com essa ordem.
+ */
+typedef struct {
+    uint32_t cic_decimation;    // Fator R do CIC
+    uint8_t cic_order;          // Ordem N do CIC (1..DECIMATOR_MAX_CIC_ORDER)
+    uint8_t n_halfbands;        // Estágios de meia-banda ÷2 (0..DECIMATOR_MAX_HALFBANDS)
+    float output_scale;         // Escala aplicada à saída (ex.: volts por código)
+} decimator_config_t;
+
+/**
+ * @brief Estágio FIR com decimação por 2
+ *
+ * A linha de atraso é duplicada (delay[pos] == delay[pos + n_taps]) para
+ * que a convolução leia uma janela contígua sem aritmética modular.
+ */
+typedef struct {
+    float delay[2 * DECIMATOR_HB_TAPS];
+    uint32_t n_taps;
+    uint32_t pos;               // Próxima posição de escrita
+    uint32_t phase;             // Amostras recebidas desde a última saída (0 ou 1)
+} decimator_fir_stage_t;
+
+/**
+ * @brief Estado de um canal do decimador
+ */
+typedef struct {
+    decimator_config_t cfg;
+
+    // CIC: integradores na taxa de entrada, pentes na taxa decimada
+    uint64_t integrator[DECIMATOR_MAX_CIC_ORDER];  // Aritmética modular: o estouro se cancela nos pentes
+    uint64_t comb[DECIMATOR_MAX_CIC_ORDER];
+    uint32_t cic_phase;         // Amostras acumuladas desde a última saída do CIC
+    float cic_gain;             // output_scale / R^N
+
+    decimator_fir_stage_t comp;
+    decimator_fir_stage_t halfband[DECIMATOR_MAX_HALFBANDS];
+} decimator_t;
+
+// Protótipos de funções
+void decimator_init(decimator_t *dec, const decimator_config_t *cfg);
+void decimator_reset(decimator_t *dec);
+uint32_t decimator_total_factor(const decimator_config_t *cfg);
+bool decimator_config_for_factor(uint32_t factor, uint8_t cic_order, float output_scale, decimator_config_t *cfg);
+float decimator_group_delay(const decimator_config_t *cfg);
+size_t decimator_process(decimator_t *dec, const uint16_t *input, size_t n, float *output, size_t max_output);
+size_t decimator_process_hold(decimator_t *dec, int32_t value, size_t n, float *output, size_t max_output);
+
+#endif // DECIMATOR_H
@@ -4,10 +4,11 @@ ESP32 to NILMTK Data Converter
 Converte dados coletados pela ESP32 para formato compatível com NILMTK.
 
 Este módulo permite:
-1. Carregar dados CSV da ESP32
+1. Carregar dados da ESP32 (captura HDF5 do capture_store.py ou CSV)
 2. Converter para formato NILMTK (HDF5)
 3. Configurar metadata necessário
 4. Preparar dados para análise NILM
+5. Converter em fluxo (memória limitada) e vários medidores em paralelo
 """
 
 import pandas as pd
@@ -17,6 +18,59 @@ import h5py
 import os
 from typing import Dict, List, Optional, Tuple
 import warnings
+from concurrent.futures import ProcessPoolExecutor
+
+from capture_store import CaptureReader, is_capture_file
+
+# Pacotes lidos por vez de uma captura HDF5
+CAPTURE_BATCH_PACKETS = 1024
+
+# Conversão em fluxo
+STREAM_CSV_ROWS = 200000        # Linhas do CSV lidas por vez
+STREAM_H5_CHUNK = 65536         # Amostras por chunk das séries de saída
+# power/reactive e power/apparent só existem se a fonte os mede (colunas reactive/apparent,
+# ex.: power_meter.c do detector NILM); o RMS de signal_analyzer não dá Q nem S
+STREAM_SERIES = ('timestamps', 'power/active', 'power/reactive', 'power/apparent', 'voltage', 'current')
+
+
+def _power_frame(timestamps, rms) -> pd.DataFrame:
+    """Potência a partir do RMS de cada pacote (mesma conversão de extract_power_data)"""
+    # Conversão simplificada - ajustar conforme calibração real
+    voltage_rms = rms * 110  # Assume 110V nominal
+    current_rms = rms * 10   # Escala para corrente
+    return pd.DataFrame({
+        'power': voltage_rms * current_rms,  # Potência aparente
+        'voltage': voltage_rms,
+        'current': current_rms,
+    }, index=pd.DatetimeIndex(timestamps, name='timestamp'))
+
+
+class _RunningStats:
+    """count/mean/std/min/max acumulados lote a lote (combinação de Chan)"""
+
+    def __init__(self):
+        self.count, self.mean, self.m2 = 0, 0.0, 0.0
+        self.min, self.max = np.inf, -np.inf
+
+    def update(self, values):
+        values = np.asarray(values, dtype=np.float64)
+        n = len(values)
+        if not n:
+            return
+        mean = values.mean()
+        m2 = np.square(values - mean).sum()
+        total = self.count + n
+        delta = mean - self.mean
+        self.mean += delta * n / total
+        self.m2 += m2 + delta * delta * self.count * n / total
+        self.count = total
+        self.min = min(self.min, values.min())
+        self.max = max(self.max, values.max())
+
+    def as_dict(self) -> Dict:
+        std = np.sqrt(self.m2 / (self.count - 1)) if self.count > 1 else np.nan
+        return {'count': self.count, 'mean': float(self.mean), 'std': float(std),
+                'min': float(self.min), 'max': float(self.max)}
 
 class ESP32ToNILMTK:
     """
@@ -30,10 +84,12 @@ class ESP32ToNILMTK:
         Parameters:
         -----------
         csv_file_path : str
-            Caminho para o arquivo CSV gerado pela ESP32
+            Caminho para a captura HDF5 (signal_analyzer.py) ou para o CSV
+            gerado pela ESP32
         """
         self.csv_file_path = csv_file_path
         self.raw_data = None
+        self.capture = None
         self.nilmtk_data = None
         self.metadata = self._create_default_metadata()
         
@@ -60,15 +116,26 @@ class ESP32ToNILMTK:
     
     def load_esp32_data(self) -> pd.DataFrame:
         """
-        Carrega e processa dados CSV da ESP32.
+        Carrega e processa dados CSV da ESP32. Uma captura HDF5 não é
+        carregada: só o índice de pacotes, e os blocos são lidos em lotes por
+        extract_power_data().
         
         Returns:
         --------
         pd.DataFrame
-            DataFrame com dados processados
+            DataFrame com dados processados (índice de pacotes, para captura)
         """
         print(f"📂 Carregando dados de: {self.csv_file_path}")
         
+        if is_capture_file(self.csv_file_path):
+            self.capture = CaptureReader(self.csv_file_path)
+            index = pd.DataFrame(self.capture.index)
+            index['timestamp'] = pd.to_datetime(index['timestamp'], unit='s')
+            print(f"✅ Captura aberta: {len(index)} pacotes")
+            if len(index):
+                print(f"📊 Período: {index['timestamp'].min()} até {index['timestamp'].max()}")
+            return index
+        
         try:
             # Carrega dados CSV
             self.raw_data = pd.read_csv(self.csv_file_path)
@@ -102,11 +169,18 @@ class ESP32ToNILMTK:
         pd.DataFrame
             DataFrame com dados de potência no formato NILMTK
         """
-        if self.raw_data is None:
+        if self.raw_data is None and self.capture is None:
             self.load_esp32_data()
         
         print("⚡ Processando dados de potência...")
         
+        if self.capture is not None:
+            parts = list(self._iter_capture_power())
+            power_df = pd.concat(parts) if parts else _power_frame([], np.empty(0))
+            print(f"✅ {len(power_df)} pontos de potência extraídos")
+            print(f"📈 Potência média: {power_df['power'].mean():.2f} W")
+            return power_df
+        
         # Filtra apenas dados de sinal original (não FFT)
         signal_data = self.raw_data[self.raw_data['data_type'] == 'signal_original'].copy()
         
@@ -141,6 +215,60 @@ class ESP32ToNILMTK:
         
         return power_df
     
+    def _iter_capture_power(self):
+        """
+        Mesma conversão de extract_power_data(), lote a lote sobre o bloco
+        signal_original da captura: cada lote é uma leitura contígua e o RMS
+        por pacote sai de np.add.reduceat.
+        """
+        for rows, _, y, lengths in self.capture.iter_batches('signal_original', CAPTURE_BATCH_PACKETS):
+            keep = lengths > 0
+            if not keep.any():
+                continue
+            lengths = lengths[keep]
+            starts = np.concatenate(([0], np.cumsum(lengths[:-1])))
+            y = y.astype(np.float64)
+            rms = np.sqrt(np.add.reduceat(y * y, starts) / lengths)
+            yield _power_frame(pd.to_datetime(rows['timestamp'][keep], unit='s'), rms)
+    
+    def _iter_csv_power(self, chunk_rows: int = STREAM_CSV_ROWS):
+        """
+        extract_power_data() sobre o CSV lido em pedaços: um pacote são as
+        linhas com o mesmo timestamp; o último pacote de cada pedaço passa para
+        o próximo, que pode continuá-lo.
+        """
+        tail = None
+        columns = ['timestamp', 'data_type', 'amplitude_or_magnitude']
+        for chunk in pd.read_csv(self.csv_file_path, chunksize=chunk_rows, usecols=columns):
+            chunk = chunk[chunk['data_type'] == 'signal_original']
+            if tail is not None:
+                chunk = pd.concat([tail, chunk], ignore_index=True)
+            if chunk.empty:
+                continue
+            last = chunk['timestamp'].iloc[-1]
+            tail = chunk[chunk['timestamp'] == last]
+            body = chunk[chunk['timestamp'] != last]
+            if len(body):
+                yield self._packet_power(body)
+        if tail is not None and len(tail):
+            yield self._packet_power(tail)
+    
+    @staticmethod
+    def _packet_power(signal_rows: pd.DataFrame) -> pd.DataFrame:
+        ms = np.square(signal_rows['amplitude_or_magnitude']).groupby(signal_rows['timestamp']).mean()
+        return _power_frame(pd.to_datetime(ms.index), np.sqrt(ms.values))
+    
+    def iter_power_chunks(self):
+        """
+        Potência em pedaços (DataFrames como os de extract_power_data), sem
+        carregar a entrada inteira: lotes de pacotes da captura ou pedaços do CSV.
+        """
+        if is_capture_file(self.csv_file_path):
+            if self.capture is None:
+                self.capture = CaptureReader(self.csv_file_path)
+            return self._iter_capture_power()
+        return self._iter_csv_power()
+    
     def create_nilmtk_format(self, power_data: pd.DataFrame, 
                            building_number: int = 1,
                            meter_number: int = 1) -> Dict:
@@ -164,15 +292,17 @@ class ESP32ToNILMTK:
         print("🔄 Convertendo para formato NILMTK...")
         
         # Cria estrutura NILMTK
+        # Reativa/aparente só quando medidas (sem colunas zeradas ou copiadas da ativa)
+        power = {'active': power_data['power'].values}
+        for column in ('reactive', 'apparent'):
+            if column in power_data:
+                power[column] = power_data[column].values
+        
         nilmtk_data = {
             f'building{building_number}': {
                 'elec': {
                     'meter1': {
-                        'power': {
-                            'active': power_data['power'].values,
-                            'reactive': np.zeros(len(power_data)),  # Placeholder
-                            'apparent': power_data['power'].values
-                        },
+                        'power': power,
                         'voltage': power_data['voltage'].values,
                         'current': power_data['current'].values,
                         'timestamps': power_data.index
@@ -255,9 +385,8 @@ class ESP32ToNILMTK:
                 
                 # Dados de potência
                 power_group = meter_group.create_group('power')
-                power_group.create_dataset('active', data=meter_data['power']['active'])
-                power_group.create_dataset('reactive', data=meter_data['power']['reactive'])
-                power_group.create_dataset('apparent', data=meter_data['power']['apparent'])
+                for name, values in meter_data['power'].items():
+                    power_group.create_dataset(name, data=values)
                 
                 # Dados de tensão e corrente
                 meter_group.create_dataset('voltage', data=meter_data['voltage'])
@@ -297,6 +426,90 @@ class ESP32ToNILMTK:
             print(f"❌ Erro ao salvar HDF5: {e}")
             raise
     
+    def convert_streaming(self, output_path: str, building_number: int = 1,
+                          meter_number: int = 1, chunks=None) -> Dict:
+        """
+        Converte em fluxo: cada pedaço de potência é acrescentado a datasets
+        redimensionáveis, em chunks comprimidos, no layout de save_to_hdf5()
+        (building{n}/elec/meter{m}/timestamps, power/active, ...). A memória
+        usada é a de um pedaço, qualquer que seja a duração da entrada.
+        
+        Parameters:
+        -----------
+        output_path : str
+            Arquivo HDF5 de saída (aberto para acréscimo; o medidor é substituído)
+        building_number : int
+            Número do prédio
+        meter_number : int
+            Número do medidor
+        chunks : iterable, optional
+            DataFrames de potência (índice datetime; colunas power, voltage,
+            current e, opcionais, reactive/apparent). Padrão: iter_power_chunks()
+            
+        Returns:
+        --------
+        Dict
+            building, meter, start, end e estatísticas da potência ativa
+        """
+        chunks = self.iter_power_chunks() if chunks is None else chunks
+        stats = _RunningStats()
+        start = end = None
+        print(f"💾 Convertendo em fluxo: {output_path} (building{building_number}/meter{meter_number})")
+        
+        with h5py.File(output_path, 'a') as f:
+            building_group = f.require_group(f'building{building_number}')
+            elec_group = building_group.require_group('elec')
+            if f'meter{meter_number}' in elec_group:
+                del elec_group[f'meter{meter_number}']
+            meter_group = elec_group.create_group(f'meter{meter_number}')
+            series = {}
+            
+            for chunk in chunks:
+                n = len(chunk)
+                if not n:
+                    continue
+                index = pd.DatetimeIndex(chunk.index)
+                power = chunk['power'].values
+                values = {
+                    'timestamps': index.asi8 / 1e9,
+                    'power/active': power,
+                    'voltage': chunk['voltage'].values,
+                    'current': chunk['current'].values,
+                }
+                for column in ('reactive', 'apparent'):
+                    if column in chunk:
+                        values[f'power/{column}'] = chunk[column].values
+                if not series:
+                    # As séries do primeiro lote definem o medidor
+                    for path in STREAM_SERIES:
+                        if path in values:
+                            series[path] = meter_group.create_dataset(
+                                path, shape=(0,), maxshape=(None,), dtype='<f8', chunks=(STREAM_H5_CHUNK,),
+                                compression='gzip', compression_opts=4, shuffle=True)
+                    # Segundos Unix com fração: a 10 Hz o inteiro de save_to_hdf5 colidiria
+                    series['timestamps'].attrs['units'] = 's'
+                for path, dataset in series.items():
+                    length = dataset.shape[0]
+                    dataset.resize((length + n,))
+                    dataset[length:] = values[path]
+                stats.update(power)
+                start = index[0] if start is None else start
+                end = index[-1]
+            
+            summary = {'building': building_number, 'meter': meter_number,
+                       'start': start, 'end': end, **stats.as_dict()}
+            _write_metadata(building_group, summary)
+        
+        self.nilmtk_data = {f'building{building_number}': {
+            'elec': {f'meter{meter_number}': {}},
+            'metadata': {'timeframe': {'start': start, 'end': end},
+                         'elec_meters': {meter_number: {'device_model': 'ESP32-S3', 'site_meter': True,
+                                                        'data_location': 'ESP32_ADC',
+                                                        'statistics': stats.as_dict()}}},
+        }}
+        print(f"✅ {stats.count} pontos de potência gravados")
+        return summary
+    
     def generate_summary_report(self) -> str:
         """
         Gera relatório resumo dos dados convertidos.
@@ -310,8 +523,7 @@ class ESP32ToNILMTK:
             return "❌ Dados NILMTK não disponíveis"
         
         building_data = list(self.nilmtk_data.values())[0]
-        meter_data = building_data['elec']['meter1']
-        metadata = building_data['metadata']['elec_meters'][1]
+        metadata = next(iter(building_data['metadata']['elec_meters'].values()))
         
         report = f"""
 📊 RELATÓRIO DE CONVERSÃO ESP32 → NILMTK
@@ -338,9 +550,100 @@ class ESP32ToNILMTK:
 """
         return report
 
+def _write_metadata(building_group, summary: Dict):
+    """
+    Metadados de um medidor convertido em fluxo, no layout de save_to_hdf5().
+    O timeframe do prédio é a união dos medidores já gravados.
+    """
+    building_number, meter_number = summary['building'], summary['meter']
+    metadata_group = building_group.require_group('metadata')
+    metadata_group.attrs['instance'] = building_number
+    metadata_group.attrs['original_name'] = f'ESP32_Building_{building_number}'
+    
+    timeframe_group = metadata_group.require_group('timeframe')
+    if summary['start'] is not None:
+        start, end = pd.Timestamp(summary['start']), pd.Timestamp(summary['end'])
+        if 'start' in timeframe_group.attrs:
+            start = min(start, pd.Timestamp(timeframe_group.attrs['start']))
+            end = max(end, pd.Timestamp(timeframe_group.attrs['end']))
+        timeframe_group.attrs['start'] = str(start)
+        timeframe_group.attrs['end'] = str(end)
+    
+    elec_meters_group = metadata_group.require_group('elec_meters')
+    if str(meter_number) in elec_meters_group:
+        del elec_meters_group[str(meter_number)]
+    meter_group = elec_meters_group.create_group(str(meter_number))
+    meter_group.attrs['device_model'] = 'ESP32-S3'
+    meter_group.attrs['site_meter'] = meter_number == 1
+    meter_group.attrs['data_location'] = 'ESP32_ADC'
+    stats_group = meter_group.create_group('statistics')
+    for key in ('count', 'mean', 'std', 'min', 'max'):
+        stats_group.attrs[key] = float(summary[key])
+
+
+def _convert_job(job: Dict) -> Dict:
+    """Conversão de um medidor num processo do pool (arquivo de saída próprio)"""
+    converter = ESP32ToNILMTK(job['input'])
+    return converter.convert_streaming(job['output'], job['building'], job['meter'])
+
+
+def convert_fleet(jobs: List[Tuple[str, int, int]], output_hdf5: str,
+                  max_workers: Optional[int] = None) -> List[Dict]:
+    """
+    Converte vários medidores/prédios em paralelo, em fluxo.
+    
+    HDF5 não aceita escritores concorrentes, então cada processo grava um
+    arquivo parcial (output_hdf5 + '.parts/') e, no fim, os medidores são
+    copiados para output_hdf5 (cópia de chunks pelo HDF5, sem carregar as
+    séries) e os parciais removidos.
+    
+    Parameters:
+    -----------
+    jobs : list
+        (entrada, prédio, medidor) para cada medidor; entrada é uma captura
+        HDF5 ou um CSV da ESP32
+    output_hdf5 : str
+        Arquivo NILMTK de saída
+    max_workers : int, optional
+        Processos (padrão: os.cpu_count())
+        
+    Returns:
+    --------
+    List[Dict]
+        Resumo de cada medidor (retorno de convert_streaming)
+    """
+    parts_dir = output_hdf5 + '.parts'
+    os.makedirs(parts_dir, exist_ok=True)
+    tasks = [{'input': source, 'building': building, 'meter': meter,
+              'output': os.path.join(parts_dir, f'building{building}_meter{meter}.h5')}
+             for source, building, meter in jobs]
+    for task in tasks:
+        if os.path.exists(task['output']):
+            os.remove(task['output'])
+    
+    print(f"🚀 Convertendo {len(tasks)} medidores em paralelo")
+    with ProcessPoolExecutor(max_workers=max_workers) as pool:
+        summaries = list(pool.map(_convert_job, tasks))
+    
+    with h5py.File(output_hdf5, 'a') as out:
+        for task, summary in zip(tasks, summaries):
+            building, meter = f"building{task['building']}", f"meter{task['meter']}"
+            elec_group = out.require_group(f'{building}/elec')
+            if meter in elec_group:
+                del elec_group[meter]
+            with h5py.File(task['output'], 'r') as part:
+                part.copy(part[f'{building}/elec/{meter}'], elec_group, name=meter)
+            _write_metadata(out[building], summary)
+            os.remove(task['output'])
+    os.rmdir(parts_dir)
+    
+    print(f"✅ Arquivo HDF5 salvo: {output_hdf5}")
+    return summaries
+
 def convert_esp32_to_nilmtk(csv_file: str, 
                            output_hdf5: str,
-                           building_number: int = 1) -> str:
+                           building_number: int = 1,
+                           streaming: bool = False) -> str:
     """
     Função utilitária para conversão completa ESP32 → NILMTK.
     
@@ -352,6 +655,8 @@ def convert_esp32_to_nilmtk(csv_file: str,
         Caminho de saída do arquivo HDF5
     building_number : int
         Número do prédio
+    streaming : bool
+        Converte em fluxo (convert_streaming), com memória limitada
         
     Returns:
     --------
@@ -365,6 +670,13 @@ def convert_esp32_to_nilmtk(csv_file: str,
         # Cria conversor
         converter = ESP32ToNILMTK(csv_file)
         
+        if streaming:
+            converter.convert_streaming(output_hdf5, building_number)
+            report = converter.generate_summary_report()
+            print("\n🎉 Conversão concluída com sucesso!")
+            print(report)
+            return report
+        
         # Carrega dados
         converter.load_esp32_data()
         
@@ -391,8 +703,10 @@ def convert_esp32_to_nilmtk(csv_file: str,
         raise
 
 if __name__ == "__main__":
-    # Exemplo de uso
-    csv_file = "signal_analysis_data.csv"
+    # Exemplo de uso (captura HDF5 se existir, senão o CSV antigo)
+    csv_file = "signal_analysis_data.h5"
+    if not os.path.exists(csv_file):
+        csv_file = "signal_analysis_data.csv"
     output_file = "esp32_nilmtk_dataset.h5"
     
     if os.path.exists(csv_file):
@@ -0,0 +1,199 @@
+/**
+ * @file event_detector.c
+ * @brief Implementação do detector de eventos NILM (limiar adaptativo, debounce e CUSUM)
+ */
+
+#include "event_detector.h"
+#include <math.h>
+#include <stddef.h>
+
+/**
+ * @brief Inicializa o detector
+ *
+ * @param ed Estado
+ * @param config Parâmetros; NULL usa EVENT_DETECTOR_DEFAULT_CONFIG
+ */
+void event_detector_init(event_detector_t *ed, const event_detector_config_t *config) {
+    static const event_detector_config_t defaults = EVENT_DETECTOR_DEFAULT_CONFIG;
+    ed->config = (config != NULL) ? *config : defaults;
+
+    if (ed->config.noise_window < 2) {
+        ed->config.noise_window = 2;
+    } else if (ed->config.noise_window > EVENT_DETECTOR_MAX_NOISE_WINDOW) {
+        ed->config.noise_window = EVENT_DETECTOR_MAX_NOISE_WINDOW;
+    }
+
+    if (ed->config.level_samples < 1) {
+        ed->config.level_samples = 1;
+    } else if (ed->config.level_samples > EVENT_DETECTOR_MAX_LEVEL_WINDOW) {
+        ed->config.level_samples = EVENT_DETECTOR_MAX_LEVEL_WINDOW;
+    }
+
+    running_stats_init(&ed->noise, ed->noise_values, NULL, NULL, ed->config.noise_window);
+    running_stats_init(&ed->level, ed->level_values, NULL, NULL, ed->config.level_samples);
+    changepoint_init(&ed->change, &ed->config.changepoint);
+    event_detector_reset(ed);
+}
+
+/**
+ * @brief Volta ao estado inicial (janela de ruído vazia, sem eventos)
+ */
+void event_detector_reset(event_detector_t *ed) {
+    ed->n = 0;
+    ed->previous_power = 0.0f;
+    ed->threshold = ed->config.min_threshold;
+    ed->last_highpass = 0.0f;
+    ed->last_event = 0;
+    ed->has_event = false;
+    ed->pending = false;
+    ed->level_before = 0.0f;
+    ed->level_after_sum = 0.0;
+    running_stats_reset(&ed->noise);
+    running_stats_reset(&ed->level);
+    changepoint_reset(&ed->change);
+}
+
+/**
+ * @brief Limiar adaptativo: sigma_k vezes o desvio padrão do ruído, nunca abaixo de min_threshold
+ */
+static float adaptive_threshold(const event_detector_t *ed) {
+    if (!running_stats_full(&ed->noise)) {
+        return ed->config.min_threshold;
+    }
+    // A janela guarda diferenças entre amostras: sigma(dP) = sqrt(2) * sigma(P)
+    float sigma = running_stats_stddev(&ed->noise) * 0.70710678f;
+    float threshold = ed->config.sigma_k * sigma;
+    return (threshold > ed->config.min_threshold) ? threshold : ed->config.min_threshold;
+}
+
+/**
+ * @brief Degrau entre regimes permanentes, datado no início do transitório
+ */
+static bool changepoint_step(event_detector_t *ed, float power, event_detector_event_t *event) {
+    changepoint_event_t change;
+    ed->change.config.min_delta = ed->threshold;    // Menor degrau = limiar adaptativo
+    if (!changepoint_update(&ed->change, power, &change)) {
+        return false;
+    }
+    *event = (event_detector_event_t){
+        .index = change.start,
+        .duration = change.duration,
+        .delta_power = change.delta_power,
+        .power = change.level_after,
+        .steady = true,
+        .timed_out = change.timed_out,
+    };
+    return true;
+}
+
+/**
+ * @brief Amostras entre o disparo e o fim da janela do nível depois
+ */
+static uint32_t threshold_settle(const event_detector_t *ed) {
+    const event_detector_config_t *c = &ed->config;
+    return (c->debounce_samples > c->level_samples) ? c->debounce_samples : c->level_samples;
+}
+
+/**
+ * @brief |passa-alta| acima do limiar dispara; o evento sai com o degrau entre as médias de nível
+ *
+ * No máximo um disparo a cada debounce_samples, e nenhum enquanto o
+ * anterior espera o nível depois. Sem degrau acima do limiar entre os
+ * níveis, o disparo é descartado.
+ */
+static bool threshold_step(event_detector_t *ed, float power, float highpass, event_detector_event_t *event) {
+    const uint32_t index = ed->n;
+    const uint32_t settle = threshold_settle(ed);
+
+    if (!ed->pending) {
+        if (ed->has_event && index - ed->last_event < ed->config.debounce_samples) {
+            return false;
+        }
+        if (!(fabsf(highpass) > ed->threshold)) {
+            return false;
+        }
+        // A janela de nível ainda não tem a amostra do disparo
+        ed->level_before = (ed->level.count > 0) ? running_stats_mean(&ed->level) : power;
+        ed->level_after_sum = 0.0;
+        ed->last_event = index;
+        ed->has_event = true;
+        ed->pending = true;
+    }
+
+    // Nível depois: média das level_samples amostras que terminam em last_event + settle
+    const uint32_t age = index - ed->last_event;
+    if (age >= settle - ed->config.level_samples) {
+        ed->level_after_sum += power;
+    }
+    if (age < settle - 1) {
+        return false;
+    }
+    float level_after = (float)(ed->level_after_sum / ed->config.level_samples);
+    float delta = level_after - ed->level_before;
+    ed->pending = false;
+    if (!(fabsf(delta) > ed->threshold)) {
+        return false;
+    }
+    *event = (event_detector_event_t){
+        .index = ed->last_event,
+        .delta_power = delta,
+        .power = level_after,
+    };
+    return true;
+}
+
+/**
+ * @brief Processa uma amostra
+ *
+ * @param ed Estado
+ * @param power Potência ativa (W)
+ * @param highpass Saída do passa-alta para a mesma amostra (W; ignorada no CUSUM)
+ * @param event Recebe o evento, se houver
+ * @return true se um evento foi entregue nesta amostra (datado em event->index)
+ */
+bool event_detector_update(event_detector_t *ed, float power, float highpass, event_detector_event_t *event) {
+    if (ed->n > 0) {
+        running_stats_push(&ed->noise, power - ed->previous_power);
+    }
+    ed->previous_power = power;
+    ed->threshold = adaptive_threshold(ed);
+    ed->last_highpass = highpass;
+
+    bool detected;
+    if (ed->config.kind == EVENT_DETECTOR_CHANGEPOINT) {
+        detected = changepoint_step(ed, power, event);
+    } else {
+        detected = threshold_step(ed, power, highpass, event);
+        running_stats_push(&ed->level, power);
+    }
+    ed->n++;
+    return detected;
+}
+
+/**
+ * @brief Verdadeiro se há mudança em curso (controle adaptativo da aquisição)
+ *
+ * No CUSUM, transitório ou estatística acumulando; no limiar, disparo à
+ * espera do nível depois ou |passa-alta| acima de metade do limiar na
+ * última amostra.
+ */
+bool event_detector_active(const event_detector_t *ed) {
+    if (ed->config.kind == EVENT_DETECTOR_CHANGEPOINT) {
+        return changepoint_active(&ed->change);
+    }
+    return ed->pending || fabsf(ed->last_highpass) > 0.5f * ed->threshold;
+}
+
+/**
+ * @brief Menor número de amostras entre dois eventos (dimensiona buffers de eventos)
+ *
+ * No limiar é o debounce ou a espera do nível depois, o que for maior; no
+ * CUSUM, a confirmação de um regime exige a janela de acomodação cheia
+ * depois da confirmação anterior.
+ */
+uint32_t event_detector_min_gap(const event_detector_t *ed) {
+    uint32_t gap = (ed->config.kind == EVENT_DETECTOR_CHANGEPOINT)
+                       ? ed->change.config.settle_samples
+                       : threshold_settle(ed);
+    return (gap > 0) ? gap : 1;
+}
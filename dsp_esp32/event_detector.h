@@ -0,0 +1,122 @@
+/**
+ * @file event_detector.h
+ * @brief Detector de eventos NILM comum ao firmware e às ferramentas do host
+ *
+ * Recebe, a cada amostra na taxa NILM, a potência e a saída do passa-alta
+ * e decide se houve evento:
+ *
+ *  - LIMIAR ADAPTATIVO: max(min_threshold, sigma_k · σ), com σ do ruído de
+ *    potência estimado pelas diferenças entre amostras em uma janela de
+ *    noise_window amostras (σ(dP) = √2·σ(P)); min_threshold enquanto a
+ *    janela não enche;
+ *  - EVENT_DETECTOR_CHANGEPOINT: CUSUM com segmentação em regime
+ *    permanente (changepoint.h) sobre a potência, menor degrau = limiar;
+ *    o evento é datado no início do transitório;
+ *  - EVENT_DETECTOR_THRESHOLD: |passa-alta| > limiar, com debounce de
+ *    debounce_samples amostras entre eventos. O passa-alta só dispara: o
+ *    ΔP é a média das últimas level_samples amostras antes do disparo
+ *    subtraída da média das level_samples amostras que terminam
+ *    max(debounce_samples, level_samples) amostras depois dele, quando o
+ *    evento é entregue (datado no disparo). Disparos com |ΔP| <= limiar
+ *    (picos que voltam ao nível, cauda do passa-alta depois de um degrau)
+ *    não geram evento.
+ *
+ * O debounce conta amostras, não tempo: no firmware as amostras chegam na
+ * grade de 100 ms também no modo econômico (acq_control.h), então
+ * debounce_samples = tempo / período. Índices contam amostras desde
+ * event_detector_init()/event_detector_reset(). Nenhuma dependência do
+ * ESP-IDF; o mesmo código roda em host/nilm_replay.c e host/nilm_batch.c.
+ */
+
+#ifndef EVENT_DETECTOR_H
+#define EVENT_DETECTOR_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "nilm_filters.h"
+#include "running_stats.h"
+#include "changepoint.h"
+
+#define EVENT_DETECTOR_MAX_NOISE_WINDOW     600     // Maior janela de ruído (amostras)
+#define EVENT_DETECTOR_MAX_LEVEL_WINDOW     100     // Maior janela das médias de nível (amostras)
+
+/**
+ * @brief Regra de decisão
+ */
+typedef enum {
+    EVENT_DETECTOR_THRESHOLD = 0,   // |passa-alta| > limiar com debounce
+    EVENT_DETECTOR_CHANGEPOINT,     // Degrau entre regimes permanentes (CUSUM)
+} event_detector_kind_t;
+
+/**
+ * @brief Parâmetros (em W e amostras)
+ */
+typedef struct {
+    event_detector_kind_t kind;
+    float min_threshold;            // Piso do limiar adaptativo (W)
+    float sigma_k;                  // Limiar adaptativo em sigmas do ruído de potência
+    uint32_t noise_window;          // Janela do ruído (<= EVENT_DETECTOR_MAX_NOISE_WINDOW)
+    uint32_t debounce_samples;      // Amostras mínimas entre eventos (só no limiar)
+    uint32_t level_samples;         // Médias antes/depois do evento (só no limiar, <= EVENT_DETECTOR_MAX_LEVEL_WINDOW)
+    changepoint_config_t changepoint;   // CUSUM (min_delta é substituído pelo limiar)
+} event_detector_config_t;
+
+// As constantes de nilm_filters.h; a 10 Hz, ruído em 60 s e níveis em 1 s
+#define EVENT_DETECTOR_DEFAULT_CONFIG {             \
+    .kind = EVENT_DETECTOR_CHANGEPOINT,             \
+    .min_threshold = NILM_EVENT_THRESHOLD,          \
+    .sigma_k = NILM_EVENT_SIGMA_K,                  \
+    .noise_window = 60 * NILM_SAMPLE_RATE_HZ,       \
+    .debounce_samples = NILM_DEBOUNCE_TIME_MS * NILM_SAMPLE_RATE_HZ / 1000, \
+    .level_samples = NILM_SAMPLE_RATE_HZ,           \
+    .changepoint = CHANGEPOINT_DEFAULT_CONFIG,      \
+}
+
+/**
+ * @brief Evento detectado
+ */
+typedef struct {
+    uint32_t index;                 // Amostra do evento (início do transitório no CUSUM, disparo no limiar)
+    uint32_t duration;              // Amostras de transitório (0 no limiar)
+    float delta_power;              // Nível depois - nível antes (W)
+    float power;                    // Nível depois do evento (W)
+    bool steady;                    // Níveis são regimes permanentes confirmados (CUSUM)
+    bool timed_out;                 // CUSUM: confirmado por max_transient
+} event_detector_event_t;
+
+/**
+ * @brief Estado do detector
+ */
+typedef struct {
+    event_detector_config_t config;
+    uint32_t n;                     // Índice da próxima amostra
+    float previous_power;           // Amostra anterior (diferenças do ruído)
+    float threshold;                // Limiar usado na última amostra (W)
+    float last_highpass;            // Passa-alta da última amostra (W)
+    uint32_t last_event;            // Índice do último disparo (debounce)
+    bool has_event;
+    bool pending;                   // Limiar: disparo à espera do nível depois
+    float level_before;             // Limiar: média antes do disparo (W)
+    double level_after_sum;         // Limiar: soma da janela depois do disparo
+    running_stats_t noise;          // Diferenças entre amostras consecutivas
+    float noise_values[EVENT_DETECTOR_MAX_NOISE_WINDOW];
+    running_stats_t level;          // Limiar: últimas level_samples potências
+    float level_values[EVENT_DETECTOR_MAX_LEVEL_WINDOW];
+    changepoint_t change;
+} event_detector_t;
+
+// Protótipos de funções
+void event_detector_init(event_detector_t *ed, const event_detector_config_t *config);
+void event_detector_reset(event_detector_t *ed);
+bool event_detector_update(event_detector_t *ed, float power, float highpass, event_detector_event_t *event);
+bool event_detector_active(const event_detector_t *ed);
+uint32_t event_detector_min_gap(const event_detector_t *ed);
+
+/**
+ * @brief Limiar adaptativo usado na última amostra (W)
+ */
+static inline float event_detector_threshold(const event_detector_t *ed) {
+    return ed->threshold;
+}
+
+#endif // EVENT_DETECTOR_H
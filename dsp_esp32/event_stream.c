@@ -0,0 +1,181 @@
+/**
+ * @file event_stream.c
+ * @brief Implementação do envio de eventos em lotes e do resumo de potência
+ */
+
+#include "event_stream.h"
+#include <string.h>
+#include <math.h>
+#include "telemetry.h"
+
+// Buffer circular de registros pendentes
+static event_record_t records[EVENT_STREAM_CAPACITY];
+static size_t head = 0;                 // Registro mais antigo
+static size_t count = 0;
+static uint32_t oldest_ms = 0;          // Instante do registro mais antigo
+static uint16_t next_sequence = 0;
+static uint16_t dropped_pending = 0;    // Descartes ainda não informados ao host
+static uint32_t dropped_total = 0;
+static uint32_t batch_id = 0;
+
+// Acumuladores do resumo de potência
+static uint32_t summary_start_ms = 0;
+static uint32_t summary_id = 0;
+static uint32_t summary_samples = 0;
+static uint32_t summary_events = 0;
+static float summary_sum = 0.0f;
+static float summary_reactive = 0.0f;
+static float summary_apparent = 0.0f;
+static float summary_min = INFINITY;
+static float summary_max = -INFINITY;
+
+static void summary_reset(uint32_t now_ms) {
+    summary_start_ms = now_ms;
+    summary_samples = 0;
+    summary_events = 0;
+    summary_sum = 0.0f;
+    summary_reactive = 0.0f;
+    summary_apparent = 0.0f;
+    summary_min = INFINITY;
+    summary_max = -INFINITY;
+}
+
+/**
+ * @brief Inicializa o buffer e o período do resumo
+ *
+ * @param now_ms Instante atual (ms desde o boot)
+ */
+void event_stream_init(uint32_t now_ms) {
+    head = 0;
+    count = 0;
+    next_sequence = 0;
+    dropped_pending = 0;
+    dropped_total = 0;
+    batch_id = 0;
+    summary_id = 0;
+    summary_reset(now_ms);
+}
+
+/**
+ * @brief Enfileira um evento; envia o lote se atingir EVENT_STREAM_BATCH
+ *
+ * Com o buffer cheio (telemetria parada) o evento é descartado, mas o
+ * número de sequência avança para que o host perceba a lacuna.
+ *
+ * @param event Evento classificado
+ * @param power Potência no instante do evento (W)
+ */
+void event_stream_push(const nilm_event_t *event, float power) {
+    uint16_t sequence = next_sequence++;
+    summary_events++;
+    
+    if (count == EVENT_STREAM_CAPACITY) {
+        if (dropped_pending < UINT16_MAX) dropped_pending++;
+        dropped_total++;
+        return;
+    }
+    
+    event_record_from_event(&records[(head + count) % EVENT_STREAM_CAPACITY], event, power, sequence);
+    if (count++ == 0) {
+        oldest_ms = event->timestamp_ms;
+    }
+    
+    if (count >= EVENT_STREAM_BATCH) {
+        event_stream_flush();
+    }
+}
+
+/**
+ * @brief Acumula uma amostra de potência no resumo do período
+ *
+ * @param power Potência ativa (W)
+ * @param reactive Potência reativa (var)
+ * @param apparent Potência aparente (VA)
+ */
+void event_stream_add_sample(float power, float reactive, float apparent) {
+    summary_samples++;
+    summary_sum += power;
+    summary_reactive += reactive;
+    summary_apparent += apparent;
+    if (power < summary_min) summary_min = power;
+    if (power > summary_max) summary_max = power;
+}
+
+/**
+ * @brief Envia os registros pendentes em um quadro TELEMETRY_TYPE_EVENTS
+ *
+ * @return true se o buffer foi esvaziado (ou já estava vazio); false se a
+ *         fila de transmissão estava cheia (os registros ficam para a
+ *         próxima tentativa)
+ */
+bool event_stream_flush(void) {
+    static uint8_t payload[sizeof(event_batch_header_t) + EVENT_STREAM_CAPACITY * sizeof(event_record_t)];
+    
+    if (count == 0 && dropped_pending == 0) {
+        return true;
+    }
+    
+    event_batch_header_t header = { .n_events = (uint16_t)count, .dropped = dropped_pending };
+    memcpy(payload, &header, sizeof(header));
+    
+    // Copia o buffer circular em até dois trechos
+    size_t first = EVENT_STREAM_CAPACITY - head;
+    if (first > count) first = count;
+    uint8_t *out = payload + sizeof(header);
+    memcpy(out, &records[head], first * sizeof(event_record_t));
+    memcpy(out + first * sizeof(event_record_t), &records[0], (count - first) * sizeof(event_record_t));
+    
+    uint16_t len = (uint16_t)(sizeof(header) + count * sizeof(event_record_t));
+    if (!telemetry_send_raw(TELEMETRY_TYPE_EVENTS, batch_id, payload, len, 0)) {
+        return false;
+    }
+    
+    batch_id++;
+    head = 0;
+    count = 0;
+    dropped_pending = 0;
+    return true;
+}
+
+/**
+ * @brief Disparos por tempo: lote com registro antigo e resumo do período
+ *
+ * Chamada a cada amostra da task NILM.
+ *
+ * @param now_ms Instante atual (ms desde o boot)
+ * @param baseline_power Baseline atual do detector (W)
+ * @param threshold Limiar atual do detector (W)
+ */
+void event_stream_poll(uint32_t now_ms, float baseline_power, float threshold) {
+    if ((count > 0 || dropped_pending > 0) && now_ms - oldest_ms >= EVENT_STREAM_FLUSH_MS) {
+        event_stream_flush();
+    }
+    
+    uint32_t period_ms = now_ms - summary_start_ms;
+    if (period_ms < EVENT_STREAM_SUMMARY_MS) {
+        return;
+    }
+    
+    power_summary_record_t rec = {
+        .timestamp_ms = now_ms,
+        .period_ms = period_ms,
+        .n_samples = (summary_samples > UINT16_MAX) ? UINT16_MAX : (uint16_t)summary_samples,
+        .n_events = (summary_events > UINT16_MAX) ? UINT16_MAX : (uint16_t)summary_events,
+        .mean_power = summary_samples ? summary_sum / summary_samples : NAN,
+        .min_power = summary_samples ? summary_min : NAN,
+        .max_power = summary_samples ? summary_max : NAN,
+        .baseline_power = baseline_power,
+        .threshold = threshold,
+        .mean_reactive = summary_samples ? summary_reactive / summary_samples : NAN,
+        .mean_apparent = summary_samples ? summary_apparent / summary_samples : NAN,
+    };
+    telemetry_send_raw(TELEMETRY_TYPE_POWER_SUMMARY, summary_id++, &rec, sizeof(rec), 0);
+    summary_reset(now_ms);
+}
+
+/**
+ * @brief Total de eventos descartados por buffer cheio
+ */
+uint32_t event_stream_get_dropped(void) {
+    return dropped_total;
+}
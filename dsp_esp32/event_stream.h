@@ -0,0 +1,103 @@
+/**
+ * @file event_stream.h
+ * @brief Envio de eventos NILM em lotes binários e resumo periódico de potência
+ *
+ * No modo somente-eventos o detector não transmite potência nem texto:
+ * cada evento vira um registro de 16 bytes guardado em um buffer circular
+ * na RAM, e os registros são enviados juntos em um quadro
+ * TELEMETRY_TYPE_EVENTS quando o lote atinge EVENT_STREAM_BATCH registros
+ * ou quando o registro mais antigo espera EVENT_STREAM_FLUSH_MS. Um quadro
+ * TELEMETRY_TYPE_POWER_SUMMARY (média/mín/máx do período, médias de Q e S) sai a cada
+ * EVENT_STREAM_SUMMARY_MS.
+ *
+ * Todas as funções devem ser chamadas pela mesma task (a task NILM): o
+ * buffer não tem lock.
+ */
+
+#ifndef EVENT_STREAM_H
+#define EVENT_STREAM_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "nilm_filters.h"
+
+// Configurações do envio
+#define EVENT_STREAM_CAPACITY       32      // Registros no buffer circular
+#define EVENT_STREAM_BATCH          8       // Registros que disparam o envio
+#define EVENT_STREAM_FLUSH_MS       5000    // Espera máxima de um registro no buffer
+#define EVENT_STREAM_SUMMARY_MS     60000   // Período do resumo de potência
+
+// Flags do registro de evento
+#define EVENT_FLAG_ON               0x01    // Degrau positivo (liga); senão desliga
+#define EVENT_FLAG_STEADY           0x02    // Degrau entre regimes permanentes (changepoint.h);
+                                            // senão entre médias de nível (limiar)
+
+/**
+ * @brief Registro de evento no fio (16 bytes)
+ *
+ * Versão compacta de nilm_event_t: o nome não é enviado, o host o obtém
+ * de device_type.
+ */
+typedef struct __attribute__((packed)) {
+    uint32_t timestamp_ms;      // Instante do evento (ms desde o boot)
+    float    delta_power;       // Degrau entre os níveis antes e depois do evento (W)
+    float    power;             // Nível depois do evento (W)
+    uint16_t sequence;          // Número do evento (detecta perdas)
+    uint8_t  device_type;       // device_type_t
+    uint8_t  flags;             // EVENT_FLAG_*
+} event_record_t;
+
+/**
+ * @brief Cabeçalho do payload TELEMETRY_TYPE_EVENTS (4 bytes)
+ *
+ * Seguido de n_events event_record_t.
+ */
+typedef struct __attribute__((packed)) {
+    uint16_t n_events;
+    uint16_t dropped;           // Registros descartados (buffer cheio) desde o lote anterior
+} event_batch_header_t;
+
+/**
+ * @brief Payload TELEMETRY_TYPE_POWER_SUMMARY (40 bytes)
+ */
+typedef struct __attribute__((packed)) {
+    uint32_t timestamp_ms;      // Fim do período
+    uint32_t period_ms;         // Duração do período
+    uint16_t n_samples;         // Amostras de potência no período
+    uint16_t n_events;          // Eventos detectados no período
+    float    mean_power;        // W
+    float    min_power;         // W
+    float    max_power;         // W
+    float    baseline_power;    // Baseline do detector no fim do período (W)
+    float    threshold;         // Limiar do detector no fim do período (W)
+    float    mean_reactive;     // var (power_meter.h)
+    float    mean_apparent;     // VA
+} power_summary_record_t;
+
+_Static_assert(sizeof(event_record_t) == 16, "event_record_t deve ter 16 bytes");
+_Static_assert(sizeof(event_batch_header_t) == 4, "event_batch_header_t deve ter 4 bytes");
+_Static_assert(sizeof(power_summary_record_t) == 40, "power_summary_record_t deve ter 40 bytes");
+
+/**
+ * @brief Preenche um registro a partir de um evento do detector
+ */
+static inline void event_record_from_event(event_record_t *rec, const nilm_event_t *event, float power,
+                                           uint16_t sequence) {
+    rec->timestamp_ms = event->timestamp_ms;
+    rec->delta_power = event->delta_power;
+    rec->power = power;
+    rec->sequence = sequence;
+    rec->device_type = event->device_type;
+    rec->flags = ((event->delta_power > 0.0f) ? EVENT_FLAG_ON : 0) | (event->steady ? EVENT_FLAG_STEADY : 0);
+}
+
+// Protótipos de funções
+void event_stream_init(uint32_t now_ms);
+void event_stream_push(const nilm_event_t *event, float power);
+void event_stream_add_sample(float power, float reactive, float apparent);
+void event_stream_poll(uint32_t now_ms, float baseline_power, float threshold);
+bool event_stream_flush(void);
+uint32_t event_stream_get_dropped(void);
+
+#endif // EVENT_STREAM_H
@@ -0,0 +1,225 @@
+/**
+ * @file fir_engine.c
+ * @brief Implementação do FIR de fase linear (forma direta e overlap-save)
+ */
+
+#include "fir_engine.h"
+#include <math.h>
+#include <string.h>
+
+#define FIR_SYMMETRY_TOL    1e-6f       // Tolerância relativa da simetria dos coeficientes
+
+/**
+ * @brief Projeta um passa-baixa de fase linear por janela de Hamming (como firwin)
+ *
+ * @param coeffs Saída, n_taps coeficientes com ganho unitário em DC
+ * @param n_taps M, ímpar
+ * @param fc_normalized Frequência de corte / taxa de amostragem (0, 0.5)
+ * @return false se os parâmetros forem inválidos
+ */
+bool fir_engine_design_lowpass(float *coeffs, uint32_t n_taps, float fc_normalized) {
+    if ((n_taps & 1u) == 0 || fc_normalized <= 0.0f || fc_normalized >= 0.5f) {
+        return false;
+    }
+    const double center = (n_taps - 1) / 2.0;
+    double sum = 0.0;
+    for (uint32_t k = 0; k < n_taps; k++) {
+        double t = k - center;
+        double ideal = (t == 0.0) ? 2.0 * fc_normalized
+                                  : sin(2.0 * M_PI * fc_normalized * t) / (M_PI * t);
+        double w = (n_taps > 1) ? 0.54 - 0.46 * cos(2.0 * M_PI * k / (n_taps - 1)) : 1.0;
+        coeffs[k] = (float)(ideal * w);
+        sum += ideal * w;
+    }
+    for (uint32_t k = 0; k < n_taps; k++) {
+        coeffs[k] = (float)(coeffs[k] / sum);
+    }
+    return true;
+}
+
+/**
+ * @brief Espectro real do filtro centrado (h[D] em 0, h[D ± s] em ±s circular), / L
+ */
+static void compute_response(fir_engine_t *fe) {
+    const uint32_t L = fe->fft_n;
+    const uint32_t D = (fe->n_taps - 1) / 2;
+    memset(fe->work, 0, 2 * L * sizeof(float));
+    fe->work[0] = fe->coeffs[D];
+    for (uint32_t s = 1; s <= D; s++) {
+        fe->work[2 * s] = fe->coeffs[D + s];
+        fe->work[2 * (L - s)] = fe->coeffs[D - s];
+    }
+    fe->fft(fe->work, (int)L);
+    // Parte imaginária nula pela simetria (só erro de arredondamento)
+    for (uint32_t k = 0; k < L; k++) {
+        fe->response[k] = fe->work[2 * k] / (float)L;
+    }
+}
+
+/**
+ * @brief Configura o filtro e escolhe forma direta ou overlap-save
+ *
+ * @param fe Estado
+ * @param coeffs M coeficientes simétricos (copiados)
+ * @param n_taps M, ímpar, até FIR_ENGINE_MAX_TAPS
+ * @param fft FFT complexa para o overlap-save (NULL = sempre forma direta)
+ * @param fft_n L, potência de 2 até FIR_ENGINE_MAX_FFT
+ * @return false se os coeficientes não forem simétricos ou os tamanhos forem inválidos
+ */
+bool fir_engine_init(fir_engine_t *fe, const float *coeffs, uint32_t n_taps,
+                     fir_engine_fft_fn fft, uint32_t fft_n) {
+    if ((n_taps & 1u) == 0 || n_taps > FIR_ENGINE_MAX_TAPS) {
+        return false;
+    }
+    float peak = 0.0f;
+    for (uint32_t k = 0; k < n_taps; k++) {
+        peak = fmaxf(peak, fabsf(coeffs[k]));
+    }
+    for (uint32_t k = 0; k < n_taps / 2; k++) {
+        if (fabsf(coeffs[k] - coeffs[n_taps - 1 - k]) > FIR_SYMMETRY_TOL * peak) {
+            return false;
+        }
+    }
+    memcpy(fe->coeffs, coeffs, n_taps * sizeof(float));
+    fe->n_taps = n_taps;
+    fe->fft = fft;
+    fe->fft_n = fft_n;
+
+    bool fft_ok = fft != NULL && fft_n <= FIR_ENGINE_MAX_FFT && (fft_n & (fft_n - 1)) == 0;
+    if (n_taps > FIR_ENGINE_DIRECT_MAX_TAPS && fft_ok && n_taps - 1 <= fft_n / 2) {
+        fe->mode = FIR_ENGINE_OVERLAP_SAVE;
+        fe->hop = fft_n - (n_taps - 1);
+        compute_response(fe);
+    } else {
+        fe->mode = FIR_ENGINE_DIRECT;
+        fe->hop = 0;
+#if FIR_ENGINE_USE_ESP_DSP
+        dsps_fir_init_f32(&fe->fir, fe->coeffs, fe->delay, (int)n_taps);
+#endif
+    }
+    fir_engine_reset(fe);
+    return true;
+}
+
+/**
+ * @brief Zera o histórico (a saída recomeça como se a entrada anterior fosse nula)
+ */
+void fir_engine_reset(fir_engine_t *fe) {
+    if (fe->mode == FIR_ENGINE_OVERLAP_SAVE) {
+        memset(fe->os_line, 0, sizeof(fe->os_line));
+        memset(fe->os_out, 0, sizeof(fe->os_out));
+        fe->fill = fe->n_taps - 1;
+        return;
+    }
+#if FIR_ENGINE_USE_ESP_DSP
+    memset(fe->delay, 0, sizeof(fe->delay));
+    fe->fir.pos = 0;
+#else
+    memset(fe->line, 0, sizeof(fe->line));
+#endif
+}
+
+/**
+ * @brief Atraso da saída em amostras: (M-1)/2 mais a latência dos blocos
+ */
+uint32_t fir_engine_delay(const fir_engine_t *fe) {
+    return (fe->n_taps - 1) / 2 + 2 * fe->hop;
+}
+
+#if !FIR_ENGINE_USE_ESP_DSP
+/**
+ * @brief Forma direta dobrada: os pares simétricos somam antes de multiplicar
+ */
+static void direct_block(fir_engine_t *fe, const float *input, float *output, size_t n) {
+    const uint32_t m = fe->n_taps;
+    const uint32_t d = (m - 1) / 2;
+    const float *h = fe->coeffs;
+    float *line = fe->line;
+
+    memcpy(&line[m - 1], input, n * sizeof(float));
+    for (size_t i = 0; i < n; i++) {
+        // line[i + m - 1] é x[n]; line[i] é x[n - M + 1]
+        const float *x = &line[i];
+        float acc = h[d] * x[d];
+        for (uint32_t k = 0; k < d; k++) {
+            acc += h[k] * (x[m - 1 - k] + x[k]);
+        }
+        output[i] = acc;
+    }
+    memmove(line, &line[n], (m - 1) * sizeof(float));
+}
+#endif
+
+/**
+ * @brief Um bloco do overlap-save: 2·hop saídas com uma FFT direta e uma inversa
+ *
+ * Segmentos a = os_line[0, L) e b = os_line[hop, hop + L) em z = a + j·b.
+ * Com o filtro centrado, a saída circular no índice D + t é válida para
+ * t < hop e corresponde à amostra os_line[M - 1 + t] (a) ou
+ * os_line[M - 1 + hop + t] (b).
+ */
+static void overlap_save_block(fir_engine_t *fe) {
+    const uint32_t L = fe->fft_n;
+    const uint32_t hop = fe->hop;
+    const uint32_t d = (fe->n_taps - 1) / 2;
+    float *work = fe->work;
+
+    for (uint32_t t = 0; t < L; t++) {
+        work[2 * t] = fe->os_line[t];
+        work[2 * t + 1] = fe->os_line[hop + t];
+    }
+    fe->fft(work, (int)L);
+
+    // conj(Z·A/L): a FFT direta seguinte é a inversa conjugada
+    for (uint32_t k = 0; k < L; k++) {
+        work[2 * k] *= fe->response[k];
+        work[2 * k + 1] *= -fe->response[k];
+    }
+    fe->fft(work, (int)L);
+
+    for (uint32_t t = 0; t < hop; t++) {
+        fe->os_out[t] = work[2 * (d + t)];
+        fe->os_out[hop + t] = -work[2 * (d + t) + 1];
+    }
+}
+
+/**
+ * @brief Filtra n amostras (output pode ser o próprio input)
+ *
+ * No overlap-save a saída de cada amostra é a do bloco anterior, o que é
+ * a latência de 2·hop de fir_engine_delay().
+ */
+void fir_engine_process(fir_engine_t *fe, const float *input, float *output, size_t n) {
+    if (fe->mode == FIR_ENGINE_DIRECT) {
+#if FIR_ENGINE_USE_ESP_DSP
+        dsps_fir_f32(&fe->fir, input, output, (int)n);
+#else
+        for (size_t done = 0; done < n; done += FIR_ENGINE_BLOCK) {
+            size_t chunk = (n - done < FIR_ENGINE_BLOCK) ? n - done : FIR_ENGINE_BLOCK;
+            direct_block(fe, &input[done], &output[done], chunk);
+        }
+#endif
+        return;
+    }
+
+    const uint32_t history = fe->n_taps - 1;
+    const uint32_t capacity = history + 2 * fe->hop;
+    size_t done = 0;
+    while (done < n) {
+        // Saída i do bloco anterior acompanha a entrada na mesma posição
+        size_t chunk = capacity - fe->fill;
+        if (chunk > n - done) {
+            chunk = n - done;
+        }
+        memcpy(&fe->os_line[fe->fill], &input[done], chunk * sizeof(float));
+        memcpy(&output[done], &fe->os_out[fe->fill - history], chunk * sizeof(float));
+        fe->fill += chunk;
+        done += chunk;
+
+        if (fe->fill == capacity) {
+            overlap_save_block(fe);
+            memmove(fe->os_line, &fe->os_line[2 * fe->hop], history * sizeof(float));
+            fe->fill = history;
+        }
+    }
+}
@@ -0,0 +1,97 @@
+/**
+ * @file fir_engine.h
+ * @brief Filtro FIR de fase linear em fluxo: forma direta ou convolução rápida overlap-save
+ *
+ * Os coeficientes devem ser simétricos (h[k] = h[M-1-k]) com M ímpar
+ * (tipo I), como os de firwin em Filtros/Filtro_FIR.ipynb: a saída é a
+ * convolução causal atrasada exatamente de D = (M-1)/2 amostras, sem
+ * distorção de fase. O caminho é escolhido em fir_engine_init():
+ *
+ *  - DIRETO (M <= FIR_ENGINE_DIRECT_MAX_TAPS, ou M grande demais para a
+ *    FFT): dsps_fir_f32 com FIR_ENGINE_USE_ESP_DSP (núcleo SIMD; com
+ *    coeficientes simétricos a ordem direta ou invertida dá no mesmo), ou
+ *    a forma dobrada h[k]·(x[n-k] + x[n-M+1+k]), com metade das
+ *    multiplicações, no host;
+ *  - OVERLAP-SAVE (M maior): FFT de L pontos com a função do chamador
+ *    (a mesma FFT complexa do espectro), passo hop = L - M + 1. Como h é
+ *    real, dois blocos reais consecutivos vão nas partes real e imaginária
+ *    de uma única FFT complexa e saem separados da inversa. Com h
+ *    centrado (simetria), o espectro do filtro é real: um vetor A[k] e
+ *    duas multiplicações por bin. A inversa é a própria FFT direta
+ *    (IFFT(Y) = conj(FFT(conj(Y)))/L), com 1/L embutido em A.
+ *
+ * O custo do overlap-save por amostra é 2 FFTs de L pontos a cada 2·hop
+ * amostras, que não cresce com M enquanto M - 1 <= L/2. Os blocos
+ * acrescentam 2·hop amostras de latência; fir_engine_delay() dá o atraso
+ * total da saída (D + latência de bloco).
+ *
+ * O núcleo não depende do ESP-IDF (compila também no host).
+ */
+
+#ifndef FIR_ENGINE_H
+#define FIR_ENGINE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifndef FIR_ENGINE_USE_ESP_DSP
+#define FIR_ENGINE_USE_ESP_DSP      0
+#endif
+
+#if FIR_ENGINE_USE_ESP_DSP
+#include "esp_dsp.h"
+#endif
+
+#define FIR_ENGINE_MAX_TAPS         511     // M máximo (ímpar)
+#define FIR_ENGINE_MAX_FFT          512     // L máximo do overlap-save
+#define FIR_ENGINE_DIRECT_MAX_TAPS  64      // Acima disso, overlap-save (se M - 1 <= L/2)
+#define FIR_ENGINE_BLOCK            256     // Amostras por passada da forma direta
+
+/**
+ * @brief Caminho de cálculo
+ */
+typedef enum {
+    FIR_ENGINE_DIRECT = 0,
+    FIR_ENGINE_OVERLAP_SAVE,
+} fir_engine_mode_t;
+
+/**
+ * @brief FFT complexa direta in-place de n pontos intercalados (re, im), ordem natural
+ */
+typedef void (*fir_engine_fft_fn)(float *data, int n);
+
+/**
+ * @brief Estado do filtro
+ */
+typedef struct {
+    fir_engine_mode_t mode;
+    uint32_t n_taps;                        // M
+    float coeffs[FIR_ENGINE_MAX_TAPS];
+#if FIR_ENGINE_USE_ESP_DSP
+    fir_f32_t fir;                          // Forma direta (linha de atraso própria)
+    float delay[FIR_ENGINE_MAX_TAPS + 4];
+#else
+    // Forma direta: M - 1 amostras de histórico seguidas do bloco atual
+    float line[FIR_ENGINE_MAX_TAPS - 1 + FIR_ENGINE_BLOCK];
+#endif
+    // Overlap-save
+    fir_engine_fft_fn fft;
+    uint32_t fft_n;                         // L
+    uint32_t hop;                           // Saídas por bloco (L - M + 1)
+    uint32_t fill;                          // Amostras em os_line (M - 1 de histórico + novas)
+    float response[FIR_ENGINE_MAX_FFT];     // A[k]/L: espectro real do filtro centrado
+    float os_line[2 * FIR_ENGINE_MAX_FFT];  // M - 1 + 2·hop amostras de entrada
+    float os_out[2 * FIR_ENGINE_MAX_FFT];   // 2·hop saídas do último bloco
+    float work[2 * FIR_ENGINE_MAX_FFT] __attribute__((aligned(16)));
+} fir_engine_t;
+
+// Protótipos de funções
+bool fir_engine_design_lowpass(float *coeffs, uint32_t n_taps, float fc_normalized);
+bool fir_engine_init(fir_engine_t *fe, const float *coeffs, uint32_t n_taps,
+                     fir_engine_fft_fn fft, uint32_t fft_n);
+void fir_engine_reset(fir_engine_t *fe);
+void fir_engine_process(fir_engine_t *fe, const float *input, float *output, size_t n);
+uint32_t fir_engine_delay(const fir_engine_t *fe);
+
+#endif // FIR_ENGINE_H
@@ -0,0 +1,112 @@
+/**
+ * @file frame_ring.c
+ * @brief Implementação do buffer circular de quadros SPSC
+ */
+
+#include "frame_ring.h"
+#include <string.h>
+
+/**
+ * @brief Inicializa o buffer circular sobre um armazenamento estático
+ *
+ * @param ring Estrutura do buffer
+ * @param storage Memória com n_slots * slot_size bytes
+ * @param slot_size Tamanho de cada slot em bytes
+ * @param n_slots Número de slots (mínimo 2)
+ */
+void frame_ring_init(frame_ring_t *ring, void *storage, size_t slot_size, uint32_t n_slots) {
+    memset(ring, 0, sizeof(*ring));
+    ring->storage = (uint8_t *)storage;
+    ring->slot_size = slot_size;
+    ring->n_slots = (n_slots < 2) ? 2 : n_slots;
+}
+
+/**
+ * @brief Retorna o slot que o produtor deve preencher
+ *
+ * O slot permanece o mesmo até que frame_ring_commit() publique o quadro.
+ *
+ * @param ring Estrutura do buffer
+ * @return Ponteiro para o slot de escrita
+ */
+void *frame_ring_write_slot(frame_ring_t *ring) {
+    uint32_t head = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+    return ring->storage + (size_t)(head % ring->n_slots) * ring->slot_size;
+}
+
+/**
+ * @brief Publica o slot de escrita para o consumidor (lado produtor)
+ *
+ * Se a publicação deixaria o produtor sem slot livre, o quadro é
+ * descartado e o contador de overrun é incrementado.
+ *
+ * @param ring Estrutura do buffer
+ * @return true se publicado, false se descartado
+ */
+bool frame_ring_commit(frame_ring_t *ring) {
+    uint32_t head = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+    uint32_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+
+    if ((head + 1) - tail >= ring->n_slots) {
+        __atomic_store_n(&ring->dropped, ring->dropped + 1, __ATOMIC_RELAXED);
+        return false;
+    }
+
+    __atomic_store_n(&ring->committed, ring->committed + 1, __ATOMIC_RELAXED);
+    if ((head + 1) - tail > ring->high_water) {
+        __atomic_store_n(&ring->high_water, (head + 1) - tail, __ATOMIC_RELAXED);
+    }
+    __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+/**
+ * @brief Retorna o quadro pendente mais antigo (lado consumidor)
+ *
+ * O quadro pode ser processado no próprio slot até frame_ring_release().
+ *
+ * @param ring Estrutura do buffer
+ * @return Ponteiro para o quadro, ou NULL se não houver quadro pendente
+ */
+void *frame_ring_read_slot(frame_ring_t *ring) {
+    uint32_t tail = __atomic_load_n(&ring->tail, __ATOMIC_RELAXED);
+    uint32_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+
+    if (head == tail) {
+        return NULL;
+    }
+    return ring->storage + (size_t)(tail % ring->n_slots) * ring->slot_size;
+}
+
+/**
+ * @brief Devolve o quadro mais antigo ao produtor (lado consumidor)
+ *
+ * @param ring Estrutura do buffer
+ */
+void frame_ring_release(frame_ring_t *ring) {
+    uint32_t tail = __atomic_load_n(&ring->tail, __ATOMIC_RELAXED);
+    __atomic_store_n(&ring->tail, tail + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Número de quadros publicados e ainda não liberados
+ */
+uint32_t frame_ring_count(const frame_ring_t *ring) {
+    return __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+}
+
+/**
+ * @brief Número total de quadros descartados por overrun
+ */
+uint32_t frame_ring_dropped(const frame_ring_t *ring) {
+    return __atomic_load_n(&ring->dropped, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Maior profundidade da fila já observada (quadros pendentes)
+ *
+ * Próxima de n_slots - 1 indica que o consumidor está no limite.
+ */
+uint32_t frame_ring_high_water(const frame_ring_t *ring) {
+    return __atomic_load_n(&ring->high_water, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,50 @@
+/**
+ * @file frame_ring.h
+ * @brief Buffer circular de quadros SPSC (um produtor, um consumidor) sem locks
+ *
+ * O armazenamento pertence ao lado de aquisição e é dividido em slots de
+ * tamanho fixo. O produtor preenche o slot k+1 enquanto o consumidor
+ * processa o slot k no próprio buffer (sem cópia). Com 2 slots o
+ * comportamento é de ping-pong.
+ *
+ * Política de overrun: no máximo (n_slots - 1) quadros ficam pendentes.
+ * Se o consumidor estiver atrasado, o quadro recém-completado é descartado
+ * (o produtor reaproveita o mesmo slot) e o contador de descartes é
+ * incrementado, de modo que nenhum quadro chega "rasgado" ao consumidor.
+ */
+
+#ifndef FRAME_RING_H
+#define FRAME_RING_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+/**
+ * @brief Estado do buffer circular
+ *
+ * head é escrito apenas pelo produtor e tail apenas pelo consumidor;
+ * a publicação entre núcleos usa semântica acquire/release.
+ */
+typedef struct {
+    uint8_t *storage;           // n_slots * slot_size bytes
+    size_t slot_size;           // Tamanho de cada slot (bytes)
+    uint32_t n_slots;           // Número de slots (>= 2)
+    uint32_t head;              // Quadros publicados (produtor)
+    uint32_t tail;              // Quadros liberados (consumidor)
+    uint32_t committed;         // Total de quadros publicados
+    uint32_t dropped;           // Total de quadros descartados por overrun
+    uint32_t high_water;        // Maior número de quadros pendentes já observado
+} frame_ring_t;
+
+// Protótipos de funções
+void frame_ring_init(frame_ring_t *ring, void *storage, size_t slot_size, uint32_t n_slots);
+void *frame_ring_write_slot(frame_ring_t *ring);
+bool frame_ring_commit(frame_ring_t *ring);
+void *frame_ring_read_slot(frame_ring_t *ring);
+void frame_ring_release(frame_ring_t *ring);
+uint32_t frame_ring_count(const frame_ring_t *ring);
+uint32_t frame_ring_dropped(const frame_ring_t *ring);
+uint32_t frame_ring_high_water(const frame_ring_t *ring);
+
+#endif // FRAME_RING_H
@@ -0,0 +1,227 @@
+/**
+ * @file goertzel.c
+ * @brief Implementação do banco de Goertzel e do rastreador de f0
+ */
+
+#include "goertzel.h"
+#include <math.h>
+#include <string.h>
+
+#define TWO_PI  6.283185307179586
+
+/**
+ * @brief Reduz uma fase para [-pi, pi)
+ */
+static float wrap_phase(float phase) {
+    return phase - (float)TWO_PI * floorf((phase + (float)M_PI) / (float)TWO_PI);
+}
+
+/**
+ * @brief Inicializa o banco com as harmônicas 1..n_harmonics de f0
+ *
+ * Harmônicas acima de Nyquist são descartadas (n_harmonics é reduzido).
+ *
+ * @param bank Banco
+ * @param f0 Frequência nominal da rede (Hz)
+ * @param n_harmonics Número de harmônicas (até GOERTZEL_MAX_HARMONICS)
+ * @param sample_rate Taxa de amostragem (Hz)
+ * @param frame_size Amostras por quadro
+ * @param window_sum Soma da janela aplicada à entrada (N para retangular)
+ */
+void goertzel_bank_init(goertzel_bank_t *bank, float f0, uint32_t n_harmonics, float sample_rate,
+                        uint32_t frame_size, float window_sum) {
+    if (n_harmonics > GOERTZEL_MAX_HARMONICS) {
+        n_harmonics = GOERTZEL_MAX_HARMONICS;
+    }
+    float nyquist_limit = 0.5f * sample_rate / (f0 * (1.0f + GOERTZEL_TRACK_MAX_DEV));
+    if (n_harmonics > (uint32_t)nyquist_limit) {
+        n_harmonics = (uint32_t)nyquist_limit;
+    }
+    
+    bank->n_harmonics = n_harmonics;
+    bank->frame_size = frame_size;
+    bank->sample_rate = sample_rate;
+    bank->gain = 2.0f / window_sum;
+    bank->nominal_f0 = f0;
+    bank->f0 = f0;
+    goertzel_bank_tune(bank, f0);
+    goertzel_bank_reset_tracking(bank);
+}
+
+/**
+ * @brief Sintoniza as harmônicas em h * f0
+ *
+ * Usa double para o ângulo acumulado w (N - 1), que chega a centenas de
+ * radianos; só roda na inicialização e nas ressintonias.
+ */
+void goertzel_bank_tune(goertzel_bank_t *bank, float f0) {
+    for (uint32_t h = 0; h < bank->n_harmonics; h++) {
+        double w = TWO_PI * (double)f0 * (h + 1) / bank->sample_rate;
+        double end = w * (bank->frame_size - 1);
+        goertzel_tone_t *tone = &bank->tones[h];
+        tone->coeff = (float)(2.0 * cos(w));
+        tone->cos_w = (float)cos(w);
+        tone->sin_w = (float)sin(w);
+        tone->cos_end = (float)cos(end);
+        tone->sin_end = (float)sin(end);
+    }
+    bank->tuned_f0 = f0;
+}
+
+/**
+ * @brief Amplitude e fase de um tom a partir dos dois últimos estados
+ *
+ * y = s[N-1] - e^{-jw} s[N-2]; X = y e^{-jw(N-1)} (referência no início do quadro)
+ */
+static void tone_result(const goertzel_bank_t *bank, const goertzel_tone_t *tone, float s1, float s2,
+                        goertzel_harmonic_t *out) {
+    float yr = s1 - tone->cos_w * s2;
+    float yi = tone->sin_w * s2;
+    float xr = yr * tone->cos_end + yi * tone->sin_end;
+    float xi = yi * tone->cos_end - yr * tone->sin_end;
+    
+    out->amplitude = bank->gain * sqrtf(xr * xr + xi * xi);
+    out->phase = atan2f(xi, xr);
+}
+
+/**
+ * @brief Calcula amplitude e fase de todas as harmônicas em um quadro
+ *
+ * A entrada deve ter frame_size amostras, já sem a média e multiplicada
+ * pela janela cuja soma foi informada em goertzel_bank_init(). Para um
+ * sinal A cos(w n + phi), retorna amplitude ~A e fase ~phi.
+ *
+ * @param bank Banco sintonizado
+ * @param input Quadro de entrada
+ * @param out Resultado por harmônica (n_harmonics elementos)
+ */
+void goertzel_bank_process(const goertzel_bank_t *bank, const float *input, goertzel_harmonic_t *out) {
+    const uint32_t n = bank->frame_size;
+    
+    for (uint32_t h = 0; h < bank->n_harmonics; h++) {
+        const goertzel_tone_t *tone = &bank->tones[h];
+        const float coeff = tone->coeff;
+        float s1 = 0.0f, s2 = 0.0f;
+        
+        for (uint32_t i = 0; i < n; i++) {
+            float s0 = input[i] + coeff * s1 - s2;
+            s2 = s1;
+            s1 = s0;
+        }
+        tone_result(bank, tone, s1, s2, &out[h]);
+    }
+}
+
+/**
+ * @brief Começa um novo quadro amostra a amostra
+ */
+void goertzel_stream_reset(goertzel_stream_t *stream) {
+    memset(stream, 0, sizeof(*stream));
+}
+
+/**
+ * @brief Acumula uma amostra do quadro (mesma entrada de goertzel_bank_process)
+ *
+ * @return true quando o quadro tem frame_size amostras (chamar goertzel_stream_result)
+ */
+bool goertzel_stream_push(const goertzel_bank_t *bank, goertzel_stream_t *stream, float x) {
+    for (uint32_t h = 0; h < bank->n_harmonics; h++) {
+        float s0 = x + bank->tones[h].coeff * stream->s1[h] - stream->s2[h];
+        stream->s2[h] = stream->s1[h];
+        stream->s1[h] = s0;
+    }
+    return ++stream->count >= bank->frame_size;
+}
+
+/**
+ * @brief Resultado do quadro completo e reinício para o próximo
+ *
+ * @param bank Banco sintonizado (o mesmo dos goertzel_stream_push)
+ * @param stream Quadro com frame_size amostras
+ * @param out Resultado por harmônica (n_harmonics elementos)
+ */
+void goertzel_stream_result(const goertzel_bank_t *bank, goertzel_stream_t *stream, goertzel_harmonic_t *out) {
+    for (uint32_t h = 0; h < bank->n_harmonics; h++) {
+        tone_result(bank, &bank->tones[h], stream->s1[h], stream->s2[h], &out[h]);
+    }
+    goertzel_stream_reset(stream);
+}
+
+/**
+ * @brief Atualiza a estimativa de f0 pelo avanço de fase da fundamental
+ *
+ * Entre quadros separados por hop amostras a fase avança 2 pi f0 hop / fs;
+ * a diferença para o avanço esperado na frequência sintonizada dá o
+ * desvio de f0 (sem ambiguidade para |desvio| < fs / (2 hop)). Quando a
+ * estimativa se afasta mais de GOERTZEL_RETUNE_HZ da sintonia, o banco é
+ * ressintonizado.
+ *
+ * @param bank Banco
+ * @param harmonics Resultado do quadro atual
+ * @param hop Amostras entre o início do quadro anterior e o do atual
+ * @return Estimativa atual de f0 (Hz)
+ */
+float goertzel_bank_track(goertzel_bank_t *bank, const goertzel_harmonic_t *harmonics, uint32_t hop) {
+    if (bank->n_harmonics == 0 || harmonics[0].amplitude < GOERTZEL_MIN_TRACK_AMPL) {
+        bank->has_phase = false;
+        return bank->f0;
+    }
+    
+    float phase = harmonics[0].phase;
+    if (bank->has_phase) {
+        float expected = (float)fmod(TWO_PI * bank->tuned_f0 * hop / bank->sample_rate, TWO_PI);
+        float deviation = wrap_phase(phase - bank->last_phase - expected);
+        float f_est = bank->tuned_f0 + deviation * bank->sample_rate / ((float)TWO_PI * hop);
+        
+        bank->f0 += GOERTZEL_TRACK_ALPHA * (f_est - bank->f0);
+        float max_f0 = bank->nominal_f0 * (1.0f + GOERTZEL_TRACK_MAX_DEV);
+        float min_f0 = bank->nominal_f0 * (1.0f - GOERTZEL_TRACK_MAX_DEV);
+        if (bank->f0 > max_f0) bank->f0 = max_f0;
+        if (bank->f0 < min_f0) bank->f0 = min_f0;
+        
+        if (fabsf(bank->f0 - bank->tuned_f0) > GOERTZEL_RETUNE_HZ) {
+            goertzel_bank_tune(bank, bank->f0);
+        }
+    }
+    bank->last_phase = phase;
+    bank->has_phase = true;
+    return bank->f0;
+}
+
+/**
+ * @brief Descarta a fase anterior (quadros perdidos ou não consecutivos)
+ */
+void goertzel_bank_reset_tracking(goertzel_bank_t *bank) {
+    bank->has_phase = false;
+}
+
+/**
+ * @brief Distorção harmônica total: sqrt(sum A_h^2, h >= 2) / A_1
+ *
+ * @return THD (fração), ou NAN sem fundamental
+ */
+float goertzel_thd(const goertzel_harmonic_t *harmonics, uint32_t n_harmonics) {
+    if (n_harmonics == 0 || harmonics[0].amplitude < GOERTZEL_MIN_TRACK_AMPL) {
+        return NAN;
+    }
+    float sum = 0.0f;
+    for (uint32_t h = 1; h < n_harmonics; h++) {
+        sum += harmonics[h].amplitude * harmonics[h].amplitude;
+    }
+    return sqrtf(sum) / harmonics[0].amplitude;
+}
+
+/**
+ * @brief Preenche as características harmônicas de um evento para o classificador
+ *
+ * @param harmonics Harmônicas da corrente do evento (1..n_harmonics)
+ * @param n_harmonics Número de harmônicas
+ * @param features Características (thd e h3_ratio; demais campos inalterados)
+ */
+void goertzel_fill_features(const goertzel_harmonic_t *harmonics, uint32_t n_harmonics,
+                            nilm_device_features_t *features) {
+    features->thd = goertzel_thd(harmonics, n_harmonics);
+    features->h3_ratio = (n_harmonics >= 3 && !isnan(features->thd))
+                             ? harmonics[2].amplitude / harmonics[0].amplitude
+                             : NAN;
+}
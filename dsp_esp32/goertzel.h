@@ -0,0 +1,109 @@
+/**
+ * @file goertzel.h
+ * @brief Banco de Goertzel para harmônicas da rede (assinatura de carga NILM)
+ *
+ * Para a assinatura de uma carga bastam a fundamental e algumas
+ * harmônicas; uma FFT de N pontos calcula N/2 bins para usar 15. Cada
+ * filtro de Goertzel custa uma multiplicação e duas somas por amostra e
+ * pode ser sintonizado em qualquer frequência (forma generalizada, k não
+ * inteiro), então as harmônicas h * f0 ficam exatas mesmo com f0 = 60 Hz
+ * e resolução de 19.5 Hz por bin (N = 512 a 10 kHz).
+ *
+ * O rastreador estima f0 pelo avanço de fase da fundamental entre
+ * quadros consecutivos e ressintoniza o banco quando a rede se desvia.
+ *
+ * Nenhuma dependência do ESP-IDF (compila também no host).
+ */
+
+#ifndef GOERTZEL_H
+#define GOERTZEL_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "nilm_filters.h"
+
+// Configurações do rastreador
+#define GOERTZEL_MAX_HARMONICS      15      // Harmônicas 1..15
+#define GOERTZEL_TRACK_ALPHA        0.2f    // Suavização da estimativa de f0
+#define GOERTZEL_TRACK_MAX_DEV      0.05f   // Desvio máximo de f0 rastreado (fração do nominal)
+#define GOERTZEL_RETUNE_HZ          0.05f   // Desvio de f0 que dispara a ressintonia
+#define GOERTZEL_MIN_TRACK_AMPL     1e-3f   // Amplitude mínima da fundamental para rastrear
+
+/**
+ * @brief Um filtro de Goertzel sintonizado
+ */
+typedef struct {
+    float coeff;                // 2 cos(w)
+    float cos_w;
+    float sin_w;
+    float cos_end;              // cos(w (N - 1)): correção de fase para k não inteiro
+    float sin_end;              // sin(w (N - 1))
+} goertzel_tone_t;
+
+/**
+ * @brief Magnitude e fase de uma harmônica no quadro
+ */
+typedef struct {
+    float amplitude;            // Amplitude de pico (unidade do sinal)
+    float phase;                // Fase em relação ao início do quadro (rad)
+} goertzel_harmonic_t;
+
+/**
+ * @brief Banco de harmônicas com rastreamento de f0
+ */
+typedef struct {
+    goertzel_tone_t tones[GOERTZEL_MAX_HARMONICS];
+    uint32_t n_harmonics;
+    uint32_t frame_size;        // N amostras por quadro
+    float sample_rate;
+    float gain;                 // 2 / soma da janela (|X| -> amplitude de pico)
+    
+    float nominal_f0;           // Frequência nominal da rede (Hz)
+    float f0;                   // Estimativa atual (Hz)
+    float tuned_f0;             // f0 em que o banco está sintonizado
+    float last_phase;           // Fase da fundamental no quadro anterior
+    bool has_phase;
+} goertzel_bank_t;
+
+/**
+ * @brief Estado de um quadro processado amostra a amostra
+ *
+ * Mesmo resultado de goertzel_bank_process sem guardar o quadro: útil
+ * quando as amostras chegam em blocos menores que frame_size.
+ */
+typedef struct {
+    float s1[GOERTZEL_MAX_HARMONICS];
+    float s2[GOERTZEL_MAX_HARMONICS];
+    uint32_t count;             // Amostras já acumuladas no quadro
+} goertzel_stream_t;
+
+/**
+ * @brief Cabeçalho do payload TELEMETRY_TYPE_HARMONICS (12 bytes)
+ *
+ * Seguido de n_harmonics pares float32 (amplitude, fase).
+ */
+typedef struct __attribute__((packed)) {
+    float    f0;                // Fundamental rastreada (Hz)
+    float    thd;               // Distorção harmônica total (fração)
+    uint8_t  n_harmonics;
+    uint8_t  reserved[3];
+} goertzel_record_header_t;
+
+_Static_assert(sizeof(goertzel_record_header_t) == 12, "goertzel_record_header_t deve ter 12 bytes");
+
+// Protótipos de funções
+void goertzel_bank_init(goertzel_bank_t *bank, float f0, uint32_t n_harmonics, float sample_rate,
+                        uint32_t frame_size, float window_sum);
+void goertzel_bank_tune(goertzel_bank_t *bank, float f0);
+void goertzel_bank_process(const goertzel_bank_t *bank, const float *input, goertzel_harmonic_t *out);
+float goertzel_bank_track(goertzel_bank_t *bank, const goertzel_harmonic_t *harmonics, uint32_t hop);
+void goertzel_bank_reset_tracking(goertzel_bank_t *bank);
+void goertzel_stream_reset(goertzel_stream_t *stream);
+bool goertzel_stream_push(const goertzel_bank_t *bank, goertzel_stream_t *stream, float x);
+void goertzel_stream_result(const goertzel_bank_t *bank, goertzel_stream_t *stream, goertzel_harmonic_t *out);
+float goertzel_thd(const goertzel_harmonic_t *harmonics, uint32_t n_harmonics);
+void goertzel_fill_features(const goertzel_harmonic_t *harmonics, uint32_t n_harmonics,
+                            nilm_device_features_t *features);
+
+#endif // GOERTZEL_H
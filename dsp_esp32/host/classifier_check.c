@@ -0,0 +1,193 @@
+/**
+ * @file classifier_check.c
+ * @brief Verificação do classificador e do pontuador por características (host)
+ *
+ * Um degrau de 150 W cai em três faixas de device_table (TV, geladeira e
+ * computador); só pela faixa vence a TV, cujo centro está mais perto.
+ * Com o modelo de protótipos (nilm_prototype_score) a duração e a forma do
+ * transitório, medidas por nilm_transient_features() em traços sintéticos
+ * a 10 Hz, devem mudar a ordem: a partida de compressor (pico de corrente
+ * e ~1 s de transitório) passa a ser geladeira, o degrau seco continua TV.
+ * As harmônicas vêm de current_harmonics.c sobre códigos sintéticos de uma
+ * fase: uma carga com 3ª e 5ª harmônicas ligada sobre uma base resistiva,
+ * com a rede fora do nominal. A diferença entre os retratos de depois e de
+ * antes deve dar o THD e a razão da 3ª da carga, não os da soma, e essas
+ * características sozinhas devem levar a fonte chaveada (TV) à frente ou,
+ * com corrente quase senoidal, a geladeira.
+ * Um pontuador próprio por tipo confere o gancho nilm_class_scorer_t.
+ *
+ * Sai com código 1 se algum caso não tiver o primeiro candidato esperado ou
+ * se a forma medida do degrau de referência errar o tempo de subida ou o
+ * sobressinal, ou as harmônicas da carga errarem mais de HARMONIC_MAX_ERROR.
+ *
+ * Uso:
+ *   classifier_check
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <math.h>
+#include "nilm_filters.h"
+#include "current_harmonics.h"
+
+#define SAMPLE_PERIOD_S     (1.0f / NILM_SAMPLE_RATE_HZ)
+#define LEVEL_BEFORE_W      200.0f
+#define STEP_W              150.0f
+
+// Harmônicas: 1 fase a 10 kHz por canal, quadros de 128 códigos como no firmware
+#define HARMONIC_FS_HZ      10000.0
+#define HARMONIC_MAINS_HZ   59.9            // Fora do nominal: janela sem ciclos inteiros
+#define HARMONIC_BLOCK      128
+#define HARMONIC_SECONDS    1.0             // Antes e depois da carga
+#define HARMONIC_MAX_ERROR  0.02            // Erro absoluto de thd e h3_ratio
+#define LOAD_I1             80.0            // Carga: fundamental, 3ª e 5ª (códigos)
+#define LOAD_I3             64.0
+#define LOAD_I5             40.0
+
+// Protótipos só de forma (ΔP em NAN: a faixa já decide a potência)
+static const nilm_device_prototype_t prototypes[] = {
+    {DEVICE_REFRIGERATOR, {NAN, 1.0f, 0.3f, 1.5f, 0.1f, 0.05f}},    // Partida de compressor, motor
+    {DEVICE_TV,           {NAN, 0.0f, 0.1f, 0.0f, 0.9f, 0.75f}},    // Fonte chaveada sem PFC
+    {DEVICE_COMPUTER,     {NAN, 0.0f, 0.1f, 0.1f, 0.15f, 0.1f}},    // Fonte com PFC
+};
+
+// Traços desde o início do transitório (W), degrau de STEP_W sobre LEVEL_BEFORE_W
+static const float dry_step[] = {200.0f, 350.0f, 350.0f, 349.0f, 350.0f, 350.0f};
+static const float compressor_start[] = {200.0f, 500.0f, 560.0f, 450.0f, 380.0f, 350.0f, 350.0f};
+
+// Pontuador próprio: peso fixo por tipo (ctx: float[DEVICE_TYPE_COUNT])
+static float weight_score(const void *ctx, device_type_t type,
+                          const nilm_device_features_t *features, float range_score) {
+    (void)features;
+    return range_score * ((const float *)ctx)[type];
+}
+
+static nilm_device_features_t trace_features(const float *power, size_t n, float duration_s) {
+    nilm_device_features_t features = {
+        .delta_power = STEP_W, .duration_s = duration_s, .thd = NAN, .h3_ratio = NAN,
+    };
+    nilm_transient_features(power, n, LEVEL_BEFORE_W, SAMPLE_PERIOD_S, &features);
+    return features;
+}
+
+// Códigos de tensão e corrente: base resistiva e, com load_on, a carga harmônica
+static void synth_codes(uint16_t *v, uint16_t *i, size_t n, uint64_t start, bool load_on) {
+    for (size_t k = 0; k < n; k++) {
+        double wt = 2.0 * M_PI * HARMONIC_MAINS_HZ * (double)(start + k) / HARMONIC_FS_HZ;
+        double current = 300.0 * cos(wt - 0.2);
+        if (load_on) {
+            current += LOAD_I1 * cos(wt - 0.4) + LOAD_I3 * cos(3.0 * wt - 1.0) + LOAD_I5 * cos(5.0 * wt + 0.5);
+        }
+        v[k] = (uint16_t)lround(2048.0 + 1000.0 * cos(wt));
+        i[k] = (uint16_t)lround(2048.0 + current);
+    }
+}
+
+// Características harmônicas do degrau medidas por current_harmonics.c
+static nilm_device_features_t harmonic_features(void) {
+    static current_harmonics_t ch;
+    uint16_t v[HARMONIC_BLOCK], i[HARMONIC_BLOCK];
+    const uint16_t *codes[2] = {v, i};
+    const size_t n_codes[2] = {HARMONIC_BLOCK, HARMONIC_BLOCK};
+    current_harmonics_snapshot_t before;
+    uint64_t t = 0;
+
+    current_harmonics_init(&ch, 1, (float)HARMONIC_FS_HZ, 60.0f);
+    for (int on = 0; on <= 1; on++) {
+        for (; t < (uint64_t)((on + 1) * HARMONIC_SECONDS * HARMONIC_FS_HZ); t += HARMONIC_BLOCK) {
+            synth_codes(v, i, HARMONIC_BLOCK, t, on);
+            current_harmonics_process(&ch, codes, n_codes);
+        }
+        if (!on) {
+            before = ch.latest;
+        }
+    }
+
+    nilm_device_features_t features = {
+        .delta_power = STEP_W, .duration_s = NAN, .rise_time_s = NAN, .overshoot = NAN,
+    };
+    current_harmonics_features(&before, &ch.latest, &features);
+    return features;
+}
+
+// Imprime a ordem dos candidatos e confere o primeiro
+static int check_ranking(const char *label, const nilm_classifier_t *cls,
+                         const nilm_device_features_t *features, device_type_t expected) {
+    nilm_device_candidate_t candidates[DEVICE_TYPE_COUNT];
+    size_t n = nilm_classifier_candidates(cls, features, candidates, DEVICE_TYPE_COUNT);
+    int ok = n > 0 && candidates[0].type == expected;
+
+    printf("  %s:", label);
+    for (size_t k = 0; k < n; k++) {
+        printf(" %s %.3f%s", get_device_name(candidates[k].type), candidates[k].score, (k + 1 < n) ? "," : "");
+    }
+    printf(" | %s\n", ok ? "ok" : "FALHOU");
+    return !ok;
+}
+
+int main(void) {
+    nilm_classifier_t cls;
+    nilm_prototype_model_t model;
+    int failed = 0;
+
+    nilm_filters_init();
+    if (!nilm_classifier_build(&cls, device_table, DEVICE_TABLE_SIZE) ||
+        !nilm_prototype_model_init(&model, prototypes, sizeof(prototypes) / sizeof(prototypes[0]))) {
+        printf("FALHOU: catálogo ou protótipos excedem a capacidade\n");
+        return 1;
+    }
+
+    // Forma do degrau de referência: x = 0, 2, 2.4, 1.67, 1.2, 1 (pico 2.4)
+    nilm_device_features_t compressor = trace_features(compressor_start,
+        sizeof(compressor_start) / sizeof(compressor_start[0]), 1.0f);
+    nilm_device_features_t dry = trace_features(dry_step, sizeof(dry_step) / sizeof(dry_step[0]), 0.2f);
+    int shape_ok = fabsf(compressor.rise_time_s - 0.04f) < 1e-4f && fabsf(compressor.overshoot - 1.4f) < 1e-4f &&
+                   fabsf(dry.rise_time_s - 0.08f) < 1e-4f && dry.overshoot == 0.0f;
+    failed |= !shape_ok;
+    printf("Forma: partida de compressor subida %.3f s sobressinal %.3f, degrau seco %.3f s %.3f | %s\n",
+           compressor.rise_time_s, compressor.overshoot, dry.rise_time_s, dry.overshoot, shape_ok ? "ok" : "FALHOU");
+
+    // Harmônicas da carga: THD = √(I3² + I5²) / I1, h3 = I3 / I1
+    nilm_device_features_t smps = harmonic_features();
+    const double expected_thd = sqrt(LOAD_I3 * LOAD_I3 + LOAD_I5 * LOAD_I5) / LOAD_I1;
+    const double expected_h3 = LOAD_I3 / LOAD_I1;
+    int harmonics_ok = fabs(smps.thd - expected_thd) <= HARMONIC_MAX_ERROR &&
+                       fabs(smps.h3_ratio - expected_h3) <= HARMONIC_MAX_ERROR;
+    failed |= !harmonics_ok;
+    printf("Harmônicas da carga a %.1f Hz: THD %.3f (esperado %.3f), h3 %.3f (esperado %.3f) | %s\n",
+           HARMONIC_MAINS_HZ, smps.thd, expected_thd, smps.h3_ratio, expected_h3, harmonics_ok ? "ok" : "FALHOU");
+
+    const nilm_device_features_t power_only = {
+        .delta_power = STEP_W, .duration_s = NAN, .rise_time_s = NAN, .overshoot = NAN, .thd = NAN, .h3_ratio = NAN,
+    };
+    const nilm_device_features_t duration_only = {
+        .delta_power = STEP_W, .duration_s = 1.2f, .rise_time_s = NAN, .overshoot = NAN, .thd = NAN, .h3_ratio = NAN,
+    };
+    const nilm_device_features_t sinusoidal = {
+        .delta_power = STEP_W, .duration_s = NAN, .rise_time_s = NAN, .overshoot = NAN, .thd = 0.12f, .h3_ratio = 0.08f,
+    };
+
+    printf("Candidatos para ΔP = %.0f W\n", STEP_W);
+    failed |= check_ranking("só faixa", &cls, &compressor, DEVICE_TV);
+    failed |= check_ranking("classify_device_by_power", nilm_default_classifier(), &power_only,
+                            classify_device_by_power(STEP_W));
+
+    nilm_classifier_set_scorer(&cls, nilm_prototype_score, &model);
+    failed |= check_ranking("protótipos, só ΔP", &cls, &power_only, DEVICE_TV);
+    failed |= check_ranking("protótipos, degrau seco", &cls, &dry, DEVICE_TV);
+    failed |= check_ranking("protótipos, partida de compressor", &cls, &compressor, DEVICE_REFRIGERATOR);
+    failed |= check_ranking("protótipos, só duração 1.2 s", &cls, &duration_only, DEVICE_REFRIGERATOR);
+    failed |= check_ranking("protótipos, harmônicas medidas", &cls, &smps, DEVICE_TV);
+    failed |= check_ranking("protótipos, corrente quase senoidal", &cls, &sinusoidal, DEVICE_REFRIGERATOR);
+
+    float weights[DEVICE_TYPE_COUNT];
+    for (size_t t = 0; t < DEVICE_TYPE_COUNT; t++) {
+        weights[t] = (t == DEVICE_COMPUTER) ? 3.0f : 1.0f;
+    }
+    nilm_classifier_set_scorer(&cls, weight_score, weights);
+    failed |= check_ranking("pontuador próprio (computador x3)", &cls, &power_only, DEVICE_COMPUTER);
+
+    printf("%s\n", failed ? "FALHOU" : "ok");
+    return failed;
+}
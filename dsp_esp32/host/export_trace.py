@@ -0,0 +1,42 @@
+"""
+Exporta traços de potência para o benchmark nativo (nilm_replay)
+================================================================
+Converte a potência ativa de um HDF5 gerado por esp32_to_nilmtk.py
+(building<N>/elec/meter<M>/power/active) em float32 little-endian bruto,
+formato lido diretamente por nilm_replay:
+
+    python export_trace.py dados_nilmtk.h5 trace.f32 --building 1 --meter 1
+    ./nilm_replay trace.f32
+"""
+
+import argparse
+
+import h5py
+import numpy as np
+
+
+def export_trace(hdf5_path, output_path, building=1, meter=1):
+    """Grava a potência ativa do medidor como float32 e retorna o número de amostras"""
+    key = f'building{building}/elec/meter{meter}/power/active'
+    with h5py.File(hdf5_path, 'r') as f:
+        if key not in f:
+            raise KeyError(f"Dataset {key} não encontrado em {hdf5_path}")
+        power = np.asarray(f[key], dtype='<f4')
+    power.tofile(output_path)
+    return len(power)
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Exporta potência NILMTK (HDF5) para float32 bruto')
+    parser.add_argument('hdf5', help='Arquivo HDF5 de esp32_to_nilmtk.py')
+    parser.add_argument('output', help='Arquivo de saída (.f32)')
+    parser.add_argument('--building', type=int, default=1, help='Número do prédio')
+    parser.add_argument('--meter', type=int, default=1, help='Número do medidor')
+    args = parser.parse_args()
+
+    n = export_trace(args.hdf5, args.output, args.building, args.meter)
+    print(f"[INFO] {n} amostras exportadas para {args.output}")
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,143 @@
+/**
+ * @file nilm_batch.c
+ * @brief Implementação da API em lote (biblioteca compartilhada do host)
+ */
+
+#include "nilm_batch.h"
+#include <stdlib.h>
+#include "nilm_filters.h"
+#include "event_detector.h"
+
+#define NILM_BATCH_CHUNK    1024    // Amostras por chamada interna aos filtros
+
+/**
+ * @brief Estado de um medidor
+ */
+struct nilm_meter {
+    nilm_highpass_t hp;
+    biquad_section_t lp;
+    event_detector_t detector;
+    uint64_t index;             // Próxima amostra
+};
+
+/**
+ * @brief Inicializa nilm_filters ao carregar a biblioteca, antes de qualquer thread
+ */
+__attribute__((constructor)) static void nilm_batch_load(void) {
+    nilm_filters_init();
+}
+
+/**
+ * @brief Versão da API (verificada pelo binding Python)
+ */
+int nilm_batch_api_version(void) {
+    return NILM_BATCH_API_VERSION;
+}
+
+/**
+ * @brief Cria o estado de um medidor
+ *
+ * @param detector event_detector_kind_t (0 = limiar com debounce, 1 = CUSUM)
+ * @param threshold Piso do limiar adaptativo (W)
+ * @param debounce_samples Amostras mínimas entre eventos (só no limiar)
+ * @return Medidor, ou NULL sem memória ou com detector inválido
+ */
+nilm_meter_t *nilm_meter_create(int detector, float threshold, uint32_t debounce_samples) {
+    if (detector != EVENT_DETECTOR_THRESHOLD && detector != EVENT_DETECTOR_CHANGEPOINT) {
+        return NULL;
+    }
+    nilm_meter_t *meter = calloc(1, sizeof(*meter));
+    if (meter == NULL) {
+        return NULL;
+    }
+    event_detector_config_t config = EVENT_DETECTOR_DEFAULT_CONFIG;
+    config.kind = (event_detector_kind_t)detector;
+    config.min_threshold = threshold;
+    config.debounce_samples = debounce_samples;
+    event_detector_init(&meter->detector, &config);
+    init_filter_sections(&meter->hp, &meter->lp, NILM_HP_STRUCTURE);
+    nilm_meter_reset(meter);
+    return meter;
+}
+
+/**
+ * @brief Libera o estado de um medidor
+ */
+void nilm_meter_destroy(nilm_meter_t *meter) {
+    free(meter);
+}
+
+/**
+ * @brief Volta o medidor ao estado inicial (filtros zerados, índice 0)
+ */
+void nilm_meter_reset(nilm_meter_t *meter) {
+    reset_filter_states(&meter->hp, &meter->lp);
+    event_detector_reset(&meter->detector);
+    meter->index = 0;
+}
+
+/**
+ * @brief Menor número de amostras entre dois eventos
+ *
+ * Um lote de n amostras gera no máximo n / gap + 1 eventos.
+ */
+uint32_t nilm_meter_min_event_gap(const nilm_meter_t *meter) {
+    return event_detector_min_gap(&meter->detector);
+}
+
+/**
+ * @brief Processa um lote contíguo de potência de um medidor
+ *
+ * Pode ser chamado em pedaços sucessivos; o estado continua entre chamadas.
+ *
+ * @param meter Medidor
+ * @param power Potência de entrada (W)
+ * @param n Número de amostras
+ * @param highpass_out Saída do passa-alta (n floats) ou NULL
+ * @param lowpass_out Saída do passa-baixa (n floats) ou NULL
+ * @param events Eventos detectados (até max_events) ou NULL
+ * @param max_events Capacidade de events
+ * @param n_events_total Se não NULL, recebe o total de eventos do lote
+ *                       (pode exceder max_events)
+ * @return Número de eventos escritos em events
+ */
+size_t nilm_meter_process(nilm_meter_t *meter, const float *power, size_t n,
+                          float *highpass_out, float *lowpass_out,
+                          nilm_batch_event_t *events, size_t max_events, size_t *n_events_total) {
+    float hp_chunk[NILM_BATCH_CHUNK];
+    float lp_chunk[NILM_BATCH_CHUNK];
+    size_t written = 0;
+    size_t total = 0;
+
+    for (size_t start = 0; start < n; start += NILM_BATCH_CHUNK) {
+        size_t len = (n - start < NILM_BATCH_CHUNK) ? n - start : NILM_BATCH_CHUNK;
+        float *hp = highpass_out ? &highpass_out[start] : hp_chunk;
+        float *lp = lowpass_out ? &lowpass_out[start] : lp_chunk;
+
+        apply_highpass_filter_block(&power[start], hp, len, &meter->hp);
+        apply_lowpass_filter_block(&power[start], lp, len, &meter->lp);
+
+        for (size_t k = 0; k < len; k++, meter->index++) {
+            event_detector_event_t event;
+            if (!event_detector_update(&meter->detector, power[start + k], hp[k], &event)) {
+                continue;
+            }
+
+            if (events != NULL && written < max_events) {
+                // O evento é datado antes desta amostra (início do transitório ou disparo)
+                uint32_t age = meter->detector.n - 1 - event.index;
+                events[written].index = meter->index - age;
+                events[written].delta = event.delta_power;
+                events[written].power = event.power;
+                events[written].device = (int32_t)classify_device_by_power(event.delta_power);
+                written++;
+            }
+            total++;
+        }
+    }
+
+    if (n_events_total != NULL) {
+        *n_events_total = total;
+    }
+    return written;
+}
@@ -0,0 +1,49 @@
+/**
+ * @file nilm_batch.h
+ * @brief API em lote sobre nilm_filters.c para processamento offline (libnilm_filters.so)
+ *
+ * Cada medidor tem um estado próprio (cascata passa-alta, passa-baixa,
+ * detector e índice da amostra), então medidores diferentes podem ser
+ * processados em threads diferentes sem sincronização, e um medidor pode
+ * ser processado em pedaços sucessivos com o mesmo resultado de uma
+ * chamada única.
+ *
+ * O código é o mesmo do firmware: apply_*_filter_block, o detector de
+ * event_detector.c (limiar adaptativo, debounce em amostras ou CUSUM) e
+ * classify_device_by_power. Os resultados só coincidem com os do
+ * dispositivo a menos de arredondamento: compilador, fusão de
+ * multiplicação-adição e esp-dsp podem mudar os últimos bits, e um evento
+ * no limite do limiar pode cair de um lado só em um deles.
+ */
+
+#ifndef NILM_BATCH_H
+#define NILM_BATCH_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define NILM_BATCH_API_VERSION  2
+
+/**
+ * @brief Evento detectado em um lote
+ */
+typedef struct {
+    uint64_t index;             // Índice da amostra desde o início do medidor (início do transitório no CUSUM)
+    float delta;                // ΔP do evento: nível depois - nível antes (W)
+    float power;                // Potência depois do evento (W)
+    int32_t device;             // device_type_t de classify_device_by_power(delta)
+} nilm_batch_event_t;
+
+typedef struct nilm_meter nilm_meter_t;
+
+// Protótipos de funções
+int nilm_batch_api_version(void);
+nilm_meter_t *nilm_meter_create(int detector, float threshold, uint32_t debounce_samples);
+void nilm_meter_destroy(nilm_meter_t *meter);
+void nilm_meter_reset(nilm_meter_t *meter);
+uint32_t nilm_meter_min_event_gap(const nilm_meter_t *meter);
+size_t nilm_meter_process(nilm_meter_t *meter, const float *power, size_t n,
+                          float *highpass_out, float *lowpass_out,
+                          nilm_batch_event_t *events, size_t max_events, size_t *n_events_total);
+
+#endif // NILM_BATCH_H
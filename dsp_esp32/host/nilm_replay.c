@@ -0,0 +1,355 @@
+/**
+ * @file nilm_replay.c
+ * @brief Benchmark de replay de traços de potência através de nilm_filters.c (host)
+ *
+ * Lê um traço de potência (CSV ou float32 bruto), reinicia os filtros e o
+ * processa amostra a amostra como o firmware faz: passa-alta de 6ª ordem
+ * para detecção de eventos, passa-baixa para caracterização, o detector
+ * de event_detector.c (limiar adaptativo com debounce ou, com -p, o CUSUM
+ * de changepoint.c) e classify_device_by_power() em cada evento. Cada
+ * execução parte do mesmo estado, então contagem de eventos e checksum das
+ * saídas são idênticos entre execuções e servem para comparar alterações
+ * no motor de filtros e no detector.
+ *
+ * Uso:
+ *   nilm_replay [-c coluna] [-t data_type] [-s escala] [-r execuções]
+ *               [-n min_amostras] [-b] [-m] [-p] arquivo.csv|arquivo.f32
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include "nilm_filters.h"
+#include "event_detector.h"
+
+#define MAX_LINE            1024
+#define MAX_RUNS            64
+#define BLOCK_SIZE          64      // Amostras por chamada no modo -b
+
+/**
+ * @brief Traço de potência carregado na memória
+ */
+typedef struct {
+    float *values;
+    size_t count;
+    size_t capacity;
+} trace_t;
+
+/**
+ * @brief Resultado de uma execução
+ */
+typedef struct {
+    double seconds;
+    uint32_t events;
+    uint32_t events_by_type[DEVICE_OTHER + 1];
+    uint64_t checksum;
+} run_result_t;
+
+static void trace_push(trace_t *trace, float value) {
+    if (trace->count == trace->capacity) {
+        trace->capacity = trace->capacity ? trace->capacity * 2 : 4096;
+        trace->values = realloc(trace->values, trace->capacity * sizeof(float));
+        if (trace->values == NULL) {
+            fprintf(stderr, "Memória insuficiente\n");
+            exit(1);
+        }
+    }
+    trace->values[trace->count++] = value;
+}
+
+/**
+ * @brief Índice de uma coluna no cabeçalho CSV (-1 se ausente)
+ */
+static int csv_column_index(const char *header, const char *name) {
+    char buf[MAX_LINE];
+    strncpy(buf, header, sizeof(buf) - 1);
+    buf[sizeof(buf) - 1] = '\0';
+
+    int index = 0;
+    for (char *tok = strtok(buf, ",\r\n"); tok != NULL; tok = strtok(NULL, ",\r\n"), index++) {
+        if (strcmp(tok, name) == 0) {
+            return index;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief Campo `index` de uma linha CSV (modifica a linha)
+ */
+static char *csv_field(char *line, int index) {
+    char *field = line;
+    for (int i = 0; i < index; i++) {
+        field = strchr(field, ',');
+        if (field == NULL) {
+            return NULL;
+        }
+        field++;
+    }
+    field[strcspn(field, ",\r\n")] = '\0';
+    return field;
+}
+
+/**
+ * @brief Carrega um CSV com cabeçalho (ex.: signal_analysis_data.csv)
+ *
+ * @param type_filter Se não NULL, mantém só as linhas com data_type igual
+ */
+static int load_csv(const char *path, const char *column, const char *type_filter, float scale, trace_t *trace) {
+    FILE *f = fopen(path, "r");
+    if (f == NULL) {
+        perror(path);
+        return -1;
+    }
+
+    char line[MAX_LINE];
+    if (fgets(line, sizeof(line), f) == NULL) {
+        fclose(f);
+        return -1;
+    }
+    int value_col = csv_column_index(line, column);
+    int type_col = (type_filter != NULL) ? csv_column_index(line, "data_type") : -1;
+    if (value_col < 0 || (type_filter != NULL && type_col < 0)) {
+        fprintf(stderr, "Coluna '%s' ou 'data_type' ausente em %s\n", column, path);
+        fclose(f);
+        return -1;
+    }
+
+    char copy[MAX_LINE];
+    while (fgets(line, sizeof(line), f) != NULL) {
+        if (type_col >= 0) {
+            memcpy(copy, line, sizeof(copy));
+            char *type = csv_field(copy, type_col);
+            if (type == NULL || strcmp(type, type_filter) != 0) {
+                continue;
+            }
+        }
+        char *value = csv_field(line, value_col);
+        if (value != NULL && *value != '\0') {
+            trace_push(trace, strtof(value, NULL) * scale);
+        }
+    }
+
+    fclose(f);
+    return 0;
+}
+
+/**
+ * @brief Carrega um traço float32 little-endian bruto (ex.: export_trace.py)
+ */
+static int load_raw(const char *path, float scale, trace_t *trace) {
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) {
+        perror(path);
+        return -1;
+    }
+
+    float value;
+    while (fread(&value, sizeof(value), 1, f) == 1) {
+        trace_push(trace, value * scale);
+    }
+
+    fclose(f);
+    return 0;
+}
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/**
+ * @brief Acumula um float no checksum FNV-1a (padrão de bits exato)
+ */
+static uint64_t checksum_float(uint64_t hash, float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    for (int i = 0; i < 4; i++) {
+        hash ^= (bits >> (8 * i)) & 0xFF;
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+/**
+ * @brief Detector de eventos do firmware (event_detector.c)
+ *
+ * O ΔP entra no checksum para que alterações no detector apareçam.
+ */
+static uint64_t detect(run_result_t *result, event_detector_t *ed, float power, float filtered, uint64_t hash) {
+    event_detector_event_t event;
+    if (event_detector_update(ed, power, filtered, &event)) {
+        result->events++;
+        result->events_by_type[classify_device_by_power(event.delta_power)]++;
+        hash = checksum_float(hash, event.delta_power);
+    }
+    return hash;
+}
+
+/**
+ * @brief Processa o traço (repetido até total_samples) a partir do estado inicial
+ */
+static run_result_t run_once(const trace_t *trace, size_t total_samples, int use_block,
+                             nilm_hp_structure_t structure, int use_changepoint) {
+    nilm_highpass_t hp;
+    biquad_section_t lp;
+    static event_detector_t ed;
+    run_result_t result = {0};
+    uint64_t hash = 0xcbf29ce484222325ULL;
+
+    init_filter_sections(&hp, &lp, structure);
+    reset_filter_states(&hp, &lp);
+    event_detector_config_t config = EVENT_DETECTOR_DEFAULT_CONFIG;
+    config.kind = use_changepoint ? EVENT_DETECTOR_CHANGEPOINT : EVENT_DETECTOR_THRESHOLD;
+    event_detector_init(&ed, &config);
+
+    double t0 = now_seconds();
+    if (use_block) {
+        float in[BLOCK_SIZE], hp_out[BLOCK_SIZE], lp_out[BLOCK_SIZE];
+        for (size_t n = 0; n < total_samples; n += BLOCK_SIZE) {
+            size_t len = (total_samples - n < BLOCK_SIZE) ? total_samples - n : BLOCK_SIZE;
+            for (size_t k = 0; k < len; k++) {
+                in[k] = trace->values[(n + k) % trace->count];
+            }
+            apply_highpass_filter_block(in, hp_out, len, &hp);
+            apply_lowpass_filter_block(in, lp_out, len, &lp);
+            for (size_t k = 0; k < len; k++) {
+                hash = detect(&result, &ed, in[k], hp_out[k], hash);
+                hash = checksum_float(checksum_float(hash, hp_out[k]), lp_out[k]);
+            }
+        }
+    } else {
+        for (size_t n = 0; n < total_samples; n++) {
+            float power = trace->values[n % trace->count];
+            float filtered = apply_highpass_filter(power, &hp);
+            float smoothed = apply_lowpass_filter(power, &lp);
+            hash = detect(&result, &ed, power, filtered, hash);
+            hash = checksum_float(checksum_float(hash, filtered), smoothed);
+        }
+    }
+    result.seconds = now_seconds() - t0;
+    result.checksum = hash;
+    return result;
+}
+
+static int compare_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "Uso: %s [-c coluna] [-t data_type] [-s escala] [-r execuções] [-n min_amostras] [-b] [-m] [-p] arquivo\n"
+            "  arquivo .f32/.bin: float32 little-endian bruto; demais: CSV com cabeçalho\n"
+            "  -c  coluna do CSV (padrão amplitude_or_magnitude)\n"
+            "  -t  filtra linhas por data_type (ex.: signal_original)\n"
+            "  -s  escala aplicada aos valores (ex.: W por unidade)\n"
+            "  -r  número de execuções (padrão 5)\n"
+            "  -n  repete o traço até este número de amostras (padrão 1000000)\n"
+            "  -b  usa a API por bloco (apply_*_filter_block)\n"
+            "  -m  passa-alta multitaxa (NILM_HP_MULTIRATE) em vez do Butterworth direto\n"
+            "  -p  detector de mudança de regime (CUSUM) em vez de limiar + debounce\n", prog);
+}
+
+int main(int argc, char **argv) {
+    const char *column = "amplitude_or_magnitude";
+    const char *type_filter = NULL;
+    float scale = 1.0f;
+    int runs = 5;
+    size_t min_samples = 1000000;
+    int use_block = 0;
+    nilm_hp_structure_t structure = NILM_HP_DIRECT;
+    int use_changepoint = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "c:t:s:r:n:bmph")) != -1) {
+        switch (opt) {
+            case 'c': column = optarg; break;
+            case 't': type_filter = optarg; break;
+            case 's': scale = strtof(optarg, NULL); break;
+            case 'r': runs = atoi(optarg); break;
+            case 'n': min_samples = strtoull(optarg, NULL, 10); break;
+            case 'b': use_block = 1; break;
+            case 'm': structure = NILM_HP_MULTIRATE; break;
+            case 'p': use_changepoint = 1; break;
+            default: usage(argv[0]); return (opt == 'h') ? 0 : 2;
+        }
+    }
+    if (optind >= argc || runs < 1 || runs > MAX_RUNS) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    nilm_filters_init();
+
+    // O banco multi-circuito tem de acompanhar a cascata escalar
+    float bank_error = nilm_filter_bank_validate();
+    if (!(bank_error <= NILM_BANK_MAX_ERROR_W)) {
+        fprintf(stderr, "Banco de filtros diverge da cascata escalar: %.3g W (limite %.3g W)\n",
+                bank_error, NILM_BANK_MAX_ERROR_W);
+        return 1;
+    }
+
+    // O caminho Q31 tem de ficar dentro do limite de arredondamento
+    float q31_bound;
+    float q31_error = nilm_q31_validate(&q31_bound);
+    if (!(q31_error <= q31_bound)) {
+        fprintf(stderr, "Filtro Q31 diverge da referência em double: %.3g W (limite %.3g W)\n",
+                q31_error, q31_bound);
+        return 1;
+    }
+
+    const char *path = argv[optind];
+    const char *ext = strrchr(path, '.');
+    trace_t trace = {0};
+    int ret = (ext != NULL && (strcmp(ext, ".f32") == 0 || strcmp(ext, ".bin") == 0))
+                  ? load_raw(path, scale, &trace)
+                  : load_csv(path, column, type_filter, scale, &trace);
+    if (ret != 0 || trace.count == 0) {
+        fprintf(stderr, "Nenhuma amostra carregada de %s\n", path);
+        return 1;
+    }
+
+    size_t total = (trace.count > min_samples) ? trace.count : min_samples;
+    printf("Traço: %s (%zu amostras, processadas %zu por execução, %s, passa-alta %s, detector %s)\n",
+           path, trace.count, total, use_block ? "API por bloco" : "API por amostra",
+           (structure == NILM_HP_MULTIRATE) ? "multitaxa" : "direto",
+           use_changepoint ? "CUSUM" : "limiar");
+
+    double times[MAX_RUNS];
+    run_result_t first = {0};
+    int mismatch = 0;
+    for (int r = 0; r < runs; r++) {
+        run_result_t result = run_once(&trace, total, use_block, structure, use_changepoint);
+        times[r] = result.seconds;
+        if (r == 0) {
+            first = result;
+        } else if (result.checksum != first.checksum || result.events != first.events) {
+            mismatch = 1;
+        }
+        printf("  execução %d: %.3f ms, %.1f ns/amostra\n", r + 1, result.seconds * 1e3, result.seconds * 1e9 / total);
+    }
+
+    qsort(times, runs, sizeof(double), compare_double);
+    double median = times[runs / 2];
+    printf("Mediana: %.1f ns/amostra, %.2f Mamostras/s (melhor %.1f ns/amostra)\n",
+           median * 1e9 / total, total / median / 1e6, times[0] * 1e9 / total);
+    printf("Eventos: %u", first.events);
+    for (int t = 0; t <= DEVICE_OTHER; t++) {
+        if (first.events_by_type[t]) {
+            printf(" | %s: %u", get_device_name((device_type_t)t), first.events_by_type[t]);
+        }
+    }
+    printf("\nChecksum: %016llx%s\n", (unsigned long long)first.checksum,
+           mismatch ? " (DIVERGENTE entre execuções)" : "");
+
+    free(trace.values);
+    return mismatch ? 1 : 0;
+}
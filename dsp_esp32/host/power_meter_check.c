@@ -0,0 +1,286 @@
+/**
+ * @file power_meter_check.c
+ * @brief Verificação de power_meter.c contra valores analíticos (host)
+ *
+ * Gera os códigos do padrão de conversão intercalado (V1, I1, V2, ...) de
+ * um sinal sintético, com a corrente amostrada um slot depois da tensão
+ * como no ADC, e compara as saídas na taxa NILM com os valores analíticos:
+ *
+ *   v = Vp·cos(ωt),  i = I1·cos(ωt - φ) + I3·cos(3ωt - φ3)
+ *   P = Vp·I1·cos(φ)/2,  Q = Vp·I1·sin(φ)/2,  Vrms = Vp/√2,
+ *   Irms = √((I1² + I3²)/2),  S = Vrms·Irms,  PF = P/S
+ *
+ * Nos casos com demux, os códigos são montados como palavras TYPE2 do
+ * quadro do ADC (canais ADC1 4..9, como em main) e separados por
+ * adc_frame_decode_codes() antes do medidor, o mesmo caminho do firmware.
+ *
+ * Cada caso roda com a correção de atraso (i_skew) e sem ela, para
+ * mostrar o erro que ela remove. Sai com código 1 se algum erro relativo
+ * corrigido passar do limite do caso: 0,1 % com 1 e 2 fases; com 3 fases
+ * (≈ 55 amostras por ciclo) as bordas do ciclo em amostras inteiras
+ * levam o erro a ≈ 0,2 %. Os casos usam a cadeia CIC + FIR dos ciclos
+ * (cic_fir), exceto um com a média do intervalo; com 3 fases o intervalo
+ * de 333 amostras não tem a forma R·2·2^n e o medidor usa a média.
+ *
+ * A dobra de espectro é medida à parte: com a corrente modulada a
+ * ALIAS_MOD_HZ (acima da banda útil de 5 Hz), a oscilação de P na saída
+ * é a parte da modulação que dobrou para 10 - ALIAS_MOD_HZ Hz. A média do
+ * intervalo a deixa passar (≈ 11 %); a cadeia CIC + FIR deve ficar abaixo
+ * de POWER_CHECK_MAX_ALIAS.
+ *
+ * Uso:
+ *   power_meter_check
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <math.h>
+#include <string.h>
+#include "adc_frame.h"
+#include "power_meter.h"
+
+#define POWER_CHECK_MAX_ERROR   1e-3    // 0,1 %
+#define POWER_CHECK_MAX_ERROR_3 2.5e-3  // 0,25 % com 3 fases
+#define POWER_CHECK_MAX_ALIAS   0.03    // Oscilação dobrada / modulação (-30 dB)
+#define ALIAS_MOD_HZ            9.0     // Modulação da corrente (Hz)
+#define ALIAS_MOD_DEPTH         0.2     // Profundidade da modulação
+#define ALIAS_SECONDS           8.0
+#define ALIAS_SETTLE_OUTPUTS    30      // Cadeia CIC + FIR: ≈ 2 s de resposta ao impulso
+#define ADC_RATE_HZ             20000.0 // Taxa total do padrão
+#define OUTPUT_RATE_HZ          10.0f
+#define FRAME_SAMPLES           64      // Amostras por canal por quadro
+#define RUN_SECONDS             6.0
+#define SETTLE_OUTPUTS          25      // Saídas iniciais descartadas (resposta ao impulso da cadeia CIC + FIR, ≈ 2 s)
+#define V_PEAK                  311.0   // V
+#define I_PEAK                  10.0    // A (fundamental)
+#define I3_RATIO                0.125   // 3ª harmônica da corrente
+#define V_CODE_PEAK             1500.0  // Códigos no pico de tensão
+#define I_CODE_PEAK             1500.0  // Códigos no pico de corrente (com a 3ª)
+#define CHANNEL_SHIFT           13      // Campo do canal na palavra TYPE2
+
+// Padrão de conversão do firmware: V1, I1, V2, I2, V3, I3 (ADC1_CHANNEL_4..9)
+static const uint8_t pattern_channels[2 * POWER_METER_MAX_PHASES] = { 4, 5, 6, 7, 8, 9 };
+
+/**
+ * @brief Caso de teste
+ */
+typedef struct {
+    uint32_t n_phases;
+    double mains_hz;
+    double phi;                 // Ângulo da fundamental da corrente (rad, > 0 indutivo)
+    double max_error;           // Maior erro relativo aceito
+    int demux;                  // 1 = quadro TYPE2 intercalado via adc_frame_decode_codes()
+    int cic_fir;                // 1 = ciclos decimados pela cadeia CIC + FIR
+} check_case_t;
+
+/**
+ * @brief Erros relativos máximos de um caso
+ */
+typedef struct {
+    double p, q, s, pf, v_rms, i_rms, frequency;
+    double lost;                // Fração das palavras do quadro não entregue ao canal certo
+    int decimated;              // O medidor usou a cadeia CIC + FIR
+} check_error_t;
+
+static void track(double *max_error, double value, double expected) {
+    double err = fabs(value - expected) / fabs(expected);
+    if (err > *max_error) {
+        *max_error = err;
+    }
+}
+
+static uint16_t to_code(double value, double gain) {
+    long code = lround(POWER_METER_CODE_BIAS + value / gain);
+    return (uint16_t)((code < 0) ? 0 : (code > 4095) ? 4095 : code);
+}
+
+/**
+ * @brief Inicializa o medidor para n_phases fases com os ganhos do sinal sintético
+ */
+static void init_meter(power_meter_t *pm, uint32_t n_phases, float i_skew, int cic_fir) {
+    power_meter_config_t config = {
+        .n_phases = n_phases,
+        .sample_rate_hz = (float)(ADC_RATE_HZ / (2 * n_phases)),
+        .mains_hz = 60.0f,
+        .output_rate_hz = OUTPUT_RATE_HZ,
+        .v_min_rms = 10.0f,
+        .i_skew = i_skew,
+        .cic_fir = cic_fir,
+    };
+    for (uint32_t p = 0; p < n_phases; p++) {
+        config.v_gain[p] = (float)(V_PEAK / V_CODE_PEAK);
+        config.i_gain[p] = (float)(I_PEAK * (1.0 + I3_RATIO) / I_CODE_PEAK);
+    }
+    power_meter_init(pm, &config);
+}
+
+/**
+ * @brief Roda um caso e devolve os erros relativos máximos das saídas
+ */
+static check_error_t run_case(const check_case_t *cc, float i_skew) {
+    static power_meter_t pm;
+    const uint32_t n_channels = 2 * cc->n_phases;
+    const double fs = ADC_RATE_HZ / n_channels;
+    const double w = 2.0 * M_PI * cc->mains_hz;
+    const double v_gain = V_PEAK / V_CODE_PEAK;
+    const double i_gain = I_PEAK * (1.0 + I3_RATIO) / I_CODE_PEAK;
+    init_meter(&pm, cc->n_phases, i_skew, cc->cic_fir);
+
+    const double i3 = I_PEAK * I3_RATIO;
+    const double v_rms = V_PEAK / sqrt(2.0);
+    const double i_rms = sqrt((I_PEAK * I_PEAK + i3 * i3) / 2.0);
+    const double p_ref = V_PEAK * I_PEAK * cos(cc->phi) / 2.0;
+    const double q_ref = V_PEAK * I_PEAK * sin(cc->phi) / 2.0;
+    const double s_ref = v_rms * i_rms;
+
+    check_error_t err = {0};
+    uint16_t frame[2 * POWER_METER_MAX_PHASES][FRAME_SAMPLES];
+    uint16_t *codes[2 * POWER_METER_MAX_PHASES];
+    size_t counts[2 * POWER_METER_MAX_PHASES];
+    uint32_t raw[2 * POWER_METER_MAX_PHASES * FRAME_SAMPLES];
+    adc_frame_decoder_t dec;
+    adc_frame_decoder_init(&dec, pattern_channels, n_channels);
+    uint64_t words = 0, delivered = 0;
+    uint32_t outputs = 0;
+    uint64_t j = 0;
+
+    for (uint64_t total = (uint64_t)(RUN_SECONDS * fs); j < total;) {
+        for (uint32_t k = 0; k < FRAME_SAMPLES; k++, j++) {
+            for (uint32_t p = 0; p < cc->n_phases; p++) {
+                // Slots do padrão a ADC_RATE_HZ; fases defasadas de 120°
+                double shift = 2.0 * M_PI * p / 3.0;
+                double tv = (j * n_channels + 2 * p) / ADC_RATE_HZ;
+                double ti = tv + 1.0 / ADC_RATE_HZ;
+                double v = V_PEAK * cos(w * tv - shift);
+                double i = I_PEAK * cos(w * ti - shift - cc->phi) + i3 * cos(3.0 * (w * ti - shift) - 0.3);
+                frame[2 * p][k] = to_code(v, v_gain);
+                frame[2 * p + 1][k] = to_code(i, i_gain);
+            }
+            // Palavras na ordem de conversão, com o canal no campo TYPE2
+            for (uint32_t ch = 0; ch < n_channels; ch++) {
+                raw[k * n_channels + ch] = frame[ch][k] | ((uint32_t)pattern_channels[ch] << CHANNEL_SHIFT);
+            }
+        }
+        for (uint32_t ch = 0; ch < n_channels; ch++) {
+            codes[ch] = frame[ch];
+            counts[ch] = FRAME_SAMPLES;
+        }
+        if (cc->demux) {
+            // Refaz os buffers por canal a partir do quadro intercalado
+            memset(frame, 0, sizeof(frame));
+            memset(counts, 0, sizeof(counts));
+            adc_frame_decode_codes(&dec, (const uint8_t *)raw, n_channels * FRAME_SAMPLES * sizeof(raw[0]),
+                                   codes, FRAME_SAMPLES, counts);
+        }
+        words += n_channels * FRAME_SAMPLES;
+        for (uint32_t ch = 0; ch < n_channels; ch++) {
+            delivered += counts[ch];
+        }
+
+        power_sample_t out[4];
+        size_t n_out = power_meter_process(&pm, (const uint16_t *const *)codes, counts, out, 4);
+        for (size_t o = 0; o < n_out; o++, outputs++) {
+            if (outputs < SETTLE_OUTPUTS) {
+                continue;
+            }
+            for (uint32_t p = 0; p < cc->n_phases; p++) {
+                const power_phase_t *ph = &out[o].phase[p];
+                track(&err.p, ph->p, p_ref);
+                track(&err.q, ph->q, q_ref);
+                track(&err.s, ph->s, s_ref);
+                track(&err.pf, ph->pf, p_ref / s_ref);
+                track(&err.v_rms, ph->v_rms, v_rms);
+                track(&err.i_rms, ph->i_rms, i_rms);
+            }
+            track(&err.frequency, out[o].frequency, cc->mains_hz);
+        }
+    }
+    err.lost = (double)(words - delivered) / (double)words;
+    err.decimated = pm.decimate;
+    return err;
+}
+
+/**
+ * @brief Oscilação de P na saída (relativa à amplitude da modulação) com a corrente modulada a ALIAS_MOD_HZ
+ */
+static double alias_ripple(int cic_fir) {
+    static power_meter_t pm;
+    const double fs = ADC_RATE_HZ / 2;
+    const double w = 2.0 * M_PI * 60.0;
+    const double v_gain = V_PEAK / V_CODE_PEAK;
+    const double i_gain = I_PEAK * (1.0 + I3_RATIO) / I_CODE_PEAK;
+    const double p_ref = V_PEAK * I_PEAK * cos(0.5) / 2.0;
+    init_meter(&pm, 1, 0.5f, cic_fir);
+
+    uint16_t frame[2][FRAME_SAMPLES];
+    const uint16_t *codes[2] = { frame[0], frame[1] };
+    const size_t counts[2] = { FRAME_SAMPLES, FRAME_SAMPLES };
+    double max_dev = 0.0;
+    uint32_t outputs = 0;
+
+    for (uint64_t j = 0, total = (uint64_t)(ALIAS_SECONDS * fs); j < total;) {
+        for (uint32_t k = 0; k < FRAME_SAMPLES; k++, j++) {
+            double tv = (2 * j) / ADC_RATE_HZ;
+            double ti = tv + 1.0 / ADC_RATE_HZ;
+            double m = 1.0 + ALIAS_MOD_DEPTH * cos(2.0 * M_PI * ALIAS_MOD_HZ * ti);
+            frame[0][k] = to_code(V_PEAK * cos(w * tv), v_gain);
+            frame[1][k] = to_code(m * I_PEAK / (1.0 + ALIAS_MOD_DEPTH) * cos(w * ti - 0.5), i_gain);
+        }
+        power_sample_t out[4];
+        size_t n_out = power_meter_process(&pm, codes, counts, out, 4);
+        for (size_t o = 0; o < n_out; o++, outputs++) {
+            double dev = fabs(out[o].p - p_ref / (1.0 + ALIAS_MOD_DEPTH));
+            if (outputs >= ALIAS_SETTLE_OUTPUTS && dev > max_dev) {
+                max_dev = dev;
+            }
+        }
+    }
+    return max_dev / (ALIAS_MOD_DEPTH * p_ref / (1.0 + ALIAS_MOD_DEPTH));
+}
+
+static double worst(const check_error_t *e) {
+    double m = e->p;
+    const double all[] = { e->q, e->s, e->pf, e->v_rms, e->i_rms, e->frequency, e->lost };
+    for (size_t k = 0; k < sizeof(all) / sizeof(all[0]); k++) {
+        m = (all[k] > m) ? all[k] : m;
+    }
+    return m;
+}
+
+int main(void) {
+    static const check_case_t cases[] = {
+        { 1, 60.0, 0.5, POWER_CHECK_MAX_ERROR, 0, 1 },
+        { 1, 59.5, 1.2, POWER_CHECK_MAX_ERROR, 0, 1 },
+        { 1, 60.0, -0.8, POWER_CHECK_MAX_ERROR, 0, 1 },
+        { 1, 60.0, 0.5, POWER_CHECK_MAX_ERROR, 0, 0 },
+        { 2, 60.0, 0.5, POWER_CHECK_MAX_ERROR, 0, 1 },
+        { 3, 60.0, 0.5, POWER_CHECK_MAX_ERROR_3, 0, 1 },
+        { 3, 60.3, 0.5, POWER_CHECK_MAX_ERROR_3, 0, 1 },
+        { 2, 60.0, 0.7, POWER_CHECK_MAX_ERROR, 1, 1 },
+        { 3, 60.0, -0.6, POWER_CHECK_MAX_ERROR_3, 1, 1 },
+    };
+    int failed = 0;
+
+    printf("Erro relativo máximo (%%) das saídas a %.0f Hz, corrente com 3ª harmônica de %.1f %%\n",
+           OUTPUT_RATE_HZ, I3_RATIO * 100.0);
+    printf("fases  rede    φ    demux  ciclos |    P      Q      S      PF    Vrms   Irms   f     | P sem correção\n");
+    for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); c++) {
+        const check_case_t *cc = &cases[c];
+        check_error_t e = run_case(cc, 1.0f / (2 * cc->n_phases));
+        check_error_t raw = run_case(cc, 0.0f);
+        int ok = worst(&e) <= cc->max_error;
+        failed |= !ok;
+        printf("  %u    %.1f  %5.2f  %s   %s  | %.4f %.4f %.4f %.4f %.4f %.4f %.4f | %.3f %s\n",
+               cc->n_phases, cc->mains_hz, cc->phi, cc->demux ? "sim" : "não", e.decimated ? "CIC  " : "média", e.p * 100, e.q * 100, e.s * 100, e.pf * 100,
+               e.v_rms * 100, e.i_rms * 100, e.frequency * 100, raw.p * 100, ok ? "ok" : "FALHOU");
+    }
+
+    double alias_mean = alias_ripple(0);
+    double alias_cic = alias_ripple(1);
+    int alias_ok = alias_cic <= POWER_CHECK_MAX_ALIAS;
+    failed |= !alias_ok;
+    printf("Corrente modulada a %.0f Hz: oscilação dobrada de P / modulação: média do intervalo %.2f %%, CIC + FIR %.2f %% %s\n",
+           ALIAS_MOD_HZ, alias_mean * 100, alias_cic * 100, alias_ok ? "ok" : "FALHOU");
+    printf("%s\n", failed ? "FALHOU" : "ok");
+    return failed;
+}
@@ -1,5 +1,6 @@
 #include <stdint.h>
 #include <string.h>
+#include <stdlib.h>
 #include <stdio.h>
 #include <math.h>
 #include <sys/unistd.h>
@@ -17,190 +18,413 @@
 #include "freertos/semphr.h"
 #include "esp_adc/adc_continuous.h"
 #include "soc/soc_caps.h"
+#include "frame_ring.h"
+#include "nilm_filters.h"
+#include "power_meter.h"
+#include "current_harmonics.h"
+#include "running_stats.h"
+#include "pipeline_config.h"
+#include "perf_probe.h"
+#include "telemetry.h"
+#include "event_stream.h"
+#include "adc_frame.h"
+#include "power_log.h"
+#include "event_detector.h"
+#include "acq_control.h"
+#include "esp_timer.h"
+#include "esp_pm.h"
 
 // Tag para logs
 static const char* TAG = "NILM_DETECTOR";
 
 // Configurações do sistema
 #define SAMPLE_RATE_HZ          10.0f       // Taxa de amostragem para NILM (10 Hz)
-#define ADC_SAMPLE_RATE_HZ      20000       // Taxa de amostragem do ADC (20 kHz)
-#define DECIMATION_FACTOR       2000        // 20000/10 = 2000
-#define EVENT_THRESHOLD         50.0f       // Limiar de detecção de eventos (W)
-#define DEBOUNCE_TIME_MS        2000        // Tempo de debounce (2 segundos)
+#define ADC_SAMPLE_RATE_HZ      20000       // Taxa de amostragem do ADC (20 kHz, total do padrão)
+#define MAINS_FREQ_HZ           60.0f       // Frequência nominal da rede
+
+// Fases medidas: cada uma é um par tensão/corrente no padrão de conversão
+// (V1, I1, V2, I2, V3, I3), 20 kHz / (2 * NILM_PHASES) por canal
+#ifndef NILM_PHASES
+#define NILM_PHASES             1
+#endif
+#define ADC_NUM_CHANNELS        (2 * NILM_PHASES)
+#define VOLTAGE_SENSOR_SCALE    200.0f      // V de rede por V no ADC (ajustar conforme o sensor)
+#define CURRENT_SENSOR_SCALE    30.0f       // A por V no ADC (SCT-013-030: 30 A / 1 V)
+
+// 1 = ciclos da rede decimados para 10 Hz pela cadeia CIC + FIR (decimator.h,
+// atraso ≈ 1 s); 0 = média dos ciclos de cada intervalo de 100 ms
+#ifndef NILM_CYCLE_CIC_FIR
+#define NILM_CYCLE_CIC_FIR      1
+#endif
+
+// 1 = harmônicas da corrente de cada fase em janelas de 100 ms
+// (current_harmonics.h); thd e h3_ratio de cada evento são os da corrente que
+// ele acrescentou ou retirou, e entram no classificador
+#ifndef NILM_HARMONIC_FEATURES
+#define NILM_HARMONIC_FEATURES  1
+#endif
+#define ADC_FRAME_BYTES         PIPELINE_ADC_CONV_FRAME_BYTES   // Quadro de conversão (conv_frame_size)
+#define ADC_FRAME_SAMPLES       (ADC_FRAME_BYTES / ADC_FRAME_WORD_BYTES)
+
+// Detector de eventos: NILM_DETECTOR_CHANGEPOINT = CUSUM com segmentação em
+// regime permanente (changepoint.h), degrau entre regimes e sem debounce;
+// NILM_DETECTOR_THRESHOLD = |passa-alta| > limiar com debounce de NILM_DEBOUNCE_TIME_MS.
+// Limiar adaptativo e debounce são os de nilm_filters.h, os mesmos do host
+#define NILM_DETECTOR_THRESHOLD     0       // = EVENT_DETECTOR_THRESHOLD
+#define NILM_DETECTOR_CHANGEPOINT   1       // = EVENT_DETECTOR_CHANGEPOINT
+#ifndef NILM_DETECTOR
+#define NILM_DETECTOR           NILM_DETECTOR_CHANGEPOINT
+#endif
+
+// 1 = envia só lotes binários de eventos e o resumo de potência (event_stream.h),
+// sem logs de texto periódicos; 0 = eventos como ESP_LOGI
+#ifndef NILM_EVENT_ONLY_MODE
+#define NILM_EVENT_ONLY_MODE    1
+#endif
+
+// 1 = grava potência (10 Hz) e eventos no histórico em flash (power_log.h,
+// partição "powerlog" de partitions.csv)
+#ifndef NILM_POWER_LOG
+#define NILM_POWER_LOG          1
+#endif
+
+// 1 = aquisição adaptativa (acq_control.h): sem atividade do detector o ADC
+// só liga em uma rajada de QUIET_BURST_CYCLES ciclos da rede por amostra e o
+// light sleep automático fica liberado (CONFIG_PM_ENABLE e
+// CONFIG_FREERTOS_USE_TICKLESS_IDLE); 0 = ADC contínuo sempre
+#ifndef NILM_ADAPTIVE_ACQ
+#define NILM_ADAPTIVE_ACQ       1
+#endif
+#define QUIET_BURST_CYCLES      1           // Ciclos da rede por rajada no modo econômico
+#define SAMPLE_PERIOD_US        ((int64_t)(1000000.0f / SAMPLE_RATE_HZ))
+#define ADC_FRAME_US            ((int64_t)ADC_FRAME_SAMPLES * 1000000 / ADC_SAMPLE_RATE_HZ)
 
 // Configurações do ADC
-adc_channel_t channels[2] = {ADC1_CHANNEL_4, ADC1_CHANNEL_5};
-int ADC_DATA[2];
-float voltage[2];
-static uint32_t decimation_counter = 0;
-static float voltage_sum[2] = {0, 0};
+adc_channel_t channels[ADC_NUM_CHANNELS] = {
+    ADC1_CHANNEL_4, ADC1_CHANNEL_5,     // Fase 1: tensão, corrente
+#if NILM_PHASES >= 2
+    ADC1_CHANNEL_6, ADC1_CHANNEL_7,     // Fase 2
+#endif
+#if NILM_PHASES >= 3
+    ADC1_CHANNEL_8, ADC1_CHANNEL_9,     // Fase 3
+#endif
+};
+
+// P/Q/S/PF por ciclo da rede sobre os códigos brutos, médias a 10 Hz
+static power_meter_t power_meter;
+
+#if NILM_HARMONIC_FEATURES
+// Harmônicas da corrente sobre os mesmos códigos (só na taxa plena)
+static current_harmonics_t current_harmonics;
+#endif
+
+// Demux do quadro de conversão; o ganho da calibração do eFuse (linear)
+// entra no ganho de cada canal do medidor, que trabalha em códigos
+static adc_frame_decoder_t adc_decoder;
 
 adc_continuous_handle_t adc_handle;
 TaskHandle_t cb_task;
 TaskHandle_t nilm_task;
 
-bool New_ADC_data = pdFALSE;
-
-// Estrutura para armazenar estados do filtro IIR
+// Amostra de potência (10 Hz) entregue pela aquisição à task NILM
 typedef struct {
-    float x[3];  // Entradas anteriores [x[n], x[n-1], x[n-2]]
-    float y[3];  // Saídas anteriores [y[n], y[n-1], y[n-2]]
-} biquad_state_t;
-
-// Estados dos filtros para cada seção biquad
-static biquad_state_t filter_states[3];
-
-// Coeficientes do filtro Butterworth 6ª ordem passa-alta (fc = 0.002 Hz, fs = 10 Hz)
-// Decomposto em 3 seções biquad (Segunda Ordem)
-static const float filter_coeffs[3][6] = {
-    // Seção 1: [b0, b1, b2, a0, a1, a2]
-    {0.999001949317, -1.998003898634, 0.999001949317, 1.0, -1.998001949634, 0.998005898268},
-    // Seção 2:
-    {1.000000000000, -2.000000000000, 1.000000000000, 1.0, -1.997003947368, 0.997005896736},
-    // Seção 3:
-    {1.000000000000, -2.000000000000, 1.000000000000, 1.0, -1.996007894737, 0.996009844211}
-};
+    power_sample_t power;
+    int64_t dma_time_us;        // Fim do quadro de DMA que completou a amostra (esp_timer)
+    int64_t time_us;            // Instante na grade de 100 ms (contínua entre os modos de aquisição)
+#if NILM_HARMONIC_FEATURES
+    current_harmonics_snapshot_t harmonics;     // Última janela fechada (sem o atraso do decimador)
+#endif
+} nilm_sample_t;
 
-// Buffers para processamento
-#define POWER_BUFFER_SIZE       100
-static float power_buffer[POWER_BUFFER_SIZE];
-static uint32_t power_index = 0;
-static bool power_buffer_full = false;
+#define SAMPLE_RING_SLOTS       PIPELINE_SAMPLE_SLOTS
+static nilm_sample_t sample_slots[SAMPLE_RING_SLOTS];
+static frame_ring_t sample_ring;
+static volatile uint32_t adc_pool_overflows = 0;  // Pool do driver cheio (aquisição atrasada)
+static volatile int64_t adc_conv_done_us = 0;      // Instante do último quadro de DMA (esp_timer)
+
+// Modo de aquisição: decidido pela task NILM, aplicado pela de aquisição
+#if NILM_ADAPTIVE_ACQ
+static acq_control_t acq_control;
+#endif
+static volatile acq_mode_t acq_requested = ACQ_MODE_FULL;
+
+#if NILM_POWER_LOG
+static power_log_t power_log;
+static uint32_t samples_consumed = 0;               // Amostras lidas do sample_ring
+static uint16_t power_log_events = 0;
+#endif
+
+// Instrumentação dos estágios (exportada a cada PERF_REPORT_MS)
+#define PERF_REPORT_MS          10000
+static perf_stage_t perf_acq = PERF_STAGE_INIT("adc_dec", PERF_UNIT_PROBE);
+static perf_stage_t perf_filter = PERF_STAGE_INIT("highpass", PERF_UNIT_PROBE);
+static perf_stage_t perf_detect = PERF_STAGE_INIT("detect", PERF_UNIT_PROBE);
+static perf_stage_t perf_latency = PERF_STAGE_INIT("dma2det", PERF_UNIT_US);
 
-// Variáveis para detecção de eventos
-static uint32_t last_event_time = 0;
+// Filtro passa-alta Butterworth 6ª ordem (fc = 0.002 Hz, fs = 10 Hz) de nilm_filters
+#if NILM_FILTER_FIXED_POINT
+static biquad_section_q31_t hp_sections[HP_FILTER_SECTIONS];
+#else
+static nilm_highpass_t hp_filter;
+#endif
+
+// Janela do baseline (O(1) por amostra, com mínimo e máximo para o log)
+#define POWER_BUFFER_SIZE       100         // Janela do baseline (10 s a 10 Hz)
+static float power_buffer[POWER_BUFFER_SIZE];
+static uint32_t power_min_deque[POWER_BUFFER_SIZE];
+static uint32_t power_max_deque[POWER_BUFFER_SIZE];
+static running_stats_t power_stats;
 static float baseline_power = 0.0f;
 
-// Função para aplicar uma seção biquad do filtro
-static float apply_biquad(float input, int section) {
-    biquad_state_t *state = &filter_states[section];
-    const float *coeffs = filter_coeffs[section];
-    
-    // Atualizar entradas
-    state->x[2] = state->x[1];
-    state->x[1] = state->x[0];
-    state->x[0] = input;
-    
-    // Calcular saída usando Direct Form II Transposed
-    float output = coeffs[0] * state->x[0] + 
-                   coeffs[1] * state->x[1] + 
-                   coeffs[2] * state->x[2] - 
-                   coeffs[4] * state->y[1] - 
-                   coeffs[5] * state->y[2];
-    
-    // Atualizar saídas
-    state->y[2] = state->y[1];
-    state->y[1] = state->y[0];
-    state->y[0] = output;
+// Detector de eventos (event_detector.c, o mesmo de host/nilm_replay e host/nilm_batch)
+static event_detector_t detector;
+
+// Instantes na grade de amostras (time_us, em ms) e potências das últimas
+// amostras do detector: o evento é datado pela sua amostra, não pelo tick da
+// confirmação, e a forma do transitório é medida nas amostras desde o início
+#define EVENT_TIME_HISTORY      1024        // > max_transient + settle_samples do CUSUM
+static uint32_t sample_time_ms[EVENT_TIME_HISTORY];
+static float sample_power[EVENT_TIME_HISTORY];
+static float transient_power[EVENT_TIME_HISTORY];  // Cópia contígua para nilm_transient_features
+
+// Harmônicas alinhadas à potência: a amostra de potência sai com o atraso de
+// grupo do decimador (harmonic_delay amostras), o retrato das harmônicas não.
+// O retrato de antes é o último alinhado fora de um transitório
+#define HARMONIC_DELAY_SLOTS    (NILM_HARMONIC_FEATURES ? 32 : 1)
+static current_harmonics_snapshot_t harmonic_history[HARMONIC_DELAY_SLOTS];
+static current_harmonics_snapshot_t harmonics_before;
+static uint32_t harmonic_delay = 0;
+
+// Registra o evento no histórico e o envia (lote binário ou ESP_LOGI)
+static void emit_event(nilm_event_t *event, const nilm_device_features_t *features, float power) {
+    event->device_type = (uint8_t)classify_device(features);
+    event->thd = features->thd;
+    event->h3_ratio = features->h3_ratio;
+    strncpy(event->device_name, get_device_name((device_type_t)event->device_type), sizeof(event->device_name) - 1);
     
-    return output;
+#if NILM_POWER_LOG
+    event_record_t record;
+    event_record_from_event(&record, event, power, power_log_events++);
+    power_log_append_event(&power_log, &record);
+#endif
+#if NILM_EVENT_ONLY_MODE
+    event_stream_push(event, power);
+#else
+    ESP_LOGI(TAG, "EVENT DETECTED: %s | Device: %s | Power: %.1fW | Delta: %.1fW | Transient: %lu ms | THD: %.2f | H3: %.2f",
+             (event->delta_power > 0) ? "ON" : "OFF", event->device_name, power, event->delta_power,
+             event->duration_ms, event->thd, event->h3_ratio);
+#endif
 }
 
-// Função para aplicar o filtro completo (cascata de 3 seções biquad)
-static float apply_highpass_filter(float input) {
-    float output = input;
+// Monta o evento confirmado pelo detector (datas, características) e o envia
+static void report_event(const event_detector_event_t *detected, int64_t time_us,
+                         const current_harmonics_snapshot_t *harmonics_after) {
+    const uint32_t period_ms = (uint32_t)(1000.0f / SAMPLE_RATE_HZ);
+    uint32_t age = detector.n - 1 - detected->index;   // Amostras desde o evento
+    uint32_t timestamp_ms = (age < EVENT_TIME_HISTORY)
+        ? sample_time_ms[detected->index % EVENT_TIME_HISTORY]
+        : (uint32_t)(time_us / 1000) - age * period_ms;
+    nilm_event_t event = {
+        .timestamp_ms = timestamp_ms,
+        .delta_power = detected->delta_power,
+        .steady = detected->steady,
+        .duration_ms = detected->duration * period_ms,
+    };
     
-    // Aplicar cada seção biquad em cascata
-    for (int i = 0; i < 3; i++) {
-        output = apply_biquad(output, i);
+    // Características para o classificador; forma só com o transitório no histórico
+    nilm_device_features_t features = {
+        .delta_power = detected->delta_power,
+        .duration_s = (float)detected->duration / SAMPLE_RATE_HZ,
+        .rise_time_s = NAN, .overshoot = NAN, .thd = NAN, .h3_ratio = NAN,
+    };
+    if (age < EVENT_TIME_HISTORY) {
+        for (uint32_t i = 0; i <= age; i++) {
+            transient_power[i] = sample_power[(detected->index + i) % EVENT_TIME_HISTORY];
+        }
+        nilm_transient_features(transient_power, age + 1, detected->power - detected->delta_power,
+                                1.0f / SAMPLE_RATE_HZ, &features);
+    }
+    if (harmonics_after != NULL) {
+        current_harmonics_features(&harmonics_before, harmonics_after, &features);
     }
     
-    return output;
-}
-
-// Função para calcular potência a partir das tensões
-static float calculate_power(float v1, float v2) {
-    // Para sensores de corrente: P = V * I
-    // Assumindo que v1 é tensão e v2 é proporcional à corrente
-    // Ajustar conforme a configuração real dos sensores
-    return fabsf(v1 * v2 * 100.0f);  // Fator de escala para converter para Watts
+    if (detected->timed_out) {
+        ESP_LOGW(TAG, "Transient did not settle in %lu ms, delta %.1fW",
+                 detector.change.config.max_transient * period_ms, detected->delta_power);
+    }
+    emit_event(&event, &features, detected->power);
 }
 
-// Função para detectar eventos
-static void detect_events(float current_power, float filtered_power) {
-    uint32_t current_time = xTaskGetTickCount() * portTICK_PERIOD_MS;
+// Função para detectar eventos; no CUSUM o evento é datado no início do
+// transitório (a confirmação chega settle_samples depois do fim), no limiar
+// no disparo (o nível depois chega ~2 s depois). harmonics é o retrato que
+// veio com a amostra (NULL sem NILM_HARMONIC_FEATURES)
+static void detect_events(float current_power, float filtered_power, int64_t time_us,
+                          const current_harmonics_snapshot_t *harmonics) {
+    sample_time_ms[detector.n % EVENT_TIME_HISTORY] = (uint32_t)(time_us / 1000);
+    sample_power[detector.n % EVENT_TIME_HISTORY] = current_power;
     
-    // Verificar debounce
-    if (current_time - last_event_time < DEBOUNCE_TIME_MS) {
-        return;
+    // Retrato de harmonic_delay amostras atrás, o da mesma época da potência
+    const current_harmonics_snapshot_t *aligned = NULL;
+    if (harmonics != NULL) {
+        harmonic_history[detector.n % HARMONIC_DELAY_SLOTS] = *harmonics;
+        aligned = (detector.n >= harmonic_delay)
+            ? &harmonic_history[(detector.n - harmonic_delay) % HARMONIC_DELAY_SLOTS]
+            : &harmonics_before;
     }
     
-    // Verificar se há um evento significativo
-    if (fabsf(filtered_power) > EVENT_THRESHOLD) {
-        last_event_time = current_time;
-        
-        // Classificar o tipo de evento
-        const char* event_type = "unknown";
-        const char* device_type = "unknown";
-        
-        if (filtered_power > 0) {
-            event_type = "ON";
-            // Classificar dispositivo baseado na potência
-            if (current_power > 2000) {
-                device_type = "heating";
-            } else if (current_power > 500) {
-                device_type = "appliance";
-            } else if (current_power > 100) {
-                device_type = "lighting";
-            } else {
-                device_type = "small_load";
-            }
-        } else {
-            event_type = "OFF";
-        }
-        
-        ESP_LOGI(TAG, "EVENT DETECTED: %s | Device: %s | Power: %.1fW | Delta: %.1fW", 
-                 event_type, device_type, current_power, filtered_power);
+    event_detector_event_t detected;
+    if (event_detector_update(&detector, current_power, filtered_power, &detected)) {
+        report_event(&detected, time_us, aligned);
+    }
+    if (aligned != NULL && !event_detector_active(&detector)) {
+        harmonics_before = *aligned;
     }
 }
 
 // Callback do ADC
 static bool IRAM_ATTR callback(adc_continuous_handle_t handle, const adc_continuous_evt_data_t *edata, void *user_data) {
     BaseType_t mustYield = pdFALSE;
+    adc_conv_done_us = esp_timer_get_time();
     vTaskNotifyGiveFromISR(cb_task, &mustYield);
     return (mustYield == pdTRUE);
 }
 
+// Callback de overflow do pool do driver ADC
+static bool IRAM_ATTR pool_ovf_callback(adc_continuous_handle_t handle, const adc_continuous_evt_data_t *edata, void *user_data) {
+    adc_pool_overflows++;
+    return false;
+}
+
+// Próximo ponto da grade de amostras NILM para uma saída pronta em now_us.
+// A grade só avança; depois de uma lacuna (troca de modo, rajada perdida)
+// salta para o ponto mais próximo de now_us, sem perder a fase
+static int64_t next_slot(int64_t slot_us, int64_t now_us) {
+    slot_us += SAMPLE_PERIOD_US;
+    if (now_us - slot_us > SAMPLE_PERIOD_US / 2) {
+        slot_us += (now_us - slot_us + SAMPLE_PERIOD_US / 2) / SAMPLE_PERIOD_US * SAMPLE_PERIOD_US;
+    }
+    return slot_us;
+}
+
 // Task para processar dados do ADC
 void cbTask(void *parameters) {
-    uint8_t buf[256];  // Buffer maior para dados do ADC
+    static uint8_t buf[ADC_FRAME_BYTES];  // Um quadro de conversão por leitura
     uint32_t rxLen = 0;
+    nilm_sample_t *sample = (nilm_sample_t *)frame_ring_write_slot(&sample_ring);
+    
+    // Códigos separados por canal (fora da pilha)
+    static uint16_t codes[ADC_NUM_CHANNELS][ADC_FRAME_SAMPLES];
+    uint16_t *code_out[ADC_NUM_CHANNELS];
+    for (int ch = 0; ch < ADC_NUM_CHANNELS; ch++) {
+        code_out[ch] = codes[ch];
+    }
+    power_sample_t outputs[2];  // Um quadro (12.8 ms a 10 kHz) fecha no máximo um intervalo de 100 ms
+    power_sample_t last_output = {0};
+    int64_t slot_us = 0;
+    acq_mode_t mode = ACQ_MODE_FULL;
+    
+    // Duração de uma rajada do modo econômico: a janela mais o quadro que a completa
+    const int64_t burst_us = (int64_t)(power_meter_window_samples(&power_meter, QUIET_BURST_CYCLES)
+                                       * 1e6f / power_meter.config.sample_rate_hz) + ADC_FRAME_US;
     
     for (;;) {
-        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        // Troca de modo pedida pela task NILM
+        if (acq_requested != mode) {
+            mode = acq_requested;
+            if (mode == ACQ_MODE_QUIET) {
+                adc_continuous_stop(adc_handle);
+                power_meter_set_window(&power_meter, QUIET_BURST_CYCLES);
+#if NILM_HARMONIC_FEATURES
+                current_harmonics_reset(&current_harmonics);    // Rajadas curtas demais para uma janela
+#endif
+            } else {
+                power_meter_set_window(&power_meter, 0);
+                adc_continuous_flush_pool(adc_handle);
+                adc_continuous_start(adc_handle);
+            }
+        }
         
-        esp_err_t ret = adc_continuous_read(adc_handle, buf, sizeof(buf), &rxLen, 0);
-        if (ret == ESP_OK) {
-            for (int i = 0; i < rxLen; i += SOC_ADC_DIGI_RESULT_BYTES) {
-                adc_digi_output_data_t *p = (adc_digi_output_data_t *)&buf[i];
-                uint16_t channel = p->type2.channel;
-                uint16_t data = p->type2.data;
-                
-                if (channel == ADC1_CHANNEL_4) {
-                    voltage_sum[0] += data * 3.3f / 4095.0f;
-                } else if (channel == ADC1_CHANNEL_5) {
-                    voltage_sum[1] += data * 3.3f / 4095.0f;
+        size_t n_ready = 0;
+        int64_t dma_time_us;
+        uint32_t t0;
+        if (mode == ACQ_MODE_FULL) {
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            
+            t0 = perf_probe_begin();
+            dma_time_us = adc_conv_done_us;
+            esp_err_t ret = adc_continuous_read(adc_handle, buf, sizeof(buf), &rxLen, 0);
+            if (ret != ESP_OK) {
+                continue;   // Notificação de troca de modo, sem quadro
+            }
+            
+            // Separa o quadro por canal (cabe inteiro em codes)
+            size_t n_codes[ADC_NUM_CHANNELS] = {0};
+            adc_frame_decode_codes(&adc_decoder, buf, rxLen, code_out, ADC_FRAME_SAMPLES, n_codes);
+            
+            // Potência por ciclo da rede e médias na taxa NILM
+            n_ready = power_meter_process(&power_meter, (const uint16_t *const *)code_out, n_codes,
+                                          outputs, sizeof(outputs) / sizeof(outputs[0]));
+#if NILM_HARMONIC_FEATURES
+            current_harmonics_process(&current_harmonics, (const uint16_t *const *)code_out, n_codes);
+#endif
+        } else {
+            // Dorme até a rajada que termina no próximo ponto da grade; a CPU
+            // pode entrar em light sleep (ADC parado, nenhum lock de PM)
+            int64_t wait_us = slot_us + SAMPLE_PERIOD_US - burst_us - esp_timer_get_time();
+            if (wait_us > 0) {
+                ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(wait_us / 1000) + 1);
+                if (acq_requested != mode) {
+                    continue;
                 }
-                
-                decimation_counter++;
-                
-                // Decimação para obter 10 Hz
-                if (decimation_counter >= DECIMATION_FACTOR) {
-                    voltage[0] = voltage_sum[0] / DECIMATION_FACTOR;
-                    voltage[1] = voltage_sum[1] / DECIMATION_FACTOR;
-                    
-                    // Reset dos acumuladores
-                    voltage_sum[0] = 0;
-                    voltage_sum[1] = 0;
-                    decimation_counter = 0;
-                    
-                    New_ADC_data = pdTRUE;
-                    
-                    // Notificar a task NILM
-                    xTaskNotifyGive(nilm_task);
+            }
+            
+            // Rajada: ADC ligado até fechar uma janela de QUIET_BURST_CYCLES ciclos
+            t0 = perf_probe_begin();
+            power_meter_reset(&power_meter);
+            adc_continuous_flush_pool(adc_handle);
+            adc_continuous_start(adc_handle);
+            int64_t deadline_us = esp_timer_get_time() + 2 * burst_us;
+            while (n_ready == 0 && esp_timer_get_time() < deadline_us) {
+                if (adc_continuous_read(adc_handle, buf, sizeof(buf), &rxLen,
+                                        (uint32_t)(burst_us / 1000)) != ESP_OK) {
+                    continue;
                 }
+                size_t n_codes[ADC_NUM_CHANNELS] = {0};
+                adc_frame_decode_codes(&adc_decoder, buf, rxLen, code_out, ADC_FRAME_SAMPLES, n_codes);
+                n_ready = power_meter_process(&power_meter, (const uint16_t *const *)code_out, n_codes,
+                                              outputs, 1);
+            }
+            adc_continuous_stop(adc_handle);
+            dma_time_us = adc_conv_done_us;
+            
+            // Rajada sem janela completa: repete a última saída para manter a grade
+            if (n_ready == 0) {
+                outputs[0] = last_output;
+                n_ready = 1;
+            }
+            ulTaskNotifyTake(pdTRUE, 0);    // Descarta as notificações dos quadros lidos
+        }
+        
+        // Publica as amostras de potência e notifica a task NILM
+        for (size_t k = 0; k < n_ready; k++) {
+            slot_us = next_slot(slot_us, esp_timer_get_time());
+            sample->power = outputs[k];
+            sample->dma_time_us = dma_time_us;
+            sample->time_us = slot_us;
+#if NILM_HARMONIC_FEATURES
+            sample->harmonics = current_harmonics.latest;
+#endif
+            
+            if (frame_ring_commit(&sample_ring)) {
+                xTaskNotifyGive(nilm_task);
             }
+            sample = (nilm_sample_t *)frame_ring_write_slot(&sample_ring);
         }
+        if (n_ready > 0) {
+            last_output = outputs[n_ready - 1];
+        }
+        perf_probe_end(&perf_acq, t0);
     }
 }
 
@@ -210,49 +434,135 @@ void nilmTask(void *parameters) {
         // Aguardar nova amostra
         ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
         
-        if (New_ADC_data) {
-            New_ADC_data = pdFALSE;
+        // Drena todas as amostras pendentes e filtra como um bloco
+        float power_block[SAMPLE_RING_SLOTS];       // Potência ativa total (W)
+        float reactive_block[SAMPLE_RING_SLOTS];    // var
+        float apparent_block[SAMPLE_RING_SLOTS];    // VA
+        float pf_block[SAMPLE_RING_SLOTS];
+        float filtered_block[SAMPLE_RING_SLOTS];
+        int64_t dma_time_block[SAMPLE_RING_SLOTS];
+        int64_t time_block[SAMPLE_RING_SLOTS];
+        size_t n_block = 0;
+#if NILM_HARMONIC_FEATURES
+        static current_harmonics_snapshot_t harmonics_block[SAMPLE_RING_SLOTS];
+#endif
+#if NILM_POWER_LOG
+        uint32_t index_block[SAMPLE_RING_SLOTS];   // Índice desde o boot (conta as descartadas)
+#endif
+        
+        nilm_sample_t *sample;
+        while (n_block < SAMPLE_RING_SLOTS &&
+               (sample = (nilm_sample_t *)frame_ring_read_slot(&sample_ring)) != NULL) {
+#if NILM_POWER_LOG
+            index_block[n_block] = samples_consumed++ + frame_ring_dropped(&sample_ring);
+#endif
+            dma_time_block[n_block] = sample->dma_time_us;
+            time_block[n_block] = sample->time_us;
+#if NILM_HARMONIC_FEATURES
+            harmonics_block[n_block] = sample->harmonics;
+#endif
+            reactive_block[n_block] = sample->power.q;
+            apparent_block[n_block] = sample->power.s;
+            pf_block[n_block] = sample->power.pf;
+            power_block[n_block++] = sample->power.p;
+            frame_ring_release(&sample_ring);
+        }
+        
+        // Aplicar filtro passa-alta para detectar eventos
+        uint32_t t0 = perf_probe_begin();
+#if NILM_FILTER_FIXED_POINT
+        for (size_t k = 0; k < n_block; k++) {
+            int32_t q = apply_highpass_filter_q31(nilm_float_to_q31(power_block[k]), hp_sections);
+            filtered_block[k] = nilm_q31_to_float(q);
+        }
+#else
+        apply_highpass_filter_block(power_block, filtered_block, n_block, &hp_filter);
+#endif
+        perf_probe_end(&perf_filter, t0);
+        
+        for (size_t k = 0; k < n_block; k++) {
+            float current_power = power_block[k];
+            float filtered_power = filtered_block[k];
+            t0 = perf_probe_begin();
             
-            // Calcular potência instantânea
-            float current_power = calculate_power(voltage[0], voltage[1]);
+            // Atualizar baseline (média móvel)
+            running_stats_push(&power_stats, current_power);
+            if (running_stats_full(&power_stats)) {
+                baseline_power = running_stats_mean(&power_stats);
+            }
             
-            // Aplicar filtro passa-alta para detectar eventos
-            float filtered_power = apply_highpass_filter(current_power);
+#if NILM_POWER_LOG
+            // Histórico antes da detecção: o evento fica depois da sua amostra
+            power_log_append(&power_log, index_block[k], current_power, (uint32_t)(time_block[k] / 1000));
+#endif
             
-            // Armazenar no buffer circular
-            power_buffer[power_index] = current_power;
-            power_index = (power_index + 1) % POWER_BUFFER_SIZE;
-            if (power_index == 0) power_buffer_full = true;
+            // Detectar eventos
+#if NILM_HARMONIC_FEATURES
+            detect_events(current_power, filtered_power, time_block[k], &harmonics_block[k]);
+#else
+            detect_events(current_power, filtered_power, time_block[k], NULL);
+#endif
+            float threshold = event_detector_threshold(&detector);
             
-            // Calcular baseline (média móvel)
-            if (power_buffer_full) {
-                float sum = 0;
-                for (int i = 0; i < POWER_BUFFER_SIZE; i++) {
-                    sum += power_buffer[i];
-                }
-                baseline_power = sum / POWER_BUFFER_SIZE;
+#if NILM_ADAPTIVE_ACQ
+            // Atividade volta na hora para a taxa plena; repouso longo libera o modo econômico
+            if (acq_control_update(&acq_control, event_detector_active(&detector))) {
+                acq_requested = acq_control.mode;
+                xTaskNotifyGive(cb_task);
             }
-            
-            // Detectar eventos
-            detect_events(current_power, filtered_power);
+#endif
+#if NILM_EVENT_ONLY_MODE
+            event_stream_add_sample(current_power, reactive_block[k], apparent_block[k]);
+            event_stream_poll((uint32_t)(time_block[k] / 1000), baseline_power, threshold);
+#endif
+            perf_probe_end(&perf_detect, t0);
+            perf_stage_record(&perf_latency, (uint32_t)(esp_timer_get_time() - dma_time_block[k]));
             
             // Log periódico (a cada 10 segundos)
             static uint32_t log_counter = 0;
             if (++log_counter >= 100) {  // 100 amostras * 0.1s = 10s
                 log_counter = 0;
-                ESP_LOGI(TAG, "Power: %.1fW | Baseline: %.1fW | Filtered: %.1fW", 
-                         current_power, baseline_power, filtered_power);
+                ESP_LOGI(TAG, "Power: %.1fW %.1fvar %.1fVA PF %.2f | Baseline: %.1fW [%.1f..%.1f] | Filtered: %.1fW | Threshold: %.1fW",
+                         current_power, reactive_block[k], apparent_block[k], pf_block[k], baseline_power,
+                         running_stats_min(&power_stats), running_stats_max(&power_stats), filtered_power, threshold);
             }
         }
     }
 }
 
+// Exporta o registro de instrumentação (estágios, pilhas e filas)
+static void send_perf_record(uint32_t record_id) {
+    static perf_stage_t *const stages[] = { &perf_acq, &perf_filter, &perf_detect, &perf_latency };
+    const perf_gauge_t gauges[] = {
+        { "stk_acq",  uxTaskGetStackHighWaterMark(cb_task) },
+        { "stk_nilm", uxTaskGetStackHighWaterMark(nilm_task) },
+        { "ring_max", frame_ring_high_water(&sample_ring) },
+        { "ring_drp", frame_ring_dropped(&sample_ring) },
+        { "tx_drop",  telemetry_get_dropped() },
+        { "evt_drop", event_stream_get_dropped() },
+        { "adc_ovf",  adc_pool_overflows },
+        { "pm_drop",  power_meter.carry_dropped },
+#if NILM_ADAPTIVE_ACQ
+        { "acq_mode", acq_control.mode },
+        { "acq_sw",   acq_control.switches },
+        { "acq_qs",   (uint32_t)(acq_control_quiet_fraction(&acq_control) * 1000.0f) },   // Fração em repouso (‰)
+#endif
+        { "heap",     esp_get_free_heap_size() },
+#if NILM_POWER_LOG
+        { "plog_sec", power_log.sectors_written },
+        { "plog_err", power_log.write_errors },
+#endif
+    };
+    perf_probe_send(record_id, PERF_REPORT_MS, stages, sizeof(stages) / sizeof(stages[0]),
+                    gauges, sizeof(gauges) / sizeof(gauges[0]));
+}
+
 // Função para inicializar o ADC
 void configure_adc(adc_channel_t *channels, uint8_t numChannels) {
     // Configuração do handle
     adc_continuous_handle_cfg_t handle_config = {
-        .conv_frame_size = 256,
-        .max_store_buf_size = 1024,
+        .conv_frame_size = ADC_FRAME_BYTES,
+        .max_store_buf_size = PIPELINE_ADC_STORE_BYTES,
     };
     ESP_ERROR_CHECK(adc_continuous_new_handle(&handle_config, &adc_handle));
     
@@ -278,6 +588,7 @@ void configure_adc(adc_channel_t *channels, uint8_t numChannels) {
     // Configuração do callback
     adc_continuous_evt_cbs_t cb_config = {
         .on_conv_done = callback,
+        .on_pool_ovf = pool_ovf_callback,
     };
     ESP_ERROR_CHECK(adc_continuous_register_event_callbacks(adc_handle, &cb_config, NULL));
 }
@@ -285,28 +596,171 @@ void configure_adc(adc_channel_t *channels, uint8_t numChannels) {
 // Função principal
 void app_main(void) {
     ESP_LOGI(TAG, "=== NILM Event Detector Starting ===");
-    ESP_LOGI(TAG, "Filter: Butterworth 6th order High-Pass, fc = 0.002 Hz");
+    ESP_LOGI(TAG, "Filter: %s, fc = 0.002 Hz", (NILM_HP_STRUCTURE == NILM_HP_MULTIRATE)
+             ? "multirate baseline subtraction (6th order Low-Pass at 0.1 Hz)" : "Butterworth 6th order High-Pass");
     ESP_LOGI(TAG, "Sample Rate: %.1f Hz", SAMPLE_RATE_HZ);
-    ESP_LOGI(TAG, "Event Threshold: %.1f W", EVENT_THRESHOLD);
+    ESP_LOGI(TAG, "Event Threshold: max(%.1f W, %.1f sigma)", NILM_EVENT_THRESHOLD, NILM_EVENT_SIGMA_K);
+    event_detector_config_t detector_config = EVENT_DETECTOR_DEFAULT_CONFIG;
+    detector_config.kind = (event_detector_kind_t)NILM_DETECTOR;
+    event_detector_init(&detector, &detector_config);
+#if NILM_DETECTOR == NILM_DETECTOR_CHANGEPOINT
+    ESP_LOGI(TAG, "Detector: two-sided CUSUM (h = %.1f sigma), settle %lu samples, no debounce",
+             detector.change.config.threshold_sigma, detector.change.config.settle_samples);
+#else
+    ESP_LOGI(TAG, "Detector: |high-pass| > threshold, debounce %d ms (%lu samples)",
+             NILM_DEBOUNCE_TIME_MS, detector.config.debounce_samples);
+#endif
+    
+    // Inicializar seções do filtro
+#if NILM_FILTER_FIXED_POINT
+    init_filter_sections_q31(hp_sections, NULL);
     
-    // Inicializar estados do filtro
-    memset(filter_states, 0, sizeof(filter_states));
+    // Caminho Q31 fora do limite de arredondamento: não inicia o detector com ele
+    float q31_bound;
+    float q31_error = nilm_q31_validate(&q31_bound);
+    if (!(q31_error <= q31_bound)) {
+        ESP_LOGE(TAG, "Fixed-point Q31 filter: max error vs double %.3g W exceeds rounding bound %.3g W; rebuild with NILM_FILTER_FIXED_POINT=0",
+                 q31_error, q31_bound);
+        abort();
+    }
+    ESP_LOGI(TAG, "Fixed-point Q31 filter: max error vs double %.3g W (bound %.3g W)", q31_error, q31_bound);
+#else
+    init_filter_sections(&hp_filter, NULL, NILM_HP_STRUCTURE);
+#endif
+    nilm_filters_init();
     
-    // Criar tasks
-    xTaskCreate(cbTask, "ADC Callback Task", 4096, NULL, 5, &cb_task);
-    xTaskCreate(nilmTask, "NILM Processing Task", 8192, NULL, 4, &nilm_task);
+    // Janela do baseline
+    running_stats_init(&power_stats, power_buffer, power_min_deque, power_max_deque, POWER_BUFFER_SIZE);
+    
+    // Demux e calibração do eFuse por canal (sem ela, 3.3/4095 nominal)
+    uint8_t pattern_channels[ADC_NUM_CHANNELS];
+    for (int ch = 0; ch < ADC_NUM_CHANNELS; ch++) {
+        pattern_channels[ch] = (uint8_t)channels[ch];
+    }
+    adc_frame_decoder_init(&adc_decoder, pattern_channels, ADC_NUM_CHANNELS);
+    for (int ch = 0; ch < ADC_NUM_CHANNELS; ch++) {
+        esp_err_t cal_ret = adc_frame_calibrate(&adc_decoder, ch, ADC_UNIT_1, ADC_ATTEN_DB_12, ADC_BITWIDTH_12, NULL);
+        if (cal_ret == ESP_OK) {
+            ESP_LOGI(TAG, "ADC channel %d calibration (eFuse): %.4f mV/code, offset %.1f mV",
+                     channels[ch], adc_decoder.gain[ch] * 1e3f, adc_decoder.offset[ch] * 1e3f);
+        } else {
+            ESP_LOGW(TAG, "ADC channel %d calibration unavailable (%s), using nominal 3.3/4095",
+                     channels[ch], esp_err_to_name(cal_ret));
+        }
+    }
+    
+    // Medidor de potência (ganho por código = calibração do canal × escala do sensor)
+    power_meter_config_t pm_config = {
+        .n_phases = NILM_PHASES,
+        .sample_rate_hz = (float)ADC_SAMPLE_RATE_HZ / ADC_NUM_CHANNELS,
+        .mains_hz = MAINS_FREQ_HZ,
+        .output_rate_hz = SAMPLE_RATE_HZ,
+        .v_min_rms = 10.0f,
+        .i_skew = 1.0f / ADC_NUM_CHANNELS,     // channels[]: I de cada fase no slot seguinte ao de V
+        .cic_fir = NILM_CYCLE_CIC_FIR,
+    };
+    for (int p = 0; p < NILM_PHASES; p++) {
+        pm_config.v_gain[p] = adc_decoder.gain[2 * p] * VOLTAGE_SENSOR_SCALE;
+        pm_config.i_gain[p] = adc_decoder.gain[2 * p + 1] * CURRENT_SENSOR_SCALE;
+    }
+    power_meter_init(&power_meter, &pm_config);
+    if (power_meter.decimate) {
+        ESP_LOGI(TAG, "Power meter: %d phase(s), %.0f Hz per channel, per-cycle P/Q/S decimated to %.1f Hz by CIC (R=%lu) + FIR + %u half-band(s), delay %.2f s",
+                 NILM_PHASES, pm_config.sample_rate_hz, SAMPLE_RATE_HZ, power_meter.decim_config.cic_decimation,
+                 power_meter.decim_config.n_halfbands,
+                 decimator_group_delay(&power_meter.decim_config) / pm_config.sample_rate_hz);
+    } else {
+        ESP_LOGI(TAG, "Power meter: %d phase(s), %.0f Hz per channel, per-cycle P/Q/S averaged to %.1f Hz",
+                 NILM_PHASES, pm_config.sample_rate_hz, SAMPLE_RATE_HZ);
+    }
+    
+#if NILM_HARMONIC_FEATURES
+    // Harmônicas da corrente; o retrato é atrasado como a potência decimada
+    current_harmonics_init(&current_harmonics, NILM_PHASES, pm_config.sample_rate_hz, MAINS_FREQ_HZ);
+    if (power_meter.decimate) {
+        float delay_s = decimator_group_delay(&power_meter.decim_config) / pm_config.sample_rate_hz;
+        harmonic_delay = (uint32_t)lroundf(delay_s * SAMPLE_RATE_HZ);
+        if (harmonic_delay >= HARMONIC_DELAY_SLOTS) {
+            harmonic_delay = HARMONIC_DELAY_SLOTS - 1;
+        }
+    }
+    ESP_LOGI(TAG, "Current harmonics: 1-%lu over %d-cycle windows, aligned %lu samples back",
+             current_harmonics.i_bank.n_harmonics, CURRENT_HARMONICS_CYCLES, harmonic_delay);
+#endif
+    
+#if NILM_ADAPTIVE_ACQ
+    // Aquisição adaptativa e light sleep automático (ADC parado entre as rajadas)
+    acq_control_init(&acq_control, NULL);
+    ESP_LOGI(TAG, "Adaptive acquisition: quiet after %.0f s idle, %d-cycle bursts every %.0f ms",
+             acq_control.config.quiet_after / SAMPLE_RATE_HZ, QUIET_BURST_CYCLES, 1000.0f / SAMPLE_RATE_HZ);
+#if CONFIG_PM_ENABLE
+    esp_pm_config_t pm_sleep = {
+        .max_freq_mhz = CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ,
+        .min_freq_mhz = 40,     // XTAL
+#if CONFIG_FREERTOS_USE_TICKLESS_IDLE
+        .light_sleep_enable = true,
+#endif
+    };
+    esp_err_t pm_ret = esp_pm_configure(&pm_sleep);
+    if (pm_ret != ESP_OK) {
+        ESP_LOGW(TAG, "Power management unavailable (%s)", esp_err_to_name(pm_ret));
+    }
+#else
+    ESP_LOGW(TAG, "CONFIG_PM_ENABLE off: quiet mode stops the ADC but the CPU does not light-sleep");
+#endif
+#endif
+    
+    // Telemetria binária (registros de instrumentação e lotes de eventos)
+    ESP_ERROR_CHECK(telemetry_init());
+    event_stream_init((uint32_t)(esp_timer_get_time() / 1000));   // Mesmo relógio de time_us
+    
+#if NILM_POWER_LOG
+    // Histórico em flash (continua do último setor gravado, com novo boot_id)
+    esp_err_t log_ret = power_log_init(&power_log);
+    if (log_ret == ESP_OK) {
+        ESP_LOGI(TAG, "Power log: %lu sectors (%.1f h at 10 Hz), boot %lu", power_log.n_sectors,
+                 power_log.n_sectors * ((POWER_LOG_SECTOR_SIZE - sizeof(power_log_sector_header_t)) / 4)
+                     * (POWER_LOG_SAMPLE_PERIOD_MS / 1000.0f) / 3600.0f,
+                 power_log.boot_id);
+    } else {
+        ESP_LOGW(TAG, "Power log disabled (%s): flash with partitions.csv", esp_err_to_name(log_ret));
+    }
+#endif
+    
+    // Buffer de amostras entre aquisição e task NILM
+    frame_ring_init(&sample_ring, sample_slots, sizeof(sample_slots[0]), SAMPLE_RING_SLOTS);
+    
+    // Criar tasks (aquisição/decimação e processamento em núcleos distintos)
+    xTaskCreatePinnedToCore(cbTask, "ADC Callback Task", PIPELINE_ACQ_STACK, NULL,
+                            PIPELINE_ACQ_PRIORITY, &cb_task, PIPELINE_ACQ_CORE);
+    xTaskCreatePinnedToCore(nilmTask, "NILM Processing Task", PIPELINE_DSP_STACK, NULL,
+                            PIPELINE_DSP_PRIORITY, &nilm_task, PIPELINE_DSP_CORE);
     
     // Configurar e iniciar ADC
-    configure_adc(channels, 2);
+    configure_adc(channels, ADC_NUM_CHANNELS);
     ESP_ERROR_CHECK(adc_continuous_start(adc_handle));
     
     ESP_LOGI(TAG, "System initialized successfully!");
     
+#if NILM_EVENT_ONLY_MODE
+    // Daqui em diante só quadros binários (logs de status somente se WARN ou pior)
+    ESP_LOGI(TAG, "Event-only mode: batches of %d events or every %d ms, power summary every %d ms",
+             EVENT_STREAM_BATCH, EVENT_STREAM_FLUSH_MS, EVENT_STREAM_SUMMARY_MS);
+    esp_log_level_set(TAG, ESP_LOG_WARN);
+#endif
+    
     // Loop principal - monitoramento do sistema
+    uint32_t perf_record_id = 0;
     while (1) {
-        vTaskDelay(pdMS_TO_TICKS(10000));  // 10 segundos
+        vTaskDelay(pdMS_TO_TICKS(PERF_REPORT_MS));  // 10 segundos
         
         // Log de status do sistema
         ESP_LOGI(TAG, "System running... Free heap: %lu bytes", esp_get_free_heap_size());
+        ESP_LOGI(TAG, "Samples dropped (overrun): %lu", frame_ring_dropped(&sample_ring));
+        ESP_LOGI(TAG, "Pipeline depth: ADC pool overflows %lu | sample ring max %lu/%d",
+                 adc_pool_overflows, frame_ring_high_water(&sample_ring), SAMPLE_RING_SLOTS - 1);
+        
+        // Registro de instrumentação para o host
+        send_perf_record(++perf_record_id);
     }
 }
\ No newline at end of file
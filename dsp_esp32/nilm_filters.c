@@ -7,6 +7,12 @@
 #include <math.h>
 #include <string.h>
 
+#if NILM_FILTERS_USE_ESP_DSP
+#include "esp_dsp.h"
+#endif
+
+#define Q31_LIMIT   ((int32_t)1 << 30)      // ±0.5 em Q31 (NILM_Q31_MAX_INPUT_W): entradas e saídas das seções
+
 /**
  * @brief Aplica uma seção biquad usando Direct Form II Transposed
  * 
@@ -17,29 +23,98 @@
  * @return Amostra filtrada de saída
  */
 float apply_biquad_section(float input, biquad_section_t *section) {
+#if NILM_FILTERS_USE_ESP_DSP
+    // Direct Form II (mesma forma e estados de dsps_biquad_f32)
+    float w0 = input - section->a1 * section->w1 - section->a2 * section->w2;
+    float output = section->b0 * w0 + section->b1 * section->w1 + section->b2 * section->w2;
+    
+    section->w2 = section->w1;
+    section->w1 = w0;
+#else
     // Direct Form II Transposed
     float output = section->b0 * input + section->w1;
     
     // Atualiza estados internos
     section->w1 = section->b1 * input - section->a1 * output + section->w2;
     section->w2 = section->b2 * input - section->a2 * output;
+#endif
     
     return output;
 }
 
 /**
- * @brief Aplica o filtro passa-alta completo (cascata de seções biquad)
+ * @brief Aplica uma seção biquad a um bloco de amostras
+ * 
+ * Coeficientes e estados ficam em variáveis locais (registradores) durante
+ * todo o bloco e são gravados de volta apenas no final. Pode operar no
+ * próprio buffer (input == output).
+ * 
+ * @param input Bloco de entrada
+ * @param output Bloco de saída
+ * @param n Número de amostras
+ * @param section Ponteiro para a estrutura da seção biquad
+ */
+void apply_biquad_section_block(const float *input, float *output, size_t n, biquad_section_t *section) {
+#if NILM_FILTERS_USE_ESP_DSP
+    // Layout de biquad_section_t: b0, b1, b2, a1, a2 seguidos de w1, w2
+    dsps_biquad_f32(input, output, (int)n, &section->b0, &section->w1);
+#else
+    const float b0 = section->b0, b1 = section->b1, b2 = section->b2;
+    const float a1 = section->a1, a2 = section->a2;
+    float w1 = section->w1, w2 = section->w2;
+    
+    for (size_t i = 0; i < n; i++) {
+        float x = input[i];
+        float y = b0 * x + w1;
+        w1 = b1 * x - a1 * y + w2;
+        w2 = b2 * x - a2 * y;
+        output[i] = y;
+    }
+    
+    section->w1 = w1;
+    section->w2 = w2;
+#endif
+}
+
+/**
+ * @brief Fecha um bloco da estrutura multitaxa: filtra a média e reinicia a interpolação
+ *
+ * O baseline segue em linha reta do valor atual até a nova saída do
+ * passa-baixa ao longo do próximo bloco, sem acumular erro entre blocos.
+ */
+static void multirate_update_baseline(nilm_highpass_t *hp) {
+    float target = hp->accumulator * (1.0f / HP_MULTIRATE_DECIMATION);
+    for (int i = 0; i < HP_FILTER_SECTIONS; i++) {
+        target = apply_biquad_section(target, &hp->sections[i]);
+    }
+    hp->baseline_step = (target - hp->baseline) * (1.0f / HP_MULTIRATE_DECIMATION);
+    hp->accumulator = 0.0f;
+    hp->phase = 0;
+}
+
+/**
+ * @brief Aplica o filtro passa-alta do detector
  * 
  * @param input Amostra de entrada
- * @param sections Array de seções biquad
+ * @param hp Estado do passa-alta (estrutura escolhida em init_filter_sections)
  * @return Amostra filtrada de saída
  */
-float apply_highpass_filter(float input, biquad_section_t sections[HP_FILTER_SECTIONS]) {
+float apply_highpass_filter(float input, nilm_highpass_t *hp) {
+    if (hp->structure == NILM_HP_MULTIRATE) {
+        float output = input - hp->baseline;
+        hp->baseline += hp->baseline_step;
+        hp->accumulator += input;
+        if (++hp->phase == HP_MULTIRATE_DECIMATION) {
+            multirate_update_baseline(hp);
+        }
+        return output;
+    }
+    
     float output = input;
     
     // Aplica cada seção em cascata
     for (int i = 0; i < HP_FILTER_SECTIONS; i++) {
-        output = apply_biquad_section(output, &sections[i]);
+        output = apply_biquad_section(output, &hp->sections[i]);
     }
     
     return output;
@@ -56,61 +131,798 @@ float apply_lowpass_filter(float input, biquad_section_t *section) {
     return apply_biquad_section(input, section);
 }
 
+/**
+ * @brief Aplica o filtro passa-alta do detector a um bloco de amostras
+ * 
+ * Direta: cada seção percorre o bloco inteiro antes da próxima (a saída de
+ * uma seção é filtrada no próprio buffer pela seguinte). Multitaxa: trechos
+ * até cada fronteira de bloco decimado com o estado em variáveis locais.
+ * Idêntico bit a bit a apply_highpass_filter() amostra a amostra.
+ * 
+ * @param input Bloco de entrada
+ * @param output Bloco de saída (pode ser igual a input)
+ * @param n Número de amostras
+ * @param hp Estado do passa-alta
+ */
+void apply_highpass_filter_block(const float *input, float *output, size_t n, nilm_highpass_t *hp) {
+    if (hp->structure == NILM_HP_MULTIRATE) {
+        size_t k = 0;
+        while (k < n) {
+            size_t run = HP_MULTIRATE_DECIMATION - hp->phase;
+            if (run > n - k) {
+                run = n - k;
+            }
+            
+            float baseline = hp->baseline, step = hp->baseline_step, acc = hp->accumulator;
+            for (size_t j = k; j < k + run; j++) {
+                float x = input[j];
+                output[j] = x - baseline;
+                baseline += step;
+                acc += x;
+            }
+            hp->baseline = baseline;
+            hp->accumulator = acc;
+            hp->phase += run;
+            k += run;
+            
+            if (hp->phase == HP_MULTIRATE_DECIMATION) {
+                multirate_update_baseline(hp);
+            }
+        }
+        return;
+    }
+    
+    apply_biquad_section_block(input, output, n, &hp->sections[0]);
+    
+    for (int i = 1; i < HP_FILTER_SECTIONS; i++) {
+        apply_biquad_section_block(output, output, n, &hp->sections[i]);
+    }
+}
+
+/**
+ * @brief Aplica o filtro passa-baixa a um bloco de amostras
+ * 
+ * @param input Bloco de entrada
+ * @param output Bloco de saída (pode ser igual a input)
+ * @param n Número de amostras
+ * @param section Ponteiro para a seção biquad do filtro passa-baixa
+ */
+void apply_lowpass_filter_block(const float *input, float *output, size_t n, biquad_section_t *section) {
+    apply_biquad_section_block(input, output, n, section);
+}
+
+/**
+ * @brief Inicializa uma seção biquad a partir de [b0, b1, b2, a1, a2]
+ * 
+ * Mesmo layout de coeficientes usado por dsps_biquad_gen_*_f32.
+ * 
+ * @param section Seção a inicializar (estados zerados)
+ * @param coeffs Coeficientes [b0, b1, b2, a1, a2]
+ */
+void init_biquad_section(biquad_section_t *section, const float coeffs[5]) {
+    section->b0 = coeffs[0];
+    section->b1 = coeffs[1];
+    section->b2 = coeffs[2];
+    section->a1 = coeffs[3];
+    section->a2 = coeffs[4];
+    section->w1 = 0.0f;
+    section->w2 = 0.0f;
+}
+
 /**
  * @brief Inicializa as seções de filtro com os coeficientes pré-calculados
  * 
- * @param sections Array de seções para o filtro passa-alta
+ * @param hp Passa-alta do detector
  * @param lp_section Ponteiro para a seção do filtro passa-baixa
+ * @param structure NILM_HP_DIRECT ou NILM_HP_MULTIRATE
  */
-void init_filter_sections(biquad_section_t sections[HP_FILTER_SECTIONS], biquad_section_t *lp_section) {
-    // Inicializa seções do filtro passa-alta
+void init_filter_sections(nilm_highpass_t *hp, biquad_section_t *lp_section, nilm_hp_structure_t structure) {
+    // Inicializa seções do filtro passa-alta (ou do passa-baixa decimado)
+    hp->structure = structure;
     for (int i = 0; i < HP_FILTER_SECTIONS; i++) {
-        sections[i].b0 = hp_filter_coeffs[i][0];
-        sections[i].b1 = hp_filter_coeffs[i][1];
-        sections[i].b2 = hp_filter_coeffs[i][2];
-        sections[i].a1 = hp_filter_coeffs[i][3];
-        sections[i].a2 = hp_filter_coeffs[i][4];
-        sections[i].w1 = 0.0f;
-        sections[i].w2 = 0.0f;
+        init_biquad_section(&hp->sections[i], (structure == NILM_HP_MULTIRATE) ? hp_multirate_lp_coeffs[i]
+                                                                              : hp_filter_coeffs[i]);
     }
+    hp->accumulator = 0.0f;
+    hp->phase = 0;
+    hp->baseline = 0.0f;
+    hp->baseline_step = 0.0f;
     
     // Inicializa seção do filtro passa-baixa
     if (lp_section != NULL) {
-        lp_section->b0 = lp_filter_coeffs[0];
-        lp_section->b1 = lp_filter_coeffs[1];
-        lp_section->b2 = lp_filter_coeffs[2];
-        lp_section->a1 = lp_filter_coeffs[3];
-        lp_section->a2 = lp_filter_coeffs[4];
-        lp_section->w1 = 0.0f;
-        lp_section->w2 = 0.0f;
+        init_biquad_section(lp_section, lp_filter_coeffs);
     }
 }
 
 /**
- * @brief Classifica o tipo de dispositivo baseado na variação de potência
+ * @brief Converte potência (W) para Q31, saturando em NILM_Q31_MAX_INPUT_W
  * 
- * @param delta_power Variação de potência em Watts
- * @return Tipo de dispositivo classificado
+ * @param watts Potência em Watts
+ * @return Valor Q31 (1.0 = NILM_Q31_FULL_SCALE_W)
  */
-device_type_t classify_device_by_power(float delta_power) {
-    float abs_power = fabsf(delta_power);
+int32_t nilm_float_to_q31(float watts) {
+    if (watts > NILM_Q31_MAX_INPUT_W) watts = NILM_Q31_MAX_INPUT_W;
+    if (watts < -NILM_Q31_MAX_INPUT_W) watts = -NILM_Q31_MAX_INPUT_W;
+    return (int32_t)lrintf(watts * (2147483648.0f / NILM_Q31_FULL_SCALE_W));
+}
+
+/**
+ * @brief Converte Q31 para potência (W)
+ */
+float nilm_q31_to_float(int32_t value) {
+    return (float)value * (NILM_Q31_FULL_SCALE_W / 2147483648.0f);
+}
+
+/**
+ * @brief Converte coeficientes [b0, b1, b2, a1, a2] em float para Q30
+ * 
+ * Usado com as tabelas hp_filter_coeffs/lp_filter_coeffs. Os estados da
+ * seção são zerados.
+ * 
+ * @param coeffs Coeficientes em float
+ * @param section Seção em ponto fixo
+ */
+void nilm_coeffs_to_q30(const float coeffs[5], biquad_section_q31_t *section) {
+    int32_t q[5];
+    for (int i = 0; i < 5; i++) {
+        double scaled = (double)coeffs[i] * 1073741824.0;
+        if (scaled > 2147483647.0) scaled = 2147483647.0;
+        if (scaled < -2147483648.0) scaled = -2147483648.0;
+        q[i] = (int32_t)llrint(scaled);
+    }
+    
+    section->b0 = q[0];
+    section->b1 = q[1];
+    section->b2 = q[2];
+    section->a1 = q[3];
+    section->a2 = q[4];
+    section->x1 = section->x2 = 0;
+    section->y1 = section->y2 = 0;
+    section->e1 = section->e2 = 0;
+}
+
+/**
+ * @brief Inicializa as seções Q31 a partir das tabelas em float
+ * 
+ * @param sections Array de seções para o filtro passa-alta
+ * @param lp_section Ponteiro para a seção do filtro passa-baixa (pode ser NULL)
+ */
+void init_filter_sections_q31(biquad_section_q31_t sections[HP_FILTER_SECTIONS], biquad_section_q31_t *lp_section) {
+    for (int i = 0; i < HP_FILTER_SECTIONS; i++) {
+        nilm_coeffs_to_q30(hp_filter_coeffs[i], &sections[i]);
+    }
+    
+    if (lp_section != NULL) {
+        nilm_coeffs_to_q30(lp_filter_coeffs, lp_section);
+    }
+}
+
+/**
+ * @brief Aplica uma seção biquad Q31 (DF-I com realimentação de erro)
+ * 
+ * acc (Q61) = b·x - a·y + 2·e[n-1] - e[n-2]; y = acc >> 30 (Q31).
+ * 
+ * A entrada e a saída são saturadas em ±0.5 (Q31_LIMIT): nilm_float_to_q31
+ * já limita a entrada, mas o sobressinal do passa-alta em degraus grandes
+ * pode levar a saída de uma seção (entrada da seguinte) além disso. Com
+ * |x|, |y| <= 0.5 e Σ|b| <= 4, Σ|a| <= 3 em Q30, |acc| < 1.75·2^62 e o
+ * acumulador de 64 bits não transborda. Na saturação o resíduo deixa de
+ * estar em [0, 2^30) e a realimentação de erro é reiniciada.
+ * 
+ * @param input Amostra de entrada Q31
+ * @param section Seção em ponto fixo
+ * @return Amostra de saída Q31
+ */
+int32_t apply_biquad_section_q31(int32_t input, biquad_section_q31_t *section) {
+    if (input > Q31_LIMIT) input = Q31_LIMIT;
+    if (input < -Q31_LIMIT) input = -Q31_LIMIT;
+    
+    int64_t acc = (int64_t)section->b0 * input
+                + (int64_t)section->b1 * section->x1
+                + (int64_t)section->b2 * section->x2
+                - (int64_t)section->a1 * section->y1
+                - (int64_t)section->a2 * section->y2
+                + 2 * section->e1 - section->e2;
+    
+    int64_t y = acc >> 30;
+    if (y > Q31_LIMIT || y < -Q31_LIMIT) {
+        y = (y > 0) ? Q31_LIMIT : -Q31_LIMIT;
+        section->e1 = section->e2 = 0;
+    } else {
+        // Resíduo descartado na redução (0 <= e < 2^30)
+        section->e2 = section->e1;
+        section->e1 = acc - y * ((int64_t)1 << 30);
+    }
+    
+    section->x2 = section->x1;
+    section->x1 = input;
+    section->y2 = section->y1;
+    section->y1 = (int32_t)y;
+    
+    return (int32_t)y;
+}
+
+/**
+ * @brief Aplica o filtro passa-alta Q31 completo (cascata de seções)
+ */
+int32_t apply_highpass_filter_q31(int32_t input, biquad_section_q31_t sections[HP_FILTER_SECTIONS]) {
+    int32_t output = input;
+    
+    for (int i = 0; i < HP_FILTER_SECTIONS; i++) {
+        output = apply_biquad_section_q31(output, &sections[i]);
+    }
+    
+    return output;
+}
+
+/**
+ * @brief Aplica o filtro passa-baixa Q31
+ */
+int32_t apply_lowpass_filter_q31(int32_t input, biquad_section_q31_t *section) {
+    return apply_biquad_section_q31(input, section);
+}
+
+/**
+ * @brief Seção DF-I em double com os coeficientes Q30 de uma seção Q31
+ * 
+ * @param x Entrada (LSB de Q31)
+ * @param b Numerador [b0, b1, b2]
+ * @param section Seção Q31 de onde vêm a1 e a2
+ * @param state Estados [x1, x2, y1, y2]
+ * @return Saída (LSB de Q31)
+ */
+static double q31_reference_section(double x, const double b[3], const biquad_section_q31_t *section,
+                                    double state[4]) {
+    const double a1 = section->a1 / 1073741824.0;
+    const double a2 = section->a2 / 1073741824.0;
+    double y = b[0] * x + b[1] * state[0] + b[2] * state[1] - a1 * state[2] - a2 * state[3];
+    state[1] = state[0];
+    state[0] = x;
+    state[3] = state[2];
+    state[2] = y;
+    return y;
+}
+
+/**
+ * @brief Aplica as seções [first, HP_FILTER_SECTIONS) em double
+ */
+static double q31_reference_cascade(double x, const biquad_section_q31_t sections[HP_FILTER_SECTIONS],
+                                    double state[HP_FILTER_SECTIONS][4], int first) {
+    for (int s = first; s < HP_FILTER_SECTIONS; s++) {
+        const double b[3] = {
+            sections[s].b0 / 1073741824.0,
+            sections[s].b1 / 1073741824.0,
+            sections[s].b2 / 1073741824.0,
+        };
+        x = q31_reference_section(x, b, &sections[s], state[s]);
+    }
+    return x;
+}
+
+/**
+ * @brief Limite do erro de arredondamento do caminho Q31 (W)
+ * 
+ * Na seção s, y·2^30 = acc - e[n] com o resíduo e[n] em [0, 2^30), e acc
+ * soma 2e[n-1] - e[n-2]. Contra a mesma seção sem arredondamento, o erro
+ * de saída é então ε = -(1 - z^-1)^2 / A_s(z) · e/2^30, com e/2^30 em
+ * [0, 1) LSB, e atravessa as seções s+1.. seguintes. Sendo g_s a resposta
+ * ao impulso desse caminho, |ε_s| <= ||g_s||_1 LSB, e o limite total é
+ * Σ_s ||g_s||_1 LSB. Vale enquanto nenhuma seção satura (a saturação
+ * reinicia a realimentação).
+ * 
+ * As normas são somadas em NILM_Q31_NORM_SAMPLES amostras; o polo mais
+ * lento do passa-alta de 0.002 Hz decai com constante de ~3000 amostras
+ * e a cauda que fica de fora é desprezível. São ~1.3 M avaliações de
+ * seção em double, feitas uma vez na partida.
+ * 
+ * @param sections Seções Q31 (só os coeficientes são usados)
+ * @return Limite do erro absoluto da saída do passa-alta (W)
+ */
+float nilm_q31_error_bound(const biquad_section_q31_t sections[HP_FILTER_SECTIONS]) {
+    static const double shaping[3] = { 1.0, -2.0, 1.0 };    // (1 - z^-1)^2
+    double l1 = 0.0;
     
-    // Busca na tabela de dispositivos
-    for (int i = 0; i < DEVICE_TABLE_SIZE; i++) {
-        if (abs_power >= device_table[i].min_power && 
-            abs_power <= device_table[i].max_power) {
-            return device_table[i].type;
+    for (int s = 0; s < HP_FILTER_SECTIONS; s++) {
+        double noise_state[4] = {0};
+        double state[HP_FILTER_SECTIONS][4] = {{0}};
+        for (int n = 0; n < NILM_Q31_NORM_SAMPLES; n++) {
+            double g = q31_reference_section((n == 0) ? 1.0 : 0.0, shaping, &sections[s], noise_state);
+            l1 += fabs(q31_reference_cascade(g, sections, state, s + 1));
         }
     }
     
+    return (float)(l1 * (NILM_Q31_FULL_SCALE_W / 2147483648.0));
+}
+
+/**
+ * @brief Valida o caminho Q31 contra uma referência em double
+ * 
+ * Estímulo determinístico de 20 minutos a 10 Hz: base de 300 W com ruído,
+ * degraus de liga/desliga (60 W a 2 kW) e um ciclo de compressor. A
+ * referência é a mesma cascata DF-I avaliada em double, com os
+ * coeficientes Q30 e a entrada já quantizada em Q31; a única diferença
+ * entre os dois caminhos é o arredondamento interno das seções, limitado
+ * por nilm_q31_error_bound().
+ * 
+ * @param bound Se não for NULL, recebe nilm_q31_error_bound() (W)
+ * @return Maior diferença absoluta entre as saídas do passa-alta (W);
+ *         deve ficar abaixo de *bound
+ */
+float nilm_q31_validate(float *bound) {
+    biquad_section_q31_t fix[HP_FILTER_SECTIONS];
+    double state[HP_FILTER_SECTIONS][4] = {{0}};
+    init_filter_sections_q31(fix, NULL);
+    
+    uint32_t lcg = 12345u;
+    double max_error = 0.0;
+    
+    for (int n = 0; n < 12000; n++) {
+        float t = n / (float)NILM_SAMPLE_RATE_HZ;
+        float power = 300.0f;
+        if (t >= 60.0f && t < 400.0f) power += 2000.0f;     // Aquecedor
+        if (t >= 200.0f && t < 900.0f) power += 60.0f;      // Lâmpada
+        if (fmodf(t, 300.0f) < 120.0f) power += 150.0f;     // Geladeira
+        
+        lcg = lcg * 1664525u + 1013904223u;
+        power += ((float)(lcg >> 8) / 16777216.0f - 0.5f) * 4.0f;
+        
+        int32_t x = nilm_float_to_q31(power);
+        double y_ref = q31_reference_cascade((double)x, fix, state, 0);
+        int32_t y_fix = apply_highpass_filter_q31(x, fix);
+        
+        double err = fabs(y_ref - (double)y_fix);
+        if (err > max_error) max_error = err;
+    }
+    
+    if (bound != NULL) {
+        *bound = nilm_q31_error_bound(fix);
+    }
+    return (float)(max_error * (NILM_Q31_FULL_SCALE_W / 2147483648.0));
+}
+
+/**
+ * @brief Inicializa o banco de filtros multi-circuito com hp_filter_coeffs
+ * 
+ * @param bank Banco de filtros
+ * @param n_channels Número de circuitos (limitado a NILM_BANK_MAX_CHANNELS)
+ */
+void nilm_filter_bank_init(nilm_filter_bank_t *bank, uint32_t n_channels) {
+    for (int s = 0; s < HP_FILTER_SECTIONS; s++) {
+        bank->b0[s] = hp_filter_coeffs[s][0];
+        bank->b1[s] = hp_filter_coeffs[s][1];
+        bank->b2[s] = hp_filter_coeffs[s][2];
+        bank->a1[s] = hp_filter_coeffs[s][3];
+        bank->a2[s] = hp_filter_coeffs[s][4];
+    }
+    
+    bank->n_channels = (n_channels > NILM_BANK_MAX_CHANNELS) ? NILM_BANK_MAX_CHANNELS : n_channels;
+    nilm_filter_bank_reset(bank);
+}
+
+/**
+ * @brief Zera os estados de todos os canais do banco
+ * 
+ * @param bank Banco de filtros
+ */
+void nilm_filter_bank_reset(nilm_filter_bank_t *bank) {
+    memset(bank->w1, 0, sizeof(bank->w1));
+    memset(bank->w2, 0, sizeof(bank->w2));
+}
+
+/**
+ * @brief Processa uma amostra de todos os circuitos do banco
+ * 
+ * A cascata é percorrida seção a seção; dentro de cada seção os
+ * coeficientes ficam em registradores e o laço sobre os canais não tem
+ * dependência entre iterações. A forma e a ordem das operações são as de
+ * apply_biquad_section() (DF-II com NILM_FILTERS_USE_ESP_DSP, DF-II
+ * transposta sem), então cada canal dá a mesma saída da cascata escalar.
+ * 
+ * @param bank Banco de filtros
+ * @param input Uma amostra por canal (n_channels valores)
+ * @param output Saída por canal (pode ser igual a input)
+ */
+void nilm_filter_bank_process(nilm_filter_bank_t *bank, const float *input, float *output) {
+    const uint32_t n = bank->n_channels;
+    
+    for (int s = 0; s < HP_FILTER_SECTIONS; s++) {
+        const float b0 = bank->b0[s], b1 = bank->b1[s], b2 = bank->b2[s];
+        const float a1 = bank->a1[s], a2 = bank->a2[s];
+        float *restrict w1 = bank->w1[s];
+        float *restrict w2 = bank->w2[s];
+        const float *x = (s == 0) ? input : output;
+        
+        for (uint32_t c = 0; c < n; c++) {
+            float xc = x[c];
+#if NILM_FILTERS_USE_ESP_DSP
+            float w0 = xc - a1 * w1[c] - a2 * w2[c];
+            float y = b0 * w0 + b1 * w1[c] + b2 * w2[c];
+            w2[c] = w1[c];
+            w1[c] = w0;
+#else
+            float y = b0 * xc + w1[c];
+            w1[c] = b1 * xc - a1 * y + w2[c];
+            w2[c] = b2 * xc - a2 * y;
+#endif
+            output[c] = y;
+        }
+    }
+}
+
+/**
+ * @brief Compara o banco com a cascata escalar (apply_biquad_section) em todos os canais
+ * 
+ * Cada canal recebe um perfil de carga próprio (degraus com escala e
+ * fase diferentes, mais ruído), filtrado pelo banco e por uma cascata de
+ * biquad_section_t com os mesmos coeficientes, ambos a partir do repouso.
+ * 
+ * @return Maior diferença absoluta entre as saídas (W); deve ficar abaixo
+ *         de NILM_BANK_MAX_ERROR_W (só arredondamento)
+ */
+float nilm_filter_bank_validate(void) {
+    static nilm_filter_bank_t bank;
+    biquad_section_t ref[NILM_BANK_MAX_CHANNELS][HP_FILTER_SECTIONS];
+    float input[NILM_BANK_MAX_CHANNELS], output[NILM_BANK_MAX_CHANNELS];
+    
+    nilm_filter_bank_init(&bank, NILM_BANK_MAX_CHANNELS);
+    for (int c = 0; c < NILM_BANK_MAX_CHANNELS; c++) {
+        for (int s = 0; s < HP_FILTER_SECTIONS; s++) {
+            init_biquad_section(&ref[c][s], hp_filter_coeffs[s]);
+        }
+    }
+    
+    uint32_t lcg = 54321u;
+    float max_error = 0.0f;
+    
+    for (int n = 0; n < 6000; n++) {
+        for (int c = 0; c < NILM_BANK_MAX_CHANNELS; c++) {
+            float t = n / (float)NILM_SAMPLE_RATE_HZ + 17.0f * c;
+            float power = 50.0f * (c + 1);
+            if (fmodf(t, 200.0f) < 80.0f) power += 100.0f * (c + 1);
+            lcg = lcg * 1664525u + 1013904223u;
+            input[c] = power + ((float)(lcg >> 8) / 16777216.0f - 0.5f) * 4.0f;
+        }
+        
+        nilm_filter_bank_process(&bank, input, output);
+        
+        for (int c = 0; c < NILM_BANK_MAX_CHANNELS; c++) {
+            float y = input[c];
+            for (int s = 0; s < HP_FILTER_SECTIONS; s++) {
+                y = apply_biquad_section(y, &ref[c][s]);
+            }
+            float err = fabsf(output[c] - y);
+            if (err > max_error) max_error = err;
+        }
+    }
+    
+    return max_error;
+}
+
+/**
+ * @brief Índice do balde que contém uma potência (último balde é aberto)
+ */
+static size_t classifier_bucket(float power) {
+    float b = power / NILM_CLASS_BUCKET_W;
+    if (!(b >= 0.0f)) {
+        return 0;
+    }
+    return (b >= (float)(NILM_CLASS_BUCKETS - 1)) ? NILM_CLASS_BUCKETS - 1 : (size_t)b;
+}
+
+/**
+ * @brief Constrói o índice em baldes a partir de um catálogo de faixas
+ * 
+ * Feito uma única vez; o catálogo deve permanecer válido enquanto o
+ * classificador for usado. O pontuador configurado anteriormente é
+ * descartado.
+ * 
+ * @param cls Classificador
+ * @param table Catálogo de faixas (até NILM_CLASS_MAX_ENTRIES)
+ * @param n_entries Número de entradas
+ * @return false se o catálogo ou o índice excederem a capacidade
+ */
+bool nilm_classifier_build(nilm_classifier_t *cls, const device_power_range_t *table, size_t n_entries) {
+    memset(cls, 0, sizeof(*cls));
+    if (n_entries > NILM_CLASS_MAX_ENTRIES) {
+        return false;
+    }
+    
+    // Contagem por balde e prefixo (CSR)
+    uint16_t count[NILM_CLASS_BUCKETS] = {0};
+    size_t total = 0;
+    for (size_t i = 0; i < n_entries; i++) {
+        size_t first = classifier_bucket(table[i].min_power);
+        size_t last = classifier_bucket(table[i].max_power);
+        for (size_t b = first; b <= last; b++) {
+            count[b]++;
+        }
+        total += last - first + 1;
+    }
+    if (total > NILM_CLASS_MAX_REFS) {
+        return false;
+    }
+    for (size_t b = 0; b < NILM_CLASS_BUCKETS; b++) {
+        cls->bucket_start[b + 1] = cls->bucket_start[b] + count[b];
+    }
+    
+    // Preenchimento na ordem do catálogo (desempate estável)
+    uint16_t fill[NILM_CLASS_BUCKETS];
+    memcpy(fill, cls->bucket_start, sizeof(fill));
+    for (size_t i = 0; i < n_entries; i++) {
+        size_t first = classifier_bucket(table[i].min_power);
+        size_t last = classifier_bucket(table[i].max_power);
+        for (size_t b = first; b <= last; b++) {
+            cls->refs[fill[b]++] = (uint16_t)i;
+        }
+    }
+    
+    cls->table = table;
+    cls->n_entries = n_entries;
+    return true;
+}
+
+/**
+ * @brief Configura o pontuador do classificador
+ * 
+ * ctx deve permanecer válido enquanto o classificador for usado;
+ * scorer = NULL volta à pontuação só por faixa. nilm_classifier_build
+ * descarta o pontuador, então configure depois de construir.
+ */
+void nilm_classifier_set_scorer(nilm_classifier_t *cls, nilm_class_scorer_t scorer, const void *ctx) {
+    cls->scorer = scorer;
+    cls->scorer_ctx = (scorer != NULL) ? ctx : NULL;
+}
+
+/**
+ * @brief Lista todas as entradas do catálogo compatíveis com um evento
+ * 
+ * A pontuação de faixa vale 1 no centro da faixa e 0 nas bordas; com um
+ * pontuador configurado, a pontuação final é a que ele retorna para o
+ * tipo da entrada. Os candidatos saem em ordem decrescente de pontuação
+ * (empates na ordem do catálogo).
+ * 
+ * @param cls Classificador construído por nilm_classifier_build
+ * @param features Características do evento (usa |delta_power|)
+ * @param candidates Saída (até max_candidates)
+ * @param max_candidates Capacidade de candidates
+ * @return Número de candidatos escritos (os de maior pontuação)
+ */
+size_t nilm_classifier_candidates(const nilm_classifier_t *cls, const nilm_device_features_t *features,
+                                  nilm_device_candidate_t *candidates, size_t max_candidates) {
+    float power = fabsf(features->delta_power);
+    size_t n = 0;
+    
+    if (cls->table == NULL || max_candidates == 0 || isnan(power)) {
+        return 0;
+    }
+    
+    size_t b = classifier_bucket(power);
+    for (uint16_t k = cls->bucket_start[b]; k < cls->bucket_start[b + 1]; k++) {
+        const device_power_range_t *entry = &cls->table[cls->refs[k]];
+        if (power < entry->min_power || power > entry->max_power) {
+            continue;
+        }
+        
+        float half_width = 0.5f * (entry->max_power - entry->min_power);
+        float centre = entry->min_power + half_width;
+        float score = (half_width > 0.0f) ? 1.0f - fabsf(power - centre) / half_width : 1.0f;
+        if (cls->scorer != NULL) {
+            score = cls->scorer(cls->scorer_ctx, entry->type, features, score);
+        }
+        
+        // Inserção ordenada mantendo só os max_candidates melhores
+        size_t pos = (n < max_candidates) ? n++ : max_candidates;
+        while (pos > 0 && candidates[pos - 1].score < score) {
+            if (pos < max_candidates) {
+                candidates[pos] = candidates[pos - 1];
+            }
+            pos--;
+        }
+        if (pos < max_candidates) {
+            candidates[pos] = (nilm_device_candidate_t){entry->type, cls->refs[k], score};
+        }
+    }
+    
+    return n;
+}
+
+/**
+ * @brief Prepara o modelo de vizinho mais próximo
+ * 
+ * Agrupa os protótipos por tipo, de modo que cada candidato só é
+ * comparado com os protótipos do próprio tipo. O vetor deve permanecer
+ * válido enquanto o modelo for usado; n = 0 deixa o modelo vazio (não
+ * altera pontuações). Escalas padrão: 100 W, 1 s, 0.5 s, 0.5, 0.1 e 0.1.
+ * 
+ * @return false se houver mais de NILM_CLASS_MAX_ENTRIES protótipos ou tipos inválidos
+ */
+bool nilm_prototype_model_init(nilm_prototype_model_t *model, const nilm_device_prototype_t *prototypes, size_t n) {
+    static const float default_scale[NILM_FEATURE_DIM] = {100.0f, 1.0f, 0.5f, 0.5f, 0.1f, 0.1f};
+    
+    memset(model, 0, sizeof(*model));
+    memcpy(model->feature_scale, default_scale, sizeof(default_scale));
+    if (n > NILM_CLASS_MAX_ENTRIES) {
+        return false;
+    }
+    
+    uint16_t count[DEVICE_TYPE_COUNT] = {0};
+    for (size_t i = 0; i < n; i++) {
+        if ((unsigned)prototypes[i].type >= DEVICE_TYPE_COUNT) {
+            return false;
+        }
+        count[prototypes[i].type]++;
+    }
+    for (size_t t = 0; t < DEVICE_TYPE_COUNT; t++) {
+        model->proto_start[t + 1] = model->proto_start[t] + count[t];
+    }
+    
+    uint16_t fill[DEVICE_TYPE_COUNT];
+    memcpy(fill, model->proto_start, sizeof(fill));
+    for (size_t i = 0; i < n; i++) {
+        model->proto_refs[fill[prototypes[i].type]++] = (uint16_t)i;
+    }
+    
+    model->prototypes = prototypes;
+    model->n_prototypes = n;
+    return true;
+}
+
+/**
+ * @brief Pontuador por protótipos (ctx: nilm_prototype_model_t)
+ * 
+ * Multiplica a pontuação de faixa por 1 / (1 + d²), sendo d² a distância
+ * quadrática normalizada ao protótipo mais próximo do mesmo tipo sobre as
+ * características disponíveis nos dois (NAN é ignorado). Sem protótipo do
+ * tipo ou sem característica comum, a pontuação de faixa é mantida.
+ */
+float nilm_prototype_score(const void *ctx, device_type_t type,
+                           const nilm_device_features_t *features, float range_score) {
+    const nilm_prototype_model_t *model = (const nilm_prototype_model_t *)ctx;
+    const float feature[NILM_FEATURE_DIM] = {
+        fabsf(features->delta_power), features->duration_s, features->rise_time_s, features->overshoot,
+        features->thd, features->h3_ratio
+    };
+    
+    if ((unsigned)type >= DEVICE_TYPE_COUNT) {
+        return range_score;
+    }
+    
+    float best = NAN;
+    for (uint16_t k = model->proto_start[type]; k < model->proto_start[type + 1]; k++) {
+        const nilm_device_prototype_t *proto = &model->prototypes[model->proto_refs[k]];
+        float d2 = 0.0f;
+        int used = 0;
+        for (int j = 0; j < NILM_FEATURE_DIM; j++) {
+            if (isnan(feature[j]) || isnan(proto->feature[j])) {
+                continue;
+            }
+            float d = (feature[j] - proto->feature[j]) / model->feature_scale[j];
+            d2 += d * d;
+            used++;
+        }
+        if (used > 0 && !(d2 >= best)) {
+            best = d2;
+        }
+    }
+    
+    return isnan(best) ? range_score : range_score / (1.0f + best);
+}
+
+/**
+ * @brief Instante (em amostras) em que o degrau normalizado cruza um nível
+ *
+ * Interpolação linear entre as amostras em volta do primeiro cruzamento.
+ */
+static float step_crossing(const float *power, size_t n, float level_before, float step, float level) {
+    float previous = 0.0f;
+    for (size_t i = 0; i < n; i++) {
+        float x = (power[i] - level_before) / step;
+        if (x >= level) {
+            if (i == 0 || x <= previous) {
+                return (float)i;
+            }
+            return (float)(i - 1) + (level - previous) / (x - previous);
+        }
+        previous = x;
+    }
+    return NAN;
+}
+
+/**
+ * @brief Forma do transitório de um evento (tempo de subida e sobressinal)
+ * 
+ * power[] são as amostras do início do transitório em diante. O degrau é
+ * normalizado por features->delta_power a partir de level_before, então
+ * desligamentos são medidos pelo mesmo critério.
+ * 
+ * @param power Potência desde o início do transitório (W)
+ * @param n Número de amostras
+ * @param level_before Nível antes do evento (W)
+ * @param sample_period_s Período de amostragem (s)
+ * @param features Entrada delta_power; saída rise_time_s e overshoot (NAN se indefinidos)
+ */
+void nilm_transient_features(const float *power, size_t n, float level_before, float sample_period_s,
+                             nilm_device_features_t *features) {
+    float step = features->delta_power;
+    
+    features->rise_time_s = NAN;
+    features->overshoot = NAN;
+    if (n == 0 || !(fabsf(step) > 0.0f)) {
+        return;
+    }
+    
+    float peak = -INFINITY;
+    for (size_t i = 0; i < n; i++) {
+        float x = (power[i] - level_before) / step;
+        if (x > peak) {
+            peak = x;
+        }
+    }
+    
+    float t10 = step_crossing(power, n, level_before, step, 0.1f);
+    float t90 = step_crossing(power, n, level_before, step, 0.9f);
+    if (!isnan(t10) && !isnan(t90)) {
+        features->rise_time_s = (t90 - t10) * sample_period_s;
+    }
+    features->overshoot = (peak > 1.0f) ? peak - 1.0f : 0.0f;
+}
+
+static nilm_classifier_t default_classifier;
+
+/**
+ * @brief Inicializa as tabelas do módulo (classificador padrão de device_table)
+ *
+ * Chamar uma vez na partida, antes de criar as tasks/threads que
+ * classificam; depois disso o classificador padrão é só lido.
+ */
+void nilm_filters_init(void) {
+    nilm_classifier_build(&default_classifier, device_table, DEVICE_TABLE_SIZE);
+}
+
+/**
+ * @brief Classificador construído por nilm_filters_init()
+ *
+ * Antes da inicialização o índice está vazio e não retorna candidatos.
+ */
+const nilm_classifier_t *nilm_default_classifier(void) {
+    return &default_classifier;
+}
+
+/**
+ * @brief Classifica um evento pelo melhor candidato do classificador padrão
+ * 
+ * @param features Características do evento
+ * @return Tipo de dispositivo classificado
+ */
+device_type_t classify_device(const nilm_device_features_t *features) {
+    nilm_device_candidate_t best;
+    
+    if (nilm_classifier_candidates(nilm_default_classifier(), features, &best, 1) > 0) {
+        return best.type;
+    }
+    
     // Se não encontrou correspondência
-    if (abs_power > 50.0f) {
+    if (fabsf(features->delta_power) > 50.0f) {
         return DEVICE_OTHER;
     } else {
         return DEVICE_UNKNOWN;
     }
 }
 
+/**
+ * @brief Classifica o tipo de dispositivo baseado na variação de potência
+ * 
+ * @param delta_power Variação de potência em Watts
+ * @return Tipo de dispositivo classificado
+ */
+device_type_t classify_device_by_power(float delta_power) {
+    const nilm_device_features_t features = {
+        .delta_power = delta_power,
+        .duration_s = NAN, .rise_time_s = NAN, .overshoot = NAN, .thd = NAN, .h3_ratio = NAN,
+    };
+    return classify_device(&features);
+}
+
 /**
  * @brief Retorna o nome do dispositivo baseado no tipo
  * 
@@ -118,17 +930,24 @@ device_type_t classify_device_by_power(float delta_power) {
  * @return String com o nome do dispositivo
  */
 const char* get_device_name(device_type_t type) {
-    for (int i = 0; i < DEVICE_TABLE_SIZE; i++) {
-        if (device_table[i].type == type) {
-            return device_table[i].name;
-        }
-    }
+    static const char *const names[DEVICE_TYPE_COUNT] = {
+        [DEVICE_UNKNOWN]         = "Unknown",
+        [DEVICE_LIGHT]           = "Light",
+        [DEVICE_MICROWAVE]       = "Microwave",
+        [DEVICE_WASHING_MACHINE] = "Washing Machine",
+        [DEVICE_DISHWASHER]      = "Dishwasher",
+        [DEVICE_REFRIGERATOR]    = "Refrigerator",
+        [DEVICE_AIR_CONDITIONER] = "Air Conditioner",
+        [DEVICE_WATER_HEATER]    = "Water Heater",
+        [DEVICE_TV]              = "Television",
+        [DEVICE_COMPUTER]        = "Computer",
+        [DEVICE_OTHER]           = "Other Device",
+    };
     
-    switch (type) {
-        case DEVICE_OTHER: return "Other Device";
-        case DEVICE_UNKNOWN: return "Unknown";
-        default: return "Undefined";
+    if ((unsigned)type >= DEVICE_TYPE_COUNT) {
+        return "Undefined";
     }
+    return names[type];
 }
 
 /**
@@ -137,12 +956,16 @@ const char* get_device_name(device_type_t type) {
  * @param sections Array de seções do filtro passa-alta
  * @param lp_section Seção do filtro passa-baixa
  */
-void reset_filter_states(biquad_section_t sections[HP_FILTER_SECTIONS], biquad_section_t *lp_section) {
+void reset_filter_states(nilm_highpass_t *hp, biquad_section_t *lp_section) {
     // Reset estados do filtro passa-alta
     for (int i = 0; i < HP_FILTER_SECTIONS; i++) {
-        sections[i].w1 = 0.0f;
-        sections[i].w2 = 0.0f;
+        hp->sections[i].w1 = 0.0f;
+        hp->sections[i].w2 = 0.0f;
     }
+    hp->accumulator = 0.0f;
+    hp->phase = 0;
+    hp->baseline = 0.0f;
+    hp->baseline_step = 0.0f;
     
     // Reset estado do filtro passa-baixa
     if (lp_section != NULL) {
@@ -151,6 +974,58 @@ void reset_filter_states(biquad_section_t sections[HP_FILTER_SECTIONS], biquad_s
     }
 }
 
+/**
+ * @brief Coloca uma seção no regime permanente de uma entrada constante
+ *
+ * @return Saída da seção nesse regime (ganho DC * input)
+ */
+static float settle_biquad_section(biquad_section_t *section, float input) {
+    double x = input;
+    double den = 1.0 + section->a1 + section->a2;
+#if NILM_FILTERS_USE_ESP_DSP
+    // Direct Form II: w0 = w1 = w2 constantes
+    double w = x / den;
+    section->w1 = (float)w;
+    section->w2 = (float)w;
+    return (float)((section->b0 + section->b1 + section->b2) * w);
+#else
+    // Direct Form II Transposed: y = H(0) x, estados de y = b0 x + w1
+    double y = (section->b0 + section->b1 + section->b2) * x / den;
+    section->w1 = (float)((section->b1 + section->b2) * x - (section->a1 + section->a2) * y);
+    section->w2 = (float)(section->b2 * x - section->a2 * y);
+    return (float)y;
+#endif
+}
+
+/**
+ * @brief Inicia os filtros como se a entrada já estivesse constante em input
+ *
+ * Evita o transitório de degrau de reset_filter_states() ao processar um
+ * trecho que começa no meio do sinal (ex.: replay do histórico em flash):
+ * com o passa-alta de 0.002 Hz esse degrau levaria minutos para sumir.
+ *
+ * @param hp Passa-alta do detector
+ * @param lp_section Seção do passa-baixa (pode ser NULL)
+ * @param input Primeira amostra do trecho
+ */
+void settle_filter_states(nilm_highpass_t *hp, biquad_section_t *lp_section, float input) {
+    float x = input;
+    for (int i = 0; i < HP_FILTER_SECTIONS; i++) {
+        x = settle_biquad_section(&hp->sections[i], x);
+    }
+    if (hp->structure == NILM_HP_MULTIRATE) {
+        // x é a saída do passa-baixa decimado: o baseline já parte nela
+        hp->accumulator = 0.0f;
+        hp->phase = 0;
+        hp->baseline = x;
+        hp->baseline_step = 0.0f;
+    }
+    
+    if (lp_section != NULL) {
+        settle_biquad_section(lp_section, input);
+    }
+}
+
 /**
  * @brief Calcula a resposta em frequência de uma seção biquad
  * 
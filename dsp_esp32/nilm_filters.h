@@ -10,22 +10,53 @@
 #define NILM_FILTERS_H
 
 #include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+/**
+ * Caminho opcional pelos kernels otimizados da esp-dsp (dsps_biquad_f32).
+ *
+ * A esp-dsp implementa a Forma Direta II (não transposta): w1/w2 passam a
+ * guardar os estados dessa forma em todas as funções deste módulo. Com
+ * polos muito próximos do círculo unitário (passa-alta de 0.002 Hz) a
+ * DF-II perde precisão; use-a para filtros bem condicionados, como o
+ * passa-baixas de 1 kHz do signal_analyzer.
+ */
+#ifndef NILM_FILTERS_USE_ESP_DSP
+#define NILM_FILTERS_USE_ESP_DSP 0
+#endif
 
 // Configurações do sistema NILM
 #define NILM_SAMPLE_RATE_HZ     10      // Taxa de amostragem adequada para NILM
 #define NILM_BUFFER_SIZE        1024    // Tamanho do buffer de amostras
-#define NILM_EVENT_THRESHOLD    50.0f   // Limiar de detecção de eventos (Watts)
-#define NILM_DEBOUNCE_TIME_MS   5000    // Tempo de debounce entre eventos (ms)
+#define NILM_EVENT_THRESHOLD    50.0f   // Piso do limiar adaptativo de eventos (Watts)
+#define NILM_EVENT_SIGMA_K      5.0f    // Limiar adaptativo = k * sigma do ruído de potência
+#define NILM_DEBOUNCE_TIME_MS   2000    // Tempo de debounce entre eventos (ms)
 
 // Configurações do filtro passa-alta (detector de eventos)
 #define HP_FILTER_ORDER         6       // Ordem do filtro passa-alta
 #define HP_FILTER_SECTIONS      3       // Número de seções biquad (ordem/2)
 #define HP_CUTOFF_FREQ_HZ       0.002f  // Frequência de corte (Hz)
+#define HP_MULTIRATE_DECIMATION 100     // Estrutura multitaxa: baseline calculado a 0.1 Hz
 
 // Configurações do filtro passa-baixa (caracterizador de potência)
 #define LP_FILTER_ORDER         2       // Ordem do filtro passa-baixa
 #define LP_CUTOFF_FREQ_HZ       0.01f   // Frequência de corte (Hz)
 
+// Motor de filtros em ponto fixo (Q31 com realimentação de erro)
+#ifndef NILM_FILTER_FIXED_POINT
+#define NILM_FILTER_FIXED_POINT 0       // 1 = detector usa o caminho Q31 (sem FPU)
+#endif
+#define NILM_Q31_FULL_SCALE_W   16384.0f // Potência equivalente a 1.0 em Q31 (W)
+#define NILM_Q31_MAX_INPUT_W    8192.0f  // Entrada saturada em FS/2 (margem do acumulador)
+#define NILM_Q31_NORM_SAMPLES   60000    // Amostras somadas nas normas l1 do limite de erro (100 min a 10 Hz)
+
+// Configurações do banco de filtros multi-circuito
+#ifndef NILM_BANK_MAX_CHANNELS
+#define NILM_BANK_MAX_CHANNELS  16      // Máximo de circuitos por banco
+#endif
+#define NILM_BANK_MAX_ERROR_W   0.01f   // Banco vs cascata escalar (só arredondamento, W)
+
 /**
  * @brief Estrutura de uma seção biquad (2ª ordem)
  * 
@@ -43,13 +74,97 @@ typedef struct {
     float w1, w2;
 } biquad_section_t;
 
+/**
+ * @brief Estrutura do passa-alta do detector de eventos
+ *
+ * NILM_HP_DIRECT: Butterworth de 6ª ordem a 10 Hz (hp_filter_coeffs), três
+ * biquads por amostra com polos a ~1e-3 do círculo unitário.
+ *
+ * NILM_HP_MULTIRATE: saída = entrada - baseline. O baseline é a média de
+ * blocos de HP_MULTIRATE_DECIMATION amostras filtrada por um Butterworth
+ * passa-baixa de 6ª ordem a 0.1 Hz (hp_multirate_lp_coeffs) e interpolada
+ * linearmente de volta a 10 Hz: três biquads a cada 100 amostras e poucas
+ * somas por amostra. O baseline atrasa um bloco a mais (10 s), pouco
+ * diante do atraso do próprio passa-baixa de 0.002 Hz; um degrau aparece
+ * na saída no mesmo instante nas duas estruturas.
+ */
+typedef enum {
+    NILM_HP_DIRECT = 0,
+    NILM_HP_MULTIRATE = 1,
+} nilm_hp_structure_t;
+
+#ifndef NILM_HP_STRUCTURE
+#define NILM_HP_STRUCTURE       NILM_HP_DIRECT  // Estrutura usada pelo detector
+#endif
+
+/**
+ * @brief Estado do passa-alta do detector (qualquer estrutura)
+ */
+typedef struct {
+    nilm_hp_structure_t structure;
+    biquad_section_t sections[HP_FILTER_SECTIONS];  // Passa-alta a 10 Hz ou passa-baixa a 0.1 Hz
+    
+    // Somente NILM_HP_MULTIRATE
+    float accumulator;          // Soma do bloco em andamento
+    uint32_t phase;             // Amostras no bloco em andamento
+    float baseline;             // Baseline interpolado da amostra atual
+    float baseline_step;        // Incremento do baseline por amostra
+} nilm_highpass_t;
+
+/**
+ * @brief Seção biquad em ponto fixo (Forma Direta I)
+ * 
+ * Coeficientes em Q30 (faixa [-2, 2)), amostras em Q31 e acumulador de
+ * 64 bits. Os bits descartados ao reduzir o acumulador para Q31 são
+ * realimentados com o polinômio (1 - z^-1)^2, cujo zero duplo em DC
+ * cancela o ganho de ruído dos polos colados em z = 1 do passa-alta
+ * de 0.002 Hz.
+ */
+typedef struct {
+    // Coeficientes Q30
+    int32_t b0, b1, b2;
+    int32_t a1, a2;
+    
+    // Linha de atraso Q31 (DF-I)
+    int32_t x1, x2;
+    int32_t y1, y2;
+    
+    // Resíduos de quantização anteriores (realimentação de erro)
+    int64_t e1, e2;
+} biquad_section_q31_t;
+
+/**
+ * @brief Banco de filtros passa-alta para vários circuitos (struct-of-arrays)
+ * 
+ * Os coeficientes são compartilhados e guardados uma única vez por seção;
+ * os estados w1/w2 de cada seção ficam contíguos por canal, de modo que
+ * uma amostra de todos os circuitos é processada por um laço simples e
+ * vetorizável sobre os canais (sem cadeia de structs por circuito).
+ * Mesma forma de apply_biquad_section() (nilm_filter_bank_validate()).
+ */
+typedef struct {
+    // Coeficientes compartilhados (um conjunto por seção)
+    float b0[HP_FILTER_SECTIONS], b1[HP_FILTER_SECTIONS], b2[HP_FILTER_SECTIONS];
+    float a1[HP_FILTER_SECTIONS], a2[HP_FILTER_SECTIONS];
+    
+    // Estados internos [seção][canal] (DF-II com NILM_FILTERS_USE_ESP_DSP, senão DF-II transposta)
+    float w1[HP_FILTER_SECTIONS][NILM_BANK_MAX_CHANNELS] __attribute__((aligned(16)));
+    float w2[HP_FILTER_SECTIONS][NILM_BANK_MAX_CHANNELS] __attribute__((aligned(16)));
+    
+    uint32_t n_channels;        // Circuitos ativos (<= NILM_BANK_MAX_CHANNELS)
+} nilm_filter_bank_t;
+
 /**
  * @brief Estrutura para classificação de eventos
  */
 typedef struct {
-    uint32_t timestamp_ms;      // Timestamp do evento
+    uint32_t timestamp_ms;      // Instante da amostra do evento na grade time_us (ms; início do transitório no detector de mudança)
     float delta_power;          // Variação de potência (W)
     uint8_t device_type;        // Tipo de dispositivo classificado
+    bool steady;                // delta_power entre regimes permanentes (changepoint.h)
+    uint32_t duration_ms;       // Duração do transitório (0 no detector por limiar)
+    float thd;                  // THD da corrente acrescentada/retirada pelo evento (NAN sem medida)
+    float h3_ratio;             // 3ª harmônica / fundamental dessa corrente (NAN sem medida)
     char device_name[32];       // Nome do dispositivo
 } nilm_event_t;
 
@@ -95,39 +210,176 @@ static const device_power_range_t device_table[] = {
 
 #define DEVICE_TABLE_SIZE (sizeof(device_table) / sizeof(device_power_range_t))
 
+#define DEVICE_TYPE_COUNT (DEVICE_OTHER + 1)
+
+// Índice do classificador (faixas de potência em baldes fixos)
+#define NILM_CLASS_BUCKET_W         50.0f   // Largura de cada balde (W)
+#define NILM_CLASS_BUCKETS          128     // Baldes; o último é aberto (>= 6350 W)
+#define NILM_CLASS_MAX_ENTRIES      512     // Entradas máximas do catálogo
+#define NILM_CLASS_MAX_REFS         4096    // Referências (entrada, balde) no índice
+#define NILM_FEATURE_DIM            6       // Dimensão do vetor de características
+
+/**
+ * @brief Características de um evento para classificação
+ *
+ * Campos desconhecidos ficam em NAN e são ignorados pelo pontuador;
+ * delta_power é obrigatório (define os candidatos).
+ */
+typedef struct {
+    float delta_power;          // Variação de potência (W)
+    float duration_s;           // Duração do transitório (s)
+    float rise_time_s;          // Tempo de subida 10-90% do transitório (s)
+    float overshoot;            // Pico do transitório / degrau final - 1
+    float thd;                  // Distorção harmônica total da corrente do degrau (goertzel.h)
+    float h3_ratio;             // Amplitude da 3ª harmônica / fundamental dessa corrente
+} nilm_device_features_t;
+
+/**
+ * @brief Protótipo do modelo de vizinho mais próximo
+ *
+ * feature[] segue a ordem de nilm_device_features_t; NAN ignora a
+ * característica (ex.: protótipo só de forma, sem ΔP).
+ */
+typedef struct {
+    device_type_t type;
+    float feature[NILM_FEATURE_DIM];
+} nilm_device_prototype_t;
+
+/**
+ * @brief Pontuador plugável do classificador
+ *
+ * Recebe a pontuação de faixa (1 no centro, 0 nas bordas) de um candidato
+ * do tipo type e retorna a pontuação final. Chamado só para leitura de
+ * ctx, então pode ser usado por várias threads.
+ */
+typedef float (*nilm_class_scorer_t)(const void *ctx, device_type_t type,
+                                     const nilm_device_features_t *features, float range_score);
+
+/**
+ * @brief Modelo de protótipos (pontuador nilm_prototype_score)
+ *
+ * Os protótipos ficam agrupados por tipo (proto_start/proto_refs, CSR),
+ * então cada candidato só é comparado com os protótipos do próprio tipo.
+ */
+typedef struct {
+    const nilm_device_prototype_t *prototypes;
+    size_t n_prototypes;
+    uint16_t proto_start[DEVICE_TYPE_COUNT + 1];
+    uint16_t proto_refs[NILM_CLASS_MAX_ENTRIES];
+    float feature_scale[NILM_FEATURE_DIM];  // Escala de cada característica na distância
+} nilm_prototype_model_t;
+
+/**
+ * @brief Candidato retornado pelo classificador
+ */
+typedef struct {
+    device_type_t type;
+    uint16_t entry;             // Índice da entrada no catálogo
+    float score;                // Pontuação em [0, 1] (maior é melhor)
+} nilm_device_candidate_t;
+
+/**
+ * @brief Classificador por faixas de potência com índice em baldes
+ *
+ * Cada balde de NILM_CLASS_BUCKET_W guarda as entradas do catálogo cujas
+ * faixas o interceptam (formato CSR: bucket_start/refs), então uma
+ * consulta lê só o balde da potência e o custo não depende do tamanho do
+ * catálogo, apenas de quantas faixas se sobrepõem naquele ponto.
+ *
+ * O pontuador, se configurado, refina a pontuação de cada candidato com as
+ * demais características do evento (duração, forma do transitório).
+ */
+typedef struct {
+    const device_power_range_t *table;
+    size_t n_entries;
+    uint16_t bucket_start[NILM_CLASS_BUCKETS + 1];
+    uint16_t refs[NILM_CLASS_MAX_REFS];
+    
+    nilm_class_scorer_t scorer;     // NULL: só a pontuação de faixa
+    const void *scorer_ctx;
+} nilm_classifier_t;
+
 /**
  * @brief Coeficientes pré-calculados do filtro Butterworth passa-alta
  * 
  * Filtro de 6ª ordem (3 seções biquad) com fc = 0.002 Hz @ fs = 10 Hz
- * Calculado usando scipy.signal.butter() e convertido para SOS (Second Order Sections)
+ * Transformação bilinear com pré-distorção, convertido para SOS (Second Order Sections).
+ * Cada seção tem ganho unitário em Nyquist e zeros duplos exatos em z = 1
+ * (b1 = -2*b0, b2 = b0). Seções ordenadas do polo mais afastado do círculo
+ * unitário para o mais próximo (|p| = 0.998787, 0.999112, 0.999675).
  */
 static const float hp_filter_coeffs[HP_FILTER_SECTIONS][5] = {
     // Seção 1: [b0, b1, b2, a1, a2]
-    {0.997575307740f, -1.988312337657f, 0.990752632414f, -1.991046493047f, 0.991071281177f},
+    {0.998787259390f, -1.997574518779f, 0.998787259390f, -1.997573730168f, 0.997575307390f},
     
     // Seção 2: [b0, b1, b2, a1, a2]
-    {1.000000000000f, -2.006874965307f, 1.006890743483f, -2.005708281949f, 1.005721304286f},
+    {0.999111818080f, -1.998223636159f, 0.999111818080f, -1.998222847292f, 0.998224425026f},
     
     // Seção 3: [b0, b1, b2, a1, a2]
-    {1.000000000000f, -1.999979933536f, 0.999995642535f, -1.998389952299f, 0.998409811440f}
+    {0.999674469573f, -1.999348939146f, 0.999674469573f, -1.999348149835f, 0.999349728458f}
+};
+
+/**
+ * @brief Passa-baixa do baseline da estrutura multitaxa
+ *
+ * Butterworth de 6ª ordem com fc = 0.002 Hz @ fs = 0.1 Hz (10 Hz decimado
+ * por HP_MULTIRATE_DECIMATION): fc normalizada de 0.02 em vez de 2e-4, polos
+ * a |p| = 0.885, 0.915, 0.968 do centro. Ganho DC unitário por seção.
+ */
+static const float hp_multirate_lp_coeffs[HP_FILTER_SECTIONS][5] = {
+    {0.003516885959f, 0.007033771919f, 0.003516885959f, -1.769954139848f, 0.784021683686f},
+    {0.003621681515f, 0.007243363030f, 0.003621681515f, -1.822694925196f, 0.837181651256f},
+    {0.003818773568f, 0.007637547136f, 0.003818773568f, -1.921886056121f, 0.937161150394f}
 };
 
 /**
  * @brief Coeficientes do filtro Butterworth passa-baixa
  * 
- * Filtro de 2ª ordem com fc = 0.01 Hz @ fs = 10 Hz
+ * Filtro de 2ª ordem com fc = 0.01 Hz @ fs = 10 Hz (ganho DC unitário)
  * Para suavização e caracterização de potência
  */
 static const float lp_filter_coeffs[5] = {
     // [b0, b1, b2, a1, a2]
-    0.000009446918f, 0.000018893836f, 0.000009446918f, -1.999924093655f, 0.999961880327f
+    0.000009825917f, 0.000019651834f, 0.000009825917f, -1.991114292202f, 0.991153595869f
 };
 
 // Protótipos de funções
 float apply_biquad_section(float input, biquad_section_t *section);
-float apply_highpass_filter(float input, biquad_section_t sections[HP_FILTER_SECTIONS]);
+float apply_highpass_filter(float input, nilm_highpass_t *hp);
 float apply_lowpass_filter(float input, biquad_section_t *section);
-void init_filter_sections(biquad_section_t sections[HP_FILTER_SECTIONS], biquad_section_t *lp_section);
+void apply_biquad_section_block(const float *input, float *output, size_t n, biquad_section_t *section);
+void apply_highpass_filter_block(const float *input, float *output, size_t n, nilm_highpass_t *hp);
+void apply_lowpass_filter_block(const float *input, float *output, size_t n, biquad_section_t *section);
+void init_biquad_section(biquad_section_t *section, const float coeffs[5]);
+void init_filter_sections(nilm_highpass_t *hp, biquad_section_t *lp_section, nilm_hp_structure_t structure);
+void reset_filter_states(nilm_highpass_t *hp, biquad_section_t *lp_section);
+void settle_filter_states(nilm_highpass_t *hp, biquad_section_t *lp_section, float input);
+float biquad_frequency_response(const biquad_section_t *section, float frequency, float sample_rate);
+int32_t nilm_float_to_q31(float watts);
+float nilm_q31_to_float(int32_t value);
+void nilm_coeffs_to_q30(const float coeffs[5], biquad_section_q31_t *section);
+void init_filter_sections_q31(biquad_section_q31_t sections[HP_FILTER_SECTIONS], biquad_section_q31_t *lp_section);
+int32_t apply_biquad_section_q31(int32_t input, biquad_section_q31_t *section);
+int32_t apply_highpass_filter_q31(int32_t input, biquad_section_q31_t sections[HP_FILTER_SECTIONS]);
+int32_t apply_lowpass_filter_q31(int32_t input, biquad_section_q31_t *section);
+float nilm_q31_error_bound(const biquad_section_q31_t sections[HP_FILTER_SECTIONS]);
+float nilm_q31_validate(float *bound);
+void nilm_filter_bank_init(nilm_filter_bank_t *bank, uint32_t n_channels);
+void nilm_filter_bank_reset(nilm_filter_bank_t *bank);
+void nilm_filter_bank_process(nilm_filter_bank_t *bank, const float *input, float *output);
+float nilm_filter_bank_validate(void);
+bool nilm_classifier_build(nilm_classifier_t *cls, const device_power_range_t *table, size_t n_entries);
+void nilm_classifier_set_scorer(nilm_classifier_t *cls, nilm_class_scorer_t scorer, const void *ctx);
+size_t nilm_classifier_candidates(const nilm_classifier_t *cls, const nilm_device_features_t *features,
+                                  nilm_device_candidate_t *candidates, size_t max_candidates);
+bool nilm_prototype_model_init(nilm_prototype_model_t *model, const nilm_device_prototype_t *prototypes, size_t n);
+float nilm_prototype_score(const void *ctx, device_type_t type,
+                           const nilm_device_features_t *features, float range_score);
+void nilm_transient_features(const float *power, size_t n, float level_before, float sample_period_s,
+                             nilm_device_features_t *features);
+void nilm_filters_init(void);
+const nilm_classifier_t *nilm_default_classifier(void);
+device_type_t classify_device(const nilm_device_features_t *features);
 device_type_t classify_device_by_power(float delta_power);
 const char* get_device_name(device_type_t type);
 
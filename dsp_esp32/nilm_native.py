@@ -0,0 +1,166 @@
+"""
+Binding Python do motor de filtros NILM nativo (libnilm_filters.so)
+===================================================================
+Executa no PC a mesma cascata passa-alta/passa-baixa, o mesmo detector
+de eventos e o mesmo classificador do firmware (nilm_filters.c e
+event_detector.c), via host/nilm_batch.c.
+
+Compilação da biblioteca:
+
+    cd host && make
+
+Uso:
+
+    from nilm_native import NativeMeter, process_meters
+
+    meter = NativeMeter(threshold=50.0, detector='changepoint')
+    events, highpass, lowpass = meter.process(power_w)
+
+    # Vários medidores em paralelo (a chamada nativa libera o GIL)
+    results = process_meters({'casa1': p1, 'casa2': p2}, max_workers=4)
+"""
+
+import ctypes
+import os
+from concurrent.futures import ThreadPoolExecutor
+
+import numpy as np
+
+API_VERSION = 2
+DEFAULT_LIB = os.path.join(os.path.dirname(os.path.abspath(__file__)), 'host', 'libnilm_filters.so')
+
+# event_detector_kind_t
+DETECTORS = {'threshold': 0, 'changepoint': 1}
+
+# Espelho de nilm_batch_event_t (uint64 + float + float + int32, alinhado a 8 bytes)
+EVENT_DTYPE = np.dtype([('index', '<u8'), ('delta', '<f4'), ('power', '<f4'), ('device', '<i4')], align=True)
+
+_lib = None
+
+
+def load_library(path=None):
+    """Carrega a biblioteca (NILM_NATIVE_LIB ou host/libnilm_filters.so)"""
+    global _lib
+    if _lib is not None and path is None:
+        return _lib
+
+    path = path or os.environ.get('NILM_NATIVE_LIB', DEFAULT_LIB)
+    lib = ctypes.CDLL(path)  # CDLL libera o GIL durante as chamadas
+
+    float_p = ctypes.POINTER(ctypes.c_float)
+    lib.nilm_batch_api_version.restype = ctypes.c_int
+    lib.nilm_meter_create.argtypes = [ctypes.c_int, ctypes.c_float, ctypes.c_uint32]
+    lib.nilm_meter_create.restype = ctypes.c_void_p
+    lib.nilm_meter_destroy.argtypes = [ctypes.c_void_p]
+    lib.nilm_meter_reset.argtypes = [ctypes.c_void_p]
+    lib.nilm_meter_min_event_gap.argtypes = [ctypes.c_void_p]
+    lib.nilm_meter_min_event_gap.restype = ctypes.c_uint32
+    lib.nilm_meter_process.argtypes = [ctypes.c_void_p, float_p, ctypes.c_size_t, float_p, float_p,
+                                       ctypes.c_void_p, ctypes.c_size_t, ctypes.POINTER(ctypes.c_size_t)]
+    lib.nilm_meter_process.restype = ctypes.c_size_t
+    lib.get_device_name.argtypes = [ctypes.c_int]
+    lib.get_device_name.restype = ctypes.c_char_p
+
+    version = lib.nilm_batch_api_version()
+    if version != API_VERSION:
+        raise RuntimeError(f"Versão da API nativa incompatível: {version} (esperado {API_VERSION})")
+
+    _lib = lib
+    return lib
+
+
+def device_name(device):
+    """Nome do dispositivo (get_device_name do firmware)"""
+    return load_library().get_device_name(int(device)).decode('utf-8')
+
+
+class NativeMeter:
+    """
+    Estado de um medidor no motor nativo. Lotes sucessivos continuam o
+    mesmo estado, como no dispositivo.
+
+    detector: 'changepoint' (CUSUM, padrão do firmware) ou 'threshold'
+    (|passa-alta| > limiar adaptativo com debounce_samples amostras).
+    threshold é o piso do limiar adaptativo (W).
+    """
+
+    def __init__(self, threshold=50.0, debounce_samples=20, detector='changepoint', lib_path=None):
+        if detector not in DETECTORS:
+            raise ValueError(f"Detector desconhecido: {detector} (use {', '.join(DETECTORS)})")
+        self._lib = load_library(lib_path)
+        self._handle = self._lib.nilm_meter_create(DETECTORS[detector], threshold, debounce_samples)
+        if not self._handle:
+            raise MemoryError("nilm_meter_create falhou")
+        self.min_event_gap = self._lib.nilm_meter_min_event_gap(self._handle)
+
+    def process(self, power, return_filtered=True):
+        """
+        Processa um lote de potência (W).
+
+        Returns:
+        --------
+        (events, highpass, lowpass): eventos como array estruturado
+        EVENT_DTYPE e saídas dos filtros (None se return_filtered=False)
+        """
+        power = np.ascontiguousarray(power, dtype=np.float32)
+        n = len(power)
+        float_p = ctypes.POINTER(ctypes.c_float)
+
+        highpass = lowpass = None
+        hp_ptr = lp_ptr = None
+        if return_filtered:
+            highpass = np.empty(n, dtype=np.float32)
+            lowpass = np.empty(n, dtype=np.float32)
+            hp_ptr = highpass.ctypes.data_as(float_p)
+            lp_ptr = lowpass.ctypes.data_as(float_p)
+
+        # No máximo um evento a cada min_event_gap amostras (debounce ou acomodação do CUSUM)
+        capacity = n // self.min_event_gap + 1
+        events = np.empty(capacity, dtype=EVENT_DTYPE)
+        total = ctypes.c_size_t(0)
+
+        written = self._lib.nilm_meter_process(self._handle, power.ctypes.data_as(float_p), n,
+                                               hp_ptr, lp_ptr, events.ctypes.data, capacity,
+                                               ctypes.byref(total))
+        return events[:written], highpass, lowpass
+
+    def reset(self):
+        """Volta ao estado inicial"""
+        self._lib.nilm_meter_reset(self._handle)
+
+    def close(self):
+        if self._handle:
+            self._lib.nilm_meter_destroy(self._handle)
+            self._handle = None
+
+    def __del__(self):
+        self.close()
+
+
+def process_meters(meters, threshold=50.0, debounce_samples=20, detector='changepoint', max_workers=None,
+                   return_filtered=False):
+    """
+    Processa vários medidores em paralelo (um NativeMeter por medidor).
+
+    Parameters:
+    -----------
+    meters : dict
+        nome -> array de potência (W)
+    max_workers : int
+        Threads (padrão: os.cpu_count())
+
+    Returns:
+    --------
+    dict
+        nome -> (events, highpass, lowpass)
+    """
+    def run(item):
+        name, power = item
+        meter = NativeMeter(threshold, debounce_samples, detector)
+        try:
+            return name, meter.process(power, return_filtered)
+        finally:
+            meter.close()
+
+    with ThreadPoolExecutor(max_workers=max_workers) as pool:
+        return dict(pool.map(run, meters.items()))
@@ -8,6 +8,7 @@ Este módulo permite:
 2. Aplicar filtros e pré-processamento
 3. Análise exploratória de dados
 4. Visualizações especializadas para NILM
+5. Analisar todos os medidores de um arquivo em paralelo (analyze_fleet)
 """
 
 import pandas as pd
@@ -18,18 +19,77 @@ from datetime import datetime, timedelta
 import warnings
 from typing import Dict, List, Optional, Tuple, Union
 import os
+from concurrent.futures import ProcessPoolExecutor
 
 # Configuração de visualização
 plt.style.use('default')
 sns.set_palette("husl")
 warnings.filterwarnings('ignore')
 
+EVENT_COLUMNS = ['timestamp', 'event_type', 'power_change', 'power_before', 'power_after']
+
+
+def _debounce_indices(times: np.ndarray, min_gap) -> np.ndarray:
+    """
+    Índices dos eventos mantidos: cada um a pelo menos min_gap do último
+    mantido. Com tempos ordenados, o próximo mantido sai de um searchsorted,
+    então o custo é O(mantidos · log n) em vez de um laço por evento.
+    """
+    n = len(times)
+    if n == 0:
+        return np.empty(0, dtype=np.int64)
+    if not np.all(times[1:] >= times[:-1]):
+        # Fora de ordem: mesma varredura sequencial de antes
+        keep, last = [], None
+        for i, t in enumerate(times):
+            if last is None or t - last >= min_gap:
+                keep.append(i)
+                last = t
+        return np.asarray(keep, dtype=np.int64)
+    keep = []
+    i = 0
+    while i < n:
+        keep.append(i)
+        i = max(i + 1, int(np.searchsorted(times, times[i] + min_gap, side='left')))
+    return np.asarray(keep, dtype=np.int64)
+
+
+def detect_power_events(power_series: pd.Series, threshold: float = 50.0,
+                        min_duration: str = '10s') -> pd.DataFrame:
+    """
+    Eventos liga/desliga de uma série de potência, vetorizado: diferença e
+    limiar em NumPy, seguidos do filtro de duração mínima.
+    
+    Returns:
+    --------
+    pd.DataFrame
+        Colunas EVENT_COLUMNS, como detect_appliance_events()
+    """
+    values = power_series.to_numpy(dtype=np.float64)
+    diff = np.diff(values)
+    # NaN (amostra faltante) nunca passa do limiar
+    idx = np.flatnonzero(np.abs(diff) > threshold) + 1
+    if not len(idx):
+        return pd.DataFrame(columns=EVENT_COLUMNS)
+    
+    times = power_series.index[idx]
+    keep = _debounce_indices(times.asi8, pd.Timedelta(min_duration).value)
+    idx = idx[keep]
+    change = diff[idx - 1]
+    return pd.DataFrame({
+        'timestamp': power_series.index[idx],
+        'event_type': np.where(change > 0, 'turn_on', 'turn_off'),
+        'power_change': change,
+        'power_before': values[idx - 1],
+        'power_after': values[idx],
+    }, columns=EVENT_COLUMNS)
+
 class NILMTKAnalyzer:
     """
     Classe para análise de dados NILMTK gerados pela ESP32.
     """
     
-    def __init__(self, hdf5_file: Optional[str] = None):
+    def __init__(self, hdf5_file: Optional[str] = None, cache_dir: Optional[str] = None):
         """
         Inicializa o analisador NILMTK.
         
@@ -37,11 +97,26 @@ class NILMTKAnalyzer:
         -----------
         hdf5_file : str, optional
             Caminho para arquivo HDF5 NILMTK
+        cache_dir : str, optional
+            Diretório para guardar as séries reamostradas entre execuções
+            (invalidadas quando o HDF5 muda)
         """
         self.hdf5_file = hdf5_file
+        self.cache_dir = cache_dir
         self.dataset = None
+        self.meter_key = None       # (prédio, medidor) carregado manualmente
         self.power_data = None
         self.metadata = None
+    
+    @property
+    def power_data(self) -> Optional[pd.DataFrame]:
+        return self._power_data
+    
+    @power_data.setter
+    def power_data(self, value: Optional[pd.DataFrame]) -> None:
+        # Nova série: as reamostragens em memória deixam de valer
+        self._power_data = value
+        self._resample_cache = {}
         
     def load_dataset(self, hdf5_file: Optional[str] = None) -> bool:
         """
@@ -95,23 +170,8 @@ class NILMTKAnalyzer:
             with h5py.File(self.hdf5_file, 'r') as f:
                 # Assume building1/elec/meter1
                 building_key = list(f.keys())[0]
-                meter_path = f"{building_key}/elec/meter1"
-                
-                # Carrega timestamps - converte de Unix timestamp para datetime
-                timestamps_unix = f[f"{meter_path}/timestamps"][:]
-                timestamps = pd.to_datetime(timestamps_unix, unit='s')
-                
-                # Carrega dados de potência
-                power_active = f[f"{meter_path}/power/active"][:]
-                voltage = f[f"{meter_path}/voltage"][:]
-                current = f[f"{meter_path}/current"][:]
-                
-                # Cria DataFrame
-                self.power_data = pd.DataFrame({
-                    'power': power_active,
-                    'voltage': voltage,
-                    'current': current
-                }, index=timestamps)
+                self.power_data = _read_meter(f, building_key, 1)
+                self.meter_key = (int(building_key[len('building'):]), 1)
                 
                 print("✅ Dataset carregado manualmente")
                 return True
@@ -120,6 +180,46 @@ class NILMTKAnalyzer:
             print(f"❌ Erro no carregamento manual: {e}")
             return False
     
+    def load_meter(self, building: int = 1, meter: int = 1) -> pd.DataFrame:
+        """
+        Carrega um medidor específico direto do HDF5 (sem NILMTK), como nos
+        arquivos de convert_fleet() com vários prédios/medidores.
+        """
+        import h5py
+        
+        with h5py.File(self.hdf5_file, 'r') as f:
+            self.power_data = _read_meter(f, f'building{building}', meter)
+        self.meter_key = (building, meter)
+        return self.power_data
+    
+    def resampled_power(self, resample_freq: str = '1H') -> pd.Series:
+        """
+        Potência média reamostrada, calculada uma vez por série: fica em
+        memória e, com cache_dir, em disco para as próximas execuções.
+        """
+        if resample_freq in self._resample_cache:
+            return self._resample_cache[resample_freq]
+        
+        path = signature = None
+        if self.cache_dir and self.meter_key and self.hdf5_file:
+            building, meter = self.meter_key
+            path = os.path.join(self.cache_dir, f'building{building}_meter{meter}_{resample_freq}.pkl')
+            index = self.power_data.index
+            signature = (os.path.getmtime(self.hdf5_file), len(index),
+                         index[0] if len(index) else None, index[-1] if len(index) else None)
+            if os.path.exists(path):
+                cached = pd.read_pickle(path)
+                if cached['signature'] == signature:
+                    self._resample_cache[resample_freq] = cached['series']
+                    return cached['series']
+        
+        resampled = self.power_data['power'].resample(resample_freq).mean()
+        self._resample_cache[resample_freq] = resampled
+        if path:
+            os.makedirs(self.cache_dir, exist_ok=True)
+            pd.to_pickle({'signature': signature, 'series': resampled}, path)
+        return resampled
+    
     def get_power_data(self, building: int = 1, meter: int = 1) -> pd.DataFrame:
         """
         Extrai dados de potência do dataset.
@@ -176,8 +276,8 @@ class NILMTKAnalyzer:
             
         print("📊 Analisando padrões de consumo...")
         
-        # Reamostragem
-        resampled = self.power_data['power'].resample(resample_freq).mean()
+        # Reamostragem (cacheada por série e frequência)
+        resampled = self.resampled_power(resample_freq)
         
         # Estatísticas básicas
         stats = {
@@ -241,31 +341,57 @@ class NILMTKAnalyzer:
             
         print(f"🔍 Detectando eventos de aparelhos (limiar: {threshold}W)...")
         
-        power_series = self.power_data['power']
+        events_df = detect_power_events(self.power_data['power'], threshold, min_duration)
         
-        # Calcula diferença de potência
-        power_diff = power_series.diff()
+        print(f"✅ {len(events_df)} eventos detectados")
+        return events_df
+    
+    def detect_events_native(self, threshold: float = 50.0,
+                             debounce_samples: int = 20,
+                             detector: str = 'changepoint') -> pd.DataFrame:
+        """
+        Detecta eventos com o motor nativo do firmware (nilm_native.py).
         
-        # Detecta eventos significativos
-        events = []
+        Usa a mesma cascata passa-alta, o mesmo detector e o mesmo
+        classificador da ESP32 (o resultado coincide com o do dispositivo
+        a menos de arredondamento de ponto flutuante).
         
-        for i, diff in enumerate(power_diff):
-            if abs(diff) > threshold:
-                event_type = 'turn_on' if diff > 0 else 'turn_off'
-                
-                events.append({
-                    'timestamp': power_series.index[i],
-                    'event_type': event_type,
-                    'power_change': diff,
-                    'power_before': power_series.iloc[i-1] if i > 0 else 0,
-                    'power_after': power_series.iloc[i]
-                })
+        Parameters:
+        -----------
+        threshold : float
+            Piso do limiar adaptativo (W)
+        debounce_samples : int
+            Amostras mínimas entre eventos no detector por limiar (20 = 2 s a 10 Hz, NILM_DEBOUNCE_TIME_MS)
+        detector : str
+            'changepoint' (CUSUM, padrão do firmware) ou 'threshold'
+            
+        Returns:
+        --------
+        pd.DataFrame
+            timestamp, event_type, power_change, power, device
+        """
+        from nilm_native import NativeMeter, device_name
+        
+        if self.power_data is None:
+            self.get_power_data()
         
-        events_df = pd.DataFrame(events)
+        print(f"🔍 Detectando eventos (motor nativo, limiar: {threshold}W)...")
         
-        if not events_df.empty:
-            # Filtra por duração mínima
-            events_df = self._filter_events_by_duration(events_df, min_duration)
+        power_series = self.power_data['power']
+        meter = NativeMeter(threshold, debounce_samples, detector)
+        try:
+            events, _, _ = meter.process(power_series.to_numpy(), return_filtered=False)
+        finally:
+            meter.close()
+        
+        index = events['index'].astype(np.int64)
+        events_df = pd.DataFrame({
+            'timestamp': power_series.index[index],
+            'event_type': np.where(events['delta'] > 0, 'turn_on', 'turn_off'),
+            'power_change': events['delta'],
+            'power': events['power'],
+            'device': [device_name(d) for d in events['device']],
+        })
         
         print(f"✅ {len(events_df)} eventos detectados")
         return events_df
@@ -288,17 +414,11 @@ class NILMTKAnalyzer:
             Eventos filtrados
         """
         # Implementação simplificada - filtra eventos muito próximos
-        min_timedelta = pd.Timedelta(min_duration)
-        
-        filtered_events = []
-        last_event_time = None
-        
-        for _, event in events_df.iterrows():
-            if last_event_time is None or (event['timestamp'] - last_event_time) >= min_timedelta:
-                filtered_events.append(event)
-                last_event_time = event['timestamp']
-        
-        return pd.DataFrame(filtered_events)
+        if events_df.empty:
+            return events_df
+        times = pd.DatetimeIndex(events_df['timestamp']).asi8
+        keep = _debounce_indices(times, pd.Timedelta(min_duration).value)
+        return events_df.iloc[keep]
     
     def plot_power_consumption(self, period: str = 'all', 
                               figsize: Tuple[int, int] = (15, 8)) -> None:
@@ -473,6 +593,83 @@ Análise gerada pelo sistema ESP32-NILMTK
         print(f"📄 Relatório salvo: {output_file}")
         return output_file
 
+def _read_meter(f, building_key: str, meter: int) -> pd.DataFrame:
+    """Série de um medidor no layout de esp32_to_nilmtk (arquivo h5py aberto)"""
+    meter_path = f"{building_key}/elec/meter{meter}"
+    
+    # Carrega timestamps - converte de Unix timestamp para datetime
+    timestamps = pd.to_datetime(f[f"{meter_path}/timestamps"][:], unit='s')
+    
+    return pd.DataFrame({
+        'power': f[f"{meter_path}/power/active"][:],
+        'voltage': f[f"{meter_path}/voltage"][:],
+        'current': f[f"{meter_path}/current"][:]
+    }, index=timestamps)
+
+
+def list_meters(hdf5_file: str) -> List[Tuple[int, int]]:
+    """(prédio, medidor) de todos os medidores do arquivo"""
+    import h5py
+    
+    meters = []
+    with h5py.File(hdf5_file, 'r') as f:
+        for building_key in f:
+            if not building_key.startswith('building') or 'elec' not in f[building_key]:
+                continue
+            for meter_key in f[building_key]['elec']:
+                if meter_key.startswith('meter'):
+                    meters.append((int(building_key[len('building'):]), int(meter_key[len('meter'):])))
+    return sorted(meters)
+
+
+def _analyze_meter(job: Dict) -> Tuple[Tuple[int, int], Dict, pd.DataFrame]:
+    """Análise de um medidor num processo do pool"""
+    analyzer = NILMTKAnalyzer(job['hdf5_file'], cache_dir=job['cache_dir'])
+    analyzer.load_meter(job['building'], job['meter'])
+    stats = analyzer.analyze_consumption_patterns(job['resample_freq'])
+    if job['native']:
+        events = analyzer.detect_events_native(job['threshold'])
+    else:
+        events = analyzer.detect_appliance_events(job['threshold'], job['min_duration'])
+    return (job['building'], job['meter']), stats, events
+
+
+def analyze_fleet(hdf5_file: str, threshold: float = 50.0, min_duration: str = '10s',
+                  resample_freq: str = '1H', max_workers: Optional[int] = None,
+                  cache_dir: Optional[str] = None, native: bool = False) -> Dict:
+    """
+    Analisa todos os medidores do arquivo, um por processo do pool.
+    
+    Parameters:
+    -----------
+    hdf5_file : str
+        Arquivo HDF5 (ex.: saída de esp32_to_nilmtk.convert_fleet)
+    max_workers : int, optional
+        Processos (padrão: os.cpu_count())
+    cache_dir : str, optional
+        Cache das reamostragens (padrão: hdf5_file + '.cache')
+    native : bool
+        Detecta com o motor do firmware (detect_events_native) em vez do
+        detector por diferença
+        
+    Returns:
+    --------
+    Dict
+        (prédio, medidor) -> {'statistics', 'events'}
+    """
+    cache_dir = cache_dir or hdf5_file + '.cache'
+    jobs = [{'hdf5_file': hdf5_file, 'building': building, 'meter': meter,
+             'threshold': threshold, 'min_duration': min_duration,
+             'resample_freq': resample_freq, 'cache_dir': cache_dir, 'native': native}
+            for building, meter in list_meters(hdf5_file)]
+    
+    print(f"🔬 Analisando {len(jobs)} medidores em paralelo")
+    with ProcessPoolExecutor(max_workers=max_workers) as pool:
+        results = {key: {'statistics': stats, 'events': events}
+                   for key, stats, events in pool.map(_analyze_meter, jobs)}
+    print(f"✅ {sum(len(r['events']) for r in results.values())} eventos em {len(results)} medidores")
+    return results
+
 def analyze_esp32_nilmtk_data(hdf5_file: str, 
                              output_dir: str = ".") -> Dict:
     """
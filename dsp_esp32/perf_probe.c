@@ -0,0 +1,192 @@
+/**
+ * @file perf_probe.c
+ * @brief Implementação da instrumentação dos estágios do pipeline
+ */
+
+#include "perf_probe.h"
+#include <string.h>
+#include "esp_private/esp_clk.h"
+#include "telemetry.h"
+
+#define PERF_SUB_COUNT  (1u << PERF_HIST_SUB_BITS)
+
+/**
+ * @brief Índice do histograma log-linear para um valor
+ *
+ * Valores < 2^PERF_HIST_SUB_BITS têm faixa própria; acima disso a faixa é
+ * (oitava, próximos PERF_HIST_SUB_BITS bits da mantissa).
+ */
+static uint32_t hist_bucket(uint32_t value) {
+    if (value < PERF_SUB_COUNT) {
+        return value;
+    }
+    uint32_t octave = 31u - (uint32_t)__builtin_clz(value);
+    uint32_t sub = (value >> (octave - PERF_HIST_SUB_BITS)) & (PERF_SUB_COUNT - 1);
+    return ((octave - PERF_HIST_SUB_BITS + 1) << PERF_HIST_SUB_BITS) + sub;
+}
+
+/**
+ * @brief Maior valor contido em uma faixa do histograma
+ */
+static uint32_t hist_upper_bound(uint32_t bucket) {
+    if (bucket < PERF_SUB_COUNT) {
+        return bucket;
+    }
+    uint32_t octave = (bucket >> PERF_HIST_SUB_BITS) + PERF_HIST_SUB_BITS - 1;
+    uint32_t sub = bucket & (PERF_SUB_COUNT - 1);
+    uint64_t upper = ((uint64_t)(PERF_SUB_COUNT + sub + 1) << (octave - PERF_HIST_SUB_BITS)) - 1;
+    return (upper > UINT32_MAX) ? UINT32_MAX : (uint32_t)upper;
+}
+
+/**
+ * @brief Registra uma medida em um estágio
+ *
+ * Seguro entre núcleos: cada campo é atualizado atomicamente.
+ *
+ * @param stage Estágio
+ * @param value Ciclos ou microssegundos (ver stage->unit)
+ */
+void perf_stage_record(perf_stage_t *stage, uint32_t value) {
+    __atomic_fetch_add(&stage->count, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&stage->total, value, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&stage->hist[hist_bucket(value)], 1, __ATOMIC_RELAXED);
+
+    uint32_t seen = __atomic_load_n(&stage->min, __ATOMIC_RELAXED);
+    while (value < seen &&
+           !__atomic_compare_exchange_n(&stage->min, &seen, value, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+    seen = __atomic_load_n(&stage->max, __ATOMIC_RELAXED);
+    while (value > seen &&
+           !__atomic_compare_exchange_n(&stage->max, &seen, value, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+}
+
+/**
+ * @brief Copia as estatísticas de um estágio e as zera (mantém nome e unidade)
+ *
+ * Cada campo é trocado atomicamente, então medidas concorrentes caem no
+ * snapshot ou no período seguinte, nunca se perdem.
+ *
+ * @param stage Estágio
+ * @param snapshot Se não NULL, recebe as estatísticas anteriores
+ */
+static void perf_stage_take(perf_stage_t *stage, perf_stage_t *snapshot) {
+    perf_stage_t local;
+    perf_stage_t *out = (snapshot != NULL) ? snapshot : &local;
+
+    out->name = stage->name;
+    out->unit = stage->unit;
+    out->count = __atomic_exchange_n(&stage->count, 0, __ATOMIC_RELAXED);
+    out->total = __atomic_exchange_n(&stage->total, 0, __ATOMIC_RELAXED);
+    out->min = __atomic_exchange_n(&stage->min, UINT32_MAX, __ATOMIC_RELAXED);
+    out->max = __atomic_exchange_n(&stage->max, 0, __ATOMIC_RELAXED);
+    for (uint32_t b = 0; b < PERF_HIST_BUCKETS; b++) {
+        out->hist[b] = __atomic_exchange_n(&stage->hist[b], 0, __ATOMIC_RELAXED);
+    }
+}
+
+/**
+ * @brief Zera as estatísticas de um estágio (mantém nome e unidade)
+ */
+void perf_stage_reset(perf_stage_t *stage) {
+    perf_stage_take(stage, NULL);
+}
+
+/**
+ * @brief Estima um percentil a partir do histograma
+ *
+ * Retorna o limite superior da faixa que contém o percentil, limitado ao
+ * máximo observado (superestima em no máximo uma sub-faixa, ~25%).
+ *
+ * @param stage Estágio
+ * @param percentile Percentil em [0, 100]
+ * @return Valor estimado (0 se não houver medidas)
+ */
+uint32_t perf_stage_percentile(const perf_stage_t *stage, float percentile) {
+    if (stage->count == 0) {
+        return 0;
+    }
+
+    uint64_t rank = (uint64_t)((percentile / 100.0f) * stage->count + 0.5f);
+    if (rank < 1) rank = 1;
+    if (rank > stage->count) rank = stage->count;
+
+    uint64_t seen = 0;
+    for (uint32_t b = 0; b < PERF_HIST_BUCKETS; b++) {
+        seen += stage->hist[b];
+        if (seen >= rank) {
+            uint32_t upper = hist_upper_bound(b);
+            return (upper < stage->max) ? upper : stage->max;
+        }
+    }
+    return stage->max;
+}
+
+/**
+ * @brief Copia um nome para o campo de tamanho fixo do registro
+ */
+static void copy_name(char out[PERF_NAME_LEN], const char *name) {
+    memset(out, 0, PERF_NAME_LEN);
+    if (name != NULL) {
+        strncpy(out, name, PERF_NAME_LEN);
+    }
+}
+
+/**
+ * @brief Exporta os estágios e medidores como quadro TELEMETRY_TYPE_PERF
+ *
+ * Cada estágio é capturado e reiniciado atomicamente; a frequência da CPU
+ * do cabeçalho é lida no momento da captura.
+ *
+ * @param packet_id Número do registro
+ * @param period_ms Período coberto pelo registro
+ * @param stages Estágios (até PERF_MAX_STAGES)
+ * @param n_stages Número de estágios
+ * @param gauges Medidores (até PERF_MAX_GAUGES)
+ * @param n_gauges Número de medidores
+ * @return true se o quadro foi enfileirado
+ */
+bool perf_probe_send(uint32_t packet_id, uint32_t period_ms, perf_stage_t *const *stages, size_t n_stages,
+                     const perf_gauge_t *gauges, size_t n_gauges) {
+    static uint8_t payload[sizeof(perf_record_header_t) +
+                           PERF_MAX_STAGES * sizeof(perf_record_stage_t) +
+                           PERF_MAX_GAUGES * sizeof(perf_record_gauge_t)];
+    static perf_stage_t stage;          // Snapshot (só a task de monitoramento envia)
+
+    if (n_stages > PERF_MAX_STAGES) n_stages = PERF_MAX_STAGES;
+    if (n_gauges > PERF_MAX_GAUGES) n_gauges = PERF_MAX_GAUGES;
+
+    perf_record_header_t header = {
+        .n_stages = (uint8_t)n_stages,
+        .n_gauges = (uint8_t)n_gauges,
+        .cpu_freq_hz = (uint32_t)esp_clk_cpu_freq(),
+        .period_ms = period_ms,
+    };
+    size_t len = 0;
+    memcpy(payload, &header, sizeof(header));
+    len += sizeof(header);
+
+    for (size_t i = 0; i < n_stages; i++) {
+        perf_stage_take(stages[i], &stage);
+        perf_record_stage_t rec = {
+            .unit = (uint8_t)stage.unit,
+            .count = stage.count,
+            .min = stage.count ? stage.min : 0,
+            .avg = stage.count ? (uint32_t)(stage.total / stage.count) : 0,
+            .p99 = perf_stage_percentile(&stage, 99.0f),
+            .max = stage.max,
+        };
+        copy_name(rec.name, stage.name);
+        memcpy(payload + len, &rec, sizeof(rec));
+        len += sizeof(rec);
+    }
+
+    for (size_t i = 0; i < n_gauges; i++) {
+        perf_record_gauge_t rec = { .value = gauges[i].value };
+        copy_name(rec.name, gauges[i].name);
+        memcpy(payload + len, &rec, sizeof(rec));
+        len += sizeof(rec);
+    }
+
+    return telemetry_send_raw(TELEMETRY_TYPE_PERF, packet_id, payload, (uint16_t)len, 0);
+}
@@ -0,0 +1,169 @@
+/**
+ * @file perf_probe.h
+ * @brief Instrumentação dos estágios do pipeline (ciclos, latência e histogramas)
+ *
+ * Cada estágio acumula contagem, mínimo, média, máximo e um histograma
+ * log-linear (4 sub-faixas por oitava, erro relativo <= 25%) do qual se
+ * estima o p99. Medidas de um único núcleo usam o contador de ciclos
+ * (esp_cpu_get_cycle_count); latências entre núcleos usam esp_timer em
+ * microssegundos, pois os contadores de ciclos dos núcleos não são
+ * sincronizados.
+ *
+ * Periodicamente perf_probe_send() exporta todos os estágios e um
+ * conjunto de medidores (pilha livre das tasks, profundidade das filas,
+ * descartes) como um quadro de telemetria TELEMETRY_TYPE_PERF e reinicia
+ * as estatísticas, de modo que cada registro cobre um período.
+ *
+ * Os valores em ciclos saem crus, com a frequência da CPU lida no
+ * momento da captura do registro (esp_clk_cpu_freq), e não a frequência
+ * de compilação. Com gerenciamento de energia (CONFIG_PM_ENABLE) o DFS
+ * muda a frequência entre as medidas e ciclos não têm conversão única:
+ * perf_probe_begin()/perf_probe_end() passam a medir em microssegundos
+ * (esp_timer, PERF_PROBE_USE_TIMER) e os estágios declarados com
+ * PERF_UNIT_PROBE saem em µs. Um lock ESP_PM_CPU_FREQ_MAX fixaria a
+ * frequência, mas também impediria o light sleep do modo econômico.
+ *
+ * Um estágio pode ser registrado por tasks em núcleos diferentes e é lido
+ * e zerado pela task de monitoramento: os campos são atualizados e
+ * capturados com operações atômicas, campo a campo. Um registro pode
+ * misturar amostras da fronteira entre períodos, o que é aceitável para
+ * diagnóstico, mas nenhuma medida é perdida ou contada duas vezes.
+ */
+
+#ifndef PERF_PROBE_H
+#define PERF_PROBE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "sdkconfig.h"
+#include "esp_cpu.h"
+#include "esp_timer.h"
+
+// Configurações da instrumentação
+#ifndef PERF_PROBE_ENABLE
+#define PERF_PROBE_ENABLE       1       // 0 = sondas viram no-op
+#endif
+#define PERF_MAX_STAGES         16      // Estágios por registro
+#define PERF_MAX_GAUGES         16      // Medidores por registro
+#define PERF_NAME_LEN           8       // Nome no registro (sem terminador obrigatório)
+#define PERF_HIST_SUB_BITS      2       // 2^2 = 4 sub-faixas por oitava
+#define PERF_HIST_BUCKETS       (32 << PERF_HIST_SUB_BITS)
+
+// Sondas em µs com DFS (frequência da CPU variável); ciclos sem ele
+#ifndef PERF_PROBE_USE_TIMER
+#if CONFIG_PM_ENABLE
+#define PERF_PROBE_USE_TIMER    1
+#else
+#define PERF_PROBE_USE_TIMER    0
+#endif
+#endif
+
+/**
+ * @brief Unidade dos valores de um estágio
+ */
+typedef enum {
+    PERF_UNIT_CYCLES = 0,       // Ciclos de CPU (mesmo núcleo)
+    PERF_UNIT_US     = 1        // Microssegundos (esp_timer, entre núcleos)
+} perf_unit_t;
+
+// Unidade dos estágios medidos com perf_probe_begin()/perf_probe_end()
+#if PERF_PROBE_USE_TIMER
+#define PERF_UNIT_PROBE         PERF_UNIT_US
+#else
+#define PERF_UNIT_PROBE         PERF_UNIT_CYCLES
+#endif
+
+/**
+ * @brief Estatísticas de um estágio do pipeline
+ */
+typedef struct {
+    const char *name;
+    perf_unit_t unit;
+    uint32_t count;
+    uint32_t min;
+    uint32_t max;
+    uint64_t total;
+    uint32_t hist[PERF_HIST_BUCKETS];
+} perf_stage_t;
+
+#define PERF_STAGE_INIT(stage_name, stage_unit) { .name = (stage_name), .unit = (stage_unit), .min = UINT32_MAX }
+
+/**
+ * @brief Medidor instantâneo exportado junto com os estágios
+ */
+typedef struct {
+    const char *name;
+    uint32_t value;
+} perf_gauge_t;
+
+/**
+ * @brief Cabeçalho do payload TELEMETRY_TYPE_PERF (12 bytes)
+ *
+ * Seguido de n_stages perf_record_stage_t e n_gauges perf_record_gauge_t.
+ */
+typedef struct __attribute__((packed)) {
+    uint8_t  n_stages;
+    uint8_t  n_gauges;
+    uint16_t reserved;
+    uint32_t cpu_freq_hz;       // Frequência da CPU na captura, para converter ciclos em tempo
+    uint32_t period_ms;         // Período coberto pelo registro
+} perf_record_header_t;
+
+typedef struct __attribute__((packed)) {
+    char     name[PERF_NAME_LEN];
+    uint8_t  unit;              // perf_unit_t
+    uint8_t  reserved[3];
+    uint32_t count;
+    uint32_t min;
+    uint32_t avg;
+    uint32_t p99;
+    uint32_t max;
+} perf_record_stage_t;
+
+typedef struct __attribute__((packed)) {
+    char     name[PERF_NAME_LEN];
+    uint32_t value;
+} perf_record_gauge_t;
+
+_Static_assert(sizeof(perf_record_header_t) == 12, "perf_record_header_t deve ter 12 bytes");
+_Static_assert(sizeof(perf_record_stage_t) == 32, "perf_record_stage_t deve ter 32 bytes");
+_Static_assert(sizeof(perf_record_gauge_t) == 12, "perf_record_gauge_t deve ter 12 bytes");
+
+// Protótipos de funções
+void perf_stage_record(perf_stage_t *stage, uint32_t value);
+void perf_stage_reset(perf_stage_t *stage);
+uint32_t perf_stage_percentile(const perf_stage_t *stage, float percentile);
+bool perf_probe_send(uint32_t packet_id, uint32_t period_ms, perf_stage_t *const *stages, size_t n_stages,
+                     const perf_gauge_t *gauges, size_t n_gauges);
+
+/**
+ * @brief Marca o início de um trecho medido (ciclos, ou µs com PERF_PROBE_USE_TIMER)
+ */
+static inline uint32_t perf_probe_begin(void) {
+#if PERF_PROBE_ENABLE && PERF_PROBE_USE_TIMER
+    return (uint32_t)esp_timer_get_time();
+#elif PERF_PROBE_ENABLE
+    return esp_cpu_get_cycle_count();
+#else
+    return 0;
+#endif
+}
+
+/**
+ * @brief Fecha o trecho iniciado em perf_probe_begin() e registra a duração
+ *
+ * O estágio deve ser declarado com PERF_UNIT_PROBE.
+ */
+static inline void perf_probe_end(perf_stage_t *stage, uint32_t start) {
+#if PERF_PROBE_ENABLE && PERF_PROBE_USE_TIMER
+    perf_stage_record(stage, (uint32_t)esp_timer_get_time() - start);
+#elif PERF_PROBE_ENABLE
+    perf_stage_record(stage, esp_cpu_get_cycle_count() - start);
+#else
+    (void)stage;
+    (void)start;
+#endif
+}
+
+#endif // PERF_PROBE_H
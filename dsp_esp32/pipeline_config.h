@@ -0,0 +1,55 @@
+/**
+ * @file pipeline_config.h
+ * @brief Distribuição das tasks entre os núcleos do ESP32-S3 (ambos os firmwares)
+ *
+ * O pipeline tem três estágios ligados por filas limitadas:
+ *
+ *   núcleo 0: ISR do ADC -> aquisição/decimação -> [frame_ring] -+
+ *                                                                |
+ *   núcleo 1:        filtros, FFT, detecção de eventos <---------+
+ *                                 |
+ *   núcleo 0:        [ringbuffer de telemetria] -> transmissão (UART/USB)
+ *
+ * A aquisição fica no núcleo 0, ao lado das pilhas de WiFi/UART, com a
+ * maior prioridade do pipeline para que o DMA do ADC seja esvaziado a
+ * tempo. O processamento pesado fica sozinho no núcleo 1, de modo que o
+ * envio de dados nunca atrasa a leitura do ADC.
+ */
+
+#ifndef PIPELINE_CONFIG_H
+#define PIPELINE_CONFIG_H
+
+// Núcleos
+#define PIPELINE_ACQ_CORE           0       // Aquisição e decimação
+#define PIPELINE_DSP_CORE           1       // Filtros, FFT e detecção
+#define PIPELINE_IO_CORE            0       // Telemetria e logs
+
+// Prioridades (acima das tasks de sistema de baixa prioridade, abaixo do WiFi)
+#define PIPELINE_ACQ_PRIORITY       5
+#define PIPELINE_DSP_PRIORITY       4
+#define PIPELINE_IO_PRIORITY        2
+
+// Pilhas (bytes)
+#define PIPELINE_ACQ_STACK          4096
+#define PIPELINE_DSP_STACK          8192
+
+// Profundidade das filas entre estágios (quadros)
+#define PIPELINE_ADC_FRAME_SLOTS    4       // signal_analyzer: quadros de N_SAMPLES
+#define PIPELINE_SAMPLE_SLOTS       8       // detector NILM: amostras decimadas
+
+// Quadro de conversão do ADC (bytes, 4 por amostra): uma notificação e uma
+// leitura por quadro. Maior = menos wakeups da aquisição, mais latência
+// (1024 B = 25.6 ms a 10 kHz no signal_analyzer, 12.8 ms a 20 kHz no detector)
+#ifndef PIPELINE_ADC_CONV_FRAME_BYTES
+#define PIPELINE_ADC_CONV_FRAME_BYTES   1024
+#endif
+
+// Pool de resultados do driver ADC (bytes); comporta vários quadros de DMA e
+// cobre ~100 ms a 20 kHz, mais que o apagamento de um setor do power_log
+// (cache desligado nos dois núcleos durante a operação de flash)
+#define PIPELINE_ADC_STORE_BYTES    8192
+_Static_assert(PIPELINE_ADC_CONV_FRAME_BYTES % 4 == 0 &&
+               PIPELINE_ADC_STORE_BYTES >= 2 * PIPELINE_ADC_CONV_FRAME_BYTES,
+               "Quadro de conversão inválido para o pool do driver ADC");
+
+#endif // PIPELINE_CONFIG_H
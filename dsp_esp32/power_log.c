@@ -0,0 +1,392 @@
+/**
+ * @file power_log.c
+ * @brief Implementação do log circular de potência em flash
+ */
+
+#include "power_log.h"
+#include <string.h>
+#include <math.h>
+#include "esp_log.h"
+#include "nilm_filters.h"
+
+static const char *TAG = "POWER_LOG";
+
+#define POWER_LOG_QUIET_NAN     0x7FC00000u     // Amostra NaN gravada sem colidir com os marcadores
+#define POWER_LOG_REPLAY_CHUNK  64              // Amostras por chamada ao passa-alta no replay
+
+/**
+ * @brief Cabeçalho de um setor na flash, ou NULL se o setor não pertence ao log
+ */
+static const power_log_sector_header_t *sector_header(const power_log_t *log, uint32_t sector) {
+    const power_log_sector_header_t *header =
+        (const power_log_sector_header_t *)&log->map[(size_t)sector * POWER_LOG_SECTOR_SIZE];
+    if (header->magic != POWER_LOG_MAGIC || header->version != POWER_LOG_VERSION) {
+        return NULL;
+    }
+    return header;
+}
+
+/**
+ * @brief Monta o log sobre a partição "powerlog"
+ *
+ * Mapeia a partição inteira e procura o setor mais recente pelo número de
+ * sequência; a gravação continua no setor seguinte, com um novo boot_id.
+ *
+ * @return ESP_OK, ESP_ERR_NOT_FOUND sem a partição ou o erro do mapeamento
+ */
+esp_err_t power_log_init(power_log_t *log) {
+    memset(log, 0, sizeof(*log));
+
+    log->partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY,
+                                              POWER_LOG_PARTITION_LABEL);
+    if (log->partition == NULL) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    log->n_sectors = log->partition->size / POWER_LOG_SECTOR_SIZE;
+    if (log->n_sectors < 2) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    const void *map = NULL;
+    esp_err_t ret = esp_partition_mmap(log->partition, 0, (size_t)log->n_sectors * POWER_LOG_SECTOR_SIZE,
+                                       ESP_PARTITION_MMAP_DATA, &map, &log->map_handle);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    log->map = (const uint8_t *)map;
+
+    // Setor mais recente (maior sequência) e último boot registrado
+    bool found = false;
+    uint32_t newest = 0, max_sequence = 0, max_boot = 0;
+    for (uint32_t s = 0; s < log->n_sectors; s++) {
+        const power_log_sector_header_t *header = sector_header(log, s);
+        if (header == NULL) {
+            continue;
+        }
+        if (!found || header->sequence > max_sequence) {
+            max_sequence = header->sequence;
+            newest = s;
+        }
+        if (!found || header->boot_id > max_boot) {
+            max_boot = header->boot_id;
+        }
+        found = true;
+    }
+
+    log->boot_id = found ? max_boot + 1 : 1;
+    log->sequence = found ? max_sequence + 1 : 0;
+    log->write_sector = found ? (newest + 1) % log->n_sectors : 0;
+    return ESP_OK;
+}
+
+/**
+ * @brief Apaga o setor de gravação e inicia o cabeçalho na RAM
+ */
+static bool open_sector(power_log_t *log, uint32_t start_index, uint32_t start_ms) {
+    esp_err_t ret = esp_partition_erase_range(log->partition, (size_t)log->write_sector * POWER_LOG_SECTOR_SIZE,
+                                              POWER_LOG_SECTOR_SIZE);
+    if (ret != ESP_OK) {
+        log->write_errors++;
+        ESP_LOGW(TAG, "Erase of sector %lu failed: %s", log->write_sector, esp_err_to_name(ret));
+        return false;
+    }
+
+    memset(log->sector, 0xFF, sizeof(log->sector));
+    power_log_sector_header_t header = {
+        .magic = POWER_LOG_MAGIC,
+        .version = POWER_LOG_VERSION,
+        .sample_period_ms = POWER_LOG_SAMPLE_PERIOD_MS,
+        .sequence = log->sequence,
+        .boot_id = log->boot_id,
+        .start_index = start_index,
+        .start_ms = start_ms,
+    };
+    memcpy(log->sector, &header, sizeof(header));
+    log->used = sizeof(header);
+    log->synced = 0;
+    log->open = true;
+    log->next_index = start_index;
+    return true;
+}
+
+/**
+ * @brief Grava o que falta do setor e passa para o seguinte
+ */
+static void close_sector(power_log_t *log) {
+    power_log_sync(log);
+    log->write_sector = (log->write_sector + 1) % log->n_sectors;
+    log->sequence++;
+    log->sectors_written++;
+    log->open = false;
+}
+
+/**
+ * @brief Garante espaço para `bytes` no setor atual, abrindo outro se preciso
+ *
+ * @return false se não há setor aberto (falha de apagamento)
+ */
+static bool reserve(power_log_t *log, size_t bytes, uint32_t index, uint32_t now_ms) {
+    if (log->open && log->used + bytes > POWER_LOG_SECTOR_SIZE) {
+        close_sector(log);
+    }
+    if (!log->open && !open_sector(log, index, now_ms)) {
+        return false;
+    }
+    return true;
+}
+
+static void put_word(power_log_t *log, uint32_t word) {
+    memcpy(&log->sector[log->used], &word, sizeof(word));
+    log->used += sizeof(word);
+}
+
+/**
+ * @brief Acrescenta uma amostra de potência
+ *
+ * @param sample_index Índice da amostra desde o boot (saltos viram POWER_LOG_MARK_GAP)
+ * @param power Potência (W)
+ * @param now_ms Instante da amostra (ms desde o boot)
+ */
+void power_log_append(power_log_t *log, uint32_t sample_index, float power, uint32_t now_ms) {
+    if (log->map == NULL) {
+        return;
+    }
+
+    bool gap = log->open && sample_index != log->next_index;
+    if (!reserve(log, sizeof(uint32_t) * (gap ? 3 : 1), sample_index, now_ms)) {
+        return;
+    }
+    // Um setor aberto agora já começa em sample_index (sem marcador)
+    if (sample_index != log->next_index) {
+        put_word(log, POWER_LOG_MARK_GAP);
+        put_word(log, sample_index);
+    }
+
+    uint32_t word;
+    memcpy(&word, &power, sizeof(word));
+    if (isnan(power)) {
+        word = POWER_LOG_QUIET_NAN;
+    }
+    put_word(log, word);
+    log->next_index = sample_index + 1;
+
+    if (now_ms - log->last_sync_ms >= POWER_LOG_SYNC_MS) {
+        log->last_sync_ms = now_ms;
+        power_log_sync(log);
+    }
+}
+
+/**
+ * @brief Acrescenta um evento (fica entre a amostra em que foi detectado e a seguinte)
+ */
+void power_log_append_event(power_log_t *log, const event_record_t *record) {
+    if (log->map == NULL) {
+        return;
+    }
+    if (!reserve(log, sizeof(uint32_t) + sizeof(*record), log->next_index, record->timestamp_ms)) {
+        return;
+    }
+    put_word(log, POWER_LOG_MARK_EVENT);
+    memcpy(&log->sector[log->used], record, sizeof(*record));
+    log->used += sizeof(*record);
+}
+
+/**
+ * @brief Grava na flash a parte ainda não gravada do setor atual
+ *
+ * O setor só foi apagado uma vez; gravações parciais apenas programam
+ * bytes ainda apagados. Chame antes de ler o trecho mais recente.
+ */
+esp_err_t power_log_sync(power_log_t *log) {
+    if (!log->open || log->used == log->synced) {
+        return ESP_OK;
+    }
+    esp_err_t ret = esp_partition_write(log->partition,
+                                        (size_t)log->write_sector * POWER_LOG_SECTOR_SIZE + log->synced,
+                                        &log->sector[log->synced], log->used - log->synced);
+    if (ret != ESP_OK) {
+        log->write_errors++;
+        return ret;
+    }
+    log->synced = log->used;
+    return ESP_OK;
+}
+
+/**
+ * @brief Prepara a leitura de [from_index, to_index) de um boot, do mais antigo ao mais recente
+ *
+ * @param boot_id Boot desejado, ou POWER_LOG_ANY_BOOT
+ */
+void power_log_reader_init(power_log_reader_t *reader, const power_log_t *log, uint32_t boot_id,
+                           uint32_t from_index, uint32_t to_index) {
+    memset(reader, 0, sizeof(*reader));
+    reader->log = log;
+    reader->boot_id = boot_id;
+    reader->from_index = from_index;
+    reader->to_index = to_index;
+    if (log->map == NULL) {
+        return;
+    }
+    // O setor de gravação é o mais novo se já foi aberto; senão ainda guarda o mais antigo
+    reader->sector = log->open ? (log->write_sector + 1) % log->n_sectors : log->write_sector;
+    reader->sectors_left = log->n_sectors;
+}
+
+/**
+ * @brief Próximo setor do intervalo; pula setores inteiros antes de from_index
+ */
+static const power_log_sector_header_t *next_sector(power_log_reader_t *reader) {
+    const power_log_t *log = reader->log;
+    while (reader->sectors_left > 0) {
+        const power_log_sector_header_t *header = sector_header(log, reader->sector);
+        reader->sector = (reader->sector + 1) % log->n_sectors;
+        reader->sectors_left--;
+
+        if (header == NULL || (reader->boot_id != POWER_LOG_ANY_BOOT && header->boot_id != reader->boot_id)) {
+            continue;
+        }
+        if (header->start_index >= reader->to_index) {
+            continue;
+        }
+        const power_log_sector_header_t *next = (reader->sectors_left > 0) ? sector_header(log, reader->sector) : NULL;
+        if (next != NULL && next->sequence == header->sequence + 1 && next->boot_id == header->boot_id &&
+            next->start_index <= reader->from_index) {
+            continue;   // Todo o setor é anterior ao intervalo
+        }
+        return header;
+    }
+    return NULL;
+}
+
+/**
+ * @brief Próximo item do intervalo (ponteiros dentro da partição mapeada)
+ *
+ * @return false no fim do log
+ */
+bool power_log_next(power_log_reader_t *reader, power_log_item_t *item) {
+    for (;;) {
+        if (reader->header == NULL) {
+            reader->header = next_sector(reader);
+            if (reader->header == NULL) {
+                return false;
+            }
+            reader->offset = sizeof(power_log_sector_header_t);
+            reader->index = reader->header->start_index;
+        }
+
+        const uint8_t *body = (const uint8_t *)reader->header;
+        while (reader->offset + sizeof(uint32_t) <= POWER_LOG_SECTOR_SIZE) {
+            const uint32_t *words = (const uint32_t *)&body[reader->offset];
+            uint32_t word = words[0];
+            if (word == POWER_LOG_ERASED) {
+                break;
+            }
+
+            if (word == POWER_LOG_MARK_EVENT) {
+                if (reader->offset + sizeof(uint32_t) + sizeof(event_record_t) > POWER_LOG_SECTOR_SIZE) {
+                    break;
+                }
+                reader->offset += sizeof(uint32_t) + sizeof(event_record_t);
+                if (reader->index > reader->from_index && reader->index <= reader->to_index) {
+                    item->kind = POWER_LOG_ITEM_EVENT;
+                    item->boot_id = reader->header->boot_id;
+                    item->sample_index = reader->index - 1;
+                    item->power = NULL;
+                    item->n_samples = 0;
+                    item->event = (const event_record_t *)&words[1];
+                    return true;
+                }
+                continue;
+            }
+
+            if (word == POWER_LOG_MARK_GAP) {
+                if (reader->offset + 2 * sizeof(uint32_t) > POWER_LOG_SECTOR_SIZE) {
+                    break;
+                }
+                reader->index = words[1];
+                reader->offset += 2 * sizeof(uint32_t);
+                continue;
+            }
+
+            // Trecho de amostras até o próximo marcador
+            size_t max_words = (POWER_LOG_SECTOR_SIZE - reader->offset) / sizeof(uint32_t);
+            size_t n = 1;
+            while (n < max_words && words[n] != POWER_LOG_ERASED &&
+                   words[n] != POWER_LOG_MARK_EVENT && words[n] != POWER_LOG_MARK_GAP) {
+                n++;
+            }
+            uint32_t first = reader->index;
+            reader->index += n;
+            reader->offset += n * sizeof(uint32_t);
+
+            size_t skip = (reader->from_index > first) ? reader->from_index - first : 0;
+            size_t end = (reader->to_index > first) ? reader->to_index - first : 0;
+            if (skip > n) skip = n;
+            if (end > n) end = n;
+            if (end > skip) {
+                item->kind = POWER_LOG_ITEM_SAMPLES;
+                item->boot_id = reader->header->boot_id;
+                item->sample_index = first + skip;
+                item->power = (const float *)&words[skip];
+                item->n_samples = end - skip;
+                item->event = NULL;
+                return true;
+            }
+        }
+        reader->header = NULL;
+    }
+}
+
+/**
+ * @brief Redetecta eventos num intervalo do histórico (ex.: após mudar o limiar)
+ *
+ * Passa as amostras do mapa direto pelo passa-alta do detector, com o
+ * critério |passa-alta| > limiar e debounce. Os filtros partem do regime
+ * permanente da primeira amostra e de cada trecho após uma lacuna.
+ *
+ * @return Número de eventos encontrados
+ */
+uint32_t power_log_replay(const power_log_t *log, uint32_t boot_id, uint32_t from_index, uint32_t to_index,
+                          float threshold, uint32_t debounce_samples, power_log_event_cb_t callback, void *ctx) {
+    nilm_highpass_t hp;
+    float filtered[POWER_LOG_REPLAY_CHUNK];
+    power_log_reader_t reader;
+    power_log_item_t item;
+    uint32_t events = 0, last_event = 0, expected = 0, last_boot = 0;
+    bool settled = false, has_event = false;
+
+    init_filter_sections(&hp, NULL, NILM_HP_STRUCTURE);
+    power_log_reader_init(&reader, log, boot_id, from_index, to_index);
+    while (power_log_next(&reader, &item)) {
+        if (item.kind != POWER_LOG_ITEM_SAMPLES) {
+            continue;
+        }
+        if (!settled || item.sample_index != expected || item.boot_id != last_boot) {
+            settle_filter_states(&hp, NULL, item.power[0]);
+            settled = true;
+            has_event = false;
+        }
+
+        for (size_t k = 0; k < item.n_samples; k += POWER_LOG_REPLAY_CHUNK) {
+            size_t len = item.n_samples - k;
+            if (len > POWER_LOG_REPLAY_CHUNK) len = POWER_LOG_REPLAY_CHUNK;
+            apply_highpass_filter_block(&item.power[k], filtered, len, &hp);
+
+            for (size_t j = 0; j < len; j++) {
+                uint32_t index = item.sample_index + k + j;
+                if (fabsf(filtered[j]) <= threshold || (has_event && index - last_event < debounce_samples)) {
+                    continue;
+                }
+                last_event = index;
+                has_event = true;
+                events++;
+                if (callback != NULL) {
+                    callback(ctx, index, filtered[j], item.power[k + j]);
+                }
+            }
+        }
+        expected = item.sample_index + item.n_samples;
+        last_boot = item.boot_id;
+    }
+    return events;
+}
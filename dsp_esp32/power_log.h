@@ -0,0 +1,137 @@
+/**
+ * @file power_log.h
+ * @brief Histórico de potência e eventos em flash (log circular mapeado em memória)
+ *
+ * A partição "powerlog" (partitions.csv) é um log circular de setores de
+ * 4 KB. As amostras de 10 Hz e os eventos são acumulados num setor na RAM
+ * e gravados de uma vez quando ele enche (ou em power_log_sync()). O log
+ * avança sempre para o setor seguinte e apaga o mais antigo, então todos
+ * os setores sofrem o mesmo número de ciclos de apagamento.
+ *
+ * Leituras não copiam: a partição fica mapeada (esp_partition_mmap) e o
+ * leitor devolve ponteiros para trechos contíguos de amostras dentro do
+ * mapa, que podem ir direto para apply_highpass_filter_block(). Com a
+ * partição padrão de 1984 KB cabem ~14 h a 10 Hz.
+ *
+ * Corpo do setor: palavras de 32 bits. Uma palavra comum é uma amostra de
+ * potência (float, índice implícito); POWER_LOG_MARK_EVENT é seguida de um
+ * event_record_t e POWER_LOG_MARK_GAP do novo índice da amostra seguinte
+ * (amostras perdidas). 0xFFFFFFFF (flash apagada) encerra o setor.
+ *
+ * Todas as funções devem ser chamadas pela mesma task (a task NILM).
+ */
+
+#ifndef POWER_LOG_H
+#define POWER_LOG_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "esp_partition.h"
+#include "event_stream.h"
+
+// Configurações do log
+#define POWER_LOG_PARTITION_LABEL   "powerlog"
+#define POWER_LOG_SECTOR_SIZE       4096
+#define POWER_LOG_SAMPLE_PERIOD_MS  100     // Amostras de 10 Hz
+#define POWER_LOG_SYNC_MS           60000   // Grava o setor parcial ao menos a cada minuto
+#define POWER_LOG_ANY_BOOT          0xFFFFFFFFu
+
+#define POWER_LOG_MAGIC             0x474F4C50u     // "PLOG"
+#define POWER_LOG_VERSION           1
+
+// Marcadores no corpo do setor (NaN sinalizador: nunca resulta de aritmética)
+#define POWER_LOG_MARK_EVENT        0x7FB0E701u
+#define POWER_LOG_MARK_GAP          0x7FB0E702u
+#define POWER_LOG_ERASED            0xFFFFFFFFu
+
+/**
+ * @brief Cabeçalho de cada setor (32 bytes)
+ */
+typedef struct __attribute__((packed)) {
+    uint32_t magic;             // POWER_LOG_MAGIC
+    uint16_t version;           // POWER_LOG_VERSION
+    uint16_t sample_period_ms;  // Período das amostras
+    uint32_t sequence;          // Ordem do setor no log (cresce a cada setor aberto)
+    uint32_t boot_id;           // Boot que gravou o setor
+    uint32_t start_index;       // Índice (desde o boot) da primeira amostra do setor
+    uint32_t start_ms;          // Instante dessa amostra (ms desde o boot)
+    uint32_t reserved[2];
+} power_log_sector_header_t;
+
+_Static_assert(sizeof(power_log_sector_header_t) == 32, "power_log_sector_header_t deve ter 32 bytes");
+
+/**
+ * @brief Estado do log
+ */
+typedef struct {
+    const esp_partition_t *partition;
+    const uint8_t *map;                 // Partição inteira mapeada
+    esp_partition_mmap_handle_t map_handle;
+    uint32_t n_sectors;
+    uint32_t boot_id;
+
+    // Setor em gravação (cópia na RAM)
+    uint8_t sector[POWER_LOG_SECTOR_SIZE] __attribute__((aligned(4)));
+    uint32_t write_sector;
+    uint32_t sequence;
+    size_t used;                        // Bytes preenchidos no setor
+    size_t synced;                      // Bytes já gravados na flash
+    bool open;                          // Setor com cabeçalho (ao menos uma amostra)
+    uint32_t next_index;                // Índice esperado da próxima amostra
+    uint32_t last_sync_ms;
+
+    uint32_t sectors_written;
+    uint32_t write_errors;
+} power_log_t;
+
+/**
+ * @brief Item devolvido pelo leitor
+ */
+typedef enum {
+    POWER_LOG_ITEM_SAMPLES,             // Trecho contíguo de amostras
+    POWER_LOG_ITEM_EVENT,               // Evento detectado após a amostra sample_index - 1
+} power_log_item_kind_t;
+
+typedef struct {
+    power_log_item_kind_t kind;
+    uint32_t boot_id;
+    uint32_t sample_index;              // Índice da primeira amostra (ou do evento)
+    const float *power;                 // SAMPLES: n_samples amostras dentro do mapa
+    size_t n_samples;
+    const event_record_t *event;        // EVENT: registro dentro do mapa
+} power_log_item_t;
+
+/**
+ * @brief Leitor de um intervalo [from_index, to_index) de um boot
+ */
+typedef struct {
+    const power_log_t *log;
+    uint32_t boot_id;                   // POWER_LOG_ANY_BOOT = todos
+    uint32_t from_index;
+    uint32_t to_index;
+    uint32_t sectors_left;
+    uint32_t sector;                    // Próximo setor a visitar
+    const power_log_sector_header_t *header;    // Setor atual (NULL = nenhum)
+    size_t offset;
+    uint32_t index;
+} power_log_reader_t;
+
+/**
+ * @brief Evento encontrado em power_log_replay()
+ */
+typedef void (*power_log_event_cb_t)(void *ctx, uint32_t sample_index, float delta_power, float power);
+
+// Protótipos de funções
+esp_err_t power_log_init(power_log_t *log);
+void power_log_append(power_log_t *log, uint32_t sample_index, float power, uint32_t now_ms);
+void power_log_append_event(power_log_t *log, const event_record_t *record);
+esp_err_t power_log_sync(power_log_t *log);
+void power_log_reader_init(power_log_reader_t *reader, const power_log_t *log, uint32_t boot_id,
+                           uint32_t from_index, uint32_t to_index);
+bool power_log_next(power_log_reader_t *reader, power_log_item_t *item);
+uint32_t power_log_replay(const power_log_t *log, uint32_t boot_id, uint32_t from_index, uint32_t to_index,
+                          float threshold, uint32_t debounce_samples, power_log_event_cb_t callback, void *ctx);
+
+#endif // POWER_LOG_H
@@ -0,0 +1,485 @@
+/**
+ * @file power_meter.c
+ * @brief Implementação da medição de potência por ciclo da rede
+ */
+
+#include "power_meter.h"
+#include <math.h>
+#include <string.h>
+
+#if POWER_METER_USE_ESP_DSP
+#include "esp_dsp.h"
+#endif
+
+#define PM_TWO_PI           6.28318531f
+#define PM_SQRT2            1.41421356f
+#define PM_HYSTERESIS       0.1f        // Fração do pico de tensão do último ciclo
+#define PM_MIN_APPARENT     1e-3f       // VA abaixo dos quais PF = 0
+#define PM_DECIM_MAX_INPUT  2.1e9f      // Entrada da cadeia saturada abaixo de 2^31
+
+// Resolução da entrada inteira da cadeia CIC + FIR: W, var, V², A²
+static const float decim_lsb[POWER_METER_DECIM_VALUES] = { 1e-3f, 1e-3f, 1e-3f, 1e-5f };
+
+/**
+ * @brief Produto escalar <a, b> de n floats
+ */
+static float dot(const float *a, const float *b, size_t n) {
+    float result = 0.0f;
+#if POWER_METER_USE_ESP_DSP
+    dsps_dotprod_f32(a, b, &result, (int)n);
+#else
+    for (size_t k = 0; k < n; k++) {
+        result += a[k] * b[k];
+    }
+#endif
+    return result;
+}
+
+static float sum(const float *a, size_t n) {
+    float result = 0.0f;
+    for (size_t k = 0; k < n; k++) {
+        result += a[k];
+    }
+    return result;
+}
+
+/**
+ * @brief Inicializa o medidor
+ *
+ * @param pm Estado
+ * @param config Parâmetros (n_phases é limitado a POWER_METER_MAX_PHASES)
+ */
+void power_meter_init(power_meter_t *pm, const power_meter_config_t *config) {
+    pm->config = *config;
+    if (pm->config.n_phases < 1) {
+        pm->config.n_phases = 1;
+    } else if (pm->config.n_phases > POWER_METER_MAX_PHASES) {
+        pm->config.n_phases = POWER_METER_MAX_PHASES;
+    }
+    pm->n_channels = 2 * pm->config.n_phases;
+
+    float interval = pm->config.sample_rate_hz / pm->config.output_rate_hz + 0.5f;
+    pm->interval = (interval < 1.0f) ? 1 : (uint32_t)interval;
+    float period = pm->config.sample_rate_hz / pm->config.mains_hz;
+    pm->min_cycle = (uint32_t)(0.5f * period);
+    pm->max_cycle = (uint32_t)(2.0f * period);
+    pm->window = 0;
+    pm->carry_dropped = 0;
+    pm->decimate = pm->config.cic_fir &&
+                   decimator_config_for_factor(pm->interval, POWER_METER_CIC_ORDER, 1.0f, &pm->decim_config);
+
+    power_meter_reset(pm);
+}
+
+/**
+ * @brief Descarta ciclos, médias e códigos pendentes
+ *
+ * O contador carry_dropped é cumulativo desde power_meter_init() e não é zerado.
+ */
+void power_meter_reset(power_meter_t *pm) {
+    memset(pm->phase, 0, sizeof(pm->phase));
+    for (uint32_t p = 0; p < pm->config.n_phases; p++) {
+        power_meter_phase_t *ph = &pm->phase[p];
+        ph->v_gain = pm->config.v_gain[p];
+        ph->i_gain = pm->config.i_gain[p];
+        ph->hysteresis = PM_HYSTERESIS * PM_SQRT2 * pm->config.v_min_rms;
+        ph->synced = (pm->window > 0);     // A janela começa na primeira amostra
+        if (pm->decimate) {
+            for (int k = 0; k < POWER_METER_DECIM_VALUES; k++) {
+                decimator_config_t cfg = pm->decim_config;
+                cfg.output_scale = decim_lsb[k];
+                decimator_init(&ph->decim[k], &cfg);
+            }
+        }
+    }
+    pm->interval_count = 0;
+    memset(pm->n_carry, 0, sizeof(pm->n_carry));
+}
+
+/**
+ * @brief Amostras em `cycles` períodos nominais da rede (arredondado)
+ */
+uint32_t power_meter_window_samples(const power_meter_t *pm, uint32_t cycles) {
+    return (uint32_t)(cycles * pm->config.sample_rate_hz / pm->config.mains_hz + 0.5f);
+}
+
+/**
+ * @brief Alterna entre ciclos da rede (cycles = 0) e janelas de `cycles` períodos nominais
+ *
+ * Descarta o estado (power_meter_reset). No modo janela cada rajada deve
+ * começar com power_meter_reset(); a primeira saída depois dele é a da
+ * janela, e as amostras seguintes da rajada podem ser descartadas.
+ */
+void power_meter_set_window(power_meter_t *pm, uint32_t cycles) {
+    pm->window = cycles ? power_meter_window_samples(pm, cycles) : 0;
+    power_meter_reset(pm);
+}
+
+/**
+ * @brief Acumula as amostras j em [a, b) do bloco no ciclo em curso
+ *
+ * Amostra j: tensão v_work[j + 1] (vizinhas v_work[j] e v_work[j + 2]) e
+ * corrente i_work[j].
+ */
+static void accumulate(power_meter_phase_t *ph, size_t a, size_t b) {
+    size_t n = b - a;
+    if (n == 0) {
+        return;
+    }
+    const float *v = &ph->v_work[a + 1];
+    const float *i = &ph->i_work[a];
+
+    ph->sum_v += sum(v, n);
+    ph->sum_i += sum(i, n);
+    ph->sum_vv += dot(v, v, n);
+    ph->sum_ii += dot(i, i, n);
+    ph->sum_vi += dot(v, i, n);
+    ph->sum_q += dot(i, v - 1, n) - dot(i, v + 1, n);
+    // Soma telescópica de v[j-1] - v[j+1]
+    ph->sum_dv += v[-1] + v[0] - v[n - 1] - v[n];
+    ph->cycle_samples += (uint32_t)n;
+}
+
+/**
+ * @brief Grandezas de uma fase a partir de P, Q e dos quadrados médios
+ */
+static void set_phase(power_phase_t *out, float p, float q, float vv, float ii) {
+    out->p = p;
+    out->q = q;
+    out->v_rms = sqrtf((vv > 0.0f) ? vv : 0.0f);
+    out->i_rms = sqrtf((ii > 0.0f) ? ii : 0.0f);
+    out->s = out->v_rms * out->i_rms;
+    out->pf = (out->s > PM_MIN_APPARENT) ? out->p / out->s : 0.0f;
+}
+
+/**
+ * @brief Frequência média dos ciclos com cruzamento acumulados (0 se nenhum)
+ */
+static float accumulated_hz(const power_meter_t *pm, const power_meter_phase_t *ph) {
+    return ph->acc_locked ? pm->config.sample_rate_hz * ph->acc_locked / ph->acc_period : 0.0f;
+}
+
+static void clear_accumulators(power_meter_phase_t *ph) {
+    ph->acc_p = ph->acc_q = ph->acc_vv = ph->acc_ii = 0.0f;
+    ph->acc_period = 0.0f;
+    ph->acc_samples = 0;
+    ph->acc_cycles = ph->acc_locked = 0;
+}
+
+/**
+ * @brief Passa o ciclo que fechou pela cadeia CIC + FIR, uma entrada por amostra dele
+ *
+ * As saídas entram na fila da fase com a frequência e o número dos
+ * ciclos acumulados desde a saída anterior.
+ */
+static void decimate_cycle(const power_meter_t *pm, power_meter_phase_t *ph, float vv, float ii) {
+    const float value[POWER_METER_DECIM_VALUES] = { ph->cycle.p, ph->cycle.q, vv, ii };
+    if (!ph->decim_primed) {
+        memcpy(ph->decim_ref, value, sizeof(value));
+        ph->decim_primed = true;
+    }
+
+    float y[POWER_METER_DECIM_VALUES][POWER_METER_DECIM_QUEUE];
+    size_t n_y = 0;
+    for (int k = 0; k < POWER_METER_DECIM_VALUES; k++) {
+        float x = (value[k] - ph->decim_ref[k]) / decim_lsb[k];
+        x = (x > PM_DECIM_MAX_INPUT) ? PM_DECIM_MAX_INPUT : (x < -PM_DECIM_MAX_INPUT) ? -PM_DECIM_MAX_INPUT : x;
+        n_y = decimator_process_hold(&ph->decim[k], (int32_t)lrintf(x), ph->cycle_samples, y[k],
+                                     POWER_METER_DECIM_QUEUE);
+    }
+
+    // As quatro cadeias andam juntas: o mesmo número de saídas
+    for (size_t j = 0; j < n_y && ph->n_decim_out < POWER_METER_DECIM_QUEUE; j++) {
+        uint32_t slot = ph->n_decim_out++;
+        set_phase(&ph->decim_out[slot], ph->decim_ref[0] + y[0][j], ph->decim_ref[1] + y[1][j],
+                  ph->decim_ref[2] + y[2][j], ph->decim_ref[3] + y[3][j]);
+        ph->decim_hz[slot] = accumulated_hz(pm, ph);
+        ph->decim_cycles[slot] = ph->acc_cycles;
+        clear_accumulators(ph);
+    }
+}
+
+/**
+ * @brief Fecha o ciclo em curso e o soma ao intervalo de saída
+ *
+ * @param locked true se fechado por cruzamento por zero
+ * @param period Período do ciclo em amostras (fracionário se locked)
+ */
+static void finish_cycle(const power_meter_t *pm, power_meter_phase_t *ph, bool locked, float period) {
+    const float n = (float)ph->cycle_samples;
+    const float fs = pm->config.sample_rate_hz;
+
+    if (ph->synced && ph->cycle_samples > 0) {
+        float mv = ph->sum_v / n;
+        float mi = ph->sum_i / n;
+        float vv = ph->sum_vv / n - mv * mv;
+        float ii = ph->sum_ii / n - mi * mi;
+        vv = (vv > 0.0f) ? vv : 0.0f;
+        ii = (ii > 0.0f) ? ii : 0.0f;
+
+        // Derivada central: ganho 2·sin(ωT) na fundamental medida
+        float hz = locked ? fs / period : pm->config.mains_hz;
+        float k = 2.0f * sinf(PM_TWO_PI * hz / fs);
+
+        // Corrente atrasada de i_skew amostras: gira P/Q de volta a θ = ω·i_skew/fs
+        float p = ph->sum_vi / n - mv * mi;
+        float q = (ph->sum_q / n - mi * (ph->sum_dv / n)) / k;
+        float theta = PM_TWO_PI * hz * pm->config.i_skew / fs;
+        float cos_t = cosf(theta), sin_t = sinf(theta);
+
+        power_phase_t *c = &ph->cycle;
+        c->p = p * cos_t - q * sin_t;
+        c->q = q * cos_t + p * sin_t;
+        c->v_rms = sqrtf(vv);
+        c->i_rms = sqrtf(ii);
+        c->s = c->v_rms * c->i_rms;
+        c->pf = (c->s > PM_MIN_APPARENT) ? c->p / c->s : 0.0f;
+        ph->cycle_hz = locked ? hz : 0.0f;
+
+        ph->acc_p += c->p * n;
+        ph->acc_q += c->q * n;
+        ph->acc_vv += vv * n;
+        ph->acc_ii += ii * n;
+        ph->acc_samples += ph->cycle_samples;
+        ph->acc_cycles++;
+        if (locked) {
+            ph->acc_period += period;
+            ph->acc_locked++;
+        }
+
+        float v_ref = (c->v_rms > pm->config.v_min_rms) ? c->v_rms : pm->config.v_min_rms;
+        ph->hysteresis = PM_HYSTERESIS * PM_SQRT2 * v_ref;
+
+        if (pm->decimate && pm->window == 0) {
+            decimate_cycle(pm, ph, vv, ii);
+        }
+    }
+    ph->synced = true;
+
+    ph->sum_v = ph->sum_i = 0.0f;
+    ph->sum_vv = ph->sum_ii = ph->sum_vi = 0.0f;
+    ph->sum_q = ph->sum_dv = 0.0f;
+    ph->cycle_samples = 0;
+}
+
+/**
+ * @brief Processa n amostras já carregadas em v_work/i_work
+ *
+ * Procura os cruzamentos por zero ascendentes e acumula cada trecho entre
+ * eles com produtos escalares.
+ */
+static void process_phase(const power_meter_t *pm, power_meter_phase_t *ph, size_t n) {
+    size_t seg = 0;
+    if (!ph->primed) {
+        // Primeiro bloco: a primeira amostra só serve de histórico
+        ph->v_work[0] = ph->v_work[1] = ph->v_work[2];
+        ph->i_work[0] = ph->i_work[1];
+        ph->primed = true;
+        seg = 1;
+    }
+
+    for (size_t j = seg; j < n; j++) {
+        float v = ph->v_work[j + 1];
+        uint32_t count = ph->cycle_samples + (uint32_t)(j - seg);   // Amostras do ciclo antes de j
+        bool crossed = false;
+        bool close;
+
+        if (pm->window > 0) {
+            // Modo janela: fecha em `window` amostras, sem cruzamento por zero
+            close = (count >= pm->window);
+        } else {
+            if (v < -ph->hysteresis) {
+                ph->armed = true;
+            } else if (ph->armed && v >= 0.0f) {
+                // Cruzamento cedo demais (início no meio do ciclo, ruído): espera o próximo
+                crossed = (count >= pm->min_cycle);
+                ph->armed = crossed;
+            }
+            close = crossed || count >= pm->max_cycle;
+        }
+        if (!close) {
+            continue;
+        }
+
+        accumulate(ph, seg, j);
+        if (crossed) {
+            // Cruzamento entre j-1 e j por interpolação linear
+            float prev = ph->v_work[j];
+            float frac = (prev < 0.0f) ? prev / (prev - v) : 1.0f;
+            float period = (float)count - 1.0f + frac - ph->cycle_offset;
+            finish_cycle(pm, ph, true, period);
+            ph->cycle_offset = frac - 1.0f;
+        } else {
+            finish_cycle(pm, ph, false, (float)count);
+            ph->cycle_offset = 0.0f;
+        }
+        ph->armed = false;
+        seg = j;
+    }
+    accumulate(ph, seg, n);
+
+    // Histórico para o próximo bloco
+    ph->v_work[0] = ph->v_work[n];
+    ph->v_work[1] = ph->v_work[n + 1];
+    ph->i_work[0] = ph->i_work[n];
+}
+
+/**
+ * @brief Converte n códigos de um canal (pendentes + quadro) a partir da posição start
+ */
+static void load_channel(const power_meter_t *pm, uint32_t ch, const uint16_t *codes, size_t start, size_t n,
+                         float gain, float *out) {
+    const uint32_t n_carry = pm->n_carry[ch];
+    for (size_t k = 0; k < n; k++) {
+        size_t idx = start + k;
+        int32_t code = (idx < n_carry) ? pm->carry[ch][idx] : codes[idx - n_carry];
+        out[k] = (float)(code - POWER_METER_CODE_BIAS) * gain;
+    }
+}
+
+/**
+ * @brief Fecha o intervalo de saída de uma fase: médias dos ciclos que terminaram nele
+ */
+static void finish_interval(const power_meter_t *pm, power_meter_phase_t *ph) {
+    if (ph->acc_samples > 0) {
+        float n = (float)ph->acc_samples;
+        set_phase(&ph->held, ph->acc_p / n, ph->acc_q / n, ph->acc_vv / n, ph->acc_ii / n);
+        ph->held_hz = accumulated_hz(pm, ph);
+    }
+    ph->held_cycles = ph->acc_cycles;
+    clear_accumulators(ph);
+}
+
+/**
+ * @brief Tira a saída mais antiga da fila da cadeia CIC + FIR da fase
+ */
+static void pop_decimated(power_meter_phase_t *ph) {
+    ph->held = ph->decim_out[0];
+    ph->held_hz = ph->decim_hz[0];
+    ph->held_cycles = ph->decim_cycles[0];
+    ph->n_decim_out--;
+    memmove(&ph->decim_out[0], &ph->decim_out[1], ph->n_decim_out * sizeof(ph->decim_out[0]));
+    memmove(&ph->decim_hz[0], &ph->decim_hz[1], ph->n_decim_out * sizeof(ph->decim_hz[0]));
+    memmove(&ph->decim_cycles[0], &ph->decim_cycles[1], ph->n_decim_out * sizeof(ph->decim_cycles[0]));
+}
+
+/**
+ * @brief Monta a saída a partir da última saída de cada fase
+ */
+static void emit_output(const power_meter_t *pm, power_sample_t *out) {
+    power_sample_t result;
+    memset(&result, 0, sizeof(result));
+    result.n_phases = (uint8_t)pm->config.n_phases;
+    result.frequency = pm->phase[0].held_hz;
+    result.n_cycles = pm->phase[0].held_cycles;
+
+    for (uint32_t p = 0; p < pm->config.n_phases; p++) {
+        const power_meter_phase_t *ph = &pm->phase[p];
+        result.phase[p] = ph->held;
+        result.p += ph->held.p;
+        result.q += ph->held.q;
+        result.s += ph->held.s;
+    }
+    result.pf = (result.s > PM_MIN_APPARENT) ? result.p / result.s : 0.0f;
+
+    if (out != NULL) {
+        *out = result;
+    }
+}
+
+/**
+ * @brief Verdadeiro se todas as fases têm uma saída da cadeia CIC + FIR
+ */
+static bool decimated_ready(const power_meter_t *pm) {
+    for (uint32_t p = 0; p < pm->config.n_phases; p++) {
+        if (pm->phase[p].n_decim_out == 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Processa os códigos de um quadro de conversão
+ *
+ * Só amostras com todos os canais presentes são processadas; as que
+ * sobram (o quadro termina no meio do padrão) esperam o próximo quadro.
+ *
+ * @param pm Estado
+ * @param codes Códigos por canal, na ordem V1, I1, V2, I2, ... (adc_frame_decode_codes)
+ * @param counts Códigos de cada canal
+ * @param out Saídas na taxa output_rate_hz
+ * @param max_out Capacidade de out (saídas excedentes são descartadas)
+ * @return Número de saídas escritas em out
+ */
+size_t power_meter_process(power_meter_t *pm, const uint16_t *const codes[], const size_t counts[],
+                           power_sample_t *out, size_t max_out) {
+    size_t n_total = SIZE_MAX;
+    for (uint32_t ch = 0; ch < pm->n_channels; ch++) {
+        size_t avail = pm->n_carry[ch] + counts[ch];
+        n_total = (avail < n_total) ? avail : n_total;
+    }
+
+    size_t n_out = 0;
+    for (size_t done = 0; done < n_total;) {
+        size_t n = n_total - done;
+        if (n > POWER_METER_MAX_BLOCK) {
+            n = POWER_METER_MAX_BLOCK;
+        }
+        const bool decimated = pm->decimate && pm->window == 0;
+        if (pm->window == 0 && !decimated && n > pm->interval - pm->interval_count) {
+            n = pm->interval - pm->interval_count;
+        }
+
+        for (uint32_t p = 0; p < pm->config.n_phases; p++) {
+            power_meter_phase_t *ph = &pm->phase[p];
+            load_channel(pm, 2 * p, codes[2 * p], done, n, ph->v_gain, &ph->v_work[2]);
+            load_channel(pm, 2 * p + 1, codes[2 * p + 1], done, n, ph->i_gain, &ph->i_work[1]);
+            process_phase(pm, ph, n);
+        }
+
+        done += n;
+        if (decimated) {
+            while (decimated_ready(pm)) {
+                for (uint32_t p = 0; p < pm->config.n_phases; p++) {
+                    pop_decimated(&pm->phase[p]);
+                }
+                emit_output(pm, (n_out < max_out) ? &out[n_out] : NULL);
+                if (n_out < max_out) {
+                    n_out++;
+                }
+            }
+            continue;
+        }
+
+        pm->interval_count += (uint32_t)n;
+        bool interval_done = (pm->window > 0) ? (pm->phase[0].acc_cycles > 0) : (pm->interval_count == pm->interval);
+        if (interval_done) {
+            pm->interval_count = 0;
+            for (uint32_t p = 0; p < pm->config.n_phases; p++) {
+                finish_interval(pm, &pm->phase[p]);
+            }
+            emit_output(pm, (n_out < max_out) ? &out[n_out] : NULL);
+            if (n_out < max_out) {
+                n_out++;
+            }
+        }
+    }
+
+    // Códigos sem par ficam para o próximo quadro
+    for (uint32_t ch = 0; ch < pm->n_channels; ch++) {
+        size_t avail = pm->n_carry[ch] + counts[ch];
+        size_t left = avail - n_total;
+        size_t keep = (left < POWER_METER_MAX_CARRY) ? left : POWER_METER_MAX_CARRY;
+        uint16_t next[POWER_METER_MAX_CARRY];
+        for (size_t k = 0; k < keep; k++) {
+            size_t idx = n_total + k;
+            next[k] = (idx < pm->n_carry[ch]) ? pm->carry[ch][idx] : codes[ch][idx - pm->n_carry[ch]];
+        }
+        memcpy(pm->carry[ch], next, keep * sizeof(uint16_t));
+        pm->n_carry[ch] = (uint32_t)keep;
+        pm->carry_dropped += (uint32_t)(left - keep);
+    }
+
+    return n_out;
+}
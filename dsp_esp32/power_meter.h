@@ -0,0 +1,182 @@
+/**
+ * @file power_meter.h
+ * @brief Medição de potência ativa/reativa/aparente por ciclo da rede, sobre as amostras brutas do ADC
+ *
+ * Cada fase é um par de canais do padrão de conversão (tensão, corrente),
+ * na ordem V1, I1, V2, I2, V3, I3. As amostras são convertidas de código
+ * para unidades de rede (ganho de calibração × escala do sensor, com o
+ * código central subtraído) e agrupadas em ciclos pelo cruzamento por zero
+ * ascendente da tensão (com histerese de 10 % do pico). Para cada trecho
+ * de um ciclo os somatórios são produtos escalares de vetores contíguos
+ * (dsps_dotprod_f32 com POWER_METER_USE_ESP_DSP):
+ *
+ *     P = <v, i>/N - v̄·ī          Vrms² = <v, v>/N - v̄²     Irms² = <i, i>/N - ī²
+ *     Q = (<i, v[-1]> - <i, v[+1]>)/N / (2·sin(2π·f/fs))   (corrigido do nível DC de i)
+ *     S = Vrms·Irms                PF = P/S
+ *
+ * A média do próprio ciclo remove o offset dos sensores sem filtro. Q usa
+ * a derivada central da tensão, que atrasa a fundamental exatamente 90°
+ * com uma amostra de histórico; para a harmônica k o peso é
+ * sin(k·ωT)/sin(ωT) ≈ k, então Q é exato para a fundamental e
+ * S² - P² - Q² indica a distorção. A corrente é amostrada i_skew amostras
+ * depois da tensão (1/canais no padrão intercalado, ≈ 1° a 60 Hz com 2
+ * canais); P e Q de cada ciclo são girados de θ = 2π·f·i_skew/fs na
+ * frequência medida, o atraso fracionário exato da fundamental da
+ * corrente, sem atenuar Irms. A potência das harmônicas fica com o erro
+ * de fase de (k - 1)·θ.
+ *
+ * Os ciclos são decimados para a taxa de saída (output_rate_hz, a taxa
+ * NILM) pela cadeia CIC + FIR de decimator.h (cic_fir): P, Q, Vrms² e
+ * Irms² de cada ciclo são repetidos em cada amostra dele, o que dá um
+ * sinal uniforme na taxa do canal, e decimados pelo fator do intervalo
+ * (1000 = 125·2·2·2 com 1 fase). A cadeia rejeita > 34 dB as variações de
+ * carga acima de 0.3·output_rate_hz que a média do intervalo dobraria
+ * sobre a banda útil, com atraso de grupo de ≈ 1 s (1 fase). A entrada
+ * é a diferença para o primeiro ciclo depois do reset, então a cadeia
+ * parte do regime em vez de subir do zero.
+ *
+ * Sem cic_fir, no modo janela ou com um intervalo que não tem a forma
+ * R·2·2^n (3 fases: 333 amostras), a saída é a média dos ciclos ponderada
+ * pelo número de amostras: P e Q pela média, Vrms e Irms pela média dos
+ * quadrados. Cada ciclo entra no intervalo em que termina; um intervalo
+ * sem ciclo completo repete a saída anterior.
+ * Sem tensão (nenhum cruzamento em 2 períodos nominais) os ciclos são
+ * fechados no período nominal e a corrente continua medida.
+ *
+ * No modo janela (power_meter_set_window, aquisição em rajadas) não há
+ * cruzamento por zero: cada saída integra as primeiras `window` amostras
+ * desde power_meter_reset(), um número inteiro de períodos nominais, o
+ * que dá P, Vrms e Irms corretos qualquer que seja a fase inicial. Sem
+ * cruzamentos não há período medido: frequency sai 0 nesse modo, e Q usa
+ * a frequência nominal.
+ *
+ * O núcleo não depende do ESP-IDF (compila também no host).
+ */
+
+#ifndef POWER_METER_H
+#define POWER_METER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "decimator.h"
+
+#ifndef POWER_METER_USE_ESP_DSP
+#define POWER_METER_USE_ESP_DSP     0
+#endif
+
+#define POWER_METER_MAX_PHASES      3
+#define POWER_METER_MAX_BLOCK       256     // Amostras por canal processadas de uma vez
+#define POWER_METER_MAX_CARRY       8       // Códigos de um canal à espera do par (quadro termina no meio do padrão)
+#define POWER_METER_CODE_BIAS       2048    // Código central (sensores polarizados em meia escala)
+#define POWER_METER_CIC_ORDER       4       // Ordem do CIC da decimação dos ciclos
+#define POWER_METER_DECIM_VALUES    4       // Grandezas decimadas por fase: P, Q, Vrms², Irms²
+#define POWER_METER_DECIM_QUEUE     4       // Saídas de uma fase à espera das outras
+
+/**
+ * @brief Parâmetros do medidor
+ */
+typedef struct {
+    uint32_t n_phases;                      // Fases (pares V/I no padrão), 1..POWER_METER_MAX_PHASES
+    float sample_rate_hz;                   // Amostras por segundo de cada canal
+    float mains_hz;                         // Frequência nominal da rede
+    float output_rate_hz;                   // Taxa de saída (médias dos ciclos)
+    float v_min_rms;                        // Piso da histerese do cruzamento por zero (V rms)
+    float i_skew;                           // Atraso da corrente em relação à tensão (amostras do canal)
+    bool cic_fir;                           // Ciclos -> taxa de saída pela cadeia CIC + FIR (senão média do intervalo)
+    float v_gain[POWER_METER_MAX_PHASES];   // V de rede por código (calibração × sensor)
+    float i_gain[POWER_METER_MAX_PHASES];   // A por código
+} power_meter_config_t;
+
+/**
+ * @brief Grandezas de uma fase em um ciclo ou em um intervalo de saída
+ */
+typedef struct {
+    float p;                    // Potência ativa (W)
+    float q;                    // Potência reativa da fundamental (var, > 0 indutiva)
+    float s;                    // Potência aparente Vrms·Irms (VA)
+    float pf;                   // Fator de potência P/S (0 sem corrente)
+    float v_rms;                // V
+    float i_rms;                // A
+} power_phase_t;
+
+/**
+ * @brief Saída na taxa NILM
+ */
+typedef struct {
+    power_phase_t phase[POWER_METER_MAX_PHASES];
+    float p;                    // Soma das fases (W)
+    float q;                    // Soma das fases (var)
+    float s;                    // Soma aritmética das fases (VA)
+    float pf;                   // p / s
+    float frequency;            // Frequência medida na fase 1 (Hz; 0 sem tensão e no modo janela)
+    uint16_t n_cycles;          // Ciclos da fase 1 no intervalo
+    uint8_t n_phases;
+} power_sample_t;
+
+/**
+ * @brief Estado de uma fase
+ *
+ * v_work guarda duas amostras de histórico (v[-2], v[-1]) antes do bloco e
+ * i_work uma (i[-1]): a amostra j do bloco é processada com v[j-1] e
+ * v[j+1], então a última amostra de cada bloco só entra no seguinte.
+ */
+typedef struct {
+    float v_gain, i_gain;
+    float v_work[POWER_METER_MAX_BLOCK + 2];
+    float i_work[POWER_METER_MAX_BLOCK + 1];
+    bool primed;                // Histórico preenchido
+    bool synced;                // Primeiro ciclo (parcial) já descartado
+    // Ciclo em curso
+    float sum_v, sum_i, sum_vv, sum_ii, sum_vi, sum_q, sum_dv;
+    uint32_t cycle_samples;
+    float cycle_offset;         // Posição do cruzamento que abriu o ciclo, relativa à 1ª amostra (-1, 0]
+    bool armed;                 // Tensão passou abaixo de -histerese
+    float hysteresis;           // V
+    power_phase_t cycle;        // Último ciclo completo
+    float cycle_hz;             // Frequência do último ciclo (0 se fechado sem cruzamento)
+    // Intervalo de saída
+    float acc_p, acc_q, acc_vv, acc_ii;     // Ponderados pelo número de amostras
+    float acc_period;           // Soma dos períodos (amostras) dos ciclos com cruzamento
+    uint32_t acc_samples;
+    uint16_t acc_cycles, acc_locked;
+    power_phase_t held;         // Última saída
+    float held_hz;
+    uint16_t held_cycles;
+    // Cadeia CIC + FIR
+    decimator_t decim[POWER_METER_DECIM_VALUES];
+    float decim_ref[POWER_METER_DECIM_VALUES];      // Grandezas do primeiro ciclo (regime do estado zero)
+    bool decim_primed;
+    power_phase_t decim_out[POWER_METER_DECIM_QUEUE];
+    float decim_hz[POWER_METER_DECIM_QUEUE];
+    uint16_t decim_cycles[POWER_METER_DECIM_QUEUE];
+    uint32_t n_decim_out;
+} power_meter_phase_t;
+
+/**
+ * @brief Estado do medidor
+ */
+typedef struct {
+    power_meter_config_t config;
+    power_meter_phase_t phase[POWER_METER_MAX_PHASES];
+    uint32_t n_channels;                    // 2 * n_phases
+    uint32_t interval;                      // Amostras por saída
+    uint32_t interval_count;                // Amostras no intervalo em curso
+    uint32_t min_cycle, max_cycle;          // Limites do ciclo (amostras)
+    uint32_t window;                        // Amostras por saída no modo janela (0 = ciclos da rede)
+    bool decimate;                          // cic_fir e intervalo = R·2·2^n (decim_config)
+    decimator_config_t decim_config;        // Cadeia dos ciclos (output_scale = 1)
+    uint16_t carry[2 * POWER_METER_MAX_PHASES][POWER_METER_MAX_CARRY];
+    uint32_t n_carry[2 * POWER_METER_MAX_PHASES];
+    uint32_t carry_dropped;                 // Códigos descartados por desalinhamento entre canais (desde init)
+} power_meter_t;
+
+// Protótipos de funções
+void power_meter_init(power_meter_t *pm, const power_meter_config_t *config);
+void power_meter_reset(power_meter_t *pm);
+void power_meter_set_window(power_meter_t *pm, uint32_t cycles);
+uint32_t power_meter_window_samples(const power_meter_t *pm, uint32_t cycles);
+size_t power_meter_process(power_meter_t *pm, const uint16_t *const codes[], const size_t counts[],
+                           power_sample_t *out, size_t max_out);
+
+#endif // POWER_METER_H
@@ -0,0 +1,169 @@
+/**
+ * @file running_stats.c
+ * @brief Implementação das estatísticas incrementais em janela deslizante
+ */
+
+#include "running_stats.h"
+#include <math.h>
+#include <stddef.h>
+
+/**
+ * @brief Inicializa as estatísticas sobre a memória do chamador
+ *
+ * @param rs Estado
+ * @param values Vetor com capacity floats (janela)
+ * @param min_deque Vetor com capacity posições, ou NULL sem mínimo
+ * @param max_deque Vetor com capacity posições, ou NULL sem máximo
+ * @param capacity Comprimento da janela (mínimo 1)
+ */
+void running_stats_init(running_stats_t *rs, float *values, uint32_t *min_deque, uint32_t *max_deque, uint32_t capacity) {
+    rs->values = values;
+    rs->min_deque = min_deque;
+    rs->max_deque = max_deque;
+    rs->capacity = (capacity < 1) ? 1 : capacity;
+    running_stats_reset(rs);
+}
+
+/**
+ * @brief Esvazia a janela
+ */
+void running_stats_reset(running_stats_t *rs) {
+    rs->count = 0;
+    rs->seq = 0;
+    rs->mean = 0.0;
+    rs->m2 = 0.0;
+    rs->min_head = rs->min_len = 0;
+    rs->max_head = rs->max_len = 0;
+}
+
+/**
+ * @brief Atualiza uma fila monotônica com a amostra de sequência seq
+ *
+ * Remove da frente as posições que saíram da janela e do fundo as que
+ * nunca mais serão extremo (valor pior ou igual ao novo).
+ *
+ * @param deque Fila circular de números de sequência
+ * @param head Índice da frente
+ * @param len Número de elementos
+ * @param sign +1 para máximo, -1 para mínimo
+ */
+static void deque_push(const running_stats_t *rs, uint32_t *deque, uint32_t *head, uint32_t *len,
+                       uint32_t seq, float x, float sign) {
+    const uint32_t cap = rs->capacity;
+
+    while (*len > 0) {
+        uint32_t front = deque[*head];
+        uint32_t age = (seq >= front) ? seq - front : seq + 2 * cap - front;
+        if (age < cap) {
+            break;
+        }
+        *head = (*head + 1 == cap) ? 0 : *head + 1;
+        (*len)--;
+    }
+
+    while (*len > 0) {
+        uint32_t back = *head + *len - 1;
+        if (back >= cap) back -= cap;
+        if (sign * rs->values[deque[back] % cap] > sign * x) {
+            break;
+        }
+        (*len)--;
+    }
+
+    uint32_t pos = *head + *len;
+    if (pos >= cap) pos -= cap;
+    deque[pos] = seq;
+    (*len)++;
+}
+
+/**
+ * @brief Insere uma amostra, descartando a mais antiga se a janela estiver cheia
+ *
+ * Welford deslizante: ao trocar x_old por x_new numa janela de n amostras,
+ *   mean' = mean + (x_new - x_old) / n
+ *   M2'   = M2 + (x_new - x_old) * (x_new - mean' + x_old - mean)
+ */
+void running_stats_push(running_stats_t *rs, float x) {
+    const uint32_t seq = rs->seq;
+    const uint32_t slot = seq % rs->capacity;
+
+    rs->seq = (seq + 1 == 2 * rs->capacity) ? 0 : seq + 1;
+
+    if (rs->count < rs->capacity) {
+        rs->count++;
+        double delta = x - rs->mean;
+        rs->mean += delta / rs->count;
+        rs->m2 += delta * (x - rs->mean);
+    } else {
+        double x_old = rs->values[slot];
+        double old_mean = rs->mean;
+        rs->mean += (x - x_old) / rs->count;
+        rs->m2 += (x - x_old) * (x - rs->mean + x_old - old_mean);
+        if (rs->m2 < 0.0) {
+            rs->m2 = 0.0;
+        }
+    }
+    rs->values[slot] = x;
+
+    if (rs->max_deque != NULL) {
+        deque_push(rs, rs->max_deque, &rs->max_head, &rs->max_len, seq, x, 1.0f);
+    }
+    if (rs->min_deque != NULL) {
+        deque_push(rs, rs->min_deque, &rs->min_head, &rs->min_len, seq, x, -1.0f);
+    }
+}
+
+/**
+ * @brief Indica se a janela já contém capacity amostras
+ */
+bool running_stats_full(const running_stats_t *rs) {
+    return rs->count == rs->capacity;
+}
+
+/**
+ * @brief Soma das amostras da janela
+ */
+float running_stats_sum(const running_stats_t *rs) {
+    return (float)(rs->mean * rs->count);
+}
+
+/**
+ * @brief Média das amostras da janela (0 se vazia)
+ */
+float running_stats_mean(const running_stats_t *rs) {
+    return (float)rs->mean;
+}
+
+/**
+ * @brief Variância amostral (n - 1) da janela (0 com menos de 2 amostras)
+ */
+float running_stats_variance(const running_stats_t *rs) {
+    return (rs->count > 1) ? (float)(rs->m2 / (rs->count - 1)) : 0.0f;
+}
+
+/**
+ * @brief Desvio padrão amostral da janela
+ */
+float running_stats_stddev(const running_stats_t *rs) {
+    return sqrtf(running_stats_variance(rs));
+}
+
+/**
+ * @brief Mínimo da janela (NAN se vazia ou sem fila de mínimo)
+ */
+float running_stats_min(const running_stats_t *rs) {
+    if (rs->min_deque == NULL || rs->min_len == 0) {
+        return NAN;
+    }
+    return rs->values[rs->min_deque[rs->min_head] % rs->capacity];
+}
+
+/**
+ * @brief Máximo da janela (NAN se vazia ou sem fila de máximo)
+ */
+float running_stats_max(const running_stats_t *rs) {
+    if (rs->max_deque == NULL || rs->max_len == 0) {
+        return NAN;
+    }
+    return rs->values[rs->max_deque[rs->max_head] % rs->capacity];
+}
@@ -0,0 +1,54 @@
+/**
+ * @file running_stats.h
+ * @brief Estatísticas incrementais em janela deslizante com custo O(1) por amostra
+ *
+ * Mantém, para as últimas `capacity` amostras:
+ *  - soma e média;
+ *  - variância pelo método de Welford deslizante (atualização com a
+ *    amostra que entra e a que sai, sem somas de quadrados);
+ *  - mínimo e máximo por filas monotônicas (custo amortizado O(1)).
+ *
+ * Toda a memória é fornecida pelo chamador (vetores estáticos), de modo
+ * que janelas de minutos a 10 Hz custam apenas RAM, não processamento.
+ * Nenhuma dependência do ESP-IDF.
+ */
+
+#ifndef RUNNING_STATS_H
+#define RUNNING_STATS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * @brief Estado das estatísticas de uma janela
+ *
+ * As filas de mínimo/máximo guardam números de sequência das amostras
+ * (o valor é lido de values[seq % capacity]). Média e M2 são acumulados
+ * em double para que janelas longas não acumulem erro de arredondamento.
+ */
+typedef struct {
+    float *values;              // Janela circular (capacity amostras)
+    uint32_t *min_deque;        // Fila monotônica crescente (opcional, NULL desativa)
+    uint32_t *max_deque;        // Fila monotônica decrescente (opcional, NULL desativa)
+    uint32_t capacity;          // Comprimento da janela
+    uint32_t count;             // Amostras válidas (<= capacity)
+    uint32_t seq;               // Número de sequência da próxima amostra (módulo 2*capacity)
+    double mean;                // Média da janela
+    double m2;                  // Soma dos quadrados dos desvios (Welford)
+    uint32_t min_head, min_len;
+    uint32_t max_head, max_len;
+} running_stats_t;
+
+// Protótipos de funções
+void running_stats_init(running_stats_t *rs, float *values, uint32_t *min_deque, uint32_t *max_deque, uint32_t capacity);
+void running_stats_reset(running_stats_t *rs);
+void running_stats_push(running_stats_t *rs, float x);
+bool running_stats_full(const running_stats_t *rs);
+float running_stats_sum(const running_stats_t *rs);
+float running_stats_mean(const running_stats_t *rs);
+float running_stats_variance(const running_stats_t *rs);
+float running_stats_stddev(const running_stats_t *rs);
+float running_stats_min(const running_stats_t *rs);
+float running_stats_max(const running_stats_t *rs);
+
+#endif // RUNNING_STATS_H
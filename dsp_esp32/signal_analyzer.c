@@ -8,6 +8,17 @@
 #include "hal/adc_types.h"
 #include "esp_log.h"
 #include "esp_dsp.h"
+#include "telemetry.h"
+#include "frame_ring.h"
+#include "nilm_filters.h"
+#include "pipeline_config.h"
+#include "perf_probe.h"
+#include "goertzel.h"
+#include "sliding_dft.h"
+#include "adc_frame.h"
+#include "split_radix.h"
+#include "fir_engine.h"
+#include "esp_timer.h"
 
 #define TAG "SIGNAL_ANALYZER"
 
@@ -16,31 +27,190 @@
 #define SAMPLE_FREQ_HZ 10000
 #define FILTER_FC 1000  // Frequência de corte do filtro passa-baixas (1kHz)
 
+// Filtro passa-baixas antes do espectro: FILTER_IIR = biquad Butterworth de
+// 2ª ordem; FILTER_FIR = FIR de fase linear de FIR_TAPS coeficientes
+// (fir_engine.h: forma direta até FIR_ENGINE_DIRECT_MAX_TAPS, overlap-save
+// com a FFT complexa do espectro acima disso). O FIR atrasa a saída de
+// fir_engine_delay() amostras (mais de um quadro no overlap-save), e o
+// sinal original é atrasado do mesmo tanto antes do espectro e do envio
+#define FILTER_IIR      0
+#define FILTER_FIR      1
+#ifndef FILTER_TYPE
+#define FILTER_TYPE     FILTER_IIR
+#endif
+#define FIR_TAPS        255     // Ímpar; 255 a 10 kHz: transição de ≈ 130 Hz (Hamming)
+
+// Modos de cálculo do espectro (ambos os sinais são reais)
+#define FFT_MODE_COMPLEX 0  // Uma FFT complexa de N pontos por sinal (parte imaginária zerada)
+#define FFT_MODE_DUAL    1  // Original e filtrado empacotados em uma única FFT complexa
+#define FFT_MODE_REAL    2  // FFT real via FFT complexa de N/2 pontos, um sinal por vez
+#ifndef FFT_MODE
+#define FFT_MODE FFT_MODE_DUAL
+#endif
+#define FFT_COMPLEX_N    ((FFT_MODE == FFT_MODE_REAL) ? N_SAMPLES / 2 : N_SAMPLES)
+
+// Núcleo da FFT complexa (saída sempre em ordem natural): radix-2 do esp-dsp,
+// radix-4 do esp-dsp (só N potência de 4), split-radix de split_radix.c, ou
+// FFT_KERNEL_AUTO = mede os candidatos na partida e fica com o mais rápido
+#define FFT_KERNEL_RADIX2   0
+#define FFT_KERNEL_RADIX4   1
+#define FFT_KERNEL_SPLIT    2
+#define FFT_KERNEL_AUTO     3
+#ifndef FFT_KERNEL
+#define FFT_KERNEL FFT_KERNEL_AUTO
+#endif
+#define FFT_RADIX4_SUPPORTED ((FFT_COMPLEX_N == 256) || (FFT_COMPLEX_N == 1024))
+#define FFT_BENCH_RUNS      16      // Transformadas por candidato na medição da partida
+
+// Espectro médio de Welch: segmentos sobrepostos com janela de Hann, potência
+// acumulada no domínio linear e conversão para dB apenas no envio
+#ifndef SPECTRUM_WELCH
+#define SPECTRUM_WELCH          1
+#endif
+#define WELCH_OVERLAP_PERCENT   50      // Sobreposição entre segmentos (0, 50 ou 75)
+#define WELCH_AVERAGE_FRAMES    ((SEND_INTERVAL < 8) ? SEND_INTERVAL : 8)   // Quadros por espectro enviado
+#define WELCH_HOP               (N_SAMPLES * (100 - WELCH_OVERLAP_PERCENT) / 100)
+_Static_assert(N_SAMPLES % WELCH_HOP == 0, "N_SAMPLES deve ser múltiplo do passo de Welch");
+#if SPECTRUM_WELCH && FFT_MODE == FFT_MODE_REAL
+#error "SPECTRUM_WELCH transforma os dois sinais em uma FFT complexa de N pontos; use FFT_MODE_DUAL ou FFT_MODE_COMPLEX"
+#endif
+
 // ADC
 adc_channel_t ADC_CHANNEL[1] = {ADC_CHANNEL_5};
 static adc_continuous_handle_t adc_handle = NULL;
 static TaskHandle_t cb_task_handle = NULL;
 static TaskHandle_t analysis_task_handle = NULL;
 
-// Buffers
-static float adc_buffer[N_SAMPLES];
+// Buffers (slots pertencem à aquisição; a análise processa no próprio slot)
+#define ADC_RING_SLOTS PIPELINE_ADC_FRAME_SLOTS
+static float adc_slots[ADC_RING_SLOTS][N_SAMPLES] __attribute__((aligned(16)));
+static frame_ring_t adc_ring;
+static volatile uint32_t adc_pool_overflows = 0;  // Pool do driver cheio (aquisição atrasada)
+static volatile int64_t adc_conv_done_us = 0;      // Instante do último quadro de DMA (esp_timer)
+static int64_t adc_slot_time_us[ADC_RING_SLOTS];   // Instante de DMA que completou cada slot
 static float filtered_buffer[N_SAMPLES];
-static int adc_index = 0;
-static volatile bool buffer_full = false;
+
+// Leitura do driver (um quadro de conversão) e decodificação calibrada direto no slot
+static uint8_t adc_read_buf[PIPELINE_ADC_CONV_FRAME_BYTES];
+static adc_frame_decoder_t adc_decoder;
+static float adc_cal_lut[ADC_FRAME_CODE_COUNT];    // Curva do eFuse: código -> V
 
 // FFT buffers
 static float window[N_SAMPLES] __attribute__((aligned(16)));
 static float fft_input[N_SAMPLES * 2] __attribute__((aligned(16)));
+#if FFT_MODE == FFT_MODE_REAL
+static float rfft_twiddle[N_SAMPLES] __attribute__((aligned(16)));  // [cos, sin](2πk/N), k < N/2
+#endif
 static float mag_db_original[N_SAMPLES / 2];
 static float mag_db_filtered[N_SAMPLES / 2];
+static split_radix_fft_t split_fft;
+static int fft_kernel = FFT_KERNEL;     // Núcleo em uso (resolvido na partida se AUTO)
+static const char *const fft_kernel_names[] = { "esp-dsp radix-2", "esp-dsp radix-4", "split-radix" };
+
+#if SPECTRUM_WELCH
+// Estado do Welch: quadro anterior (segmentos que cruzam a fronteira) e potência acumulada
+static float welch_prev_original[N_SAMPLES];
+static float welch_prev_filtered[N_SAMPLES];
+static bool welch_prev_valid = false;
+static float welch_power_original[N_SAMPLES / 2];
+static float welch_power_filtered[N_SAMPLES / 2];
+static uint32_t welch_segments = 0;
+#endif
+
+// Harmônicas da rede (banco de Goertzel, a cada quadro)
+#define HARMONIC_TRACKING       1
+#define MAINS_FREQ_HZ           60.0f   // Frequência nominal da rede
+#define HARMONIC_COUNT          15      // Harmônicas 1..15
 
-// Filtro IIR passa-baixas
-static float coeffs_lp[5];
-static float w_lp[5] = {0};
+#if HARMONIC_TRACKING
+static goertzel_bank_t harmonic_bank;
+static goertzel_harmonic_t harmonics[GOERTZEL_MAX_HARMONICS];
+static float harmonic_input[N_SAMPLES] __attribute__((aligned(16)));
+static uint32_t harmonic_last_dropped = 0;
+#endif
+
+#if FILTER_TYPE == FILTER_FIR
+// Filtro FIR passa-baixas (compilar com FIR_ENGINE_USE_ESP_DSP=1 para dsps_fir_f32)
+static fir_engine_t lp_fir;
+static float fir_coeffs[FIR_TAPS];
+
+// Linha de atraso do sinal original (fir_engine_delay() < 2·FIR_ENGINE_MAX_FFT)
+#define RAW_DELAY_MAX   (2 * FIR_ENGINE_MAX_FFT)
+static float raw_line[RAW_DELAY_MAX + N_SAMPLES];
+static float raw_aligned[N_SAMPLES];
+static uint32_t raw_delay = 0;
+#else
+// Filtro IIR passa-baixas (motor de nilm_filters; compilar com NILM_FILTERS_USE_ESP_DSP=1)
+static biquad_section_t lp_section;
+#endif
 
 // Contador para controlar envio de dados
 static uint32_t sample_counter = 0;
-static const uint32_t SEND_INTERVAL = 100; // Enviar a cada 100 aquisições
+#define SEND_INTERVAL 1         // Enviar a cada SEND_INTERVAL quadros (1 = todos, ~20 pacotes/s)
+
+// Instrumentação dos estágios (exportada a cada PERF_REPORT_MS)
+#define PERF_REPORT_MS 10000
+static perf_stage_t perf_acq = PERF_STAGE_INIT("adc_read", PERF_UNIT_PROBE);
+static perf_stage_t perf_filter = PERF_STAGE_INIT("lowpass", PERF_UNIT_PROBE);
+static perf_stage_t perf_fft = PERF_STAGE_INIT("fft", PERF_UNIT_PROBE);
+static perf_stage_t perf_send = PERF_STAGE_INIT("send", PERF_UNIT_PROBE);
+static perf_stage_t perf_latency = PERF_STAGE_INIT("dma2ana", PERF_UNIT_US);
+static perf_stage_t perf_harmonic = PERF_STAGE_INIT("harmonic", PERF_UNIT_PROBE);
+
+// Formato dos blocos no tempo: F32, I16 (escala por bloco) ou DELTA_VARINT
+// (passo de 1 LSB calibrado do ADC: erro <= 0.5 LSB no sinal original, ~1-2 bytes/amostra)
+#define SIGNAL_FORMAT TELEMETRY_FORMAT_DELTA_VARINT
+
+// Envio dos espectros
+#define SPECTRUM_FULL           0       // Todos os N/2 bins em float32
+#define SPECTRUM_ABOVE_FLOOR    1       // Só bins acima da mediana + SPECTRUM_FLOOR_MARGIN_DB
+#define SPECTRUM_LOG_BANDS      2       // Pico de cada uma de SPECTRUM_LOG_BAND_COUNT bandas log
+#define SPECTRUM_ENCODING       SPECTRUM_LOG_BANDS
+#define SPECTRUM_FLOOR_MARGIN_DB 10.0f
+#define SPECTRUM_LOG_BAND_COUNT 64
+
+// Pior caso de um pacote no fio. DELTA_VARINT: raw de 13 bits (passo de 1 LSB
+// de 12 bits), diferença zig-zag < 2^14, 2 bytes por amostra
+#define FRAME_OVERHEAD_BYTES    (TELEMETRY_HEADER_SIZE + TELEMETRY_CRC_SIZE)
+#define SIGNAL_BLOCK_MAX_BYTES  ((SIGNAL_FORMAT == TELEMETRY_FORMAT_F32) ? 4 * N_SAMPLES : 2 * N_SAMPLES)
+#define SPECTRUM_BLOCK_MAX_BYTES ((SPECTRUM_ENCODING == SPECTRUM_LOG_BANDS) ? 4 * SPECTRUM_LOG_BAND_COUNT : 2 * N_SAMPLES)
+#define HARMONIC_BLOCK_MAX_BYTES (HARMONIC_TRACKING * (FRAME_OVERHEAD_BYTES + sizeof(goertzel_record_header_t) + \
+                                                       GOERTZEL_MAX_HARMONICS * 2 * sizeof(float)))
+#define PACKET_MAX_BYTES        (2 * (FRAME_OVERHEAD_BYTES + SIGNAL_BLOCK_MAX_BYTES) + \
+                                 2 * (FRAME_OVERHEAD_BYTES + SPECTRUM_BLOCK_MAX_BYTES) + HARMONIC_BLOCK_MAX_BYTES)
+// Os pacotes cabem em 3/4 do enlace; o resto fica para log, PERF e eventos
+_Static_assert((uint64_t)PACKET_MAX_BYTES * SAMPLE_FREQ_HZ / ((uint64_t)N_SAMPLES * SEND_INTERVAL)
+                   <= 3 * (uint64_t)TELEMETRY_LINK_BYTES_PER_S / 4,
+               "enlace lento demais para SEND_INTERVAL: aumente TELEMETRY_UART_BAUD_RATE ou use USB-Serial-JTAG");
+
+#if SPECTRUM_ENCODING != SPECTRUM_FULL
+static uint16_t spectrum_bins[N_SAMPLES / 2];
+static float spectrum_values[N_SAMPLES / 2];
+#endif
+#if SPECTRUM_ENCODING == SPECTRUM_LOG_BANDS
+static uint16_t log_band_start[SPECTRUM_LOG_BAND_COUNT + 1];  // Bin inicial de cada banda (+ fim)
+static int log_band_count = 0;
+#endif
+
+// DFT deslizante na aquisição (transitórios amostra a amostra, sem esperar o quadro)
+#define SLIDING_DFT_MODE        1
+#define SDFT_WINDOW             500     // 50 ms: bins de 20 Hz, harmônicas de 60 Hz exatas
+#define SDFT_REANCHOR_SAMPLES   10000   // Re-ancoragem de todos os bins a cada 1 s
+#define SDFT_EVENT_RATIO        1.5f    // Disparo: amplitude > 1.5x ou < 1/1.5x da média
+#define SDFT_EVENT_MIN_AMPL     0.02f   // Amplitude mínima (V) para considerar o bin
+#define SDFT_BASELINE_SAMPLES   5000    // Constante de tempo da média (0.5 s)
+#define SDFT_HOLDOFF_SAMPLES    5000    // Intervalo mínimo entre disparos do mesmo bin
+
+#if SLIDING_DFT_MODE
+static const uint16_t sdft_bins[] = { 3, 9, 15, 21 };   // 60, 180, 300, 420 Hz
+#define SDFT_N_BINS (sizeof(sdft_bins) / sizeof(sdft_bins[0]))
+static sliding_dft_t sdft;
+static float sdft_history[SDFT_WINDOW];
+static float sdft_baseline[SDFT_N_BINS];        // Média de |X_k|² (sem normalização)
+static uint32_t sdft_last_event[SDFT_N_BINS];
+static uint32_t sdft_sample_index = 0;
+static uint32_t sdft_events = 0;
+#endif
 
 /**
  * Callback do ADC
@@ -49,48 +219,244 @@ static bool IRAM_ATTR adc_callback(adc_continuous_handle_t handle,
                                    const adc_continuous_evt_data_t *edata, 
                                    void *user_data) {
     BaseType_t must_yield = pdFALSE;
+    adc_conv_done_us = esp_timer_get_time();
     vTaskNotifyGiveFromISR(cb_task_handle, &must_yield);
     return (must_yield == pdTRUE);
 }
 
+/**
+ * Callback de overflow do pool do driver ADC
+ */
+static bool IRAM_ATTR adc_pool_ovf_callback(adc_continuous_handle_t handle,
+                                            const adc_continuous_evt_data_t *edata,
+                                            void *user_data) {
+    adc_pool_overflows++;
+    return false;
+}
+
+#if SLIDING_DFT_MODE
+/**
+ * Atualiza a SDFT com uma amostra e procura saltos de amplitude nos bins
+ *
+ * Compara |X_k|² com uma média exponencial lenta (razões ao quadrado, sem
+ * raiz por amostra). A média só começa depois que a janela se enche e,
+ * durante o holdoff após um disparo, segue 10x mais rápido para alcançar
+ * o novo nível antes de poder disparar de novo.
+ */
+static void sdft_update(float voltage, int64_t dma_time_us) {
+    const float alpha = 1.0f / SDFT_BASELINE_SAMPLES;
+    const float ratio2 = SDFT_EVENT_RATIO * SDFT_EVENT_RATIO;
+    const float min_power = 0.25f * SDFT_EVENT_MIN_AMPL * SDFT_EVENT_MIN_AMPL * SDFT_WINDOW * SDFT_WINDOW;
+    
+    sliding_dft_push(&sdft, voltage);
+    uint32_t n = sdft_sample_index++;
+    if (n < SDFT_WINDOW) {
+        return;
+    }
+    
+    for (uint32_t i = 0; i < SDFT_N_BINS; i++) {
+        float power = sliding_dft_power(&sdft, i);
+        float baseline = sdft_baseline[i];
+        
+        if (n == SDFT_WINDOW) {
+            sdft_baseline[i] = power;
+            sdft_last_event[i] = n;
+            continue;
+        }
+        
+        bool large = (power > min_power || baseline > min_power);
+        bool jump = (power > baseline * ratio2 || power * ratio2 < baseline);
+        if (large && jump && n - sdft_last_event[i] >= SDFT_HOLDOFF_SAMPLES) {
+            sdft_last_event[i] = n;
+            sdft_events++;
+            
+            sliding_dft_event_record_t rec = {
+                .time_us = dma_time_us,
+                .sample_index = n,
+                .bin = sdft_bins[i],
+                .window = SDFT_WINDOW,
+                .amplitude = 2.0f * sqrtf(power) / SDFT_WINDOW,
+                .baseline = 2.0f * sqrtf(baseline) / SDFT_WINDOW,
+            };
+            telemetry_send_raw(TELEMETRY_TYPE_SPECTRAL_EVENT, sdft_events, &rec, sizeof(rec), 0);
+        }
+        float rate = (n - sdft_last_event[i] < SDFT_HOLDOFF_SAMPLES) ? 10.0f * alpha : alpha;
+        sdft_baseline[i] = baseline + rate * (power - baseline);
+    }
+}
+#endif
+
 /**
  * Task de callback do ADC - coleta dados
  */
 static void cbTask(void *param) {
-    uint8_t buf[256];
     uint32_t ret_num = 0;
+    float *frame = (float *)frame_ring_write_slot(&adc_ring);
+    size_t adc_index = 0;
     
     while (1) {
         ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
         
-        esp_err_t ret = adc_continuous_read(adc_handle, buf, sizeof(buf), &ret_num, 0);
+        uint32_t t0 = perf_probe_begin();
+        int64_t dma_time_us = adc_conv_done_us;
+        esp_err_t ret = adc_continuous_read(adc_handle, adc_read_buf, sizeof(adc_read_buf), &ret_num, 0);
         if (ret == ESP_OK && ret_num > 0) {
-            for (int i = 0; i < ret_num; i += SOC_ADC_DIGI_RESULT_BYTES) {
-                adc_digi_output_data_t *data = (adc_digi_output_data_t *)&buf[i];
-                
-                if (data->type2.channel == ADC_CHANNEL[0]) {
-                    // Converte para tensão (0-3.3V)
-                    float voltage = (float)data->type2.data * 3.3f / 4095.0f;
-                    
-                    adc_buffer[adc_index++] = voltage;
+            // Tensões calibradas direto no slot; o quadro do driver pode completar um slot no meio
+            size_t pos = 0;
+            while (pos < ret_num) {
+                size_t start = adc_index;
+                pos += adc_frame_decode_volts(&adc_decoder, &adc_read_buf[pos], ret_num - pos,
+                                              &frame, N_SAMPLES, &adc_index);
+#if SLIDING_DFT_MODE
+                for (size_t k = start; k < adc_index; k++) {
+                    sdft_update(frame[k], dma_time_us);
+                }
+#endif
+                if (adc_index == N_SAMPLES) {
+                    adc_index = 0;
                     
-                    if (adc_index >= N_SAMPLES) {
-                        adc_index = 0;
-                        buffer_full = true;
-                        
-                        // Notifica task de análise
+                    // Publica o quadro; em overrun o slot é reaproveitado
+                    adc_slot_time_us[(frame - &adc_slots[0][0]) / N_SAMPLES] = dma_time_us;
+                    if (frame_ring_commit(&adc_ring)) {
                         xTaskNotifyGive(analysis_task_handle);
                     }
+                    frame = (float *)frame_ring_write_slot(&adc_ring);
                 }
             }
+#if SLIDING_DFT_MODE
+            sliding_dft_maintain(&sdft);
+#endif
+            perf_probe_end(&perf_acq, t0);
         }
     }
 }
 
 /**
- * Calcula FFT e retorna magnitude em dB
+ * Converte |X|² em dB, normalizado por N (equivale a 20*log10(|X|/N))
  */
-static void calculate_fft(float *input, float *mag_output) {
+static inline float power_to_db(float real, float imag) {
+    const float inv_n2 = 1.0f / ((float)N_SAMPLES * (float)N_SAMPLES);
+    return 10.0f * log10f((real * real + imag * imag) * inv_n2 + 1e-24f);
+}
+
+#if FFT_MODE == FFT_MODE_REAL
+/**
+ * Pré-calcula os fatores de giro usados na separação da FFT real
+ */
+static void init_rfft_twiddle(void) {
+    for (int k = 0; k < N_SAMPLES / 2; k++) {
+        float theta = 2.0f * (float)M_PI * k / N_SAMPLES;
+        rfft_twiddle[2 * k] = cosf(theta);
+        rfft_twiddle[2 * k + 1] = sinf(theta);
+    }
+}
+#endif
+
+/**
+ * FFT complexa in-place de n pontos em ordem natural com o núcleo escolhido
+ */
+static void fft_complex(float *data, int n) {
+    switch (fft_kernel) {
+#if FFT_RADIX4_SUPPORTED
+    case FFT_KERNEL_RADIX4:
+        dsps_fft4r_fc32(data, n);
+        dsps_bit_rev4r_fc32(data, n);
+        break;
+#endif
+    case FFT_KERNEL_SPLIT:
+        split_radix_fft(&split_fft, data, true);
+        break;
+    default:
+        dsps_fft2r_fc32(data, n);
+        dsps_bit_rev_fc32(data, n);
+        break;
+    }
+}
+
+/**
+ * Inicializa os núcleos de FFT e, com FFT_KERNEL_AUTO, escolhe o de menos ciclos
+ *
+ * Cada candidato transforma FFT_BENCH_RUNS vezes o mesmo bloco (a janela de
+ * Hann, só para ter dados não nulos) e vale o menor tempo medido, que
+ * descarta as interrupções.
+ *
+ * @return false se o núcleo pedido (ou nenhum, no AUTO) puder ser inicializado
+ */
+static bool fft_kernel_select(void) {
+    const bool available[3] = {
+        dsps_fft2r_init_fc32(NULL, N_SAMPLES) == ESP_OK,
+#if FFT_RADIX4_SUPPORTED
+        dsps_fft4r_init_fc32(NULL, FFT_COMPLEX_N) == ESP_OK,
+#else
+        false,
+#endif
+        split_radix_init(&split_fft, FFT_COMPLEX_N),
+    };
+    
+#if FFT_KERNEL == FFT_KERNEL_AUTO
+    uint32_t best_cycles = UINT32_MAX;
+    int best = -1;
+    for (int k = 0; k < 3; k++) {
+        if (!available[k]) {
+            continue;
+        }
+        fft_kernel = k;
+        uint32_t min_cycles = UINT32_MAX;
+        for (int run = 0; run < FFT_BENCH_RUNS; run++) {
+            for (int i = 0; i < FFT_COMPLEX_N; i++) {
+                fft_input[2 * i] = window[i];
+                fft_input[2 * i + 1] = 0.0f;
+            }
+            uint32_t t0 = esp_cpu_get_cycle_count();
+            fft_complex(fft_input, FFT_COMPLEX_N);
+            uint32_t cycles = esp_cpu_get_cycle_count() - t0;
+            min_cycles = (cycles < min_cycles) ? cycles : min_cycles;
+        }
+        ESP_LOGI(TAG, "FFT kernel %s: %lu cycles per %d-point transform",
+                 fft_kernel_names[k], min_cycles, FFT_COMPLEX_N);
+        if (min_cycles < best_cycles) {
+            best_cycles = min_cycles;
+            best = k;
+        }
+    }
+    fft_kernel = best;
+    return best >= 0;
+#else
+    return available[fft_kernel];
+#endif
+}
+
+#if !SPECTRUM_WELCH && FFT_MODE != FFT_MODE_DUAL
+/**
+ * Calcula FFT e retorna magnitude em dB (um sinal por vez, sem Welch)
+ */
+static void calculate_fft(const float *input, float *mag_output) {
+#if FFT_MODE == FFT_MODE_REAL
+    // Amostras pares/ímpares como parte real/imaginária de N/2 pontos complexos
+    const int half = N_SAMPLES / 2;
+    for (int i = 0; i < N_SAMPLES; i++) {
+        fft_input[i] = input[i] * window[i];
+    }
+    
+    fft_complex(fft_input, half);
+    
+    // X[k] = E[k] + W^k O[k], com E/O obtidos de Z[k] e conj(Z[N/2 - k])
+    for (int k = 0; k < half; k++) {
+        int m = (half - k) % half;
+        float zr = fft_input[2 * k], zi = fft_input[2 * k + 1];
+        float cr = fft_input[2 * m], ci = fft_input[2 * m + 1];
+        
+        float even_r = 0.5f * (zr + cr);
+        float even_i = 0.5f * (zi - ci);
+        float odd_r = 0.5f * (zi + ci);
+        float odd_i = -0.5f * (zr - cr);
+        
+        float c = rfft_twiddle[2 * k], s = rfft_twiddle[2 * k + 1];
+        float real = even_r + c * odd_r + s * odd_i;
+        float imag = even_i + c * odd_i - s * odd_r;
+        mag_output[k] = power_to_db(real, imag);
+    }
+#else
     // Prepara entrada da FFT (windowing)
     for (int i = 0; i < N_SAMPLES; i++) {
         fft_input[2 * i] = input[i] * window[i];      // Real
@@ -98,67 +464,314 @@ static void calculate_fft(float *input, float *mag_output) {
     }
     
     // Executa FFT
-    dsps_fft2r_fc32(fft_input, N_SAMPLES);
-    dsps_bit_rev_fc32(fft_input, N_SAMPLES);
+    fft_complex(fft_input, N_SAMPLES);
     dsps_cplx2reC_fc32(fft_input, N_SAMPLES);
     
     // Calcula magnitude em dB
     for (int i = 0; i < N_SAMPLES / 2; i++) {
-        float real = fft_input[2 * i];
-        float imag = fft_input[2 * i + 1];
-        float magnitude = sqrtf(real * real + imag * imag);
-        mag_output[i] = 20.0f * log10f(magnitude / N_SAMPLES + 1e-12f);
+        mag_output[i] = power_to_db(fft_input[2 * i], fft_input[2 * i + 1]);
     }
+#endif
 }
+#endif
+
+#if SPECTRUM_WELCH || FFT_MODE == FFT_MODE_DUAL
 
 /**
- * Envia dados do sinal original
+ * FFT complexa de fft_input com separação dos dois espectros reais
+ *
+ * A entrada tem o sinal A na parte real e o B na imaginária;
+ * dsps_cplx2reC_fc32 separa os espectros: os primeiros N/2 bins
+ * pertencem a A e os N/2 seguintes a B.
+ */
+static void fft_dual_transform(void) {
+    fft_complex(fft_input, N_SAMPLES);
+    dsps_cplx2reC_fc32(fft_input, N_SAMPLES);
+}
+#endif
+
+#if !SPECTRUM_WELCH && FFT_MODE == FFT_MODE_DUAL
+/**
+ * Calcula os espectros de dois sinais reais com uma única FFT complexa (sem Welch)
+ *
+ * input_a vai na parte real e input_b na imaginária (ver fft_dual_transform).
  */
-static void send_original_signal(void) {
-    printf("---SIGNAL_ORIGINAL_START---\n");
+static void calculate_fft_dual(const float *input_a, const float *input_b,
+                               float *mag_a, float *mag_b) {
     for (int i = 0; i < N_SAMPLES; i++) {
-        float time = (float)i / SAMPLE_FREQ_HZ;
-        printf("%.6f,%.6f\n", time, adc_buffer[i]);
+        fft_input[2 * i] = input_a[i] * window[i];
+        fft_input[2 * i + 1] = input_b[i] * window[i];
+    }
+    
+    fft_dual_transform();
+    
+    const float *spectrum_a = &fft_input[0];
+    const float *spectrum_b = &fft_input[N_SAMPLES];
+    for (int i = 0; i < N_SAMPLES / 2; i++) {
+        mag_a[i] = power_to_db(spectrum_a[2 * i], spectrum_a[2 * i + 1]);
+        mag_b[i] = power_to_db(spectrum_b[2 * i], spectrum_b[2 * i + 1]);
     }
-    printf("---SIGNAL_ORIGINAL_END---\n");
 }
+#endif
 
+#if SPECTRUM_WELCH
 /**
- * Envia dados do sinal filtrado
+ * Acumula a potência dos segmentos de Welch que terminam no quadro atual
+ *
+ * O segmento j termina na amostra (j+1)*WELCH_HOP do quadro atual; as
+ * amostras anteriores ao início do quadro vêm do quadro anterior. Ambos
+ * os sinais são transformados juntos (empacotamento real/imaginário).
+ */
+static void welch_accumulate(const float *original, const float *filtered) {
+    for (int end = WELCH_HOP; end <= N_SAMPLES; end += WELCH_HOP) {
+        int start = end - N_SAMPLES;  // <= 0: início relativo ao quadro atual
+        if (start < 0 && !welch_prev_valid) {
+            continue;
+        }
+        
+        for (int i = 0; i < N_SAMPLES; i++) {
+            int idx = start + i;
+            float a = (idx < 0) ? welch_prev_original[N_SAMPLES + idx] : original[idx];
+            float b = (idx < 0) ? welch_prev_filtered[N_SAMPLES + idx] : filtered[idx];
+            fft_input[2 * i] = a * window[i];
+            fft_input[2 * i + 1] = b * window[i];
+        }
+        
+        fft_dual_transform();
+        
+        const float *spectrum_a = &fft_input[0];
+        const float *spectrum_b = &fft_input[N_SAMPLES];
+        for (int k = 0; k < N_SAMPLES / 2; k++) {
+            welch_power_original[k] += spectrum_a[2 * k] * spectrum_a[2 * k] + spectrum_a[2 * k + 1] * spectrum_a[2 * k + 1];
+            welch_power_filtered[k] += spectrum_b[2 * k] * spectrum_b[2 * k] + spectrum_b[2 * k + 1] * spectrum_b[2 * k + 1];
+        }
+        welch_segments++;
+    }
+}
+
+/**
+ * Guarda o quadro atual para os segmentos que cruzam a próxima fronteira
+ */
+static void welch_store_previous(const float *original, const float *filtered) {
+    memcpy(welch_prev_original, original, sizeof(welch_prev_original));
+    memcpy(welch_prev_filtered, filtered, sizeof(welch_prev_filtered));
+    welch_prev_valid = true;
+}
+
+/**
+ * Converte a potência média acumulada para dB e reinicia o acumulador
+ */
+static void welch_finish(float *mag_a, float *mag_b) {
+    const float scale = 1.0f / ((float)N_SAMPLES * (float)N_SAMPLES * (float)(welch_segments ? welch_segments : 1));
+    for (int k = 0; k < N_SAMPLES / 2; k++) {
+        mag_a[k] = 10.0f * log10f(welch_power_original[k] * scale + 1e-24f);
+        mag_b[k] = 10.0f * log10f(welch_power_filtered[k] * scale + 1e-24f);
+    }
+    
+    memset(welch_power_original, 0, sizeof(welch_power_original));
+    memset(welch_power_filtered, 0, sizeof(welch_power_filtered));
+    welch_segments = 0;
+}
+#endif
+
+#if HARMONIC_TRACKING
+/**
+ * Harmônicas 1..HARMONIC_COUNT do quadro e rastreamento de f0
+ *
+ * A média é removida antes da janela de Hann: o offset de 1.65 V do ADC
+ * vazaria para a fundamental (a 3 bins de DC com N = 512).
  */
-static void send_filtered_signal(void) {
-    printf("---SIGNAL_FILTERED_START---\n");
+static void update_harmonics(const float *frame) {
+    float mean = 0.0f;
+    for (int i = 0; i < N_SAMPLES; i++) {
+        mean += frame[i];
+    }
+    mean /= N_SAMPLES;
     for (int i = 0; i < N_SAMPLES; i++) {
-        float time = (float)i / SAMPLE_FREQ_HZ;
-        printf("%.6f,%.6f\n", time, filtered_buffer[i]);
+        harmonic_input[i] = (frame[i] - mean) * window[i];
     }
-    printf("---SIGNAL_FILTERED_END---\n");
+    
+    goertzel_bank_process(&harmonic_bank, harmonic_input, harmonics);
+    
+    // Fase só é comparável entre quadros consecutivos (sem descarte no buffer)
+    uint32_t dropped = frame_ring_dropped(&adc_ring);
+    if (dropped != harmonic_last_dropped) {
+        harmonic_last_dropped = dropped;
+        goertzel_bank_reset_tracking(&harmonic_bank);
+    }
+    goertzel_bank_track(&harmonic_bank, harmonics, N_SAMPLES);
 }
 
 /**
- * Envia FFT do sinal original
+ * Envia as harmônicas do último quadro (TELEMETRY_TYPE_HARMONICS)
  */
-static void send_fft_original(void) {
-    printf("---FFT_ORIGINAL_START---\n");
-    for (int i = 0; i < N_SAMPLES / 2; i++) {
-        float freq = (float)i * SAMPLE_FREQ_HZ / N_SAMPLES;
-        printf("%.1f,%.6f\n", freq, mag_db_original[i]);
+static void send_harmonics(uint32_t packet_id) {
+    uint8_t payload[sizeof(goertzel_record_header_t) + GOERTZEL_MAX_HARMONICS * 2 * sizeof(float)];
+    goertzel_record_header_t header = {
+        .f0 = harmonic_bank.f0,
+        .thd = goertzel_thd(harmonics, harmonic_bank.n_harmonics),
+        .n_harmonics = (uint8_t)harmonic_bank.n_harmonics,
+    };
+    size_t len = sizeof(header);
+    memcpy(payload, &header, sizeof(header));
+    for (uint32_t h = 0; h < harmonic_bank.n_harmonics; h++) {
+        memcpy(payload + len, &harmonics[h].amplitude, sizeof(float));
+        memcpy(payload + len + sizeof(float), &harmonics[h].phase, sizeof(float));
+        len += 2 * sizeof(float);
     }
-    printf("---FFT_ORIGINAL_END---\n");
+    telemetry_send_raw(TELEMETRY_TYPE_HARMONICS, packet_id, payload, (uint16_t)len, 0);
 }
+#endif
 
 /**
- * Envia FFT do sinal filtrado
+ * Envia um bloco no tempo no formato SIGNAL_FORMAT
+ *
+ * F32 e DELTA_VARINT usam o passo do ajuste linear da calibração; a tabela
+ * do eFuse não é linear, então DELTA_VARINT não reproduz os códigos brutos
+ * (erro <= meio passo).
  */
-static void send_fft_filtered(void) {
-    printf("---FFT_FILTERED_START---\n");
-    for (int i = 0; i < N_SAMPLES / 2; i++) {
-        float freq = (float)i * SAMPLE_FREQ_HZ / N_SAMPLES;
-        printf("%.1f,%.6f\n", freq, mag_db_filtered[i]);
+static void send_signal(telemetry_type_t type, const float *signal, uint32_t packet_id) {
+    float scale = adc_decoder.gain[0], offset = adc_decoder.offset[0];
+#if SIGNAL_FORMAT == TELEMETRY_FORMAT_I16
+    telemetry_block_range(signal, N_SAMPLES, &scale, &offset);
+#endif
+    telemetry_send_block(type, packet_id, SAMPLE_FREQ_HZ, N_SAMPLES,
+                         signal, N_SAMPLES, SIGNAL_FORMAT, scale, offset, 0);
+}
+
+#if SPECTRUM_ENCODING == SPECTRUM_ABOVE_FLOOR
+/**
+ * Mediana de n valores (quickselect; reordena values)
+ */
+static float median_inplace(float *values, int n) {
+    int k = n / 2, lo = 0, hi = n - 1;
+    while (lo < hi) {
+        float pivot = values[(lo + hi) / 2];
+        int i = lo, j = hi;
+        while (i <= j) {
+            while (values[i] < pivot) i++;
+            while (values[j] > pivot) j--;
+            if (i <= j) {
+                float t = values[i]; values[i] = values[j]; values[j] = t;
+                i++; j--;
+            }
+        }
+        if (k <= j) hi = j;
+        else if (k >= i) lo = i;
+        else break;
     }
-    printf("---FFT_FILTERED_END---\n");
+    return values[k];
 }
 
+/**
+ * Seleciona os bins acima do piso de ruído (mediana do espectro + margem)
+ */
+static int select_spectrum_bins(const float *mag_db) {
+    memcpy(spectrum_values, mag_db, sizeof(spectrum_values));
+    float floor_db = median_inplace(spectrum_values, N_SAMPLES / 2) + SPECTRUM_FLOOR_MARGIN_DB;
+    
+    int n = 0;
+    for (int k = 0; k < N_SAMPLES / 2; k++) {
+        if (mag_db[k] > floor_db) {
+            spectrum_bins[n] = (uint16_t)k;
+            spectrum_values[n++] = mag_db[k];
+        }
+    }
+    return n;
+}
+#elif SPECTRUM_ENCODING == SPECTRUM_LOG_BANDS
+/**
+ * Bandas logarítmicas sobre os bins 1..N/2-1 (a componente DC fica de fora)
+ *
+ * Nas frequências baixas as bandas teriam menos de um bin: cada banda tem
+ * pelo menos um, então o número efetivo de bandas pode ser menor.
+ */
+static void init_log_bands(void) {
+    const int n_bins = N_SAMPLES / 2;
+    int start = 1;
+    log_band_count = 0;
+    for (int j = 1; j <= SPECTRUM_LOG_BAND_COUNT && start < n_bins; j++) {
+        int end = (int)lroundf(powf((float)n_bins, (float)j / SPECTRUM_LOG_BAND_COUNT));
+        if (end <= start) end = start + 1;
+        if (end > n_bins || j == SPECTRUM_LOG_BAND_COUNT) end = n_bins;
+        log_band_start[log_band_count++] = (uint16_t)start;
+        start = end;
+    }
+    log_band_start[log_band_count] = (uint16_t)n_bins;
+}
+
+/**
+ * Seleciona o bin de maior magnitude de cada banda logarítmica
+ */
+static int select_spectrum_bins(const float *mag_db) {
+    for (int j = 0; j < log_band_count; j++) {
+        int best = log_band_start[j];
+        for (int k = best + 1; k < log_band_start[j + 1]; k++) {
+            if (mag_db[k] > mag_db[best]) best = k;
+        }
+        spectrum_bins[j] = (uint16_t)best;
+        spectrum_values[j] = mag_db[best];
+    }
+    return log_band_count;
+}
+#endif
+
+/**
+ * Envia um espectro (dB) conforme SPECTRUM_ENCODING
+ */
+static void send_spectrum(telemetry_type_t type, const float *mag_db, uint32_t packet_id, uint8_t flags) {
+#if SPECTRUM_ENCODING == SPECTRUM_FULL
+    telemetry_send_block(type, packet_id, SAMPLE_FREQ_HZ, N_SAMPLES,
+                         mag_db, N_SAMPLES / 2, TELEMETRY_FORMAT_F32, 1.0f, 0.0f, flags);
+#else
+    int n = select_spectrum_bins(mag_db);
+    float scale, offset;
+    telemetry_block_range(spectrum_values, (uint16_t)n, &scale, &offset);
+    telemetry_send_sparse(type, packet_id, SAMPLE_FREQ_HZ, N_SAMPLES,
+                          spectrum_bins, spectrum_values, (uint16_t)n, scale, offset, flags);
+#endif
+}
+
+/**
+ * Envia dados do sinal original
+ */
+static void send_original_signal(const float *signal, uint32_t packet_id) {
+    send_signal(TELEMETRY_TYPE_SIGNAL_ORIGINAL, signal, packet_id);
+}
+
+/**
+ * Envia dados do sinal filtrado
+ */
+static void send_filtered_signal(uint32_t packet_id) {
+    send_signal(TELEMETRY_TYPE_SIGNAL_FILTERED, filtered_buffer, packet_id);
+}
+
+/**
+ * Envia FFT do sinal original
+ */
+static void send_fft_original(uint32_t packet_id) {
+    send_spectrum(TELEMETRY_TYPE_FFT_ORIGINAL, mag_db_original, packet_id, 0);
+}
+
+/**
+ * Envia FFT do sinal filtrado (último bloco do pacote)
+ */
+static void send_fft_filtered(uint32_t packet_id) {
+    send_spectrum(TELEMETRY_TYPE_FFT_FILTERED, mag_db_filtered, packet_id, TELEMETRY_FLAG_LAST_BLOCK);
+}
+
+#if FILTER_TYPE == FILTER_FIR
+/**
+ * Atrasa o quadro original de raw_delay amostras, alinhando-o à saída do FIR
+ */
+static const float *align_original(const float *frame) {
+    memcpy(&raw_line[raw_delay], frame, N_SAMPLES * sizeof(float));
+    memcpy(raw_aligned, raw_line, N_SAMPLES * sizeof(float));
+    memmove(raw_line, &raw_line[N_SAMPLES], raw_delay * sizeof(float));
+    return raw_aligned;
+}
+#endif
+
 /**
  * Task principal de análise
  */
@@ -166,49 +779,72 @@ static void analysisTask(void *param) {
     ESP_LOGI(TAG, "Analysis Task Started");
     
     while (1) {
-        // Aguarda buffer cheio
+        // Aguarda quadro publicado pela aquisição
         ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
         
-        if (buffer_full) {
-            buffer_full = false;
+        float *frame;
+        while ((frame = (float *)frame_ring_read_slot(&adc_ring)) != NULL) {
             sample_counter++;
             
-            // Copia dados para processamento local (evita sobreposição)
-            float local_buffer[N_SAMPLES];
-            memcpy(local_buffer, adc_buffer, sizeof(adc_buffer));
-            
-            // Aplica filtro passa-baixas
-            memcpy(filtered_buffer, local_buffer, sizeof(local_buffer));
-            dsps_biquad_f32(filtered_buffer, filtered_buffer, N_SAMPLES, coeffs_lp, w_lp);
+            // Aplica filtro passa-baixas; original é o quadro alinhado à saída
+            uint32_t t0 = perf_probe_begin();
+#if FILTER_TYPE == FILTER_FIR
+            fir_engine_process(&lp_fir, frame, filtered_buffer, N_SAMPLES);
+            const float *original = align_original(frame);
+#else
+            apply_lowpass_filter_block(frame, filtered_buffer, N_SAMPLES, &lp_section);
+            const float *original = frame;
+#endif
+            perf_probe_end(&perf_filter, t0);
             
             // Calcula FFT de ambos os sinais
-            calculate_fft(local_buffer, mag_db_original);
+            t0 = perf_probe_begin();
+#if SPECTRUM_WELCH
+            // Só os WELCH_AVERAGE_FRAMES quadros que antecedem o envio são transformados
+            uint32_t frames_to_send = (SEND_INTERVAL - sample_counter % SEND_INTERVAL) % SEND_INTERVAL;
+            if (frames_to_send < WELCH_AVERAGE_FRAMES) {
+                welch_accumulate(original, filtered_buffer);
+            }
+            if (frames_to_send <= WELCH_AVERAGE_FRAMES) {
+                welch_store_previous(original, filtered_buffer);
+            }
+#elif FFT_MODE == FFT_MODE_DUAL
+            calculate_fft_dual(original, filtered_buffer, mag_db_original, mag_db_filtered);
+#else
+            calculate_fft(original, mag_db_original);
             calculate_fft(filtered_buffer, mag_db_filtered);
+#endif
+            perf_probe_end(&perf_fft, t0);
             
-            // Envia dados periodicamente
+#if HARMONIC_TRACKING
+            t0 = perf_probe_begin();
+            update_harmonics(frame);
+            perf_probe_end(&perf_harmonic, t0);
+#endif
+            
+            // Envia dados periodicamente (não bloqueante, quadros binários)
             if (sample_counter % SEND_INTERVAL == 0) {
-                ESP_LOGI(TAG, "Sending data packet #%lu", sample_counter / SEND_INTERVAL);
-                
-                // Envia dados na sequência
-                send_original_signal();
-                vTaskDelay(pdMS_TO_TICKS(50));  // Pequena pausa entre envios
-                
-                send_filtered_signal();
-                vTaskDelay(pdMS_TO_TICKS(50));
+                uint32_t packet_id = sample_counter / SEND_INTERVAL;
                 
-                send_fft_original();
-                vTaskDelay(pdMS_TO_TICKS(50));
+                t0 = perf_probe_begin();
+#if SPECTRUM_WELCH
+                welch_finish(mag_db_original, mag_db_filtered);
+#endif
                 
-                send_fft_filtered();
-                vTaskDelay(pdMS_TO_TICKS(50));
-                
-                printf("---DATA_COMPLETE---\n");
+                send_original_signal(original, packet_id);
+                send_filtered_signal(packet_id);
+                send_fft_original(packet_id);
+#if HARMONIC_TRACKING
+                send_harmonics(packet_id);
+#endif
+                send_fft_filtered(packet_id);
+                perf_probe_end(&perf_send, t0);
             }
             
             // Log estatísticas básicas
             float avg_original = 0.0f, avg_filtered = 0.0f;
             for (int i = 0; i < N_SAMPLES; i++) {
-                avg_original += local_buffer[i];
+                avg_original += original[i];
                 avg_filtered += filtered_buffer[i];
             }
             avg_original /= N_SAMPLES;
@@ -217,18 +853,48 @@ static void analysisTask(void *param) {
             if (sample_counter % 50 == 0) {  // Log a cada 50 amostras
                 ESP_LOGI(TAG, "Avg Original: %.3fV, Avg Filtered: %.3fV", avg_original, avg_filtered);
             }
+            
+            // Latência do fim do DMA ao fim da análise do quadro
+            int64_t latency_us = esp_timer_get_time() - adc_slot_time_us[(frame - &adc_slots[0][0]) / N_SAMPLES];
+            perf_stage_record(&perf_latency, (uint32_t)latency_us);
+            
+            // Devolve o slot para a aquisição
+            frame_ring_release(&adc_ring);
         }
     }
 }
 
+/**
+ * Exporta o registro de instrumentação (estágios, pilhas e filas)
+ */
+static void send_perf_record(uint32_t record_id) {
+    static perf_stage_t *const stages[] = { &perf_acq, &perf_filter, &perf_fft, &perf_harmonic, &perf_send, &perf_latency };
+    const perf_gauge_t gauges[] = {
+        { "stk_acq",  uxTaskGetStackHighWaterMark(cb_task_handle) },
+        { "stk_ana",  uxTaskGetStackHighWaterMark(analysis_task_handle) },
+        { "ring_max", frame_ring_high_water(&adc_ring) },
+        { "ring_drp", frame_ring_dropped(&adc_ring) },
+        { "tx_max",   (uint32_t)telemetry_get_queue_high_water() },
+        { "tx_drop",  telemetry_get_dropped() },
+        { "adc_ovf",  adc_pool_overflows },
+        { "heap",     esp_get_free_heap_size() },
+#if SLIDING_DFT_MODE
+        { "sdft_evt", sdft_events },
+        { "sdft_anc", sdft.n_reanchors },
+#endif
+    };
+    perf_probe_send(record_id, PERF_REPORT_MS, stages, sizeof(stages) / sizeof(stages[0]),
+                    gauges, sizeof(gauges) / sizeof(gauges[0]));
+}
+
 /**
  * Configuração inicial do ADC
  */
 static void configure_adc(void) {
     // Configuração do handle ADC
     adc_continuous_handle_cfg_t handle_cfg = {
-        .conv_frame_size = 256,
-        .max_store_buf_size = 1024,
+        .conv_frame_size = PIPELINE_ADC_CONV_FRAME_BYTES,
+        .max_store_buf_size = PIPELINE_ADC_STORE_BYTES,
     };
     ESP_ERROR_CHECK(adc_continuous_new_handle(&handle_cfg, &adc_handle));
     
@@ -254,6 +920,7 @@ static void configure_adc(void) {
     // Configuração de callbacks
     adc_continuous_evt_cbs_t cbs = {
         .on_conv_done = adc_callback,
+        .on_pool_ovf = adc_pool_ovf_callback,
     };
     ESP_ERROR_CHECK(adc_continuous_register_event_callbacks(adc_handle, &cbs, NULL));
 }
@@ -265,31 +932,93 @@ void app_main(void) {
     ESP_LOGI(TAG, "=== Signal Analyzer Starting ===");
     ESP_LOGI(TAG, "Sample Rate: %d Hz", SAMPLE_FREQ_HZ);
     ESP_LOGI(TAG, "Filter FC: %d Hz", FILTER_FC);
-    ESP_LOGI(TAG, "FFT Size: %d points", N_SAMPLES);
+    ESP_LOGI(TAG, "FFT Size: %d points (mode %d)", N_SAMPLES, FFT_MODE);
+#if SPECTRUM_WELCH
+    ESP_LOGI(TAG, "Welch averaging: %d%% overlap, %d segments per spectrum",
+             WELCH_OVERLAP_PERCENT, WELCH_AVERAGE_FRAMES * (N_SAMPLES / WELCH_HOP));
+#endif
+    
+    // Gera janela de Hann
+    dsps_wind_hann_f32(window, N_SAMPLES);
     
-    // Inicializa DSP
-    esp_err_t ret = dsps_fft2r_init_fc32(NULL, N_SAMPLES);
-    if (ret != ESP_OK) {
+    // Inicializa DSP e escolhe o núcleo da FFT
+    if (!fft_kernel_select()) {
         ESP_LOGE(TAG, "FFT initialization failed!");
         return;
     }
+    ESP_LOGI(TAG, "FFT kernel: %s (%d-point complex)", fft_kernel_names[fft_kernel], FFT_COMPLEX_N);
+#if FFT_MODE == FFT_MODE_REAL
+    init_rfft_twiddle();
+#endif
+#if SPECTRUM_ENCODING == SPECTRUM_LOG_BANDS
+    init_log_bands();
+#endif
+#if SLIDING_DFT_MODE
+    sliding_dft_init(&sdft, sdft_history, SDFT_WINDOW, sdft_bins, SDFT_N_BINS, SDFT_REANCHOR_SAMPLES);
+    ESP_LOGI(TAG, "Sliding DFT: %d bins, N=%d, re-anchor every %d samples",
+             (int)SDFT_N_BINS, SDFT_WINDOW, SDFT_REANCHOR_SAMPLES);
+#endif
+#if HARMONIC_TRACKING
+    float window_sum = 0.0f;
+    for (int i = 0; i < N_SAMPLES; i++) {
+        window_sum += window[i];
+    }
+    goertzel_bank_init(&harmonic_bank, MAINS_FREQ_HZ, HARMONIC_COUNT, SAMPLE_FREQ_HZ, N_SAMPLES, window_sum);
+    ESP_LOGI(TAG, "Harmonic tracker: %lu harmonics of %.1f Hz", harmonic_bank.n_harmonics, MAINS_FREQ_HZ);
+#endif
     
-    // Gera janela de Hann
-    dsps_wind_hann_f32(window, N_SAMPLES);
-    
-    // Configura filtro passa-baixas (Butterworth, fc normalizada, Q=0.707)
     float fc_normalized = (float)FILTER_FC / SAMPLE_FREQ_HZ;
+#if FILTER_TYPE == FILTER_FIR
+    // Configura filtro passa-baixas FIR (janela de Hamming, fase linear)
+    if (!fir_engine_design_lowpass(fir_coeffs, FIR_TAPS, fc_normalized) ||
+        !fir_engine_init(&lp_fir, fir_coeffs, FIR_TAPS, fft_complex, FFT_COMPLEX_N)) {
+        ESP_LOGE(TAG, "FIR filter initialization failed!");
+        return;
+    }
+    raw_delay = fir_engine_delay(&lp_fir);
+    if (raw_delay > RAW_DELAY_MAX) {
+        ESP_LOGE(TAG, "FIR delay %lu exceeds the original-signal delay line (%d)", raw_delay, RAW_DELAY_MAX);
+        return;
+    }
+    ESP_LOGI(TAG, "FIR low-pass: %d taps, %s, output delay %lu samples (original delayed to match)", FIR_TAPS,
+             (lp_fir.mode == FIR_ENGINE_OVERLAP_SAVE) ? "overlap-save" : "direct form", raw_delay);
+#else
+    // Configura filtro passa-baixas (Butterworth, fc normalizada, Q=0.707)
+    float coeffs_lp[5];
     dsps_biquad_gen_lpf_f32(coeffs_lp, fc_normalized, 0.707f);
+    init_biquad_section(&lp_section, coeffs_lp);
     
     ESP_LOGI(TAG, "Filter coefficients: b0=%.6f, b1=%.6f, b2=%.6f, a1=%.6f, a2=%.6f", 
              coeffs_lp[0], coeffs_lp[1], coeffs_lp[2], coeffs_lp[3], coeffs_lp[4]);
+#endif
+    
+    // Inicializa telemetria binária
+    ESP_ERROR_CHECK(telemetry_init());
+    
+    // Buffer de quadros entre aquisição e análise
+    frame_ring_init(&adc_ring, adc_slots, sizeof(adc_slots[0]), ADC_RING_SLOTS);
+    
+    // Decodificador do ADC com a calibração do eFuse (sem ela, 3.3/4095 nominal)
+    const uint8_t adc_pattern_channels[1] = { ADC_CHANNEL[0] };
+    adc_frame_decoder_init(&adc_decoder, adc_pattern_channels, 1);
+    esp_err_t cal_ret = adc_frame_calibrate(&adc_decoder, 0, ADC_UNIT_1, ADC_ATTEN_DB_12, ADC_BITWIDTH_12, adc_cal_lut);
+    if (cal_ret == ESP_OK) {
+        ESP_LOGI(TAG, "ADC calibration (eFuse): %.4f mV/code, offset %.1f mV",
+                 adc_decoder.gain[0] * 1e3f, adc_decoder.offset[0] * 1e3f);
+    } else {
+        ESP_LOGW(TAG, "ADC calibration unavailable (%s), using nominal 3.3/4095", esp_err_to_name(cal_ret));
+    }
     
     // Configura ADC
     configure_adc();
+    ESP_LOGI(TAG, "ADC conversion frame: %d bytes (%d samples per notification)",
+             PIPELINE_ADC_CONV_FRAME_BYTES, PIPELINE_ADC_CONV_FRAME_BYTES / ADC_FRAME_WORD_BYTES);
     
-    // Cria tasks
-    xTaskCreate(cbTask, "ADC Callback Task", 4096, NULL, 5, &cb_task_handle);
-    xTaskCreate(analysisTask, "Analysis Task", 8192, NULL, 4, &analysis_task_handle);
+    // Cria tasks (aquisição no núcleo de I/O, análise sozinha no outro núcleo)
+    xTaskCreatePinnedToCore(cbTask, "ADC Callback Task", PIPELINE_ACQ_STACK, NULL,
+                            PIPELINE_ACQ_PRIORITY, &cb_task_handle, PIPELINE_ACQ_CORE);
+    xTaskCreatePinnedToCore(analysisTask, "Analysis Task", PIPELINE_DSP_STACK, NULL,
+                            PIPELINE_DSP_PRIORITY, &analysis_task_handle, PIPELINE_DSP_CORE);
     
     // Inicia ADC
     ESP_ERROR_CHECK(adc_continuous_start(adc_handle));
@@ -298,9 +1027,18 @@ void app_main(void) {
     ESP_LOGI(TAG, "Waiting for ADC data...");
     
     // Task principal apenas monitora o sistema
+    uint32_t perf_record_id = 0;
     while (1) {
-        vTaskDelay(pdMS_TO_TICKS(10000)); // 10 segundos
+        vTaskDelay(pdMS_TO_TICKS(PERF_REPORT_MS)); // 10 segundos
         ESP_LOGI(TAG, "System running... Free heap: %lu bytes", esp_get_free_heap_size());
         ESP_LOGI(TAG, "Total samples processed: %lu", sample_counter);
+        ESP_LOGI(TAG, "ADC frames dropped (overrun): %lu", frame_ring_dropped(&adc_ring));
+        ESP_LOGI(TAG, "Telemetry frames dropped: %lu", telemetry_get_dropped());
+        ESP_LOGI(TAG, "Pipeline depth: ADC pool overflows %lu | frame ring max %lu/%d | telemetry max %u/%d bytes",
+                 adc_pool_overflows, frame_ring_high_water(&adc_ring), ADC_RING_SLOTS - 1,
+                 (unsigned)telemetry_get_queue_high_water(), TELEMETRY_RING_SIZE);
+        
+        // Registro de instrumentação para o host
+        send_perf_record(++perf_record_id);
     }
 }
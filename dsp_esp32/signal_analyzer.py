@@ -1,25 +1,200 @@
 import sys
 import serial
 import numpy as np
-import pandas as pd
 import pyqtgraph as pg
 from PyQt5 import QtWidgets, QtCore
 import os
+import threading
 from datetime import datetime
 import time
 
+from telemetry_protocol import (FrameDecoder, BLOCK_NAMES, FLAG_LAST_BLOCK, MAX_PAYLOAD, TYPE_PERF, TYPE_EVENTS,
+                                TYPE_FFT_ORIGINAL, TYPE_FFT_FILTERED, TYPE_POWER_SUMMARY, TYPE_HARMONICS,
+                                TYPE_SPECTRAL_EVENT, block_axis, decode_perf_record, format_perf_record,
+                                decode_event_batch, decode_power_summary, decode_harmonics, decode_spectral_event)
+from capture_store import CaptureWriter
+
 # Configurações da porta serial
 SERIAL_PORT = '/dev/ttyACM0'  # Ajuste conforme necessário
-BAUD_RATE = 115200
+BAUD_RATE = 2000000  # TELEMETRY_UART_BAUD_RATE (ignorado no USB-Serial-JTAG)
+
+# Captura (HDF5 colunar, capture_store.py) onde os pacotes são acrescentados
+CAPTURE_FILENAME = 'signal_analysis_data.h5'
+
+# Atualização dos gráficos, independente da taxa do enlace
+PLOT_INTERVAL_MS = 50
 
-# Arquivo CSV para salvar dados
-CSV_FILENAME = 'signal_analysis_data.csv'
+# Pacotes entre a thread de leitura e a GUI: em escrita, último completo e em exibição
+RING_SLOTS = 3
+BLOCK_CAPACITY = MAX_PAYLOAD    # Valores por bloco (pior caso: DELTA_VARINT com 1 byte/valor)
 
 # Eixo X logarítmico para FFT
 class LogAxisItem(pg.AxisItem):
     def tickStrings(self, values, scale, spacing):
         return [f"{10**v:.0f}" if v > 0 else "1" for v in values]
 
+class PacketRing:
+    """
+    Pacotes completos (os 4 blocos) em buffers pré-alocados, trocados entre a
+    thread de leitura e a GUI em buffer triplo.
+
+    A leitura escreve num slot livre e o publica como último completo ao
+    receber FLAG_LAST_BLOCK; se a GUI não o pegou, o próximo pacote o
+    substitui. A GUI segura o slot em exibição até pegar o seguinte, então os
+    arrays passados a setData() nunca são sobrescritos. Um bloco de outro
+    packet_id antes do FLAG_LAST_BLOCK (o último bloco se perdeu) descarta o
+    pacote em montagem, para que seus blocos não entrem no seguinte.
+    """
+
+    def __init__(self, slots=RING_SLOTS, capacity=BLOCK_CAPACITY):
+        self.types = list(BLOCK_NAMES)
+        n_blocks = len(self.types)
+        # Eixo X: tempo (s) nos sinais, log10 da frequência (Hz, sem DC) nos espectros
+        self.x = np.zeros((slots, n_blocks, capacity))
+        self.y = np.zeros((slots, n_blocks, capacity))
+        self.length = np.zeros((slots, n_blocks), dtype=np.int64)
+        self.packet_id = np.zeros(slots, dtype=np.int64)
+        self.lock = threading.Lock()
+        self.write = 0
+        self.latest = -1
+        self.reading = -1
+        self.published = 0
+        self.acquired = 0
+        self.filling = False    # O slot em escrita já tem blocos do pacote packet_id[write]
+        self.discarded = 0      # Pacotes sem FLAG_LAST_BLOCK descartados
+
+    def store(self, frame):
+        """Leitura: copia um bloco para o slot em escrita"""
+        if self.filling and frame.packet_id != self.packet_id[self.write]:
+            self.length[self.write] = 0
+            self.discarded += 1
+        self.packet_id[self.write] = frame.packet_id
+        self.filling = True
+        b = self.types.index(frame.type)
+        x = block_axis(frame)
+        y = frame.values
+        if frame.type in (TYPE_FFT_ORIGINAL, TYPE_FFT_FILTERED):
+            # Eixo logarítmico: descarta a componente DC (evita log(0))
+            valid = x > 0
+            x = np.log10(x[valid])
+            y = y[valid]
+        n = min(len(y), self.x.shape[2])
+        self.x[self.write, b, :n] = x[:n]
+        self.y[self.write, b, :n] = y[:n]
+        self.length[self.write, b] = n
+
+    def publish(self):
+        """Leitura: o slot em escrita vira o último pacote completo"""
+        with self.lock:
+            self.latest = self.write
+            self.published += 1
+            self.write = next(s for s in range(len(self.packet_id)) if s not in (self.latest, self.reading))
+        self.length[self.write] = 0
+        self.filling = False
+        return self.latest
+
+    def acquire(self):
+        """GUI: slot do último pacote completo, ou None se não chegou outro"""
+        with self.lock:
+            if self.latest < 0:
+                return None
+            self.reading, self.latest = self.latest, -1
+            self.acquired += 1
+            return self.reading
+
+    def blocks(self, slot):
+        """Nome do bloco -> (x, y) do slot (views, sem cópia)"""
+        return {BLOCK_NAMES[t]: (self.x[slot, b, :self.length[slot, b]], self.y[slot, b, :self.length[slot, b]])
+                for b, t in enumerate(self.types)}
+
+
+def save_packet(writer, ring, slot):
+    """Acrescenta um pacote do anel à captura (frequência de volta para Hz)"""
+    blocks = {name: (10 ** x if name.startswith('fft') else x, y)
+              for name, (x, y) in ring.blocks(slot).items()}
+    return writer.append(blocks, esp_packet_id=int(ring.packet_id[slot]))
+
+
+class SerialReader(threading.Thread):
+    """
+    Thread de leitura: decodifica os quadros da serial, imprime os registros de
+    texto (PERF, EVENT, HARM, SDFT, POWER) e monta os pacotes no PacketRing.
+    Cada pacote completo também é gravado na captura, mesmo que a GUI não o exiba.
+    """
+
+    def __init__(self, ser, ring, writer=None):
+        super().__init__(daemon=True)
+        self.ser = ser
+        self.ring = ring
+        self.writer = writer
+        self.decoder = FrameDecoder()
+        self.stop_event = threading.Event()
+
+    def stop(self):
+        self.stop_event.set()
+        self.join(timeout=1.0)
+
+    def run(self):
+        while not self.stop_event.is_set():
+            try:
+                # Bloqueia até o timeout da porta quando não há bytes
+                data = self.ser.read(max(1, self.ser.in_waiting))
+            except Exception as e:
+                print(f"[ERROR] Erro ao ler porta serial: {e}")
+                time.sleep(0.1)
+                continue
+            if data:
+                for frame in self.decoder.feed(data):
+                    self.handle_frame(frame)
+
+    def handle_frame(self, frame):
+        if frame.type == TYPE_PERF:
+            print(f"[PERF] Registro #{frame.packet_id}:\n"
+                  f"{format_perf_record(decode_perf_record(frame.values))}")
+            return
+        if frame.type == TYPE_EVENTS:
+            batch = decode_event_batch(frame.values)
+            for ev in batch['events']:
+                print(f"[EVENT] #{ev['sequence']} t={ev['timestamp_ms'] / 1000:.1f}s "
+                      f"{'ON' if ev['on'] else 'OFF'} {ev['device']} | "
+                      f"Power: {ev['power']:.1f}W | Delta: {ev['delta_power']:.1f}W")
+            if batch['dropped']:
+                print(f"[EVENT] {batch['dropped']} eventos descartados no dispositivo")
+            return
+        if frame.type == TYPE_HARMONICS:
+            harm = decode_harmonics(frame.values)
+            ratios = ' '.join(f"h{h + 1}={a / harm['amplitude'][0]:.3f}"
+                              for h, a in enumerate(harm['amplitude'][1:8], start=1)
+                              if harm['amplitude'][0] > 0)
+            print(f"[HARM] f0={harm['f0']:.3f}Hz A1={harm['amplitude'][0]:.4f} "
+                  f"THD={harm['thd'] * 100:.1f}% {ratios}")
+            return
+        if frame.type == TYPE_SPECTRAL_EVENT:
+            ev = decode_spectral_event(frame.values)
+            print(f"[SDFT] t={ev['time_us'] / 1e6:.4f}s {ev['frequency_hz']:.0f}Hz: "
+                  f"{ev['baseline']:.4f} -> {ev['amplitude']:.4f} (amostra {ev['sample_index']})")
+            return
+        if frame.type == TYPE_POWER_SUMMARY:
+            summ = decode_power_summary(frame.values)
+            print(f"[POWER] {summ['period_ms'] / 1000:.0f}s: média {summ['mean_power']:.1f}W "
+                  f"[{summ['min_power']:.1f}..{summ['max_power']:.1f}] {summ['mean_reactive']:.1f}var "
+                  f"{summ['mean_apparent']:.1f}VA | baseline "
+                  f"{summ['baseline_power']:.1f}W | limiar {summ['threshold']:.1f}W | "
+                  f"{summ['n_events']} eventos")
+            return
+        
+        if frame.type not in BLOCK_NAMES:
+            return
+        self.ring.store(frame)
+        if frame.flags & FLAG_LAST_BLOCK:
+            if self.writer is not None:
+                try:
+                    save_packet(self.writer, self.ring, self.ring.write)
+                except Exception as e:
+                    print(f"[ERROR] Erro ao gravar captura: {e}")
+            self.ring.publish()
+
+
 class SignalAnalyzer(QtWidgets.QMainWindow):
     def __init__(self):
         super().__init__()
@@ -27,8 +202,8 @@ class SignalAnalyzer(QtWidgets.QMainWindow):
         self.setWindowTitle("Analisador de Sinais - Original vs Filtrado")
         self.resize(1400, 800)
         
-        # Inicializar arquivo CSV
-        self.init_csv_file()
+        # Abrir (ou criar) a captura
+        self.init_capture()
         
         # Layout principal
         central_widget = QtWidgets.QWidget()
@@ -107,194 +282,71 @@ class SignalAnalyzer(QtWidgets.QMainWindow):
             print(f"[ERRO] Não foi possível abrir {SERIAL_PORT}: {e}")
             sys.exit(1)
         
-        # Variáveis para armazenar dados
-        self.current_data = {
-            'signal_original': {'time': [], 'amplitude': []},
-            'signal_filtered': {'time': [], 'amplitude': []},
-            'fft_original': {'frequency': [], 'magnitude': []},
-            'fft_filtered': {'frequency': [], 'magnitude': []}
-        }
+        # Pacotes decodificados pela thread de leitura
+        self.ring = PacketRing()
+        self.slot = None            # Slot em exibição (retido até o próximo)
+        self.reader = SerialReader(self.ser, self.ring, self.capture)
+        self.reader.start()
         
-        # Estado da leitura
-        self.reading_state = None
-        self.packet_counter = 0
-        
-        # Timer para leitura serial
+        # Timer de atualização dos gráficos: pega só o último pacote completo
         self.timer = QtCore.QTimer()
-        self.timer.timeout.connect(self.read_serial)
-        self.timer.start(10)  # 10ms
+        self.timer.timeout.connect(self.refresh)
+        self.timer.start(PLOT_INTERVAL_MS)
         
-    def init_csv_file(self):
-        """Inicializa arquivo CSV com cabeçalhos se não existir"""
-        if not os.path.exists(CSV_FILENAME):
-            # Criar DataFrame vazio com colunas apropriadas
-            df = pd.DataFrame(columns=[
-                'timestamp', 'packet_id', 'data_type', 'index', 
-                'time_or_freq', 'amplitude_or_magnitude'
-            ])
-            df.to_csv(CSV_FILENAME, index=False)
-            print(f"[INFO] Arquivo CSV criado: {CSV_FILENAME}")
+    def init_capture(self):
+        """Abre a captura para acréscimo (cria o arquivo se não existir)"""
+        existed = os.path.exists(CAPTURE_FILENAME)
+        self.capture = CaptureWriter(CAPTURE_FILENAME)
+        if existed:
+            print(f"[INFO] Usando captura existente: {CAPTURE_FILENAME} ({self.capture.n_packets} pacotes)")
         else:
-            print(f"[INFO] Usando arquivo CSV existente: {CSV_FILENAME}")
+            print(f"[INFO] Captura criada: {CAPTURE_FILENAME}")
     
-    def read_serial(self):
-        """Lê dados da porta serial"""
-        while self.ser.in_waiting:
-            try:
-                line = self.ser.readline().decode('utf-8', errors='ignore').strip()
-                
-                # Processa marcadores de início/fim
-                if line == "---SIGNAL_ORIGINAL_START---":
-                    self.reading_state = 'signal_original'
-                    self.current_data['signal_original'] = {'time': [], 'amplitude': []}
-                    continue
-                elif line == "---SIGNAL_ORIGINAL_END---":
-                    self.reading_state = None
-                    continue
-                elif line == "---SIGNAL_FILTERED_START---":
-                    self.reading_state = 'signal_filtered'
-                    self.current_data['signal_filtered'] = {'time': [], 'amplitude': []}
-                    continue
-                elif line == "---SIGNAL_FILTERED_END---":
-                    self.reading_state = None
-                    continue
-                elif line == "---FFT_ORIGINAL_START---":
-                    self.reading_state = 'fft_original'
-                    self.current_data['fft_original'] = {'frequency': [], 'magnitude': []}
-                    continue
-                elif line == "---FFT_ORIGINAL_END---":
-                    self.reading_state = None
-                    continue
-                elif line == "---FFT_FILTERED_START---":
-                    self.reading_state = 'fft_filtered'
-                    self.current_data['fft_filtered'] = {'frequency': [], 'magnitude': []}
-                    continue
-                elif line == "---FFT_FILTERED_END---":
-                    self.reading_state = None
-                    continue
-                elif line == "---DATA_COMPLETE---":
-                    self.packet_counter += 1
-                    self.update_plots()
-                    self.save_to_csv()
-                    self.status_label.setText(f"Status: Pacote #{self.packet_counter} recebido")
-                    continue
-                
-                # Processa dados baseado no estado atual
-                if self.reading_state and line:
-                    parts = line.split(',')
-                    if len(parts) == 2:
-                        try:
-                            x_val = float(parts[0])
-                            y_val = float(parts[1])
-                            
-                            if self.reading_state == 'signal_original':
-                                self.current_data['signal_original']['time'].append(x_val)
-                                self.current_data['signal_original']['amplitude'].append(y_val)
-                            elif self.reading_state == 'signal_filtered':
-                                self.current_data['signal_filtered']['time'].append(x_val)
-                                self.current_data['signal_filtered']['amplitude'].append(y_val)
-                            elif self.reading_state == 'fft_original':
-                                if x_val > 0:  # Evita log(0)
-                                    self.current_data['fft_original']['frequency'].append(np.log10(x_val))
-                                    self.current_data['fft_original']['magnitude'].append(y_val)
-                            elif self.reading_state == 'fft_filtered':
-                                if x_val > 0:  # Evita log(0)
-                                    self.current_data['fft_filtered']['frequency'].append(np.log10(x_val))
-                                    self.current_data['fft_filtered']['magnitude'].append(y_val)
-                        except ValueError:
-                            print(f"[WARNING] Valor inválido ignorado: {line}")
-                
-            except Exception as e:
-                print(f"[ERROR] Erro ao processar linha: {e}")
+    def refresh(self):
+        """Exibe o último pacote completo, se chegou um novo desde a última atualização"""
+        slot = self.ring.acquire()
+        if slot is None:
+            return
+        self.slot = slot
+        self.update_plots()
+        skipped = self.ring.published - self.ring.acquired
+        self.status_label.setText(
+            f"Status: Pacote #{self.ring.published} recebido "
+            f"(ESP32 #{self.ring.packet_id[slot]}, erros CRC: {self.reader.decoder.crc_errors}, "
+            f"não exibidos: {skipped}, incompletos: {self.ring.discarded})"
+        )
     
     def update_plots(self):
-        """Atualiza todos os gráficos com os dados atuais"""
+        """Atualiza todos os gráficos com o pacote em exibição"""
         try:
-            # Atualizar sinal original
-            if self.current_data['signal_original']['time']:
-                self.curve_signal_orig.setData(
-                    self.current_data['signal_original']['time'],
-                    self.current_data['signal_original']['amplitude']
-                )
-            
-            # Atualizar sinal filtrado
-            if self.current_data['signal_filtered']['time']:
-                self.curve_signal_filt.setData(
-                    self.current_data['signal_filtered']['time'],
-                    self.current_data['signal_filtered']['amplitude']
-                )
-            
-            # Atualizar FFT original
-            if self.current_data['fft_original']['frequency']:
-                self.curve_fft_orig.setData(
-                    self.current_data['fft_original']['frequency'],
-                    self.current_data['fft_original']['magnitude']
-                )
-            
-            # Atualizar FFT filtrado
-            if self.current_data['fft_filtered']['frequency']:
-                self.curve_fft_filt.setData(
-                    self.current_data['fft_filtered']['frequency'],
-                    self.current_data['fft_filtered']['magnitude']
-                )
-                
-            print(f"[INFO] Gráficos atualizados - Pacote #{self.packet_counter}")
+            curves = {
+                'signal_original': self.curve_signal_orig,
+                'signal_filtered': self.curve_signal_filt,
+                'fft_original': self.curve_fft_orig,
+                'fft_filtered': self.curve_fft_filt,
+            }
+            for name, (x, y) in self.ring.blocks(self.slot).items():
+                # Bloco ausente no pacote: mantém a curva anterior
+                if len(x):
+                    curves[name].setData(x, y)
             
         except Exception as e:
             print(f"[ERROR] Erro ao atualizar gráficos: {e}")
     
-    def save_to_csv(self):
-        """Salva dados atuais no arquivo CSV"""
+    def save_packet(self):
+        """Grava de novo o pacote em exibição na captura"""
+        if self.slot is None:
+            return
         try:
-            timestamp = datetime.now().isoformat()
-            rows = []
-            
-            # Salvar sinal original
-            for i, (t, amp) in enumerate(zip(
-                self.current_data['signal_original']['time'],
-                self.current_data['signal_original']['amplitude']
-            )):
-                rows.append([timestamp, self.packet_counter, 'signal_original', i, t, amp])
-            
-            # Salvar sinal filtrado
-            for i, (t, amp) in enumerate(zip(
-                self.current_data['signal_filtered']['time'],
-                self.current_data['signal_filtered']['amplitude']
-            )):
-                rows.append([timestamp, self.packet_counter, 'signal_filtered', i, t, amp])
-            
-            # Salvar FFT original (converter log de volta para Hz)
-            for i, (log_f, mag) in enumerate(zip(
-                self.current_data['fft_original']['frequency'],
-                self.current_data['fft_original']['magnitude']
-            )):
-                freq_hz = 10 ** log_f
-                rows.append([timestamp, self.packet_counter, 'fft_original', i, freq_hz, mag])
-            
-            # Salvar FFT filtrado (converter log de volta para Hz)
-            for i, (log_f, mag) in enumerate(zip(
-                self.current_data['fft_filtered']['frequency'],
-                self.current_data['fft_filtered']['magnitude']
-            )):
-                freq_hz = 10 ** log_f
-                rows.append([timestamp, self.packet_counter, 'fft_filtered', i, freq_hz, mag])
-            
-            # Adicionar ao CSV
-            if rows:
-                df = pd.DataFrame(rows, columns=[
-                    'timestamp', 'packet_id', 'data_type', 'index', 
-                    'time_or_freq', 'amplitude_or_magnitude'
-                ])
-                df.to_csv(CSV_FILENAME, mode='a', header=False, index=False)
-                print(f"[INFO] {len(rows)} pontos salvos no CSV")
-            
+            n = save_packet(self.capture, self.ring, self.slot)
+            print(f"[INFO] Pacote salvo na captura como #{n}")
         except Exception as e:
-            print(f"[ERROR] Erro ao salvar CSV: {e}")
+            print(f"[ERROR] Erro ao gravar captura: {e}")
     
     def save_current_data(self):
         """Salva manualmente os dados atuais"""
-        self.save_to_csv()
-        QtWidgets.QMessageBox.information(self, "Salvar", f"Dados salvos em {CSV_FILENAME}")
+        self.save_packet()
+        QtWidgets.QMessageBox.information(self, "Salvar", f"Dados salvos em {CAPTURE_FILENAME}")
     
     def clear_plots(self):
         """Limpa todos os gráficos"""
@@ -305,18 +357,17 @@ class SignalAnalyzer(QtWidgets.QMainWindow):
         print("[INFO] Gráficos limpos")
     
     def export_csv(self):
-        """Exporta dados para um novo arquivo CSV com timestamp"""
+        """Exporta a captura para um novo arquivo CSV com timestamp"""
         try:
             timestamp = datetime.now().strftime("%Y%m%d_%H%M%S")
             new_filename = f"signal_export_{timestamp}.csv"
             
-            # Copia arquivo atual
-            df = pd.read_csv(CSV_FILENAME)
-            df.to_csv(new_filename, index=False)
+            # Converte a captura em lotes (não carrega o arquivo inteiro)
+            total = self.capture.reader().export_csv(new_filename)
             
             QtWidgets.QMessageBox.information(
                 self, "Exportar", f"Dados exportados para {new_filename}\n"
-                f"Total de registros: {len(df)}"
+                f"Total de registros: {total}"
             )
             print(f"[INFO] Dados exportados para {new_filename}")
             
@@ -325,8 +376,13 @@ class SignalAnalyzer(QtWidgets.QMainWindow):
     
     def closeEvent(self, event):
         """Fechar aplicação"""
+        self.timer.stop()
+        if hasattr(self, 'reader'):
+            self.reader.stop()
         if hasattr(self, 'ser') and self.ser.is_open:
             self.ser.close()
+        if hasattr(self, 'capture'):
+            self.capture.close()
         event.accept()
 
 def main():
@@ -339,7 +395,7 @@ def main():
     main_window.show()
     
     print("[INFO] Aplicação iniciada. Aguardando dados do ESP32...")
-    print(f"[INFO] Dados serão salvos em: {CSV_FILENAME}")
+    print(f"[INFO] Dados serão salvos em: {CAPTURE_FILENAME}")
     
     sys.exit(app.exec_())
 
@@ -0,0 +1,112 @@
+/**
+ * @file sliding_dft.c
+ * @brief Implementação da DFT deslizante com re-ancoragem periódica
+ */
+
+#include "sliding_dft.h"
+#include <math.h>
+#include <string.h>
+
+/**
+ * @brief Inicializa a SDFT com histórico zerado
+ *
+ * @param sdft Estado
+ * @param history Buffer de window floats (pertence ao chamador)
+ * @param window Tamanho da janela N
+ * @param bins Bins a acompanhar (0 <= k < N)
+ * @param n_bins Número de bins (até SLIDING_DFT_MAX_BINS)
+ * @param reanchor_interval Amostras entre re-ancoragens (0 = nunca)
+ * @return false se os parâmetros forem inválidos
+ */
+bool sliding_dft_init(sliding_dft_t *sdft, float *history, uint32_t window,
+                      const uint16_t *bins, uint32_t n_bins, uint32_t reanchor_interval) {
+    if (history == NULL || window == 0 || n_bins > SLIDING_DFT_MAX_BINS) {
+        return false;
+    }
+    
+    sdft->history = history;
+    sdft->window = window;
+    sdft->n_bins = n_bins;
+    sdft->reanchor_interval = reanchor_interval;
+    for (uint32_t i = 0; i < n_bins; i++) {
+        if (bins[i] >= window) {
+            return false;
+        }
+        double w = 2.0 * M_PI * bins[i] / window;
+        sdft->bins[i] = bins[i];
+        sdft->rot_re[i] = (float)cos(w);
+        sdft->rot_im[i] = (float)sin(w);
+    }
+    sliding_dft_reset(sdft);
+    return true;
+}
+
+/**
+ * @brief Zera histórico e bins
+ */
+void sliding_dft_reset(sliding_dft_t *sdft) {
+    memset(sdft->history, 0, sdft->window * sizeof(float));
+    memset(sdft->re, 0, sizeof(sdft->re));
+    memset(sdft->im, 0, sizeof(sdft->im));
+    sdft->pos = 0;
+    sdft->since_anchor = 0;
+    sdft->anchor_pending = 0;
+    sdft->n_reanchors = 0;
+}
+
+/**
+ * @brief Recalcula um bin a partir do histórico (Goertzel sobre a janela)
+ *
+ * Para k inteiro, Goertzel sobre x[0..N-1] dá
+ * X_k = e^{jw} s[N-1] - s[N-2], a mesma referência (início da janela)
+ * da recursão deslizante.
+ */
+void sliding_dft_reanchor_bin(sliding_dft_t *sdft, uint32_t index) {
+    const float c = sdft->rot_re[index];
+    const float coeff = 2.0f * c;
+    float s1 = 0.0f, s2 = 0.0f;
+    
+    // Da mais antiga (pos) à mais recente, em dois trechos do buffer circular
+    for (uint32_t m = sdft->pos; m < sdft->window; m++) {
+        float s0 = sdft->history[m] + coeff * s1 - s2;
+        s2 = s1;
+        s1 = s0;
+    }
+    for (uint32_t m = 0; m < sdft->pos; m++) {
+        float s0 = sdft->history[m] + coeff * s1 - s2;
+        s2 = s1;
+        s1 = s0;
+    }
+    
+    sdft->re[index] = c * s1 - s2;
+    sdft->im[index] = sdft->rot_im[index] * s1;
+    sdft->n_reanchors++;
+}
+
+/**
+ * @brief Re-ancoragem distribuída: chamar uma vez por bloco de amostras
+ *
+ * A cada reanchor_interval amostras todos os bins ficam pendentes; cada
+ * chamada recalcula no máximo um bin pendente.
+ */
+void sliding_dft_maintain(sliding_dft_t *sdft) {
+    if (sdft->reanchor_interval == 0) {
+        return;
+    }
+    if (sdft->anchor_pending == 0 && sdft->since_anchor >= sdft->reanchor_interval) {
+        sdft->since_anchor = 0;
+        sdft->anchor_pending = (sdft->n_bins >= 32) ? UINT32_MAX : ((1u << sdft->n_bins) - 1);
+    }
+    if (sdft->anchor_pending != 0) {
+        uint32_t index = (uint32_t)__builtin_ctz(sdft->anchor_pending);
+        sliding_dft_reanchor_bin(sdft, index);
+        sdft->anchor_pending &= sdft->anchor_pending - 1;
+    }
+}
+
+/**
+ * @brief Amplitude de pico de uma senoide no bin index (2 |X_k| / N)
+ */
+float sliding_dft_amplitude(const sliding_dft_t *sdft, uint32_t index) {
+    return 2.0f * sqrtf(sliding_dft_power(sdft, index)) / sdft->window;
+}
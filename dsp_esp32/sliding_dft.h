@@ -0,0 +1,99 @@
+/**
+ * @file sliding_dft.h
+ * @brief DFT deslizante (SDFT) de alguns bins, atualizada a cada amostra
+ *
+ * Para cada bin k de uma janela de N amostras:
+ *
+ *   X_k[n] = e^{j 2 pi k / N} (X_k[n-1] + x[n] - x[n-N])
+ *
+ * que é exatamente a DFT das últimas N amostras (referida ao início da
+ * janela), com custo O(1) por bin e por amostra em vez de uma FFT por
+ * quadro. Em float o erro da rotação e das somas se acumula sem limite;
+ * por isso cada bin é periodicamente recalculado a partir do histórico
+ * (re-ancoragem, O(N) por bin), um bin por chamada de
+ * sliding_dft_maintain() para não concentrar o custo em uma única amostra.
+ *
+ * k deve ser inteiro (o termo x[n-N] só cancela para bins da janela).
+ * Nenhuma dependência do ESP-IDF (compila também no host).
+ */
+
+#ifndef SLIDING_DFT_H
+#define SLIDING_DFT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#define SLIDING_DFT_MAX_BINS    16
+
+/**
+ * @brief Estado da DFT deslizante
+ */
+typedef struct {
+    float *history;             // Últimas N amostras (buffer circular do chamador)
+    uint32_t window;            // N
+    uint32_t pos;               // Posição da amostra mais antiga (próxima a sair)
+    uint32_t n_bins;
+    uint16_t bins[SLIDING_DFT_MAX_BINS];
+    float rot_re[SLIDING_DFT_MAX_BINS];     // e^{j 2 pi k / N}
+    float rot_im[SLIDING_DFT_MAX_BINS];
+    float re[SLIDING_DFT_MAX_BINS];         // X_k atual
+    float im[SLIDING_DFT_MAX_BINS];
+    
+    uint32_t reanchor_interval; // Amostras entre re-ancoragens de todos os bins
+    uint32_t since_anchor;      // Amostras desde o último disparo
+    uint32_t anchor_pending;    // Máscara de bins ainda não re-ancorados neste ciclo
+    uint32_t n_reanchors;       // Re-ancoragens feitas (diagnóstico)
+} sliding_dft_t;
+
+/**
+ * @brief Payload TELEMETRY_TYPE_SPECTRAL_EVENT (24 bytes)
+ *
+ * Variação brusca de amplitude de um bin detectada amostra a amostra.
+ */
+typedef struct __attribute__((packed)) {
+    int64_t  time_us;           // Instante do bloco de DMA da amostra (esp_timer)
+    uint32_t sample_index;      // Amostra desde o início da aquisição
+    uint16_t bin;               // Bin k da SDFT
+    uint16_t window;            // N da SDFT (frequência = k * fs / N)
+    float    amplitude;         // Amplitude no disparo
+    float    baseline;          // Amplitude média antes do disparo
+} sliding_dft_event_record_t;
+
+_Static_assert(sizeof(sliding_dft_event_record_t) == 24, "sliding_dft_event_record_t deve ter 24 bytes");
+
+// Protótipos de funções
+bool sliding_dft_init(sliding_dft_t *sdft, float *history, uint32_t window,
+                      const uint16_t *bins, uint32_t n_bins, uint32_t reanchor_interval);
+void sliding_dft_reset(sliding_dft_t *sdft);
+void sliding_dft_maintain(sliding_dft_t *sdft);
+void sliding_dft_reanchor_bin(sliding_dft_t *sdft, uint32_t index);
+float sliding_dft_amplitude(const sliding_dft_t *sdft, uint32_t index);
+
+/**
+ * @brief Insere uma amostra e atualiza todos os bins (O(n_bins))
+ */
+static inline void sliding_dft_push(sliding_dft_t *sdft, float x) {
+    float delta = x - sdft->history[sdft->pos];
+    sdft->history[sdft->pos] = x;
+    if (++sdft->pos == sdft->window) {
+        sdft->pos = 0;
+    }
+    
+    for (uint32_t i = 0; i < sdft->n_bins; i++) {
+        float a = sdft->re[i] + delta;
+        float b = sdft->im[i];
+        sdft->re[i] = a * sdft->rot_re[i] - b * sdft->rot_im[i];
+        sdft->im[i] = a * sdft->rot_im[i] + b * sdft->rot_re[i];
+    }
+    sdft->since_anchor++;
+}
+
+/**
+ * @brief |X_k|² do bin index (sem normalização; barato para comparações)
+ */
+static inline float sliding_dft_power(const sliding_dft_t *sdft, uint32_t index) {
+    return sdft->re[index] * sdft->re[index] + sdft->im[index] * sdft->im[index];
+}
+
+#endif // SLIDING_DFT_H
@@ -0,0 +1,209 @@
+/**
+ * @file split_radix.c
+ * @brief Implementação da FFT split-radix com tabelas pré-calculadas
+ */
+
+#include "split_radix.h"
+#include <math.h>
+
+/**
+ * @brief Pré-calcula os fatores de giro e as trocas da inversão de bits
+ *
+ * @param fft Plano
+ * @param n Tamanho da FFT: 256, 512 ou 1024
+ * @return false se n não for suportado
+ */
+bool split_radix_init(split_radix_fft_t *fft, uint32_t n) {
+    if (n != 256 && n != 512 && n != 1024) {
+        return false;
+    }
+    fft->n = n;
+    fft->log2n = 0;
+    while ((1u << fft->log2n) < n) {
+        fft->log2n++;
+    }
+
+    // Estágios n2 = N, N/2, ..., 4 na ordem em que são executados
+    float *tw = fft->twiddle;
+    for (uint32_t n2 = n; n2 >= 4; n2 /= 2) {
+        for (uint32_t j = 0; j < n2 / 4; j++) {
+            double a = 2.0 * M_PI * j / n2;
+            *tw++ = (float)cos(a);
+            *tw++ = (float)sin(a);
+            *tw++ = (float)cos(3.0 * a);
+            *tw++ = (float)sin(3.0 * a);
+        }
+    }
+
+    fft->n_swaps = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        uint32_t r = 0;
+        for (uint32_t b = 0; b < fft->log2n; b++) {
+            r |= ((i >> b) & 1u) << (fft->log2n - 1 - b);
+        }
+        if (i < r) {
+            fft->swap[2 * fft->n_swaps] = (uint16_t)i;
+            fft->swap[2 * fft->n_swaps + 1] = (uint16_t)r;
+            fft->n_swaps++;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Butterfly em "L" nos pontos i0, i0 + n4, i0 + 2·n4, i0 + 3·n4
+ *
+ * Meia-DFT nos dois primeiros; os dois últimos (x0 - x2 ∓ j(x1 - x3))
+ * saem multiplicados por W^m e W^3m.
+ */
+static inline void butterfly_l(float *d, uint32_t i0, uint32_t n4, float c1, float s1, float c3, float s3) {
+    float *x0 = &d[2 * i0];
+    float *x1 = x0 + 2 * n4;
+    float *x2 = x1 + 2 * n4;
+    float *x3 = x2 + 2 * n4;
+
+    float r1 = x0[0] - x2[0];
+    float i1 = x0[1] - x2[1];
+    float r2 = x1[0] - x3[0];
+    float i2 = x1[1] - x3[1];
+    x0[0] += x2[0];
+    x0[1] += x2[1];
+    x1[0] += x3[0];
+    x1[1] += x3[1];
+
+    float ar = r1 + i2, ai = i1 - r2;   // x0 - x2 - j(x1 - x3)
+    float br = r1 - i2, bi = i1 + r2;   // x0 - x2 + j(x1 - x3)
+    x2[0] = ar * c1 + ai * s1;
+    x2[1] = ai * c1 - ar * s1;
+    x3[0] = br * c3 + bi * s3;
+    x3[1] = bi * c3 - br * s3;
+}
+
+/**
+ * @brief Butterfly em "L" com m = 0 (W^0 = 1, sem multiplicações)
+ */
+static inline void butterfly_l0(float *d, uint32_t i0, uint32_t n4) {
+    float *x0 = &d[2 * i0];
+    float *x1 = x0 + 2 * n4;
+    float *x2 = x1 + 2 * n4;
+    float *x3 = x2 + 2 * n4;
+
+    float r1 = x0[0] - x2[0];
+    float i1 = x0[1] - x2[1];
+    float r2 = x1[0] - x3[0];
+    float i2 = x1[1] - x3[1];
+    x0[0] += x2[0];
+    x0[1] += x2[1];
+    x1[0] += x3[0];
+    x1[1] += x3[1];
+
+    x2[0] = r1 + i2;
+    x2[1] = i1 - r2;
+    x3[0] = r1 - i2;
+    x3[1] = i1 + r2;
+}
+
+/**
+ * @brief Núcleo DIF; inline com n constante nas versões especializadas
+ *
+ * Em cada estágio os blocos que ainda são "L" de tamanho n2 começam nos
+ * índices is, is + id, ... e a lista de inícios é refeita com
+ * is = 2·id - n2 + m, id = 4·id até passar de N (indexação de Sorensen).
+ */
+static inline __attribute__((always_inline)) void split_radix_core(const float *tw, float *d, const uint32_t n) {
+    for (uint32_t n2 = n; n2 >= 4; n2 /= 2) {
+        const uint32_t n4 = n2 / 4;
+
+        // m = 0: fatores unitários
+        uint32_t is = 0, id = 2 * n2;
+        do {
+            for (uint32_t i0 = is; i0 < n - 1; i0 += id) {
+                butterfly_l0(d, i0, n4);
+            }
+            is = 2 * id - n2;
+            id *= 4;
+        } while (is < n - 1);
+
+        for (uint32_t m = 1; m < n4; m++) {
+            const float c1 = tw[4 * m], s1 = tw[4 * m + 1];
+            const float c3 = tw[4 * m + 2], s3 = tw[4 * m + 3];
+            is = m;
+            id = 2 * n2;
+            do {
+                for (uint32_t i0 = is; i0 < n - 1; i0 += id) {
+                    butterfly_l(d, i0, n4, c1, s1, c3, s3);
+                }
+                is = 2 * id - n2 + m;
+                id *= 4;
+            } while (is < n - 1);
+        }
+        tw += 4 * n4;
+    }
+
+    // Último estágio: butterflies de 2 pontos nos blocos que restaram
+    uint32_t is = 0, id = 4;
+    do {
+        for (uint32_t i0 = is; i0 < n; i0 += id) {
+            float *x0 = &d[2 * i0];
+            float r = x0[0], i = x0[1];
+            x0[0] = r + x0[2];
+            x0[1] = i + x0[3];
+            x0[2] = r - x0[2];
+            x0[3] = i - x0[3];
+        }
+        is = 2 * id - 2;
+        id *= 4;
+    } while (is < n - 1);
+}
+
+static void __attribute__((noinline)) split_radix_256(const float *tw, float *d) {
+    split_radix_core(tw, d, 256);
+}
+
+static void __attribute__((noinline)) split_radix_512(const float *tw, float *d) {
+    split_radix_core(tw, d, 512);
+}
+
+static void __attribute__((noinline)) split_radix_1024(const float *tw, float *d) {
+    split_radix_core(tw, d, 1024);
+}
+
+/**
+ * @brief Aplica a permutação de inversão de bits (ordem natural)
+ */
+void split_radix_bit_reverse(const split_radix_fft_t *fft, float *data) {
+    const uint16_t *swap = fft->swap;
+    for (uint32_t k = 0; k < fft->n_swaps; k++) {
+        float *a = &data[2 * swap[2 * k]];
+        float *b = &data[2 * swap[2 * k + 1]];
+        float re = a[0], im = a[1];
+        a[0] = b[0];
+        a[1] = b[1];
+        b[0] = re;
+        b[1] = im;
+    }
+}
+
+/**
+ * @brief FFT direta in-place de fft->n pontos complexos intercalados
+ *
+ * @param fft Plano (split_radix_init)
+ * @param data 2·n floats (re, im)
+ * @param in_order true = ordem natural; false = bits invertidos (sem a permutação)
+ */
+void split_radix_fft(const split_radix_fft_t *fft, float *data, bool in_order) {
+    switch (fft->n) {
+    case 256:
+        split_radix_256(fft->twiddle, data);
+        break;
+    case 512:
+        split_radix_512(fft->twiddle, data);
+        break;
+    default:
+        split_radix_1024(fft->twiddle, data);
+        break;
+    }
+    if (in_order) {
+        split_radix_bit_reverse(fft, data);
+    }
+}
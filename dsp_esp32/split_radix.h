@@ -0,0 +1,53 @@
+/**
+ * @file split_radix.h
+ * @brief FFT complexa split-radix (DIF) para N = 256, 512 e 1024
+ *
+ * Versão em C do algoritmo de AlgoritmoFFT/Split_Radix.ipynb, na forma
+ * iterativa de Sorensen, Heideman e Burrus (butterflies em "L"): cada
+ * estágio divide um bloco de n2 pontos em uma metade (outra DFT de n2/2)
+ * e dois quartos multiplicados por W^j e W^3j,
+ *
+ *   X[2k]   = DFT_{n2/2}(x[m] + x[m + n2/2])
+ *   X[4k+1] = DFT_{n2/4}((x[m] - x[m+n2/2] - j(x[m+n2/4] - x[m+3n2/4])) W^m)
+ *   X[4k+3] = DFT_{n2/4}((x[m] - x[m+n2/2] + j(x[m+n2/4] - x[m+3n2/4])) W^3m)
+ *
+ * o que dá ≈ 4N·log2(N) - 6N operações reais contra ≈ 5N·log2(N) do
+ * radix-2. Os fatores de giro de cada estágio ficam contíguos em uma
+ * tabela alinhada ({cos, sin}(2πm/n2) e o mesmo para 3m), lida em
+ * sequência, e a butterfly com m = 0 não multiplica. A saída do DIF fica
+ * em ordem de bits invertida; split_radix_fft(..., true) aplica a
+ * permutação pré-calculada (só as trocas, em uma passada) e entrega a
+ * ordem natural, como dsps_fft2r_fc32 + dsps_bit_rev_fc32.
+ *
+ * Dados complexos intercalados (re, im), transformada direta e^{-j}, sem
+ * normalização. Nenhuma dependência do ESP-IDF (compila também no host).
+ */
+
+#ifndef SPLIT_RADIX_H
+#define SPLIT_RADIX_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#define SPLIT_RADIX_MIN_N       256
+#define SPLIT_RADIX_MAX_N       1024
+
+/**
+ * @brief Plano de um tamanho: fatores de giro e trocas da inversão de bits
+ */
+typedef struct {
+    uint32_t n;
+    uint32_t log2n;
+    uint32_t n_swaps;
+    // Por estágio (n2 = N, N/2, ..., 4), n2/4 quartetos {c1, s1, c3, s3}
+    float twiddle[2 * SPLIT_RADIX_MAX_N] __attribute__((aligned(16)));
+    uint16_t swap[SPLIT_RADIX_MAX_N];       // Pares (i, bitrev(i)) com i < bitrev(i)
+} split_radix_fft_t;
+
+// Protótipos de funções
+bool split_radix_init(split_radix_fft_t *fft, uint32_t n);
+void split_radix_fft(const split_radix_fft_t *fft, float *data, bool in_order);
+void split_radix_bit_reverse(const split_radix_fft_t *fft, float *data);
+
+#endif // SPLIT_RADIX_H
@@ -0,0 +1,508 @@
+/**
+ * @file telemetry.c
+ * @brief Implementação do protocolo binário de telemetria
+ *
+ * O envio é não bloqueante: os quadros são montados diretamente dentro de
+ * um ringbuffer do FreeRTOS e uma task de baixa prioridade os entrega ao
+ * driver (USB-Serial-JTAG ou UART), que os copia para o seu buffer de TX
+ * e alimenta a FIFO do periférico por interrupção (sem DMA). Se a fila
+ * estiver cheia o quadro é descartado e contabilizado, nunca bloqueando a
+ * task de análise.
+ *
+ * O console (ESP_LOG, printf) usa a mesma porta: depois de instalar o
+ * driver, o VFS passa a escrever por ele. Cada quadro sai em uma única
+ * chamada de escrita, atômica no driver (mutex de TX da UART; o quadro cabe
+ * no buffer do USB-Serial-JTAG), então texto de log só aparece entre
+ * quadros, onde o decodificador do host o separa. Só as mensagens da ROM e
+ * do pânico escrevem direto na FIFO.
+ */
+
+#include "telemetry.h"
+#include <math.h>
+#include <stdatomic.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/ringbuf.h"
+#include "esp_log.h"
+#include "sdkconfig.h"
+
+#include "esp_idf_version.h"
+
+#if CONFIG_ESP_CONSOLE_USB_SERIAL_JTAG
+#include "driver/usb_serial_jtag.h"
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 3, 0)
+#include "driver/usb_serial_jtag_vfs.h"
+#else
+#include "esp_vfs_usb_serial_jtag.h"
+#define usb_serial_jtag_vfs_use_driver esp_vfs_usb_serial_jtag_use_driver
+#endif
+#else
+#include "driver/uart.h"
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 3, 0)
+#include "driver/uart_vfs.h"
+#else
+#include "esp_vfs_dev.h"
+#define uart_vfs_dev_use_driver esp_vfs_dev_uart_use_driver
+#endif
+#define TELEMETRY_UART_PORT UART_NUM_0
+#endif
+
+static const char *TAG = "TELEMETRY";
+
+static RingbufHandle_t tx_ring = NULL;
+static TaskHandle_t tx_task_handle = NULL;
+// Atualizados pelos produtores dos dois núcleos
+static atomic_uint dropped_frames = 0;
+static atomic_size_t queue_high_water = 0;
+
+/**
+ * @brief Calcula o CRC-16/CCITT-FALSE (poli 0x1021, sem reflexão)
+ *
+ * @param data Dados de entrada
+ * @param len Número de bytes
+ * @param crc Valor inicial (0xFFFF para um quadro novo)
+ * @return CRC atualizado
+ */
+uint16_t telemetry_crc16(const uint8_t *data, size_t len, uint16_t crc) {
+    for (size_t i = 0; i < len; i++) {
+        crc ^= (uint16_t)data[i] << 8;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+        }
+    }
+    return crc;
+}
+
+/**
+ * @brief Monta um quadro completo (cabeçalho + payload + CRC) em um buffer
+ *
+ * @param out Buffer de saída
+ * @param out_size Tamanho do buffer de saída
+ * @param header Cabeçalho já preenchido (payload_len deve estar correto)
+ * @param payload Payload já no formato de transmissão
+ * @return Tamanho do quadro em bytes, ou 0 se não couber em out
+ */
+size_t telemetry_encode_frame(uint8_t *out, size_t out_size, const telemetry_header_t *header, const void *payload) {
+    size_t frame_len = TELEMETRY_HEADER_SIZE + header->payload_len + TELEMETRY_CRC_SIZE;
+    if (frame_len > out_size) {
+        return 0;
+    }
+
+    memcpy(out, header, TELEMETRY_HEADER_SIZE);
+    memcpy(out + TELEMETRY_HEADER_SIZE, payload, header->payload_len);
+
+    uint16_t crc = telemetry_crc16(out, TELEMETRY_HEADER_SIZE + header->payload_len, 0xFFFF);
+    out[frame_len - 2] = (uint8_t)(crc & 0xFF);
+    out[frame_len - 1] = (uint8_t)(crc >> 8);
+
+    return frame_len;
+}
+
+/**
+ * @brief Escreve um quadro no transporte
+ *
+ * O driver copia os bytes para o seu buffer de TX e a transmissão segue
+ * por interrupção; apenas esta task fica esperando por espaço. Uma única
+ * chamada por quadro: o log do console não entra no meio dele.
+ */
+static void transport_write(const uint8_t *data, size_t len) {
+#if CONFIG_ESP_CONSOLE_USB_SERIAL_JTAG
+    usb_serial_jtag_write_bytes(data, len, portMAX_DELAY);
+#else
+    uart_write_bytes(TELEMETRY_UART_PORT, data, len);
+#endif
+}
+
+/**
+ * Task de transmissão - esvazia o ringbuffer para o driver
+ */
+static void telemetryTask(void *param) {
+    while (1) {
+        size_t len = 0;
+        uint8_t *frame = (uint8_t *)xRingbufferReceive(tx_ring, &len, portMAX_DELAY);
+
+        if (frame != NULL) {
+            transport_write(frame, len);
+            vRingbufferReturnItem(tx_ring, frame);
+        }
+    }
+}
+
+/**
+ * @brief Inicializa o driver de transporte, a fila e a task de transmissão
+ *
+ * @return ESP_OK em caso de sucesso
+ */
+esp_err_t telemetry_init(void) {
+    esp_err_t ret;
+
+#if CONFIG_ESP_CONSOLE_USB_SERIAL_JTAG
+    usb_serial_jtag_driver_config_t usb_cfg = {
+        .tx_buffer_size = TELEMETRY_DRIVER_TX_BUFFER,
+        .rx_buffer_size = 256,
+    };
+    ret = usb_serial_jtag_driver_install(&usb_cfg);
+    if (ret == ESP_OK) {
+        // O console passa a escrever pelo driver, sem disputar a FIFO com os quadros
+        usb_serial_jtag_vfs_use_driver();
+    }
+#else
+    ret = uart_driver_install(TELEMETRY_UART_PORT, 256, TELEMETRY_DRIVER_TX_BUFFER, 0, NULL, 0);
+    if (ret == ESP_OK) {
+        uart_vfs_dev_use_driver(TELEMETRY_UART_PORT);
+        ret = uart_set_baudrate(TELEMETRY_UART_PORT, TELEMETRY_UART_BAUD_RATE);
+    }
+#endif
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Transport driver install failed: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    tx_ring = xRingbufferCreate(TELEMETRY_RING_SIZE, RINGBUF_TYPE_NOSPLIT);
+    if (tx_ring == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    if (xTaskCreatePinnedToCore(telemetryTask, "Telemetry Task", TELEMETRY_TASK_STACK, NULL,
+                                TELEMETRY_TASK_PRIORITY, &tx_task_handle, TELEMETRY_TASK_CORE) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    ESP_LOGI(TAG, "Binary telemetry ready (ring %d bytes, link %d bytes/s)", TELEMETRY_RING_SIZE,
+             TELEMETRY_LINK_BYTES_PER_S);
+    return ESP_OK;
+}
+
+/**
+ * @brief Calcula o CRC de um quadro montado no ringbuffer e o publica
+ *
+ * Também atualiza a maior ocupação da fila, usada no diagnóstico do pipeline.
+ */
+static void complete_frame(void *slot, size_t frame_len) {
+    uint8_t *out = (uint8_t *)slot;
+    uint16_t crc = telemetry_crc16(out, frame_len - TELEMETRY_CRC_SIZE, 0xFFFF);
+    out[frame_len - 2] = (uint8_t)(crc & 0xFF);
+    out[frame_len - 1] = (uint8_t)(crc >> 8);
+
+    xRingbufferSendComplete(tx_ring, slot);
+
+    size_t used = TELEMETRY_RING_SIZE - xRingbufferGetCurFreeSize(tx_ring);
+    size_t seen = atomic_load_explicit(&queue_high_water, memory_order_relaxed);
+    while (used > seen &&
+           !atomic_compare_exchange_weak_explicit(&queue_high_water, &seen, used,
+                                                  memory_order_relaxed, memory_order_relaxed)) {
+    }
+}
+
+/**
+ * @brief Quantiza um valor para o inteiro de transmissão (saturado em ±(2^30 - 1))
+ *
+ * A faixa limitada garante que a diferença entre dois valores caiba em int32.
+ * NaN/Inf (e um produto não finito com a escala) viram TELEMETRY_RAW_INVALID
+ * antes da conversão, que seria indefinida.
+ */
+static int32_t quantize_value(float value, float inv_scale, float offset) {
+    float q = roundf((value - offset) * inv_scale);
+    if (!isfinite(value) || isnan(q)) {
+        return TELEMETRY_RAW_INVALID;
+    }
+    // 2^30 - 1 não é representável em float: satura já no inteiro
+    if (q >= 1073741824.0f) return 1073741823;
+    if (q <= -1073741824.0f) return -1073741823;
+    return (int32_t)q;
+}
+
+/**
+ * @brief Quantiza um valor para int16 (saturado em ±32767, NaN/Inf = TELEMETRY_I16_INVALID)
+ */
+static int16_t quantize_i16(float value, float inv_scale, float offset) {
+    float q = roundf((value - offset) * inv_scale);
+    if (!isfinite(value) || isnan(q)) {
+        return TELEMETRY_I16_INVALID;
+    }
+    if (q > 32767.0f) q = 32767.0f;
+    if (q < -32767.0f) q = -32767.0f;
+    return (int16_t)q;
+}
+
+/**
+ * @brief Reserva um quadro no ringbuffer e escreve o cabeçalho
+ *
+ * @param slot Saída: memória do quadro, para complete_frame()
+ * @return Início do payload, ou NULL (quadro descartado e contado) se o
+ *         payload não couber ou a fila estiver cheia
+ */
+static uint8_t *begin_frame(void **slot, const telemetry_header_t *header) {
+    if (tx_ring == NULL || header->payload_len > TELEMETRY_MAX_PAYLOAD) {
+        atomic_fetch_add_explicit(&dropped_frames, 1, memory_order_relaxed);
+        return NULL;
+    }
+
+    size_t frame_len = TELEMETRY_HEADER_SIZE + header->payload_len + TELEMETRY_CRC_SIZE;
+    *slot = NULL;
+    if (xRingbufferSendAcquire(tx_ring, slot, frame_len, 0) != pdTRUE || *slot == NULL) {
+        atomic_fetch_add_explicit(&dropped_frames, 1, memory_order_relaxed);
+        return NULL;
+    }
+
+    uint8_t *out = (uint8_t *)*slot;
+    memcpy(out, header, TELEMETRY_HEADER_SIZE);
+    return out + TELEMETRY_HEADER_SIZE;
+}
+
+/**
+ * @brief Cabeçalho comum a todos os quadros
+ */
+static telemetry_header_t make_header(telemetry_type_t type, telemetry_format_t format, uint8_t flags,
+                                      uint16_t n_values, uint16_t frame_size, size_t payload_len,
+                                      uint32_t packet_id, uint32_t sample_rate_hz, float scale, float offset) {
+    return (telemetry_header_t){
+        .sync = TELEMETRY_SYNC_WORD,
+        .version = TELEMETRY_VERSION,
+        .type = (uint8_t)type,
+        .format = (uint8_t)format,
+        .flags = flags,
+        .n_values = n_values,
+        .frame_size = frame_size,
+        .payload_len = (uint16_t)payload_len,
+        .packet_id = packet_id,
+        .sample_rate_hz = sample_rate_hz,
+        .scale = scale,
+        .offset = offset,
+    };
+}
+
+/**
+ * @brief Zig-zag: inteiros pequenos (positivos ou negativos) viram códigos pequenos
+ */
+static inline uint32_t zigzag_encode(int32_t value) {
+    return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+}
+
+static inline size_t varint_size(uint32_t value) {
+    size_t n = 1;
+    while (value >= 0x80) {
+        value >>= 7;
+        n++;
+    }
+    return n;
+}
+
+/**
+ * @brief Escreve um varint LEB128 (7 bits por byte, bit 7 = continua)
+ */
+static inline uint8_t *varint_write(uint8_t *out, uint32_t value) {
+    while (value >= 0x80) {
+        *out++ = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    *out++ = (uint8_t)value;
+    return out;
+}
+
+/**
+ * @brief Tamanho do payload delta + zig-zag varint de um bloco
+ */
+static size_t delta_varint_size(const float *values, uint16_t n_values, float inv_scale, float offset) {
+    size_t len = 0;
+    int32_t prev = 0;
+    for (int i = 0; i < n_values; i++) {
+        int32_t q = quantize_value(values[i], inv_scale, offset);
+        len += varint_size(zigzag_encode(q - prev));
+        prev = q;
+    }
+    return len;
+}
+
+/**
+ * @brief Escala e offset de int16 que cobrem exatamente a faixa do bloco
+ *
+ * Com esses valores, telemetry_send_block() em TELEMETRY_FORMAT_I16 usa
+ * toda a faixa -32767..32767 (erro máximo de meio passo da faixa do bloco).
+ *
+ * @param values Valores do bloco
+ * @param n_values Número de valores
+ * @param scale Saída: escala (sempre > 0)
+ * @param offset Saída: offset (centro da faixa)
+ */
+void telemetry_block_range(const float *values, uint16_t n_values, float *scale, float *offset) {
+    float vmin = INFINITY, vmax = -INFINITY;
+    for (int i = 0; i < n_values; i++) {
+        if (!isfinite(values[i])) {
+            continue;           // Enviado como TELEMETRY_I16_INVALID
+        }
+        if (values[i] < vmin) vmin = values[i];
+        if (values[i] > vmax) vmax = values[i];
+    }
+    if (vmin > vmax) {
+        vmin = vmax = 0.0f;     // Bloco vazio ou sem valores finitos
+    }
+
+    *offset = 0.5f * (vmin + vmax);
+    *scale = (vmax > vmin) ? (vmax - vmin) / 65534.0f : 1.0f;
+}
+
+/**
+ * @brief Enfileira um bloco de dados para transmissão (não bloqueante)
+ *
+ * O quadro é montado diretamente na memória do ringbuffer, sem cópia
+ * intermediária. Nos formatos quantizados cada valor vira
+ * raw = round((valor - offset) / scale):
+ *   - I16: raw int16 com saturação
+ *   - DELTA_VARINT: diferença entre raws consecutivos (o primeiro contra 0),
+ *     em zig-zag e varint LEB128; o tamanho é calculado em uma primeira
+ *     passada para reservar exatamente o espaço do quadro
+ *
+ * @param type Tipo do bloco
+ * @param packet_id Identificador do pacote
+ * @param sample_rate_hz Taxa de amostragem do sinal
+ * @param frame_size N da janela/FFT
+ * @param values Valores a enviar
+ * @param n_values Número de valores
+ * @param format Formato do payload (F32, I16 ou DELTA_VARINT)
+ * @param scale Escala (formatos quantizados, > 0)
+ * @param offset Offset (formatos quantizados)
+ * @param flags TELEMETRY_FLAG_*
+ * @return true se enfileirado, false se descartado (fila cheia ou formato inválido)
+ */
+bool telemetry_send_block(telemetry_type_t type, uint32_t packet_id, uint32_t sample_rate_hz,
+                          uint16_t frame_size, const float *values, uint16_t n_values,
+                          telemetry_format_t format, float scale, float offset, uint8_t flags) {
+    bool quantized = (format == TELEMETRY_FORMAT_I16 || format == TELEMETRY_FORMAT_DELTA_VARINT);
+    float inv_scale = quantized ? 1.0f / scale : 1.0f;
+    size_t payload_len;
+
+    switch (format) {
+        case TELEMETRY_FORMAT_F32:
+            payload_len = (size_t)n_values * sizeof(float);
+            break;
+        case TELEMETRY_FORMAT_I16:
+            payload_len = (size_t)n_values * sizeof(int16_t);
+            break;
+        case TELEMETRY_FORMAT_DELTA_VARINT:
+            payload_len = delta_varint_size(values, n_values, inv_scale, offset);
+            break;
+        default:
+            payload_len = SIZE_MAX;
+            break;
+    }
+
+    if (payload_len > TELEMETRY_MAX_PAYLOAD || (quantized && !(scale > 0.0f))) {
+        atomic_fetch_add_explicit(&dropped_frames, 1, memory_order_relaxed);
+        return false;
+    }
+
+    telemetry_header_t header = make_header(type, format, flags, n_values, frame_size, payload_len, packet_id,
+                                            sample_rate_hz, quantized ? scale : 1.0f, quantized ? offset : 0.0f);
+    void *slot;
+    uint8_t *payload = begin_frame(&slot, &header);
+    if (payload == NULL) {
+        return false;
+    }
+
+    if (format == TELEMETRY_FORMAT_I16) {
+        for (int i = 0; i < n_values; i++) {
+            int16_t raw = quantize_i16(values[i], inv_scale, offset);
+            memcpy(payload + i * sizeof(int16_t), &raw, sizeof(int16_t));
+        }
+    } else if (format == TELEMETRY_FORMAT_DELTA_VARINT) {
+        int32_t prev = 0;
+        for (int i = 0; i < n_values; i++) {
+            int32_t q = quantize_value(values[i], inv_scale, offset);
+            payload = varint_write(payload, zigzag_encode(q - prev));
+            prev = q;
+        }
+    } else {
+        memcpy(payload, values, payload_len);
+    }
+
+    complete_frame(slot, TELEMETRY_HEADER_SIZE + payload_len + TELEMETRY_CRC_SIZE);
+    return true;
+}
+
+/**
+ * @brief Enfileira um espectro reduzido: pares (bin, valor int16)
+ *
+ * Usado para enviar só parte dos bins (acima de um piso de ruído ou um
+ * pico por banda logarítmica). frame_size continua sendo o N da FFT, de
+ * modo que o host converte bin em frequência como nos blocos completos.
+ *
+ * @param type Tipo do bloco
+ * @param packet_id Identificador do pacote
+ * @param sample_rate_hz Taxa de amostragem do sinal
+ * @param frame_size N da FFT
+ * @param bins Índices dos bins enviados
+ * @param values Valor de cada bin enviado
+ * @param n_values Número de pares
+ * @param scale Escala do int16 (> 0)
+ * @param offset Offset do int16
+ * @param flags TELEMETRY_FLAG_*
+ * @return true se enfileirado, false se descartado
+ */
+bool telemetry_send_sparse(telemetry_type_t type, uint32_t packet_id, uint32_t sample_rate_hz,
+                           uint16_t frame_size, const uint16_t *bins, const float *values, uint16_t n_values,
+                           float scale, float offset, uint8_t flags) {
+    size_t payload_len = (size_t)n_values * (sizeof(uint16_t) + sizeof(int16_t));
+
+    if (payload_len > TELEMETRY_MAX_PAYLOAD || !(scale > 0.0f)) {
+        atomic_fetch_add_explicit(&dropped_frames, 1, memory_order_relaxed);
+        return false;
+    }
+
+    telemetry_header_t header = make_header(type, TELEMETRY_FORMAT_SPARSE_I16, flags, n_values, frame_size,
+                                            payload_len, packet_id, sample_rate_hz, scale, offset);
+    void *slot;
+    uint8_t *payload = begin_frame(&slot, &header);
+    if (payload == NULL) {
+        return false;
+    }
+
+    float inv_scale = 1.0f / scale;
+    for (int i = 0; i < n_values; i++) {
+        int16_t raw = quantize_i16(values[i], inv_scale, offset);
+        memcpy(payload, &bins[i], sizeof(uint16_t));
+        memcpy(payload + sizeof(uint16_t), &raw, sizeof(int16_t));
+        payload += sizeof(uint16_t) + sizeof(int16_t);
+    }
+
+    complete_frame(slot, TELEMETRY_HEADER_SIZE + payload_len + TELEMETRY_CRC_SIZE);
+    return true;
+}
+
+/**
+ * @brief Enfileira um payload estruturado (formato RAW) para transmissão
+ *
+ * @param type Tipo do quadro (define a estrutura do payload)
+ * @param packet_id Identificador do pacote
+ * @param payload Bytes do payload
+ * @param len Tamanho do payload (até TELEMETRY_MAX_PAYLOAD)
+ * @param flags TELEMETRY_FLAG_*
+ * @return true se enfileirado, false se descartado (fila cheia)
+ */
+bool telemetry_send_raw(telemetry_type_t type, uint32_t packet_id, const void *payload, uint16_t len, uint8_t flags) {
+    telemetry_header_t header = make_header(type, TELEMETRY_FORMAT_RAW, flags, len, 0, len, packet_id, 0, 1.0f, 0.0f);
+    void *slot;
+    uint8_t *out = begin_frame(&slot, &header);
+    if (out == NULL) {
+        return false;
+    }
+    memcpy(out, payload, len);
+
+    complete_frame(slot, TELEMETRY_HEADER_SIZE + len + TELEMETRY_CRC_SIZE);
+    return true;
+}
+
+/**
+ * @brief Retorna o número de quadros descartados por falta de espaço
+ */
+uint32_t telemetry_get_dropped(void) {
+    return atomic_load_explicit(&dropped_frames, memory_order_relaxed);
+}
+
+/**
+ * @brief Maior ocupação da fila de transmissão já observada (bytes)
+ */
+size_t telemetry_get_queue_high_water(void) {
+    return atomic_load_explicit(&queue_high_water, memory_order_relaxed);
+}
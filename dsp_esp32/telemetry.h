@@ -0,0 +1,127 @@
+/**
+ * @file telemetry.h
+ * @brief Protocolo binário de telemetria (pacotes com cabeçalho e CRC)
+ *
+ * Substitui o envio textual (printf "%.6f,%.6f\n") por quadros binários.
+ * Cada bloco de dados (sinal ou espectro) vira um quadro independente:
+ *
+ *   [cabeçalho 28 bytes][payload (ver telemetry_format_t)][CRC-16 2 bytes]
+ *
+ * Todos os campos são little-endian. O eixo do tempo/frequência não é
+ * enviado: o host reconstrói a partir de sample_rate_hz e frame_size.
+ * O CRC é o CRC-16/CCITT-FALSE (poli 0x1021, init 0xFFFF) calculado
+ * sobre cabeçalho + payload.
+ */
+
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "sdkconfig.h"
+#include "pipeline_config.h"
+
+// Configurações do protocolo
+#define TELEMETRY_SYNC_WORD         0xA55A  // Bytes 0x5A 0xA5 no fio
+#define TELEMETRY_VERSION           1
+#define TELEMETRY_HEADER_SIZE       28
+#define TELEMETRY_CRC_SIZE          2
+#define TELEMETRY_MAX_PAYLOAD       4096
+#define TELEMETRY_MAX_FRAME_SIZE    (TELEMETRY_HEADER_SIZE + TELEMETRY_MAX_PAYLOAD + TELEMETRY_CRC_SIZE)
+
+// Configurações do transporte
+#define TELEMETRY_RING_SIZE         16384   // Fila de transmissão (bytes)
+#define TELEMETRY_UART_BAUD_RATE    2000000 // Fluxo contínuo do signal_analyzer (~56 kB/s, até ~125 kB/s em F32)
+#define TELEMETRY_DRIVER_TX_BUFFER  (2 * TELEMETRY_MAX_FRAME_SIZE)  // Buffer de TX do driver (um quadro por escrita)
+
+// Vazão útil do enlace (bytes/s): 10 bits por byte na UART; no USB-Serial-JTAG
+// (CDC-ACM full-speed), estimativa conservadora
+#if CONFIG_ESP_CONSOLE_USB_SERIAL_JTAG
+#define TELEMETRY_LINK_BYTES_PER_S  400000
+#else
+#define TELEMETRY_LINK_BYTES_PER_S  (TELEMETRY_UART_BAUD_RATE / 10)
+#endif
+#define TELEMETRY_TASK_STACK        3072
+#define TELEMETRY_TASK_PRIORITY     PIPELINE_IO_PRIORITY
+#define TELEMETRY_TASK_CORE         PIPELINE_IO_CORE
+
+/**
+ * @brief Tipos de quadro
+ */
+typedef enum {
+    TELEMETRY_TYPE_SIGNAL_ORIGINAL = 1,     // Sinal ADC no tempo
+    TELEMETRY_TYPE_SIGNAL_FILTERED = 2,     // Sinal após filtro
+    TELEMETRY_TYPE_FFT_ORIGINAL    = 3,     // Espectro do sinal original (dB)
+    TELEMETRY_TYPE_FFT_FILTERED    = 4,     // Espectro do sinal filtrado (dB)
+    TELEMETRY_TYPE_PERF            = 5,     // Registro de instrumentação (perf_probe.h)
+    TELEMETRY_TYPE_EVENTS          = 6,     // Lote de eventos NILM (event_stream.h)
+    TELEMETRY_TYPE_POWER_SUMMARY   = 7,     // Resumo periódico de potência (event_stream.h)
+    TELEMETRY_TYPE_HARMONICS       = 8,     // Harmônicas da rede por quadro (goertzel.h)
+    TELEMETRY_TYPE_SPECTRAL_EVENT  = 9      // Transitório detectado pela DFT deslizante (sliding_dft.h)
+} telemetry_type_t;
+
+/**
+ * @brief Formatos de payload
+ *
+ * valor = raw * scale + offset (para float32: scale = 1, offset = 0).
+ * RAW carrega uma estrutura própria do tipo do quadro (n_values = bytes).
+ * DELTA_VARINT: n_values diferenças zig-zag em varint LEB128 (a primeira
+ * contra 0); raw[i] = raw[i-1] + diferença.
+ * SPARSE_I16: n_values pares (uint16 bin, int16 raw) de um espectro de
+ * frame_size pontos.
+ * Valores não finitos (NaN/Inf) viram o raw reservado TELEMETRY_I16_INVALID
+ * (I16, SPARSE_I16) ou TELEMETRY_RAW_INVALID (DELTA_VARINT); os demais
+ * saturam em ±32767 e ±(2^30 - 1).
+ */
+typedef enum {
+    TELEMETRY_FORMAT_F32          = 0,
+    TELEMETRY_FORMAT_I16          = 1,
+    TELEMETRY_FORMAT_RAW          = 2,
+    TELEMETRY_FORMAT_DELTA_VARINT = 3,
+    TELEMETRY_FORMAT_SPARSE_I16   = 4
+} telemetry_format_t;
+
+#define TELEMETRY_I16_INVALID       INT16_MIN           // Raw int16 de um valor não finito
+#define TELEMETRY_RAW_INVALID       (-1073741824)       // Raw DELTA_VARINT de um valor não finito (-2^30)
+
+// Flags do cabeçalho
+#define TELEMETRY_FLAG_LAST_BLOCK   0x01    // Último bloco do pacote (antigo ---DATA_COMPLETE---)
+
+/**
+ * @brief Cabeçalho do quadro (28 bytes, sem padding)
+ */
+typedef struct __attribute__((packed)) {
+    uint16_t sync;              // TELEMETRY_SYNC_WORD
+    uint8_t  version;           // TELEMETRY_VERSION
+    uint8_t  type;              // telemetry_type_t
+    uint8_t  format;            // telemetry_format_t
+    uint8_t  flags;             // TELEMETRY_FLAG_*
+    uint16_t n_values;          // Número de valores no payload
+    uint16_t frame_size;        // N da janela/FFT que originou o bloco
+    uint16_t payload_len;       // Tamanho do payload (bytes)
+    uint32_t packet_id;         // Identificador do pacote (agrupa os blocos)
+    uint32_t sample_rate_hz;    // Taxa de amostragem do sinal
+    float    scale;             // Escala do payload
+    float    offset;            // Offset do payload
+} telemetry_header_t;
+
+_Static_assert(sizeof(telemetry_header_t) == TELEMETRY_HEADER_SIZE, "telemetry_header_t deve ter 28 bytes");
+
+// Protótipos de funções
+uint16_t telemetry_crc16(const uint8_t *data, size_t len, uint16_t crc);
+size_t telemetry_encode_frame(uint8_t *out, size_t out_size, const telemetry_header_t *header, const void *payload);
+esp_err_t telemetry_init(void);
+bool telemetry_send_block(telemetry_type_t type, uint32_t packet_id, uint32_t sample_rate_hz,
+                          uint16_t frame_size, const float *values, uint16_t n_values,
+                          telemetry_format_t format, float scale, float offset, uint8_t flags);
+bool telemetry_send_sparse(telemetry_type_t type, uint32_t packet_id, uint32_t sample_rate_hz,
+                           uint16_t frame_size, const uint16_t *bins, const float *values, uint16_t n_values,
+                           float scale, float offset, uint8_t flags);
+void telemetry_block_range(const float *values, uint16_t n_values, float *scale, float *offset);
+bool telemetry_send_raw(telemetry_type_t type, uint32_t packet_id, const void *payload, uint16_t len, uint8_t flags);
+uint32_t telemetry_get_dropped(void);
+size_t telemetry_get_queue_high_water(void);
+
+#endif // TELEMETRY_H
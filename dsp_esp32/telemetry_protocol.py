@@ -0,0 +1,358 @@
+"""
+Decodificador do protocolo binário de telemetria da ESP32
+=========================================================
+Espelho de telemetry.h. Cada quadro tem o formato:
+
+    [cabeçalho 28 bytes][payload][CRC-16 2 bytes]
+
+Formatos de payload: float32, int16 (raw * scale + offset), estrutura RAW,
+delta + zig-zag varint (sinais no tempo) e pares (bin, int16) de espectros
+reduzidos.
+
+O decodificador procura a palavra de sincronismo, valida o CRC
+(CRC-16/CCITT-FALSE) e ignora qualquer texto de log intercalado.
+"""
+
+import binascii
+import struct
+from collections import namedtuple
+
+import numpy as np
+
+SYNC_BYTES = b'\x5a\xa5'
+VERSION = 1
+HEADER = struct.Struct('<HBBBBHHHIIff')
+CRC_SIZE = 2
+MAX_PAYLOAD = 4096
+
+# Tipos de quadro (telemetry_type_t)
+TYPE_SIGNAL_ORIGINAL = 1
+TYPE_SIGNAL_FILTERED = 2
+TYPE_FFT_ORIGINAL = 3
+TYPE_FFT_FILTERED = 4
+TYPE_PERF = 5
+TYPE_EVENTS = 6
+TYPE_POWER_SUMMARY = 7
+TYPE_HARMONICS = 8
+TYPE_SPECTRAL_EVENT = 9
+
+# Nome usado no CSV / current_data para cada tipo de bloco
+BLOCK_NAMES = {
+    TYPE_SIGNAL_ORIGINAL: 'signal_original',
+    TYPE_SIGNAL_FILTERED: 'signal_filtered',
+    TYPE_FFT_ORIGINAL: 'fft_original',
+    TYPE_FFT_FILTERED: 'fft_filtered',
+}
+
+# Formatos de payload (telemetry_format_t)
+FORMAT_F32 = 0
+FORMAT_I16 = 1
+FORMAT_RAW = 2
+FORMAT_DELTA_VARINT = 3
+FORMAT_SPARSE_I16 = 4
+SPARSE_DTYPE = np.dtype([('bin', '<u2'), ('raw', '<i2')])
+
+# Raws reservados para valores não finitos (TELEMETRY_I16_INVALID / TELEMETRY_RAW_INVALID)
+I16_INVALID = -32768
+RAW_INVALID = -(1 << 30)
+
+# Registro de instrumentação (perf_probe.h)
+PERF_HEADER = struct.Struct('<BBHII')
+PERF_STAGE = struct.Struct('<8sB3xIIIII')
+PERF_GAUGE = struct.Struct('<8sI')
+PERF_UNITS = {0: 'cycles', 1: 'us'}
+
+# Lotes de eventos e resumo de potência (event_stream.h)
+EVENT_BATCH_HEADER = struct.Struct('<HH')
+EVENT_RECORD = struct.Struct('<IffHBB')
+POWER_SUMMARY = struct.Struct('<IIHHfffffff')
+EVENT_FLAG_ON = 0x01
+EVENT_FLAG_STEADY = 0x02            # delta_power entre regimes permanentes (changepoint.h)
+
+# Harmônicas da rede (goertzel.h)
+HARMONICS_HEADER = struct.Struct('<ffB3x')
+
+# Transitório da DFT deslizante (sliding_dft.h)
+SPECTRAL_EVENT = struct.Struct('<qIHHff')
+
+# Histórico em flash (power_log.h), lido de um dump da partição "powerlog"
+POWER_LOG_SECTOR_SIZE = 4096
+POWER_LOG_HEADER = struct.Struct('<IHHIIII8x')
+POWER_LOG_MAGIC = 0x474F4C50
+POWER_LOG_MARK_EVENT = 0x7FB0E701
+POWER_LOG_MARK_GAP = 0x7FB0E702
+POWER_LOG_ERASED = 0xFFFFFFFF
+
+# device_type_t (nilm_filters.h) -> get_device_name()
+DEVICE_NAMES = ['Unknown', 'Light', 'Microwave', 'Washing Machine', 'Dishwasher', 'Refrigerator',
+                'Air Conditioner', 'Water Heater', 'Television', 'Computer', 'Other Device']
+
+FLAG_LAST_BLOCK = 0x01
+
+# bins: índices dos bins de um espectro reduzido (None para blocos completos)
+TelemetryFrame = namedtuple('TelemetryFrame', [
+    'type', 'format', 'flags', 'n_values', 'frame_size',
+    'packet_id', 'sample_rate_hz', 'scale', 'offset', 'values', 'bins'
+], defaults=(None,))
+
+
+def crc16_ccitt(data, crc=0xFFFF):
+    """CRC-16/CCITT-FALSE, igual a telemetry_crc16() no firmware"""
+    return binascii.crc_hqx(data, crc)
+
+
+def decode_delta_varint(payload, n_values):
+    """
+    Inteiros de um payload DELTA_VARINT: varints LEB128 em zig-zag com a
+    diferença para o valor anterior (o primeiro contra 0)
+    """
+    raws = []
+    value = shift = acc = 0
+    for byte in payload:
+        acc |= (byte & 0x7F) << shift
+        if byte & 0x80:
+            shift += 7
+            continue
+        value += (acc >> 1) ^ -(acc & 1)
+        raws.append(value)
+        acc = shift = 0
+    if len(raws) != n_values:
+        raise ValueError(f"DELTA_VARINT com {len(raws)} valores (esperado {n_values})")
+    return raws
+
+
+def dequantize(raws, scale, offset, invalid):
+    """raw * scale + offset, com NaN no lugar do raw reservado"""
+    raws = np.asarray(raws)
+    return np.where(raws == invalid, np.nan, raws * scale + offset)
+
+
+def decode_sparse(payload, scale=1.0, offset=0.0):
+    """Espectro reduzido: (bins, valores) a partir dos pares (uint16, int16)"""
+    pairs = np.frombuffer(payload, dtype=SPARSE_DTYPE)
+    return pairs['bin'].astype(np.int64), dequantize(pairs['raw'], scale, offset, I16_INVALID)
+
+
+def decode_payload(fmt, payload, scale=1.0, offset=0.0, n_values=None):
+    """Converte o payload bruto em um array float"""
+    if fmt == FORMAT_F32:
+        return np.frombuffer(payload, dtype='<f4').astype(np.float64)
+    if fmt == FORMAT_I16:
+        return dequantize(np.frombuffer(payload, dtype='<i2'), scale, offset, I16_INVALID)
+    if fmt == FORMAT_RAW:
+        return bytes(payload)
+    if fmt == FORMAT_DELTA_VARINT:
+        return dequantize(np.asarray(decode_delta_varint(payload, n_values), dtype=np.int64), scale, offset,
+                          RAW_INVALID)
+    if fmt == FORMAT_SPARSE_I16:
+        return decode_sparse(payload, scale, offset)[1]
+    raise ValueError(f"Formato de payload desconhecido: {fmt}")
+
+
+def decode_perf_record(payload):
+    """
+    Decodifica um registro TYPE_PERF em um dicionário:
+    {'cpu_freq_hz', 'period_ms', 'stages': {nome: {...}}, 'gauges': {nome: valor}}
+    """
+    n_stages, n_gauges, _, cpu_freq_hz, period_ms = PERF_HEADER.unpack_from(payload)
+    pos = PERF_HEADER.size
+    stages = {}
+    for _ in range(n_stages):
+        name, unit, count, vmin, avg, p99, vmax = PERF_STAGE.unpack_from(payload, pos)
+        pos += PERF_STAGE.size
+        stages[name.rstrip(b'\0').decode('ascii', 'replace')] = {
+            'unit': PERF_UNITS.get(unit, unit), 'count': count,
+            'min': vmin, 'avg': avg, 'p99': p99, 'max': vmax,
+        }
+    gauges = {}
+    for _ in range(n_gauges):
+        name, value = PERF_GAUGE.unpack_from(payload, pos)
+        pos += PERF_GAUGE.size
+        gauges[name.rstrip(b'\0').decode('ascii', 'replace')] = value
+    return {'cpu_freq_hz': cpu_freq_hz, 'period_ms': period_ms, 'stages': stages, 'gauges': gauges}
+
+
+def decode_event_batch(payload):
+    """
+    Decodifica um lote TYPE_EVENTS:
+    {'dropped', 'events': [{'timestamp_ms', 'delta_power', 'power', 'sequence',
+                            'device_type', 'device', 'on', 'steady'}, ...]}
+    """
+    n_events, dropped = EVENT_BATCH_HEADER.unpack_from(payload)
+    events = [decode_event_record(payload, EVENT_BATCH_HEADER.size + i * EVENT_RECORD.size)
+              for i in range(n_events)]
+    return {'dropped': dropped, 'events': events}
+
+
+def decode_event_record(data, offset=0):
+    """Decodifica um event_record_t (16 bytes) em um dicionário"""
+    timestamp_ms, delta, power, sequence, device_type, flags = EVENT_RECORD.unpack_from(data, offset)
+    return {
+        'timestamp_ms': timestamp_ms, 'delta_power': delta, 'power': power,
+        'sequence': sequence, 'device_type': device_type,
+        'device': DEVICE_NAMES[device_type] if device_type < len(DEVICE_NAMES) else 'Undefined',
+        'on': bool(flags & EVENT_FLAG_ON),
+        'steady': bool(flags & EVENT_FLAG_STEADY),
+    }
+
+
+def decode_power_summary(payload):
+    """Decodifica um resumo TYPE_POWER_SUMMARY em um dicionário"""
+    keys = ('timestamp_ms', 'period_ms', 'n_samples', 'n_events', 'mean_power',
+            'min_power', 'max_power', 'baseline_power', 'threshold', 'mean_reactive', 'mean_apparent')
+    return dict(zip(keys, POWER_SUMMARY.unpack_from(payload)))
+
+
+def decode_harmonics(payload):
+    """
+    Decodifica um registro TYPE_HARMONICS:
+    {'f0', 'thd', 'amplitude': array, 'phase': array} (índice 0 = fundamental)
+    """
+    f0, thd, n_harmonics = HARMONICS_HEADER.unpack_from(payload)
+    pairs = np.frombuffer(payload, dtype='<f4', count=2 * n_harmonics, offset=HARMONICS_HEADER.size)
+    return {'f0': f0, 'thd': thd, 'amplitude': pairs[0::2].astype(np.float64),
+            'phase': pairs[1::2].astype(np.float64)}
+
+
+def decode_spectral_event(payload, sample_rate_hz=10000):
+    """Decodifica um registro TYPE_SPECTRAL_EVENT (frequência do bin em Hz)"""
+    time_us, sample_index, k, window, amplitude, baseline = SPECTRAL_EVENT.unpack_from(payload)
+    return {'time_us': time_us, 'sample_index': sample_index, 'bin': k,
+            'frequency_hz': k * sample_rate_hz / window if window else 0.0,
+            'amplitude': amplitude, 'baseline': baseline}
+
+
+def decode_power_log(data):
+    """
+    Decodifica um dump da partição "powerlog" (esptool.py read_flash).
+
+    Returns:
+    --------
+    dict
+        boot_id -> {'index': índices das amostras, 'power': W (arrays),
+                    'period_ms', 'events': [dict de decode_event_record + 'sample_index']}
+    """
+    sectors = []
+    for offset in range(0, len(data) - POWER_LOG_SECTOR_SIZE + 1, POWER_LOG_SECTOR_SIZE):
+        magic, version, period_ms, sequence, boot_id, start_index, start_ms = \
+            POWER_LOG_HEADER.unpack_from(data, offset)
+        if magic == POWER_LOG_MAGIC and version == 1:
+            sectors.append((sequence, offset, boot_id, start_index, period_ms))
+
+    boots = {}
+    for _, offset, boot_id, index, period_ms in sorted(sectors):
+        boot = boots.setdefault(boot_id, {'index': [], 'power': [], 'period_ms': period_ms, 'events': []})
+        words = np.frombuffer(data, dtype='<u4', count=POWER_LOG_SECTOR_SIZE // 4, offset=offset)
+        powers = words.view('<f4')
+        i = POWER_LOG_HEADER.size // 4
+        while i < len(words) and words[i] != POWER_LOG_ERASED:
+            if words[i] == POWER_LOG_MARK_EVENT:
+                if i + 5 > len(words):
+                    break
+                event = decode_event_record(data, offset + 4 * (i + 1))
+                event['sample_index'] = index - 1
+                boot['events'].append(event)
+                i += 5
+            elif words[i] == POWER_LOG_MARK_GAP:
+                index = int(words[i + 1])
+                i += 2
+            else:
+                stop = i
+                while stop < len(words) and words[stop] not in (POWER_LOG_ERASED, POWER_LOG_MARK_EVENT,
+                                                                 POWER_LOG_MARK_GAP):
+                    stop += 1
+                boot['index'].append(np.arange(index, index + stop - i, dtype=np.uint32))
+                boot['power'].append(powers[i:stop].astype(np.float32))
+                index += stop - i
+                i = stop
+
+    for boot in boots.values():
+        boot['index'] = np.concatenate(boot['index']) if boot['index'] else np.empty(0, np.uint32)
+        boot['power'] = np.concatenate(boot['power']) if boot['power'] else np.empty(0, np.float32)
+    return boots
+
+
+def format_perf_record(record):
+    """Texto de uma linha por estágio (ciclos convertidos para µs)"""
+    lines = []
+    cycles_per_us = record['cpu_freq_hz'] / 1e6 if record['cpu_freq_hz'] else 1.0
+    for name, st in record['stages'].items():
+        div = cycles_per_us if st['unit'] == 'cycles' else 1.0
+        lines.append(f"  {name:<8} n={st['count']:<6} min={st['min'] / div:9.1f}us "
+                     f"avg={st['avg'] / div:9.1f}us p99={st['p99'] / div:9.1f}us "
+                     f"max={st['max'] / div:9.1f}us")
+    lines.append('  ' + ' '.join(f"{k}={v}" for k, v in record['gauges'].items()))
+    return '\n'.join(lines)
+
+
+def block_axis(frame):
+    """Eixo X do bloco: tempo (s) para sinais, frequência (Hz) para espectros"""
+    index = np.arange(frame.n_values) if frame.bins is None else frame.bins
+    if frame.type in (TYPE_FFT_ORIGINAL, TYPE_FFT_FILTERED):
+        return index * frame.sample_rate_hz / frame.frame_size
+    return index / frame.sample_rate_hz
+
+
+class FrameDecoder:
+    """
+    Decodificador incremental: recebe bytes da serial e devolve quadros completos.
+    """
+
+    def __init__(self):
+        self.buffer = bytearray()
+        self.frames_ok = 0
+        self.crc_errors = 0
+
+    def feed(self, data):
+        """
+        Acrescenta bytes ao buffer e retorna a lista de quadros decodificados.
+        """
+        self.buffer.extend(data)
+        frames = []
+
+        while True:
+            start = self.buffer.find(SYNC_BYTES)
+            if start < 0:
+                # Mantém o último byte caso seja o início de um sincronismo
+                del self.buffer[:max(0, len(self.buffer) - 1)]
+                break
+            if start > 0:
+                del self.buffer[:start]
+
+            if len(self.buffer) < HEADER.size:
+                break
+
+            (_, version, ftype, fmt, flags, n_values, frame_size, payload_len,
+             packet_id, sample_rate_hz, scale, offset) = HEADER.unpack_from(self.buffer)
+
+            if version != VERSION or payload_len > MAX_PAYLOAD:
+                # Falso sincronismo: descarta e procura o próximo
+                del self.buffer[:1]
+                continue
+
+            frame_len = HEADER.size + payload_len + CRC_SIZE
+            if len(self.buffer) < frame_len:
+                break
+
+            body = bytes(self.buffer[:HEADER.size + payload_len])
+            crc_rx = self.buffer[frame_len - 2] | (self.buffer[frame_len - 1] << 8)
+            if crc16_ccitt(body) != crc_rx:
+                self.crc_errors += 1
+                del self.buffer[:1]
+                continue
+
+            del self.buffer[:frame_len]
+            self.frames_ok += 1
+
+            try:
+                if fmt == FORMAT_SPARSE_I16:
+                    bins, values = decode_sparse(body[HEADER.size:], scale, offset)
+                else:
+                    bins, values = None, decode_payload(fmt, body[HEADER.size:], scale, offset, n_values)
+            except ValueError:
+                # Formato desconhecido ou payload inconsistente (CRC válido): ignora o quadro
+                continue
+            frames.append(TelemetryFrame(ftype, fmt, flags, n_values, frame_size,
+                                         packet_id, sample_rate_hz, scale, offset, values, bins))
+
+        return frames